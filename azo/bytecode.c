@@ -47,6 +47,7 @@ AZOBCInfo bc_info[] = {
 	{AZO_TC_PUSH_EMPTY, "PUSH EMPTY", ARG_TYPE32},
 	{PUSH_IMMEDIATE, "PUSH IMMEDIATE", ARG_TYPE8_VALUE},
 	{AZO_TC_PUSH_VALUE, "PUSH VALUE", ARG_VALUE32},
+	{AZO_TC_PUSH_ENV_VALUE, "PUSH ENV VALUE", ARG_U32},
 	{AZO_TC_DUPLICATE, "DUPLICATE", ARG_U32},
 	{AZO_TC_DUPLICATE_FRAME, "DUPLICATE FRAME", ARG_U32},
 	{AZO_TC_EXCHANGE, "EXCHANGE", ARG_U32},
@@ -102,13 +103,21 @@ AZOBCInfo bc_info[] = {
 	{AZO_TC_INVOKE, "INVOKE", ARG_U8},
 	{AZO_TC_RETURN, "RETURN", ARG_NONE},
 	{AZO_TC_RETURN_VALUE, "RETURN VALUE", ARG_NONE},
-	{AZO_TC_BIND, "BIND", ARG_U32},
+	{AZO_TC_MAKE_CLOSURE, "MAKE CLOSURE", ARG_U32},
+	{AZO_TC_YIELD, "YIELD", ARG_NONE},
+	{AZO_TC_ITERATE, "ITERATE", ARG_U32},
 
 	{NEW_ARRAY, "NEW ARRAY", ARG_NONE},
 	{LOAD_ARRAY_ELEMENT, "LOAD ARRAY ELEMENT", ARG_NONE},
 	{WRITE_ARRAY_ELEMENT, "WRITE ARRAY ELEMENT"},
+	{LOAD_ARRAY_ELEMENT_U32_NOCHECK, "LOAD ARRAY ELEMENT U32 NOCHECK", ARG_NONE},
+	{TEST_ARRAY_SIZE, "TEST ARRAY SIZE", ARG_NONE},
+	{NEW_TYPED_ARRAY, "NEW TYPED ARRAY", ARG_TYPE32},
+	{VECTOR_ARITHMETIC, "VECTOR ARITHMETIC", ARG_U8},
+	{COPY_ARRAY, "COPY ARRAY", ARG_NONE},
 
 	{AZO_TC_GET_GLOBAL, "GET GLOBAL", ARG_NONE},
+	{GET_GLOBAL_SLOT, "GET GLOBAL SLOT", ARG_U32},
 	{AZO_TC_GET_PROPERTY, "GET PROPERTY", ARG_NONE},
 	{AZO_TC_GET_FUNCTION, "GET FUNCTION", ARG_U8},
 	{AZO_TC_SET_PROPERTY, "SET PROPERTY", ARG_NONE},
@@ -334,6 +343,24 @@ print_NEW_ARRAY (const unsigned char *ip)
 	return ip + 1;
 }
 
+static const unsigned char *
+print_GET_GLOBAL_SLOT (const unsigned char *ip)
+{
+	unsigned int slot;
+	memcpy (&slot, ip + 1, 4);
+	fprintf (stdout, "GET_GLOBAL_SLOT %u\n", slot);
+	return ip + 5;
+}
+
+static const unsigned char *
+print_NEW_TYPED_ARRAY (const unsigned char *ip)
+{
+	unsigned int type;
+	memcpy (&type, ip + 1, 4);
+	fprintf (stdout, "NEW_TYPED_ARRAY %s\n", az_type_get_class (type)->name);
+	return ip + 5;
+}
+
 static const unsigned char *
 print_LOAD_ARRAY_ELEMENT (const unsigned char *ip)
 {
@@ -402,11 +429,37 @@ print_bytecode (AZOProgram *prog)
 		case WRITE_ARRAY_ELEMENT:
 			ip = print_WRITE_ARRAY_ELEMENT (ip);
 			break;
+		case LOAD_ARRAY_ELEMENT_U32_NOCHECK:
+			fprintf (stdout, "LOAD_ARRAY_ELEMENT_U32_NOCHECK\n");
+			ip += 1;
+			break;
+		case TEST_ARRAY_SIZE:
+			fprintf (stdout, "TEST_ARRAY_SIZE\n");
+			ip += 1;
+			break;
+		case NEW_TYPED_ARRAY:
+			ip = print_NEW_TYPED_ARRAY (ip);
+			break;
+		case VECTOR_ARITHMETIC:
+			fprintf (stdout, "VECTOR_ARITHMETIC %u\n", ip[1]);
+			ip += 2;
+			break;
+		case COPY_ARRAY:
+			fprintf (stdout, "COPY_ARRAY\n");
+			ip += 1;
+			break;
+		case GET_GLOBAL_SLOT:
+			ip = print_GET_GLOBAL_SLOT (ip);
+			break;
 		default:
 			fprintf (stdout, "UNKNOWN %08X", *ip);
 			ip += 1;
 			break;
 		}
 	}
+	for (unsigned int i = 0; i < prog->n_handlers; i++) {
+		const AZOExceptionHandler *h = &prog->handlers[i];
+		fprintf (stdout, "CATCH %04X-%04X -> %04X DEPTH %u\n", h->start, h->end, h->handler, h->depth);
+	}
 }
 
@@ -15,6 +15,11 @@ extern "C" {
 
 #define AZO_TC_CHECK_ARGS 128
 
+/* Operand flags of VECTOR_ARITHMETIC */
+#define AZO_VECTOR_LHS_TEMPORARY 64
+#define AZO_VECTOR_RHS_TEMPORARY 128
+#define AZO_VECTOR_OPERATION_MASK 63
+
 enum {
 	NOP = 0,
 
@@ -65,6 +70,14 @@ enum {
 	PUSH_IMMEDIATE,
 	/* PUSH_VALUE LOCATION(U32) */
 	AZO_TC_PUSH_VALUE,
+	/**
+	 * @brief Pushes a captured value from the environment of current closure
+	 * 
+	 * PUSH_ENV_VALUE U32:POS
+	 * [...]
+	 * [..., val]
+	 */
+	AZO_TC_PUSH_ENV_VALUE,
 	/**
 	 * @brief Pushes a duplicate of an element into stack
 	 * 
@@ -227,9 +240,32 @@ enum {
 	 * [value]
 	 */
 	AZO_TC_RETURN_VALUE,
-	/* Bind function */
-	/* FUNCTION -> FUNCTION */
-	AZO_TC_BIND,
+	/**
+	 * @brief Create closure of compiled function and captured values
+	 * 
+	 * MAKE_CLOSURE U32:N_VALUES
+	 * [func, val1, ..., valn]
+	 * [closure]
+	 */
+	AZO_TC_MAKE_CLOSURE,
+	/**
+	 * @brief Suspend run with value
+	 * 
+	 * YIELD
+	 * [value]
+	 * []
+	 * 
+	 * Value is moved to interpreter, run is resumed at the next instruction
+	 */
+	AZO_TC_YIELD,
+	/*
+	 * ITERATE U32:POS
+	 * [...collection, index...]
+	 * [...collection, index + 1..., element, true] | [...collection, index..., false]
+	 * 
+	 * Collection and u32 index are frame values at POS and POS + 1, collection is list or generator
+	 */
+	AZO_TC_ITERATE,
 
 	/* Arrays */
 
@@ -243,9 +279,72 @@ enum {
 	/* WRITE_ARRAY_ELEMENT */
 	/* Array, index, value - the last two are popped from stack */
 	WRITE_ARRAY_ELEMENT,
+	/**
+	 * @brief Load array element without checks
+	 * 
+	 * LOAD_ARRAY_ELEMENT_U32_NOCHECK
+	 * [array, index]
+	 * [array, value]
+	 * 
+	 * Index has to be 32-bit integer below the size of list, array has to implement list.
+	 * Only emitted for loops guarded by TEST_ARRAY_SIZE.
+	 */
+	LOAD_ARRAY_ELEMENT_U32_NOCHECK,
+	/**
+	 * @brief Test whether integer bound does not exceed the size of list
+	 * 
+	 * TEST_ARRAY_SIZE
+	 * [array, bound]
+	 * [boolean]
+	 * 
+	 * Result is false if array is not list or bound is not 32-bit integer
+	 */
+	TEST_ARRAY_SIZE,
+	/**
+	 * @brief Create new typed array
+	 * 
+	 * NEW_TYPED_ARRAY TYPE32:ELEMENT_TYPE
+	 * [size | list]
+	 * [array]
+	 * 
+	 * If the argument is list, its elements are converted to element type
+	 */
+	NEW_TYPED_ARRAY,
+	/**
+	 * @brief Elementwise arithmetic on arrays
+	 * 
+	 * VECTOR_ARITHMETIC U8:OPERATION
+	 * [lhs, rhs]
+	 * [array]
+	 * 
+	 * At least one operand is list, the other is list or number. Operation is AZO_SIMD_ADD, SUBTRACT, MULTIPLY or
+	 * DIVIDE, optionally or-ed with AZO_VECTOR_LHS_TEMPORARY and/or AZO_VECTOR_RHS_TEMPORARY if the operand is
+	 * the result of another vector operation that is not referenced elsewhere. Result is written into such operand.
+	 */
+	VECTOR_ARITHMETIC,
+	/**
+	 * @brief Copy constant value array
+	 * 
+	 * COPY_ARRAY
+	 * [array]
+	 * [copy]
+	 * 
+	 * Nested value arrays are copied too, used for literal arrays that are stored in program values
+	 */
+	COPY_ARRAY,
 
 	/* Key */
 	AZO_TC_GET_GLOBAL,
+	/**
+	 * @brief Pushes the value of variable global definition
+	 * 
+	 * GET_GLOBAL_SLOT U32:SLOT
+	 * [...]
+	 * [..., val]
+	 * 
+	 * Slot is the index of definition in context, resolved by compiler
+	 */
+	GET_GLOBAL_SLOT,
 	/* Instance, key -> value|null */
 	AZO_TC_GET_PROPERTY,
 	/**
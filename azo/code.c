@@ -31,6 +31,7 @@ azo_code_clear(AZOCode *code)
 		for (i = 0; i < code->data_len; i++) az_packed_value_clear(&code->data[i]);
 		free (code->data);
 	}
+	if (code->handlers) free (code->handlers);
 }
 
 static void
@@ -83,6 +84,20 @@ azo_code_reserve_data(AZOCode *code, unsigned int amount)
 	code->data_len = amount;
 }
 
+void
+azo_code_add_handler (AZOCode *code, unsigned int start, unsigned int end, unsigned int handler, unsigned int depth)
+{
+	if (code->n_handlers >= code->size_handlers) {
+		code->size_handlers = (code->size_handlers) ? code->size_handlers << 1 : 4;
+		code->handlers = (AZOExceptionHandler *) realloc (code->handlers, code->size_handlers * sizeof (AZOExceptionHandler));
+	}
+	AZOExceptionHandler *h = &code->handlers[code->n_handlers++];
+	h->start = start;
+	h->end = end;
+	h->handler = handler;
+	h->depth = depth;
+}
+
 int
 azo_code_find_block(AZOCode *code, const AZImplementation *impl, void *block)
 {
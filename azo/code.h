@@ -16,6 +16,16 @@ extern "C" {
 #endif
 
 typedef struct _AZOCode AZOCode;
+typedef struct _AZOExceptionHandler AZOExceptionHandler;
+
+/* Protected bytecode range [start, end), exceptions thrown inside continue at handler */
+struct _AZOExceptionHandler {
+	uint32_t start;
+	uint32_t end;
+	uint32_t handler;
+	/* Stack size relative to frame at the start of handler, exception is pushed on top of it */
+	uint32_t depth;
+};
 
 struct _AZOCode {
 	/**
@@ -35,6 +45,10 @@ struct _AZOCode {
 	unsigned int data_size;
 	unsigned int data_len;
 	AZPackedValue *data;
+	/* Exception table, inner ranges precede outer ones */
+	unsigned int n_handlers;
+	unsigned int size_handlers;
+	AZOExceptionHandler *handlers;
 };
 
 void azo_code_init(AZOCode *code, unsigned int debug);
@@ -107,6 +121,19 @@ unsigned int azo_code_write_instance(AZOCode *code, const AZImplementation *impl
 
 void azo_code_reserve_data (AZOCode *code, unsigned int amount);
 
+/**
+ * @brief Append an entry to exception table
+ *
+ * Entries are searched in order, so the range of nested try has to be added before enclosing one.
+ *
+ * @param code the code container
+ * @param start the start of protected range
+ * @param end the end of protected range (exclusive)
+ * @param handler the address of handler
+ * @param depth the stack size relative to frame when handler starts
+ */
+void azo_code_add_handler (AZOCode *code, unsigned int start, unsigned int end, unsigned int handler, unsigned int depth);
+
 int azo_code_find_block(AZOCode *code, const AZImplementation *impl, void *block);
 
 #ifdef __cplusplus
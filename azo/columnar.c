@@ -0,0 +1,687 @@
+#define __AZO_COLUMNAR_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#define noDEBUG_COLUMNAR
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/class.h>
+#include <az/types.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/compiler/ir.h>
+#include <azo/interpreter.h>
+#include <azo/optimizer.h>
+#include <azo/parser.h>
+#include <azo/program.h>
+#include <azo/simd.h>
+
+#include <azo/columnar.h>
+
+/* Column operations */
+enum {
+	/* Argument column a */
+	COL_PARAM,
+	/* Constant k, broadcast to buffer at the start of evaluation */
+	COL_CONST,
+	/* Convert a to type */
+	COL_CONVERT,
+	/* a op b, subtype is AZO_SIMD_* */
+	COL_BINARY,
+	/* a cmp b, subtype is COMPARISON_*, operands are of arg_type */
+	COL_COMPARE,
+	COL_NEGATE,
+	/* Boolean operations */
+	COL_NOT,
+	COL_AND,
+	COL_OR
+};
+
+typedef struct _AZOColumnarOp AZOColumnarOp;
+
+struct _AZOColumnarOp {
+	unsigned int op;
+	unsigned int subtype;
+	/* Result type */
+	unsigned int type;
+	/* Operand type of comparison */
+	unsigned int arg_type;
+	unsigned int a;
+	unsigned int b;
+	AZValue k;
+};
+
+struct _AZOColumnarPlan {
+	AZOContext *ctx;
+	unsigned int ret_type;
+	unsigned int n_args;
+	unsigned int *arg_types;
+	/* Scalar program, arguments are preceded by this */
+	AZOProgram *prog;
+	/* Column operations, empty if plan is not vectorized */
+	unsigned int n_ops;
+	unsigned int size_ops;
+	AZOColumnarOp *ops;
+	unsigned int result;
+};
+
+static unsigned int
+column_type_is_supported (unsigned int type)
+{
+	return azo_simd_is_element_type (type) || (type == AZ_TYPE_BOOLEAN);
+}
+
+static unsigned int
+column_size (unsigned int type)
+{
+	switch (type) {
+	case AZ_TYPE_INT64:
+	case AZ_TYPE_DOUBLE:
+		return 8;
+	case AZ_TYPE_BOOLEAN:
+		return 1;
+	default:
+		break;
+	}
+	return 4;
+}
+
+/* Numeric conversion, types are element types of simd.h */
+
+#define CONVERT_LOOP(TD,TS) for (unsigned int i = 0; i < n; i++) ((TD *) d)[i] = (TD) ((const TS *) s)[i]; break;
+#define CONVERT_FROM(TD) \
+	switch (src_type) { \
+	case AZ_TYPE_INT32: CONVERT_LOOP(TD, int32_t) \
+	case AZ_TYPE_UINT32: CONVERT_LOOP(TD, uint32_t) \
+	case AZ_TYPE_INT64: CONVERT_LOOP(TD, int64_t) \
+	case AZ_TYPE_FLOAT: CONVERT_LOOP(TD, float) \
+	case AZ_TYPE_DOUBLE: CONVERT_LOOP(TD, double) \
+	} \
+	break;
+
+static void
+convert_values (unsigned int dst_type, void *d, unsigned int src_type, const void *s, unsigned int n)
+{
+	switch (dst_type) {
+	case AZ_TYPE_INT32: CONVERT_FROM(int32_t)
+	case AZ_TYPE_UINT32: CONVERT_FROM(uint32_t)
+	case AZ_TYPE_INT64: CONVERT_FROM(int64_t)
+	case AZ_TYPE_FLOAT: CONVERT_FROM(float)
+	case AZ_TYPE_DOUBLE: CONVERT_FROM(double)
+	}
+}
+
+#define COMPARE_LOOP(T) { \
+	const T *x = (const T *) a; \
+	const T *y = (const T *) b; \
+	switch (cmp) { \
+	case COMPARISON_E: for (unsigned int i = 0; i < n; i++) d[i] = x[i] == y[i]; break; \
+	case COMPARISON_NE: for (unsigned int i = 0; i < n; i++) d[i] = x[i] != y[i]; break; \
+	case COMPARISON_LT: for (unsigned int i = 0; i < n; i++) d[i] = x[i] < y[i]; break; \
+	case COMPARISON_LE: for (unsigned int i = 0; i < n; i++) d[i] = x[i] <= y[i]; break; \
+	case COMPARISON_GT: for (unsigned int i = 0; i < n; i++) d[i] = x[i] > y[i]; break; \
+	case COMPARISON_GE: for (unsigned int i = 0; i < n; i++) d[i] = x[i] >= y[i]; break; \
+	} \
+	break; \
+}
+
+static void
+compare_values (unsigned int type, unsigned int cmp, uint8_t *d, const void *a, const void *b, unsigned int n)
+{
+	switch (type) {
+	case AZ_TYPE_INT32: COMPARE_LOOP(int32_t)
+	case AZ_TYPE_UINT32: COMPARE_LOOP(uint32_t)
+	case AZ_TYPE_INT64: COMPARE_LOOP(int64_t)
+	case AZ_TYPE_FLOAT: COMPARE_LOOP(float)
+	case AZ_TYPE_DOUBLE: COMPARE_LOOP(double)
+	case AZ_TYPE_BOOLEAN: COMPARE_LOOP(uint8_t)
+	}
+}
+
+static void
+negate_values (unsigned int type, void *d, const void *a, unsigned int n)
+{
+	switch (type) {
+	case AZ_TYPE_INT32:
+		/* Wraps around like scalar negation */
+		for (unsigned int i = 0; i < n; i++) ((int32_t *) d)[i] = (int32_t) (0U - ((const uint32_t *) a)[i]);
+		break;
+	case AZ_TYPE_INT64:
+		for (unsigned int i = 0; i < n; i++) ((int64_t *) d)[i] = (int64_t) (0ULL - ((const uint64_t *) a)[i]);
+		break;
+	case AZ_TYPE_FLOAT:
+		for (unsigned int i = 0; i < n; i++) ((float *) d)[i] = -((const float *) a)[i];
+		break;
+	case AZ_TYPE_DOUBLE:
+		for (unsigned int i = 0; i < n; i++) ((double *) d)[i] = -((const double *) a)[i];
+		break;
+	}
+}
+
+static unsigned int
+has_zero (unsigned int type, const void *a, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		if ((type == AZ_TYPE_INT32) && !((const int32_t *) a)[i]) return 1;
+		if ((type == AZ_TYPE_UINT32) && !((const uint32_t *) a)[i]) return 1;
+		if ((type == AZ_TYPE_INT64) && !((const int64_t *) a)[i]) return 1;
+	}
+	return 0;
+}
+
+/* Building from IR */
+
+#define NO_OP 0xffffffff
+
+typedef struct _PlanBuilder PlanBuilder;
+
+struct _PlanBuilder {
+	AZOColumnarPlan *plan;
+	/* Operation index by IR value id */
+	unsigned int *ops;
+};
+
+static unsigned int
+add_op (AZOColumnarPlan *plan, unsigned int op, unsigned int subtype, unsigned int type, unsigned int a, unsigned int b)
+{
+	if (plan->n_ops >= plan->size_ops) {
+		plan->size_ops = (plan->size_ops) ? plan->size_ops << 1 : 16;
+		plan->ops = (AZOColumnarOp *) realloc (plan->ops, plan->size_ops * sizeof (AZOColumnarOp));
+	}
+	AZOColumnarOp *cop = &plan->ops[plan->n_ops];
+	memset (cop, 0, sizeof (AZOColumnarOp));
+	cop->op = op;
+	cop->subtype = subtype;
+	cop->type = type;
+	cop->arg_type = type;
+	cop->a = a;
+	cop->b = b;
+	return plan->n_ops++;
+}
+
+/* Same as the promotion of interpreter, limited to column types */
+
+static unsigned int
+promote_types (unsigned int lhs, unsigned int rhs)
+{
+	if (!azo_simd_is_element_type (lhs) || !azo_simd_is_element_type (rhs)) return AZ_TYPE_NONE;
+	unsigned int type = (lhs > rhs) ? lhs : rhs;
+	return (azo_simd_is_element_type (type)) ? type : AZ_TYPE_NONE;
+}
+
+static unsigned int
+convert_op (AZOColumnarPlan *plan, unsigned int idx, unsigned int type)
+{
+	AZOColumnarOp *src = &plan->ops[idx];
+	if (src->type == type) return idx;
+	if (src->op == COL_CONST) {
+		AZValue k = src->k;
+		unsigned int src_type = src->type;
+		idx = add_op (plan, COL_CONST, 0, type, 0, 0);
+		convert_values (type, &plan->ops[idx].k, src_type, &k, 1);
+		return idx;
+	}
+	return add_op (plan, COL_CONVERT, 0, type, idx, 0);
+}
+
+static unsigned int
+build_value (PlanBuilder *b, AZOIRValue *val)
+{
+	AZOColumnarPlan *plan = b->plan;
+	unsigned int lhs, rhs, type, idx = NO_OP;
+	val = azo_ir_value_get (val);
+	if (b->ops[val->id] != NO_OP) return b->ops[val->id];
+	switch (val->op) {
+	case AZO_IR_CONST:
+		if (!column_type_is_supported (val->type)) return NO_OP;
+		idx = add_op (plan, COL_CONST, 0, val->type, 0, 0);
+		if (val->type == AZ_TYPE_BOOLEAN) {
+			plan->ops[idx].k.uint32_v = (val->value.v.boolean_v != 0);
+		} else {
+			plan->ops[idx].k = val->value.v;
+		}
+		break;
+	case AZO_IR_PARAM:
+		/* Position 0 is this */
+		if (!val->pos || (val->pos > plan->n_args)) return NO_OP;
+		idx = add_op (plan, COL_PARAM, 0, plan->arg_types[val->pos - 1], val->pos - 1, 0);
+		break;
+	case AZO_IR_PHI:
+		/* Only results of && and || */
+		if ((val->subtype != ARITHMETIC_ANDAND) && (val->subtype != ARITHMETIC_OROR)) return NO_OP;
+		if ((val->n_args != 3) || (val->block->n_preds != 3)) return NO_OP;
+		if ((val->block->preds[0]->term != AZO_IR_BRANCH) || (val->block->preds[1]->term != AZO_IR_BRANCH)) return NO_OP;
+		lhs = build_value (b, val->block->preds[0]->cond);
+		if (lhs == NO_OP) return NO_OP;
+		rhs = build_value (b, val->block->preds[1]->cond);
+		if (rhs == NO_OP) return NO_OP;
+		if ((plan->ops[lhs].type != AZ_TYPE_BOOLEAN) || (plan->ops[rhs].type != AZ_TYPE_BOOLEAN)) return NO_OP;
+		/* Operands have no side effects, so evaluating both is the same as short circuit */
+		idx = add_op (plan, (val->subtype == ARITHMETIC_ANDAND) ? COL_AND : COL_OR, 0, AZ_TYPE_BOOLEAN, lhs, rhs);
+		break;
+	case AZO_IR_BINARY:
+	case AZO_IR_COMPARISON:
+		lhs = build_value (b, val->args[0]);
+		if (lhs == NO_OP) return NO_OP;
+		rhs = build_value (b, val->args[1]);
+		if (rhs == NO_OP) return NO_OP;
+		if ((plan->ops[lhs].op == COL_CONST) && (plan->ops[rhs].op == COL_CONST)) return NO_OP;
+		if ((plan->ops[lhs].type == AZ_TYPE_BOOLEAN) && (plan->ops[rhs].type == AZ_TYPE_BOOLEAN) && (val->op == AZO_IR_COMPARISON) &&
+			((val->subtype == COMPARISON_E) || (val->subtype == COMPARISON_NE))) {
+			idx = add_op (plan, COL_COMPARE, val->subtype, AZ_TYPE_BOOLEAN, lhs, rhs);
+			break;
+		}
+		type = promote_types (plan->ops[lhs].type, plan->ops[rhs].type);
+		if (!type) return NO_OP;
+		lhs = convert_op (plan, lhs, type);
+		rhs = convert_op (plan, rhs, type);
+		if (val->op == AZO_IR_COMPARISON) {
+			idx = add_op (plan, COL_COMPARE, val->subtype, AZ_TYPE_BOOLEAN, lhs, rhs);
+			plan->ops[idx].arg_type = type;
+			break;
+		}
+		switch (val->subtype) {
+		case ARITHMETIC_PLUS:
+			idx = add_op (plan, COL_BINARY, AZO_SIMD_ADD, type, lhs, rhs);
+			break;
+		case ARITHMETIC_MINUS:
+			idx = add_op (plan, COL_BINARY, AZO_SIMD_SUBTRACT, type, lhs, rhs);
+			break;
+		case ARITHMETIC_STAR:
+			idx = add_op (plan, COL_BINARY, AZO_SIMD_MULTIPLY, type, lhs, rhs);
+			break;
+		case ARITHMETIC_SLASH:
+			/* Constant integer zero always throws */
+			if ((plan->ops[rhs].op == COL_CONST) && has_zero (type, &plan->ops[rhs].k, 1)) return NO_OP;
+			idx = add_op (plan, COL_BINARY, AZO_SIMD_DIVIDE, type, lhs, rhs);
+			break;
+		default:
+			return NO_OP;
+		}
+		break;
+	case AZO_IR_PREFIX:
+		lhs = build_value (b, val->args[0]);
+		if (lhs == NO_OP) return NO_OP;
+		type = plan->ops[lhs].type;
+		if (val->subtype == PREFIX_PLUS) {
+			if ((type != AZ_TYPE_INT32) && (type != AZ_TYPE_INT64) && (type != AZ_TYPE_FLOAT) && (type != AZ_TYPE_DOUBLE)) return NO_OP;
+			idx = lhs;
+		} else if (val->subtype == PREFIX_MINUS) {
+			if ((type != AZ_TYPE_INT32) && (type != AZ_TYPE_INT64) && (type != AZ_TYPE_FLOAT) && (type != AZ_TYPE_DOUBLE)) return NO_OP;
+			idx = add_op (plan, COL_NEGATE, 0, type, lhs, 0);
+		} else if (val->subtype == PREFIX_NOT) {
+			if (type != AZ_TYPE_BOOLEAN) return NO_OP;
+			idx = add_op (plan, COL_NOT, 0, AZ_TYPE_BOOLEAN, lhs, 0);
+		} else {
+			return NO_OP;
+		}
+		break;
+	default:
+		return NO_OP;
+	}
+	b->ops[val->id] = idx;
+	return idx;
+}
+
+static unsigned int
+block_is_supported (AZOIRBlock *block)
+{
+	if ((block->term != AZO_IR_RETURN_VALUE) && (block->term != AZO_IR_BRANCH) && (block->term != AZO_IR_JUMP)) return 0;
+	for (unsigned int i = 0; i < block->n_values; i++) {
+		AZOIRValue *val = block->values[i];
+		if (val->removed) continue;
+		if (val->op == AZO_IR_PHI) {
+			if ((val->subtype != ARITHMETIC_ANDAND) && (val->subtype != ARITHMETIC_OROR)) return 0;
+		} else if ((val->op != AZO_IR_CONST) && (val->op != AZO_IR_PARAM) && (val->op != AZO_IR_BINARY) &&
+			(val->op != AZO_IR_COMPARISON) && (val->op != AZO_IR_PREFIX)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static unsigned int
+build_plan (AZOColumnarPlan *plan, AZOIRFunction *func)
+{
+	unsigned int n_blocks, result = 0;
+	AZOIRBlock **blocks = azo_ir_compute_order (func, &n_blocks);
+	AZOIRBlock *block = NULL;
+	/* Only code that returns value once, branches may only come from && and || */
+	for (unsigned int i = 0; i < n_blocks; i++) {
+		if (!block_is_supported (blocks[i])) {
+			block = NULL;
+			break;
+		}
+		if (blocks[i]->term == AZO_IR_RETURN_VALUE) {
+			if (block) {
+				block = NULL;
+				break;
+			}
+			block = blocks[i];
+		}
+	}
+	if (!block) {
+		free (blocks);
+		return 0;
+	}
+	PlanBuilder b;
+	b.plan = plan;
+	b.ops = (unsigned int *) malloc (func->n_values * sizeof (unsigned int));
+	for (unsigned int i = 0; i < func->n_values; i++) b.ops[i] = NO_OP;
+	unsigned int idx = build_value (&b, block->cond);
+	/* Branch on value that is not boolean throws in scalar code */
+	for (unsigned int i = 0; (idx != NO_OP) && (i < n_blocks); i++) {
+		if (blocks[i]->term != AZO_IR_BRANCH) continue;
+		unsigned int cond = b.ops[azo_ir_value_get (blocks[i]->cond)->id];
+		if ((cond == NO_OP) || (plan->ops[cond].type != AZ_TYPE_BOOLEAN)) idx = NO_OP;
+	}
+	free (b.ops);
+	free (blocks);
+	if (idx != NO_OP) {
+		unsigned int type = plan->ops[idx].type;
+		if (type == plan->ret_type) {
+			result = 1;
+		} else if ((type != AZ_TYPE_BOOLEAN) && (plan->ret_type != AZ_TYPE_BOOLEAN)) {
+			idx = convert_op (plan, idx, plan->ret_type);
+			result = 1;
+		}
+	}
+	if (!result) {
+		plan->n_ops = 0;
+		return 0;
+	}
+	plan->result = idx;
+	return 1;
+}
+
+AZOColumnarPlan *
+azo_columnar_plan_new (AZOContext *ctx, const uint8_t *name, unsigned int ret_type, unsigned int n_args, AZString *arg_names[], const unsigned int arg_types[],
+	const uint8_t *code, unsigned int code_len)
+{
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	if (!column_type_is_supported (ret_type)) return NULL;
+	for (unsigned int i = 0; i < n_args; i++) {
+		if (!column_type_is_supported (arg_types[i])) return NULL;
+	}
+	AZOCompiler comp;
+	azo_compiler_init (&comp, ctx);
+	comp.debug = 1;
+	azo_compiler_push_frame (&comp, NULL, NULL, ret_type);
+	for (unsigned int i = 0; i < n_args; i++) {
+		azo_compiler_declare_variable (&comp, arg_names[i], arg_types[i]);
+	}
+	AZOSource *src = azo_source_new_static (name, code, code_len);
+	AZOParser parser;
+	azo_parser_setup (&parser, src);
+	AZOExpression *root = azo_parser_parse (&parser);
+	root = azo_compiler_resolve_frame (&comp, root);
+
+	AZOColumnarPlan *plan = (AZOColumnarPlan *) malloc (sizeof (AZOColumnarPlan));
+	memset (plan, 0, sizeof (AZOColumnarPlan));
+	plan->ctx = ctx;
+	plan->ret_type = ret_type;
+	plan->n_args = n_args;
+	plan->arg_types = (unsigned int *) malloc ((n_args + 1) * sizeof (unsigned int));
+	if (n_args) memcpy (plan->arg_types, arg_types, n_args * sizeof (unsigned int));
+	if ((root->term.type == AZO_EXPRESSION_PROGRAM) || (root->term.type == AZO_EXPRESSION_BLOCK)) {
+		AZOIRFunction *func = azo_ir_build (&comp, root);
+		if (func) {
+			azo_ir_optimize (func);
+			build_plan (plan, func);
+			azo_ir_delete (func);
+		}
+	}
+	/* Scalar fallback */
+	plan->prog = azo_compiler_compile (&comp, root, 0, src);
+	azo_parser_release (&parser);
+	azo_source_unref (src);
+	azo_compiler_finalize (&comp);
+	if (!plan->prog) {
+		azo_columnar_plan_delete (plan);
+		return NULL;
+	}
+#ifdef DEBUG_COLUMNAR
+	azo_columnar_plan_dump (plan, stderr);
+#endif
+	return plan;
+}
+
+void
+azo_columnar_plan_delete (AZOColumnarPlan *plan)
+{
+	arikkei_return_if_fail (plan != NULL);
+	if (plan->prog) azo_program_delete (plan->prog);
+	free (plan->ops);
+	free (plan->arg_types);
+	free (plan);
+}
+
+unsigned int
+azo_columnar_plan_is_vectorized (AZOColumnarPlan *plan)
+{
+	arikkei_return_val_if_fail (plan != NULL, 0);
+	return plan->n_ops != 0;
+}
+
+static const char *op_names[] = {
+	"param", "const", "convert", "binary", "compare", "negate", "not", "and", "or"
+};
+
+void
+azo_columnar_plan_dump (AZOColumnarPlan *plan, FILE *ofs)
+{
+	arikkei_return_if_fail (plan != NULL);
+	if (!plan->n_ops) {
+		fprintf (ofs, "Columnar plan: scalar\n");
+		return;
+	}
+	fprintf (ofs, "Columnar plan: %u operations, result c%u\n", plan->n_ops, plan->result);
+	for (unsigned int i = 0; i < plan->n_ops; i++) {
+		AZOColumnarOp *cop = &plan->ops[i];
+		fprintf (ofs, "  c%u = %s.%u type %u", i, op_names[cop->op], cop->subtype, cop->type);
+		if (cop->op == COL_PARAM) {
+			fprintf (ofs, " column %u", cop->a);
+		} else if ((cop->op == COL_CONVERT) || (cop->op == COL_NEGATE) || (cop->op == COL_NOT)) {
+			fprintf (ofs, " c%u", cop->a);
+		} else if (cop->op != COL_CONST) {
+			fprintf (ofs, " c%u c%u", cop->a, cop->b);
+		}
+		fprintf (ofs, "\n");
+	}
+}
+
+/* Evaluation */
+
+/*
+ * Evaluate rows with vector operations
+ *
+ * Returns 0 if chunk has to be evaluated by interpreter.
+ */
+
+static unsigned int
+eval_chunk (AZOColumnarPlan *plan, unsigned int first, unsigned int n, const void *cols[], void *result, void **bufs)
+{
+	AZOColumnarOp *ops = plan->ops;
+	for (unsigned int i = 0; i < plan->n_ops; i++) {
+		AZOColumnarOp *cop = &ops[i];
+		switch (cop->op) {
+		case COL_PARAM:
+			bufs[i] = (uint8_t *) cols[cop->a] + (size_t) first * column_size (cop->type);
+			break;
+		case COL_CONST:
+			/* Buffer is filled once per evaluation */
+			break;
+		case COL_CONVERT:
+			convert_values (cop->type, bufs[i], ops[cop->a].type, bufs[cop->a], n);
+			break;
+		case COL_BINARY:
+			if ((cop->subtype == AZO_SIMD_DIVIDE) && (cop->type != AZ_TYPE_FLOAT) && (cop->type != AZ_TYPE_DOUBLE)) {
+				/* Let interpreter raise exception */
+				if ((ops[cop->b].op != COL_CONST) && has_zero (cop->type, bufs[cop->b], n)) return 0;
+			}
+			if (ops[cop->a].op == COL_CONST) {
+				azo_simd_scalar_binary (cop->type, cop->subtype, bufs[i], &ops[cop->a].k, bufs[cop->b], n);
+			} else if (ops[cop->b].op == COL_CONST) {
+				azo_simd_binary_scalar (cop->type, cop->subtype, bufs[i], bufs[cop->a], &ops[cop->b].k, n);
+			} else {
+				azo_simd_binary (cop->type, cop->subtype, bufs[i], bufs[cop->a], bufs[cop->b], n);
+			}
+			break;
+		case COL_COMPARE:
+			compare_values (cop->arg_type, cop->subtype, (uint8_t *) bufs[i], bufs[cop->a], bufs[cop->b], n);
+			break;
+		case COL_NEGATE:
+			negate_values (cop->type, bufs[i], bufs[cop->a], n);
+			break;
+		case COL_NOT:
+			for (unsigned int j = 0; j < n; j++) ((uint8_t *) bufs[i])[j] = !((const uint8_t *) bufs[cop->a])[j];
+			break;
+		case COL_AND:
+			for (unsigned int j = 0; j < n; j++) ((uint8_t *) bufs[i])[j] = ((const uint8_t *) bufs[cop->a])[j] & ((const uint8_t *) bufs[cop->b])[j];
+			break;
+		case COL_OR:
+			for (unsigned int j = 0; j < n; j++) ((uint8_t *) bufs[i])[j] = ((const uint8_t *) bufs[cop->a])[j] | ((const uint8_t *) bufs[cop->b])[j];
+			break;
+		}
+	}
+	unsigned int size = column_size (plan->ret_type);
+	memcpy ((uint8_t *) result + (size_t) first * size, bufs[plan->result], (size_t) n * size);
+	return 1;
+}
+
+static void
+load_value (unsigned int type, AZValue *val, const void *col, unsigned int row)
+{
+	switch (type) {
+	case AZ_TYPE_INT32:
+		val->int32_v = ((const int32_t *) col)[row];
+		break;
+	case AZ_TYPE_UINT32:
+		val->uint32_v = ((const uint32_t *) col)[row];
+		break;
+	case AZ_TYPE_INT64:
+		val->int64_v = ((const int64_t *) col)[row];
+		break;
+	case AZ_TYPE_FLOAT:
+		val->float_v = ((const float *) col)[row];
+		break;
+	case AZ_TYPE_DOUBLE:
+		val->double_v = ((const double *) col)[row];
+		break;
+	case AZ_TYPE_BOOLEAN:
+		val->boolean_v = ((const uint8_t *) col)[row];
+		break;
+	}
+}
+
+/* Store result of interpreter, return 0 if it cannot be converted to result type */
+
+static unsigned int
+store_value (unsigned int type, void *col, unsigned int row, const AZImplementation *impl, const AZValue *val)
+{
+	unsigned int size = column_size (type);
+	uint8_t *d = (uint8_t *) col + (size_t) row * size;
+	unsigned int src_type = (impl) ? AZ_IMPL_TYPE (impl) : AZ_TYPE_NONE;
+	if (type == AZ_TYPE_BOOLEAN) {
+		*d = (src_type == AZ_TYPE_BOOLEAN) && val->boolean_v;
+		return src_type == AZ_TYPE_BOOLEAN;
+	}
+	if (!azo_simd_is_element_type (src_type)) {
+		memset (d, 0, size);
+		return 0;
+	}
+	/* Primitive values are at the start of AZValue */
+	convert_values (type, d, src_type, val, 1);
+	return 1;
+}
+
+/* Evaluate rows with interpreter */
+
+static unsigned int
+eval_chunk_scalar (AZOColumnarPlan *plan, unsigned int first, unsigned int n, const void *cols[], void *result,
+	const AZImplementation **impls, const AZValue **vals, AZValue *buf, const AZImplementation **ret_impls, AZValue *ret_vals)
+{
+	unsigned int success = 1;
+	/* Column 0 is this */
+	for (unsigned int i = 0; i < plan->n_args; i++) {
+		AZValue *col = buf + (size_t) (i + 1) * AZO_COLUMNAR_CHUNK;
+		for (unsigned int j = 0; j < n; j++) load_value (plan->arg_types[i], &col[j], cols[i], first + j);
+	}
+	AZOInterpreter *intr = azo_context_get_interpreter (plan->ctx);
+	struct _AZOCompiledFunction *prev_closure = intr->closure;
+	intr->closure = NULL;
+	azo_program_interpret_batch (plan->prog, intr, n, plan->n_args + 1, impls, vals, ret_impls, ret_vals);
+	intr->closure = prev_closure;
+	for (unsigned int j = 0; j < n; j++) {
+		if (!store_value (plan->ret_type, result, first + j, ret_impls[j], &ret_vals[j])) success = 0;
+		if (ret_impls[j]) az_value_clear (ret_impls[j], &ret_vals[j]);
+	}
+	return success;
+}
+
+unsigned int
+azo_columnar_plan_eval (AZOColumnarPlan *plan, unsigned int n_rows, const void *cols[], void *result)
+{
+	unsigned int success = 1;
+	void **bufs = NULL;
+	uint8_t *data = NULL;
+	/* Scalar evaluation state is set up when needed */
+	const AZImplementation **impls = NULL;
+	const AZValue **vals = NULL;
+	AZValue *buf = NULL;
+	const AZImplementation **ret_impls = NULL;
+	AZValue *ret_vals = NULL;
+	arikkei_return_val_if_fail (plan != NULL, 0);
+	if (plan->n_ops) {
+		bufs = (void **) malloc (plan->n_ops * sizeof (void *));
+		data = (uint8_t *) malloc ((size_t) plan->n_ops * AZO_COLUMNAR_CHUNK * 8);
+		for (unsigned int i = 0; i < plan->n_ops; i++) {
+			AZOColumnarOp *cop = &plan->ops[i];
+			bufs[i] = data + (size_t) i * AZO_COLUMNAR_CHUNK * 8;
+			if (cop->op == COL_CONST) {
+				unsigned int size = column_size (cop->type);
+				if (cop->type == AZ_TYPE_BOOLEAN) {
+					memset (bufs[i], (int) cop->k.uint32_v, AZO_COLUMNAR_CHUNK);
+				} else {
+					for (unsigned int j = 0; j < AZO_COLUMNAR_CHUNK; j++) memcpy ((uint8_t *) bufs[i] + j * size, &cop->k, size);
+				}
+			}
+		}
+	}
+	for (unsigned int first = 0; first < n_rows; first += AZO_COLUMNAR_CHUNK) {
+		unsigned int n = ((n_rows - first) < AZO_COLUMNAR_CHUNK) ? n_rows - first : AZO_COLUMNAR_CHUNK;
+		if (plan->n_ops && eval_chunk (plan, first, n, cols, result, bufs)) continue;
+		if (!impls) {
+			unsigned int n_cols = plan->n_args + 1;
+			impls = (const AZImplementation **) malloc (n_cols * sizeof (AZImplementation *));
+			vals = (const AZValue **) malloc (n_cols * sizeof (AZValue *));
+			buf = (AZValue *) malloc ((size_t) n_cols * AZO_COLUMNAR_CHUNK * sizeof (AZValue));
+			memset (buf, 0, AZO_COLUMNAR_CHUNK * sizeof (AZValue));
+			impls[0] = NULL;
+			for (unsigned int i = 0; i < n_cols; i++) {
+				if (i) impls[i] = AZ_IMPL_FROM_TYPE (plan->arg_types[i - 1]);
+				vals[i] = buf + (size_t) i * AZO_COLUMNAR_CHUNK;
+			}
+			ret_impls = (const AZImplementation **) malloc (AZO_COLUMNAR_CHUNK * sizeof (AZImplementation *));
+			ret_vals = (AZValue *) malloc (AZO_COLUMNAR_CHUNK * sizeof (AZValue));
+		}
+		if (!eval_chunk_scalar (plan, first, n, cols, result, impls, vals, buf, ret_impls, ret_vals)) success = 0;
+	}
+	free (bufs);
+	free (data);
+	free (impls);
+	free (vals);
+	free (buf);
+	free (ret_impls);
+	free (ret_vals);
+	return success;
+}
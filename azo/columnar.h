@@ -0,0 +1,82 @@
+#ifndef __AZO_COLUMNAR_H__
+#define __AZO_COLUMNAR_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+typedef struct _AZOColumnarPlan AZOColumnarPlan;
+
+#include <stdio.h>
+
+#include <az/string.h>
+
+#include <azo/context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Columnar evaluation
+ *
+ * Expression over argument columns is compiled into a list of column operations that are run over
+ * chunks of AZO_COLUMNAR_CHUNK rows with element kernels of simd.h. The plan is built from the SSA IR of
+ * the program, so the expression is optimized the same way as scalar code.
+ *
+ * Columns are contiguous arrays of one of the element types of simd.h (int32, uint32, int64, float or
+ * double) or AZ_TYPE_BOOLEAN, boolean columns have one byte (0 or 1) per row.
+ *
+ * Programs that use anything besides arithmetic, comparisons and logic are run by scalar interpreter,
+ * one row at a time. So are chunks where integer division by zero would raise an exception.
+ */
+
+#define AZO_COLUMNAR_CHUNK 1024
+
+/**
+ * @brief Compile expression into columnar plan
+ *
+ * The code is compiled as with azo_program_compile_from_text without this, arguments are bound to
+ * columns in the order of arg_names. The result is returned with return statement.
+ *
+ * @param ctx the context
+ * @param name the name of source
+ * @param ret_type the type of result column
+ * @param n_args the number of arguments
+ * @param arg_names the argument names
+ * @param arg_types the types of argument columns
+ * @param code the source code
+ * @param code_len the length of source code
+ * @return a new plan or NULL if column type is not supported or code cannot be compiled
+ */
+AZOColumnarPlan *azo_columnar_plan_new (AZOContext *ctx, const uint8_t *name, unsigned int ret_type, unsigned int n_args, AZString *arg_names[], const unsigned int arg_types[],
+	const uint8_t *code, unsigned int code_len);
+void azo_columnar_plan_delete (AZOColumnarPlan *plan);
+
+/* Whether the whole expression is evaluated by column operations */
+unsigned int azo_columnar_plan_is_vectorized (AZOColumnarPlan *plan);
+/* Print column operations to file */
+void azo_columnar_plan_dump (AZOColumnarPlan *plan, FILE *ofs);
+
+/**
+ * @brief Evaluate plan over columns
+ *
+ * Rows where scalar evaluation throws an exception or does not return a value get zero result.
+ * Plan can be evaluated by several threads at once, scalar evaluation uses the interpreter of
+ * calling thread.
+ *
+ * @param plan the plan
+ * @param n_rows the number of rows
+ * @param cols the argument columns
+ * @param result the result column (n_rows elements)
+ * @return 1 if all rows were evaluated, 0 if some row failed
+ */
+unsigned int azo_columnar_plan_eval (AZOColumnarPlan *plan, unsigned int n_rows, const void *cols[], void *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <azo/compiled-function.h>
 #include <azo/expression.h>
+#include <azo/generator.h>
 
 static void aosora_compiled_function_class_init (AZOCompiledFunctionClass *klass);
 static void aosora_compiled_function_finalize (AZOCompiledFunctionClass *klass, AZOCompiledFunction *func);
@@ -73,7 +74,8 @@ aosora_compiled_function_class_init (AZOCompiledFunctionClass *klass)
 static void
 aosora_compiled_function_finalize (AZOCompiledFunctionClass *klass, AZOCompiledFunction *func)
 {
-	az_function_signature_delete(func->signature);
+	if (func->env) free (func->env);
+	if (func->signature) az_function_signature_delete(func->signature);
 }
 
 static void
@@ -84,7 +86,17 @@ compiled_function_shutdown (AZObject *obj)
 		azo_expression_free_tree (cfunc->root);
 		cfunc->root = NULL;
 	}
-	if (cfunc->prog) {
+	if (cfunc->env) {
+		for (unsigned int i = 0; i < cfunc->n_env; i++) az_packed_value_clear (&cfunc->env[i]);
+		cfunc->n_env = 0;
+	}
+	if (cfunc->proto) {
+		/* Program and signature are owned by prototype */
+		az_object_unref ((AZObject *) cfunc->proto);
+		cfunc->proto = NULL;
+		cfunc->prog = NULL;
+		cfunc->signature = NULL;
+	} else if (cfunc->prog) {
 		azo_program_delete (cfunc->prog);
 		cfunc->prog = NULL;
 	}
@@ -114,13 +126,25 @@ compiled_function_invoke (const AZFunctionImplementation *impl, void *inst, cons
 {
 	AZOCompiledFunction *cfunc = (AZOCompiledFunction *) inst;
 
+	if (cfunc->generator) {
+		AZOGenerator *gen = azo_generator_new (cfunc, arg_impls, arg_vals);
+		/* Reference is transferred to return value */
+		*ret_impl = (gen) ? (const AZImplementation *) gen->object.klass : NULL;
+		ret_val->value.reference = (AZReference *) gen;
+		return 1;
+	}
+
 	ARIKKEI_CHECK_INTEGRITY ();
-	/* We have to keep reference during invocation */
-	az_object_ref ((AZObject *) cfunc);
+	/* Caller holds reference during invocation, touching refcount would race with other threads */
 
-	azo_program_interpret_call(cfunc->prog, cfunc->ctx->intr, arg_impls, arg_vals, cfunc->signature->n_args, ret_impl, &ret_val->value, 64);
+	/* Functions of snapshot run in the fork that invoked them */
+	AZOInterpreter *intr = azo_interpreter_get_current ();
+	if (!intr || !azo_context_inherits (intr->ctx, cfunc->ctx)) intr = azo_context_get_interpreter (cfunc->ctx);
+	AZOCompiledFunction *prev_closure = intr->closure;
+	intr->closure = cfunc;
+	azo_program_interpret_call(cfunc->prog, intr, arg_impls, arg_vals, cfunc->signature->n_args, ret_impl, &ret_val->value, 64);
+	intr->closure = prev_closure;
 
-	az_object_unref ((AZObject *) cfunc);
 	ARIKKEI_CHECK_INTEGRITY ();
 
 	return 1;
@@ -143,6 +167,26 @@ azo_compiled_function_new (AZOContext *ctx, AZOProgram *program, unsigned int re
 	return func;
 }
 
+AZOCompiledFunction *
+azo_compiled_function_new_closure (AZOCompiledFunction *cfunc, unsigned int n_env)
+{
+	arikkei_return_val_if_fail (!cfunc->proto, NULL);
+	AZOCompiledFunction *closure = (AZOCompiledFunction *) az_object_new (AZO_TYPE_COMPILED_FUNCTION);
+	closure->ctx = cfunc->ctx;
+	closure->prog = cfunc->prog;
+	closure->proto = cfunc;
+	closure->generator = cfunc->generator;
+	az_object_ref ((AZObject *) cfunc);
+	closure->n_env = n_env;
+	if (n_env) {
+		closure->env = (AZPackedValue *) malloc (n_env * sizeof (AZPackedValue));
+		memset (closure->env, 0, n_env * sizeof (AZPackedValue));
+	}
+	/* Signature is shared with prototype */
+	closure->signature = cfunc->signature;
+	return closure;
+}
+
 #define noDEBUG_BIND
 
 void
@@ -154,6 +198,7 @@ azo_compiled_function_bind (AZOCompiledFunction *cfunc, unsigned int pos, const
 	d[len] = 0;
 	fprintf (stderr, "azo_compiled_function_bind: Binding %s to pos %u\n", d, pos);
 #endif
-	az_packed_value_set_from_impl_instance (&cfunc->prog->values[pos], impl, inst);
+	arikkei_return_if_fail (pos < cfunc->n_env);
+	az_packed_value_set_from_impl_instance (&cfunc->env[pos], impl, inst);
 	cfunc->bound = 1;
 }
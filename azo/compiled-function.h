@@ -32,8 +32,14 @@ struct _AZOCompiledFunction {
 	unsigned int bound;
 	AZOContext *ctx;
 	AZOExpression *root;
-	/* Code */
+	/* Function has yield, invocation returns generator instead of running the code */
+	unsigned int generator;
+	/* Code, owned unless this is closure */
 	AZOProgram *prog;
+	/* Closure: the function that owns the program and captured values */
+	AZOCompiledFunction *proto;
+	unsigned int n_env;
+	AZPackedValue *env;
 };
 
 struct _AZOCompiledFunctionClass {
@@ -46,6 +52,18 @@ unsigned int azo_compiled_function_get_type (void);
 
 AZOCompiledFunction *azo_compiled_function_new (AZOContext *ctx, AZOProgram *program, unsigned int ret_type, unsigned int nargs);
 
+/**
+ * @brief Create new closure of compiled function
+ * 
+ * The closure shares the program of function and has its own environment of n_env
+ * captured values that have to be set with azo_compiled_function_bind.
+ * 
+ * @param cfunc the compiled function (not closure)
+ * @param n_env the number of captured values
+ * @return a new closure
+ */
+AZOCompiledFunction *azo_compiled_function_new_closure (AZOCompiledFunction *cfunc, unsigned int n_env);
+
 void azo_compiled_function_bind (AZOCompiledFunction *cfunc, unsigned int pos, const AZImplementation *impl, void *inst);
 
 #ifdef __cplusplus
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include <azo/bytecode.h>
+#include <azo/simd.h>
 
 #include <azo/compiler/arithmetic.h>
 
@@ -33,8 +34,36 @@ compile_type_is_in_range (AZOCompiler *comp, unsigned int pos, uint32_t min_type
 	}
 }
 
+/* Get elementwise operation for arithmetic subtype, -1 if operation cannot be applied to arrays */
+
+static int
+get_vector_operation (unsigned int operation)
+{
+	switch (operation) {
+	case ARITHMETIC_PLUS:
+		return AZO_SIMD_ADD;
+	case ARITHMETIC_MINUS:
+		return AZO_SIMD_SUBTRACT;
+	case ARITHMETIC_STAR:
+		return AZO_SIMD_MULTIPLY;
+	case ARITHMETIC_SLASH:
+		return AZO_SIMD_DIVIDE;
+	default:
+		break;
+	}
+	return -1;
+}
+
+/* Whether the result of expression, if it is array, is a new array that is not referenced elsewhere */
+
 static unsigned int
-azo_compiler_compile_arithmetic_any_any (AZOCompiler *comp, unsigned int operation)
+is_vector_temporary (const AZOExpression *expr)
+{
+	return (expr->term.type == EXPRESSION_BINARY) && (get_vector_operation (expr->term.subtype) >= 0);
+}
+
+static unsigned int
+azo_compiler_compile_arithmetic_any_any (AZOCompiler *comp, unsigned int operation, unsigned int vector_flags)
 {
 	unsigned int lhs_type_lt_min, lhs_type_gt_max, rhs_type_lt_min, rhs_type_gt_max;
 	unsigned int max_ge_i32, types_equal_1, types_equal_2, lhs_type_gt_rhs_type, types_equal_3;
@@ -108,7 +137,12 @@ azo_compiler_compile_arithmetic_any_any (AZOCompiler *comp, unsigned int operati
 	azo_compiler_update_JMP_32 (comp, lhs_type_gt_max);
 	azo_compiler_update_JMP_32 (comp, rhs_type_lt_min);
 	azo_compiler_update_JMP_32 (comp, rhs_type_gt_max);
-	azo_compiler_write_EXCEPTION (comp, AZO_EXCEPTION_INVALID_TYPE, NULL);
+	if (get_vector_operation (operation) >= 0) {
+		/* Elementwise operation, throws INVALID_TYPE if neither operand is array */
+		azo_compiler_write_VECTOR_ARITHMETIC (comp, get_vector_operation (operation) | vector_flags, NULL);
+	} else {
+		azo_compiler_write_EXCEPTION (comp, AZO_EXCEPTION_INVALID_TYPE, NULL);
+	}
 
 	/* finished */
 	azo_compiler_update_JMP_32 (comp, finished);
@@ -142,8 +176,12 @@ azo_compiler_compile_arithmetic_boolean (AZOCompiler *comp, unsigned int operati
 unsigned int
 azo_compiler_compile_arithmetic (AZOCompiler *comp, const AZOExpression *lhs, const AZOExpression *rhs, const AZOExpression *expr, AZOSource *src)
 {
+	unsigned int vector_flags = 0;
 	if (!azo_compiler_compile_expression (comp, lhs, src)) return 0;
 	if (!azo_compiler_compile_expression (comp, rhs, src)) return 0;
+	/* Intermediate arrays of chained elementwise expression are overwritten instead of allocating new ones */
+	if (is_vector_temporary (lhs)) vector_flags |= AZO_VECTOR_LHS_TEMPORARY;
+	if (is_vector_temporary (rhs)) vector_flags |= AZO_VECTOR_RHS_TEMPORARY;
 	/* LHS RHS */
 	switch (expr->term.subtype) {
 	case ARITHMETIC_PLUS:
@@ -156,7 +194,7 @@ azo_compiler_compile_arithmetic (AZOCompiler *comp, const AZOExpression *lhs, co
 	case ARITHMETIC_AND:
 	case ARITHMETIC_OR:
 	case ARITHMETIC_CARET:
-		return azo_compiler_compile_arithmetic_any_any (comp, expr->term.subtype);
+		return azo_compiler_compile_arithmetic_any_any (comp, expr->term.subtype, vector_flags);
 	case ARITHMETIC_ANDAND:
 	case ARITHMETIC_OROR:
 		return azo_compiler_compile_arithmetic_boolean (comp, expr->term.subtype, expr);
@@ -29,11 +29,13 @@ static const int debug = 0;
 /* Bytecodes */
 #include <azo/bytecode.h>
 #include <azo/keyword.h>
+#include <azo/typed-array.h>
 
 #include <azo/compiler/arithmetic.h>
 #include <azo/compare.h>
 
 #include <azo/compiler/compiler.h>
+#include <azo/compiler/ir.h>
 
 typedef struct _LValue LValue;
 
@@ -45,7 +47,9 @@ enum {
 	/* Array element, stack(1) is array, stack(0) is index */
 	LVALUE_ELEMENT,
 	/* Constant */
-	LVALUE_VALUE
+	LVALUE_VALUE,
+	/* Variable global definition, pos is slot */
+	LVALUE_GLOBAL
 };
 
 struct _LValue {
@@ -68,6 +72,29 @@ void
 azo_compiler_finalize(AZOCompiler *compiler)
 {
 	if (compiler->current) azo_frame_delete_tree(compiler->current);
+	for (unsigned int i = 0; i < compiler->n_imports; i++) az_string_unref (compiler->imports[i].name);
+	free (compiler->imports);
+}
+
+void
+azo_compiler_add_import (AZOCompiler *comp, AZString *name, AZONamespace *nspace)
+{
+	if (comp->n_imports >= comp->size_imports) {
+		comp->size_imports = (comp->size_imports) ? comp->size_imports << 1 : 8;
+		comp->imports = (AZOImport *) realloc (comp->imports, comp->size_imports * sizeof (AZOImport));
+	}
+	az_string_ref (name);
+	comp->imports[comp->n_imports].name = name;
+	comp->imports[comp->n_imports++].nspace = nspace;
+}
+
+AZONamespace *
+azo_compiler_lookup_import (AZOCompiler *comp, AZString *name)
+{
+	for (unsigned int i = 0; i < comp->n_imports; i++) {
+		if (!strcmp ((const char *) comp->imports[i].name->str, (const char *) name->str)) return comp->imports[i].nspace;
+	}
+	return NULL;
 }
 
 void
@@ -181,6 +208,7 @@ azo_compiler_write_PUSH_FRAME (AZOCompiler *comp, unsigned int pos)
 void
 azo_compiler_write_POP (AZOCompiler *comp, uint32_t n_values, const AZOExpression *expr)
 {
+	if (!n_values) return;
 	write_tc_u32 (comp, AZO_TC_POP, n_values, expr);
 }
 
@@ -226,6 +254,18 @@ azo_compiler_write_EXCHANGE (AZOCompiler *comp, unsigned int pos)
 	write_tc_u32 (comp, AZO_TC_EXCHANGE, pos, NULL);
 }
 
+void
+azo_compiler_write_DUPLICATE_FRAME (AZOCompiler *comp, unsigned int pos, const AZOExpression *expr)
+{
+	azo_code_write_ic_u32(&comp->current->code, AZO_TC_DUPLICATE_FRAME, pos, expr);
+}
+
+void
+azo_compiler_write_EXCHANGE_FRAME (AZOCompiler *comp, unsigned int pos, const AZOExpression *expr)
+{
+	write_tc_u32 (comp, AZO_TC_EXCHANGE_FRAME, pos, expr);
+}
+
 void
 azo_compiler_write_TEST_TYPE (AZOCompiler *comp, unsigned int typecode, unsigned int pos)
 {
@@ -289,6 +329,12 @@ azo_compiler_write_MINMAX_TYPED (AZOCompiler *comp, unsigned int typecode, uint3
 	write_tc_u8 (comp, typecode, type & 0xff, NULL);
 }
 
+void
+azo_compiler_write_VECTOR_ARITHMETIC (AZOCompiler *comp, unsigned int operation, const AZOExpression *expr)
+{
+	write_tc_u8 (comp, VECTOR_ARITHMETIC, operation & 0xff, expr);
+}
+
 /* End new stack methods */
 
 static void
@@ -334,8 +380,8 @@ static unsigned int compile_assign (AZOCompiler *comp, const AZOExpression *left
 static unsigned int compile_variable_reference (AZOCompiler *comp, const AZOExpression *expr, unsigned int type, AZOSource *src);
 static unsigned int compile_singular_reference (AZOCompiler *comp, const AZOExpression *expr);
 static unsigned int compile_member_reference (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src);
-static unsigned int compile_array_reference (AZOCompiler *comp, const AZOExpression *aref, const AZOExpression *index, AZOSource *src);
-static unsigned int compile_array_literal (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src);
+static unsigned int compile_array_reference (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src);
+static unsigned int compile_array_literal (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src, unsigned int element_type);
 
 static unsigned int compile_new (AZOCompiler *comp, const AZOExpression *klass, const AZOExpression *list, AZOSource *src);
 static unsigned int compile_function_call (AZOCompiler *comp, const AZOExpression *function, const AZOExpression *list, AZOSource *src, unsigned int silent);
@@ -426,6 +472,16 @@ compile_lvalue (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src, LV
 			lvalue->pos = expr->var_pos;
 			lvalue->n_elements = 0;
 			return 1;
+		} else if (expr->term.subtype == VARIABLE_GLOBAL) {
+			/* Global definitions are only changed by host */
+			if (!read_only) {
+				fprintf (stderr, "Global variable in writable lvalue\n");
+				return 0;
+			}
+			lvalue->type = LVALUE_GLOBAL;
+			lvalue->pos = expr->var_pos;
+			lvalue->n_elements = 0;
+			return 1;
 		} else {
 			/*
 			 * Declared in parent frame
@@ -660,6 +716,26 @@ compile_new (AZOCompiler *comp, const AZOExpression *klass, const AZOExpression
 	unsigned int n_args = 0;
 	if (!newstr) newstr = az_string_new ((const unsigned char *) "new");
 
+	if (AZO_EXPRESSION_IS(klass, EXPRESSION_CONSTANT, AZ_TYPE_CLASS) && list->children && !list->children->next) {
+		unsigned int type = AZ_CLASS_TYPE((AZClass *) klass->value.v.block);
+		if (az_type_is_a (type, AZO_TYPE_TYPED_ARRAY)) {
+			/* new DoubleArray(size | list) */
+			const AZOExpression *arg = list->children;
+			unsigned int element_type = ((AZOTypedArrayClass *) klass->value.v.block)->element_type;
+			if (!element_type) {
+				fprintf (stderr, "compile_new: Cannot create abstract typed array\n");
+				return 0;
+			}
+			if (arg->term.type == EXPRESSION_LITERAL_ARRAY) {
+				/* Write elements directly into typed array */
+				return compile_array_literal (comp, arg, src, element_type);
+			}
+			if (!azo_compiler_compile_expression (comp, arg, src)) return 0;
+			write_tc_u32 (comp, NEW_TYPED_ARRAY, element_type, klass);
+			return 1;
+		}
+	}
+
 #ifdef DEBUG_NEW
 	write_DEBUG_STRING (comp, "compile_new: 1\n");
 	write_DEBUG_STACK (comp);
@@ -909,7 +985,7 @@ compile_function_call (AZOCompiler *comp, const AZOExpression *func, const AZOEx
 		write_DEBUG_STRING (comp, "Parent lval 1\n");
 		write_DEBUG_STACK (comp);
 #endif
-		azo_compiler_write_PUSH_VALUE (comp, lval.pos);
+		write_tc_u32 (comp, AZO_TC_PUSH_ENV_VALUE, lval.pos, NULL);
 #ifdef DEBUG_PARENT_LVAL
 		write_DEBUG_STRING (comp, "Parent lval 2\n");
 		write_DEBUG_STACK (comp);
@@ -918,6 +994,12 @@ compile_function_call (AZOCompiler *comp, const AZOExpression *func, const AZOEx
 		result = compile_call (comp, func, list, src, 0, 1);
 		if (result) return 0;
 		break;
+	case LVALUE_GLOBAL:
+		write_tc_u32 (comp, GET_GLOBAL_SLOT, lval.pos, func);
+		/* Value */
+		result = compile_call (comp, func, list, src, 0, 1);
+		if (result) return 0;
+		break;
 	default:
 		break;
 	}
@@ -929,6 +1011,19 @@ compile_function_call (AZOCompiler *comp, const AZOExpression *func, const AZOEx
 
 #define noDEBUG_FUNCTION
 
+/* Whether function body has yield outside of nested functions */
+
+static unsigned int
+function_yields (const AZOExpression *expr)
+{
+	if (expr->term.type == EXPRESSION_FUNCTION) return 0;
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_YIELD)) return 1;
+	for (const AZOExpression *child = expr->children; child; child = child->next) {
+		if (function_yields (child)) return 1;
+	}
+	return 0;
+}
+
 static unsigned int
 compile_function (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 {
@@ -936,9 +1031,6 @@ compile_function (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 	AZOExpression *child;
 	AZOProgram *prog;
 	AZOCompiledFunction *cfunc;
-	static AZString *bound_str = NULL;
-	unsigned int bound;
-	if (!bound_str) bound_str = az_string_new ((const unsigned char *) "bound");
 #ifdef DEBUG_FUNCTION
 	write_DEBUG_STRING (comp, "Function 1");
 	write_DEBUG_STACK (comp);
@@ -972,32 +1064,24 @@ compile_function (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 		return 0;
 	}
 	cfunc = azo_compiled_function_new (comp->ctx, prog, ret_type, n_args);
+	cfunc->generator = function_yields (body);
 	comp->current = prev;
 
 	compile_PUSH_VALUE_object (comp, AZ_OBJECT (cfunc));
 	/* Function */
-	azo_compiler_write_DUPLICATE (comp, 0, expr);
-	/* Function, Function */
-	compile_PUSH_VALUE_string (comp, bound_str);
-	/* Function, Function, "bound" */
-	azo_compiler_write_ic (comp, AZO_TC_GET_PROPERTY, NULL);
-	/* Function, Boolean */
-	bound = azo_compiler_write_JMP_32 (comp, JMP_32_IF, 0, NULL);
-	/* Function */
-	/* Bind function */
-
-	for (AZOVariable *var = expr->frame->parent_vars; var; var = var->next) {
-		if (var->parent_is_val) {
-			azo_compiler_write_PUSH_VALUE (comp, var->parent_pos);
-		} else {
-			azo_code_write_ic_u32(&comp->current->code, AZO_TC_DUPLICATE_FRAME, var->parent_pos, expr);
+	if (expr->frame->n_parent_vars) {
+		/* Capture parent variables into new closure */
+		for (AZOVariable *var = expr->frame->parent_vars; var; var = var->next) {
+			if (var->parent_is_val) {
+				write_tc_u32 (comp, AZO_TC_PUSH_ENV_VALUE, var->parent_pos, expr);
+			} else {
+				azo_code_write_ic_u32(&comp->current->code, AZO_TC_DUPLICATE_FRAME, var->parent_pos, expr);
+			}
 		}
+		/* Function, Values... */
+		write_tc_u32 (comp, AZO_TC_MAKE_CLOSURE, expr->frame->n_parent_vars, expr);
+		/* Closure */
 	}
-	write_tc_u32 (comp, AZO_TC_BIND, expr->frame->n_parent_vars, NULL);
-	//write_tc_u32 (comp, AZO_TC_BIND, 0);
-
-	/* Function is already bound */
-	azo_compiler_update_JMP_32 (comp, bound);
 #ifdef DEBUG_FUNCTION
 	write_DEBUG_STRING (comp, "Function\n");
 	write_DEBUG_STACK (comp);
@@ -1007,14 +1091,28 @@ compile_function (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 }
 
 static unsigned int
-compile_array_literal (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
+compile_array_literal (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src, unsigned int element_type)
 {
 	const AZOExpression *child;
 	unsigned int size = 0, idx = 0;
+	if (expr->term.subtype == ARRAY_LITERAL_COPY) {
+		/* Constant array from program values */
+		if (!azo_compiler_compile_expression (comp, expr->children, src)) return 0;
+		if (element_type) {
+			write_tc_u32 (comp, NEW_TYPED_ARRAY, element_type, expr);
+		} else {
+			azo_compiler_write_ic (comp, COPY_ARRAY, expr);
+		}
+		return 1;
+	}
 	for (child = expr->children; child; child = child->next) size += 1;
 	/* Create new array */
 	azo_compiler_write_PUSH_IMMEDIATE (comp, AZ_TYPE_UINT32, (const AZValue *) &size, NULL);
-	azo_compiler_write_ic (comp, NEW_ARRAY, NULL);
+	if (element_type) {
+		write_tc_u32 (comp, NEW_TYPED_ARRAY, element_type, expr);
+	} else {
+		azo_compiler_write_ic (comp, NEW_ARRAY, NULL);
+	}
 	for (child = expr->children; child; child = child->next) {
 		azo_compiler_write_PUSH_IMMEDIATE (comp, AZ_TYPE_UINT32, (const AZValue *) &idx, NULL);
 		azo_compiler_compile_expression (comp, child, src);
@@ -1075,12 +1173,14 @@ compile_expression_rvalue (AZOCompiler *comp, const AZOExpression *expr, AZOSour
 	if (expr->term.type == EXPRESSION_VARIABLE) {
 		if (expr->term.subtype == VARIABLE_LOCAL) {
 			azo_code_write_ic_u32(&comp->current->code, AZO_TC_DUPLICATE_FRAME, expr->var_pos, expr);
+		} else if (expr->term.subtype == VARIABLE_GLOBAL) {
+			write_tc_u32 (comp, GET_GLOBAL_SLOT, expr->var_pos, expr);
 		} else {
 #ifdef DEBUG_PARENT_VAR
 			write_DEBUG_STRING (comp, "Parent var 1\n");
 			write_DEBUG_STACK (comp);
 #endif
-			azo_compiler_write_PUSH_VALUE (comp, expr->var_pos);
+			write_tc_u32 (comp, AZO_TC_PUSH_ENV_VALUE, expr->var_pos, expr);
 #ifdef DEBUG_PARENT_VAR
 			write_DEBUG_STRING (comp, "Parent var 2\n");
 			write_DEBUG_STACK (comp);
@@ -1106,7 +1206,7 @@ compile_expression_rvalue (AZOCompiler *comp, const AZOExpression *expr, AZOSour
 	} else if (expr->term.type == EXPRESSION_FUNCTION_CALL) {
 		if (!compile_function_call (comp, expr->children, expr->children->next, src, 0)) return 0;
 	} else if (expr->term.type == EXPRESSION_LITERAL_ARRAY) {
-		if (!compile_array_literal (comp, expr, src)) return 0;
+		if (!compile_array_literal (comp, expr, src, 0)) return 0;
 		/* fixme: Do we allow operators here? (Lauris) */
 	} else if (expr->term.type == EXPRESSION_PREFIX) {
 		if (!compile_prefix (comp, expr, expr->children, src)) return 0;
@@ -1126,13 +1226,27 @@ compile_expression_rvalue (AZOCompiler *comp, const AZOExpression *expr, AZOSour
 }
 
 static unsigned int
-compile_array_reference (AZOCompiler *comp, const AZOExpression *array_ref, const AZOExpression *idx, AZOSource *src)
+element_is_bounded (AZOCompiler *comp, const AZOExpression *expr)
+{
+	if (expr->term.subtype != ARRAY_ELEMENT_BOUNDED) return 0;
+	for (AZOBoundedLoop *loop = comp->bounded; loop; loop = loop->outer) {
+		if (loop->loop == expr->loop) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+compile_array_reference (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 {
-	azo_compiler_compile_expression (comp, array_ref, src);
+	azo_compiler_compile_expression (comp, expr->children, src);
 	/* Array */
-	azo_compiler_compile_expression (comp, idx, src);
+	azo_compiler_compile_expression (comp, expr->children->next, src);
 	/* Array, Index */
-	azo_compiler_write_ic (comp, LOAD_ARRAY_ELEMENT, NULL);
+	if (element_is_bounded (comp, expr)) {
+		azo_code_write_ic (&comp->current->code, LOAD_ARRAY_ELEMENT_U32_NOCHECK, NULL);
+	} else {
+		azo_compiler_write_ic (comp, LOAD_ARRAY_ELEMENT, NULL);
+	}
 	/* Array, Value */
 	azo_compiler_write_REMOVE (comp, 1, 1, NULL);
 	return 1;
@@ -1186,7 +1300,7 @@ compile_expression_lvalue (AZOCompiler *comp, const AZOExpression *expr, AZOSour
 		/* LValue types */
 		if (!compile_variable_reference (comp, expr, expr->term.subtype, src)) return 0;
 	} else if (expr->term.type == EXPRESSION_ARRAY_ELEMENT) {
-		if (!compile_array_reference (comp, expr->children, expr->children->next, src)) return 0;
+		if (!compile_array_reference (comp, expr, src)) return 0;
 	} else {
 		fprintf (stderr, "compile_expression_lvalue: Invalid expression type %u\n", expr->term.type);
 		return 0;
@@ -1304,6 +1418,10 @@ compile_statement (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 			azo_compiler_write_ic (comp, AZO_TC_RETURN, expr);
 		}
 		return 1;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_YIELD)) {
+		if (!compile_expression_rvalue (comp, expr->children, src)) return 0;
+		azo_compiler_write_ic (comp, AZO_TC_YIELD, expr);
+		return 1;
 	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_DEBUG)) {
 		comp->debug = 1;
 		return 1;
@@ -1329,10 +1447,12 @@ compile_cycle (AZOCompiler *comp, const AZOExpression *expr,
 	const AZOExpression *init, const AZOExpression *test, const AZOExpression *step, const AZOExpression *content,
 	AZOSource *src)
 {
-	unsigned int test_condition, end_cycle;
+	unsigned int test_condition, end_cycle = 0;
 
 	/* Initialization */
 	if (init) compile_step_statement (comp, init, src);
+	/* Empty condition is always true */
+	if (test && (test->term.type == AZO_TERM_EMPTY)) test = NULL;
 	/* Test condition */
 	test_condition = azo_frame_get_current_ip (comp->current);
 	if (test) {
@@ -1346,6 +1466,78 @@ compile_cycle (AZOCompiler *comp, const AZOExpression *expr,
 	if (step) compile_silent_statement (comp, step, src);
 	/* Go back to condition testing */
 	azo_compiler_write_JMP_32 (comp, JMP_32, test_condition, NULL);
+	if (test) azo_compiler_update_JMP_32 (comp, end_cycle);
+
+	azo_compiler_write_POP (comp, expr->scope_size, NULL);
+	return 1;
+}
+
+static const AZOExpression *
+find_bounded_element (const AZOExpression *expr, const AZOExpression *loop)
+{
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_ARRAY_ELEMENT, ARRAY_ELEMENT_BOUNDED) && (expr->loop == loop)) return expr;
+	for (const AZOExpression *child = expr->children; child; child = child->next) {
+		const AZOExpression *elem = find_bounded_element (child, loop);
+		if (elem) return elem;
+	}
+	return NULL;
+}
+
+/*
+ * Counting loop with bounded array reads (marked by azo_compiler_bound_loop)
+ *
+ * init
+ * TEST_ARRAY_SIZE array, bound
+ * JMP_IF_NOT checked
+ * cycle with unchecked reads, exits to end
+ * checked:
+ * cycle
+ * end:
+ */
+
+static unsigned int
+compile_bounded_for (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
+{
+	AZOExpression *init, *test, *step, *content;
+	const AZOExpression *elem;
+	AZOBoundedLoop loop;
+	unsigned int checked, test_condition, end_unchecked, end_cycle;
+	init = expr->children;
+	test = init->next;
+	step = test->next;
+	content = step->next;
+
+	elem = find_bounded_element (content, expr);
+	loop.loop = expr;
+
+	compile_step_statement (comp, init, src);
+	/* Test array once, counter stays below bound inside loop */
+	azo_compiler_compile_expression (comp, elem->children, src);
+	/* Array */
+	azo_compiler_compile_expression (comp, test->children->next, src);
+	/* Array, Bound */
+	azo_code_write_ic (&comp->current->code, TEST_ARRAY_SIZE, expr);
+	/* Boolean */
+	checked = azo_compiler_write_JMP_32 (comp, JMP_32_IF_NOT, 0, NULL);
+	/* Unchecked version */
+	test_condition = azo_frame_get_current_ip (comp->current);
+	compile_expression_boolean (comp, test, src);
+	end_unchecked = azo_compiler_write_JMP_32 (comp, JMP_32_IF_NOT, 0, NULL);
+	loop.outer = comp->bounded;
+	comp->bounded = &loop;
+	compile_sentence (comp, content, src);
+	comp->bounded = loop.outer;
+	compile_silent_statement (comp, step, src);
+	azo_compiler_write_JMP_32 (comp, JMP_32, test_condition, NULL);
+	/* Checked version */
+	azo_compiler_update_JMP_32 (comp, checked);
+	test_condition = azo_frame_get_current_ip (comp->current);
+	compile_expression_boolean (comp, test, src);
+	end_cycle = azo_compiler_write_JMP_32 (comp, JMP_32_IF_NOT, 0, NULL);
+	compile_sentence (comp, content, src);
+	compile_silent_statement (comp, step, src);
+	azo_compiler_write_JMP_32 (comp, JMP_32, test_condition, NULL);
+	azo_compiler_update_JMP_32 (comp, end_unchecked);
 	azo_compiler_update_JMP_32 (comp, end_cycle);
 
 	azo_compiler_write_POP (comp, expr->scope_size, NULL);
@@ -1368,6 +1560,7 @@ compile_for (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 	test = init->next;
 	step = test->next;
 	content = step->next;
+	if (find_bounded_element (content, expr)) return compile_bounded_for (comp, expr, src);
 	return compile_cycle(comp, expr, init, test, step, content, src);
 }
 
@@ -1386,6 +1579,92 @@ compile_while (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 	return compile_cycle(comp, expr, NULL, test, NULL, content, src);
 }
 
+/*
+ * FOREACH
+ *   + DECLARATION_LIST
+ *   + collection
+ *   + content
+ *
+ * collection
+ * PUSH 0
+ * declaration
+ * loop:
+ * ITERATE collection_pos
+ * JMP_IF_NOT end
+ * element is moved to loop variable (or popped if it is unused)
+ * content
+ * JMP loop
+ * end:
+ */
+
+static unsigned int
+compile_foreach (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
+{
+	const AZOExpression *list, *coll, *content;
+	unsigned int zero = 0, loop, end_cycle;
+	list = expr->children;
+	coll = list->next;
+	content = coll->next;
+	if (!compile_expression_rvalue (comp, coll, src)) return 0;
+	azo_compiler_write_PUSH_IMMEDIATE (comp, AZ_TYPE_UINT32, (const AZValue *) &zero, expr);
+	if (!compile_declaration (comp, list, src)) return 0;
+	/* Collection, Index, [Variable] */
+	loop = azo_frame_get_current_ip (comp->current);
+	write_tc_u32 (comp, AZO_TC_ITERATE, list->var_pos, expr);
+	end_cycle = azo_compiler_write_JMP_32 (comp, JMP_32_IF_NOT, 0, NULL);
+	/* Element */
+	if (list->children->next) write_tc_u32 (comp, AZO_TC_EXCHANGE_FRAME, list->var_pos + 2, expr);
+	azo_compiler_write_POP (comp, 1, NULL);
+	compile_sentence (comp, content, src);
+	azo_compiler_write_JMP_32 (comp, JMP_32, loop, NULL);
+	azo_compiler_update_JMP_32 (comp, end_cycle);
+
+	azo_compiler_write_POP (comp, expr->scope_size, NULL);
+	return 1;
+}
+
+/*
+ * TRY
+ *   + body
+ *   + DECLARATION_LIST | EMPTY
+ *   + handler
+ *
+ * start:
+ * body
+ * end:
+ * JMP done
+ * handler: (stack is unwound to catch clause depth and exception is pushed)
+ * exception is left as catch variable (or popped if there is none)
+ * handler
+ * done:
+ *
+ * Protected range [start, end) goes to exception table, nothing is executed on entering try
+ */
+
+static unsigned int
+compile_try (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
+{
+	const AZOExpression *body, *list, *handler;
+	unsigned int start, end, done;
+	body = expr->children;
+	list = body->next;
+	handler = list->next;
+	start = azo_frame_get_current_ip (comp->current);
+	compile_sentence (comp, body, src);
+	end = azo_frame_get_current_ip (comp->current);
+	done = azo_compiler_write_JMP_32 (comp, JMP_32, 0, NULL);
+	/* Nested handlers are already in table */
+	if (end > start) {
+		azo_code_add_handler (&comp->current->code, start, end, azo_frame_get_current_ip (comp->current), list->var_pos);
+	}
+	/* Exception */
+	if ((list->term.type != EXPRESSION_DECLARATION_LIST) || !list->children->next) azo_compiler_write_POP (comp, 1, NULL);
+	compile_sentence (comp, handler, src);
+	azo_compiler_write_POP (comp, expr->scope_size, NULL);
+	azo_compiler_update_JMP_32 (comp, done);
+	return 1;
+}
+
 /*
  * IF
  *   + condition
@@ -1424,8 +1703,10 @@ compile_if (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
  *   Block
  *   Line
  *   for
+ *   foreach
  *   while
  *   if
+ *   try
  */
 
 static unsigned int
@@ -1437,6 +1718,10 @@ compile_sentence (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src)
 		if (!compile_for (comp, expr, src)) return 0;
 	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_WHILE)) {
 		if (!compile_while (comp, expr, src)) return 0;
+	} else if (expr->term.type == AZO_EXPRESSION_FOREACH) {
+		if (!compile_foreach (comp, expr, src)) return 0;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_TRY)) {
+		if (!compile_try (comp, expr, src)) return 0;
 	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_IF)) {
 		if (!compile_if (comp, expr, src)) return 0;
 	} else {
@@ -1482,9 +1767,18 @@ azo_compiler_compile (AZOCompiler *comp, AZOExpression *root, unsigned int need_
 		root = azo_compiler_resolve_frame (comp, root);
 	}
 
-	/* Have to reserve closure before compilation */
-	/* fixme: Here we probably do not have parent vars */
-	azo_frame_reserve_data (comp->current, comp->current->n_parent_vars);
+	if (comp->use_ir && ((root->term.type == AZO_EXPRESSION_PROGRAM) || (root->term.type == AZO_EXPRESSION_BLOCK))) {
+		AZOIRFunction *func = azo_ir_build (comp, root);
+		if (func) {
+			unsigned int result;
+			azo_ir_optimize (func);
+			if (comp->dump_ir) azo_ir_dump (func, stderr);
+			result = azo_ir_lower (comp, func, src);
+			azo_ir_delete (func);
+			if (!result) return NULL;
+			return azo_program_new(comp->ctx, &comp->current->code, root, src);
+		}
+	}
 
 	if (root->term.type == AZO_EXPRESSION_PROGRAM) {
 		/* Programs are lists of sentences */
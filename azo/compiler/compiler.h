@@ -8,6 +8,8 @@
 */
 
 typedef struct _AZOCompiler AZOCompiler;
+typedef struct _AZOBoundedLoop AZOBoundedLoop;
+typedef struct _AZOImport AZOImport;
 
 #include <stdint.h>
 
@@ -15,12 +17,25 @@ typedef struct _AZOCompiler AZOCompiler;
 #include <azo/compiler/frame.h>
 #include <azo/expression.h>
 #include <azo/interpreter.h>
+#include <azo/namespace.h>
 #include <azo/source.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Loop that is compiled without bounds checks, lives in the stack of compile_bounded_for */
+struct _AZOBoundedLoop {
+	AZOBoundedLoop *outer;
+	const AZOExpression *loop;
+};
+
+/* Module imported by program, visible after import statement */
+struct _AZOImport {
+	AZString *name;
+	AZONamespace *nspace;
+};
+
 struct _AZOCompiler {
 	/**
 	 * @brief Global definitions
@@ -39,11 +54,48 @@ struct _AZOCompiler {
 	 * 
 	 */
 	unsigned int debug : 1;
+	/**
+	 * @brief Treat property lookups as pure
+	 * 
+	 * Promises that property values do not change during loop execution unless
+	 * assigned by the script itself. Allows moving member lookups out of loops.
+	 * 
+	 */
+	unsigned int pure_properties : 1;
+	/**
+	 * @brief Compile through SSA intermediate representation
+	 * 
+	 * Frames that use unsupported constructs are compiled directly from tree.
+	 * 
+	 */
+	unsigned int use_ir : 1;
+	/**
+	 * @brief Print IR of every compiled frame to stderr
+	 * 
+	 */
+	unsigned int dump_ir : 1;
+	/**
+	 * @brief Number of generated hidden variables
+	 * 
+	 */
+	unsigned int n_hidden;
 	/**
 	 * @brief Current compilation frame
 	 * 
 	 */
 	AZOFrame *current;
+	/**
+	 * @brief Innermost loop that is being compiled in unchecked version
+	 * 
+	 */
+	AZOBoundedLoop *bounded;
+	/**
+	 * @brief Imported modules
+	 * 
+	 */
+	unsigned int n_imports;
+	unsigned int size_imports;
+	AZOImport *imports;
 };
 
 void azo_compiler_init (AZOCompiler *compiler, AZOContext *ctx);
@@ -54,6 +106,10 @@ AZOProgram *azo_compiler_compile (AZOCompiler *comp, AZOExpression *root, unsign
 void azo_compiler_push_frame (AZOCompiler *comp, const AZImplementation *this_impl, void *this_inst, unsigned int ret_type);
 AZOFrame *azo_compiler_pop_frame (AZOCompiler *comp);
 
+/* Make module visible to the rest of program, namespace is owned by context */
+void azo_compiler_add_import (AZOCompiler *comp, AZString *name, AZONamespace *nspace);
+AZONamespace *azo_compiler_lookup_import (AZOCompiler *comp, AZString *name);
+
 /* Declares variable at next free position unless already known */
 void azo_compiler_declare_variable (AZOCompiler *comp, AZString *name, unsigned int type);
 
@@ -70,6 +126,8 @@ void azo_compiler_write_PUSH_IMMEDIATE (AZOCompiler *comp, unsigned int type, co
 void azo_compiler_write_PUSH_EMPTY (AZOCompiler *comp, uint32_t type, const AZOExpression *expr);
 void azo_compiler_write_DUPLICATE (AZOCompiler *comp, unsigned int pos, const AZOExpression *expr);
 void azo_compiler_write_EXCHANGE (AZOCompiler *comp, unsigned int pos);
+void azo_compiler_write_DUPLICATE_FRAME (AZOCompiler *comp, unsigned int pos, const AZOExpression *expr);
+void azo_compiler_write_EXCHANGE_FRAME (AZOCompiler *comp, unsigned int pos, const AZOExpression *expr);
 void azo_compiler_write_TEST_TYPE (AZOCompiler *comp, unsigned int typecode, unsigned int pos);
 void azo_compiler_write_TEST_TYPE_IMMEDIATE (AZOCompiler *comp, unsigned int typecode, unsigned int pos, unsigned int type, const AZOExpression *expr);
 void azo_compiler_write_TYPE_OF (AZOCompiler *comp, unsigned int pos);
@@ -80,6 +138,7 @@ void azo_compiler_write_EQUAL_TYPED (AZOCompiler *comp, uint32_t type);
 void azo_compiler_write_COMPARE_TYPED (AZOCompiler *comp, uint32_t type);
 void azo_compiler_write_ARITHMETIC_TYPED (AZOCompiler *comp, unsigned int typecode, uint32_t type);
 void azo_compiler_write_MINMAX_TYPED (AZOCompiler *comp, unsigned int typecode, uint32_t type);
+void azo_compiler_write_VECTOR_ARITHMETIC (AZOCompiler *comp, unsigned int operation, const AZOExpression *expr);
 
 unsigned int azo_compiler_compile_expression (AZOCompiler *comp, const AZOExpression *expr, AZOSource *src);
 
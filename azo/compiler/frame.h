@@ -35,6 +35,8 @@ struct _AZOVariable {
 
 	/* Value if determined to be const */
 	AZOExpression *const_expr;
+	/* Function definition if never reassigned (inlining candidate) */
+	AZOExpression *func_expr;
 };
 
 struct _AZOScope {
@@ -0,0 +1,354 @@
+#define __AZO_COMPILER_IR_LOWER_C__
+
+/*
+ * A languge implementation based on AZ
+ *
+ * Copyright (C) Lauris Kaplinski 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <azo/bytecode.h>
+#include <azo/compiler/arithmetic.h>
+#include <azo/compiler/ir.h>
+
+/*
+ * Lowering to bytecode
+ *
+ * Every non-constant value is stored in its own frame slot. Operations are emitted by the ordinary
+ * expression compiler through temporary terms whose operands are slot variables or constants, so
+ * the runtime type dispatch is shared with direct compilation. When both operand types are known
+ * and equal, typed arithmetic is written instead.
+ *
+ * Phis are resolved by copies at the ends of predecessors. All incoming values are pushed before
+ * any phi slot is written, so copies behave as if done in parallel.
+ */
+
+typedef struct _IRFixup IRFixup;
+
+struct _IRFixup {
+	/* Position of jump instruction */
+	unsigned int pos;
+	/* NULL is the end of code */
+	AZOIRBlock *target;
+};
+
+typedef struct _IRLowering IRLowering;
+
+struct _IRLowering {
+	AZOCompiler *comp;
+	AZOIRFunction *func;
+	AZOSource *src;
+	unsigned int n_fixups;
+	unsigned int size_fixups;
+	IRFixup *fixups;
+};
+
+static void
+add_fixup (IRLowering *low, unsigned int pos, AZOIRBlock *target)
+{
+	if (low->n_fixups >= low->size_fixups) {
+		low->size_fixups = (low->size_fixups) ? low->size_fixups << 1 : 16;
+		low->fixups = (IRFixup *) realloc (low->fixups, low->size_fixups * sizeof (IRFixup));
+	}
+	low->fixups[low->n_fixups].pos = pos;
+	low->fixups[low->n_fixups].target = target;
+	low->n_fixups += 1;
+}
+
+static void
+write_jump (IRLowering *low, unsigned int ic, AZOIRBlock *target, const AZOExpression *expr)
+{
+	add_fixup (low, azo_compiler_write_JMP_32 (low->comp, ic, 0, expr), target);
+}
+
+/* Temporary terms point to freed memory afterwards, so debug information is redirected to source term */
+
+static void
+set_debug_expression (IRLowering *low, unsigned int start, const AZOExpression *expr)
+{
+	AZOCode *code = &low->comp->current->code;
+	if (!code->exprs) return;
+	for (unsigned int i = start; i < code->bc_len; i++) code->exprs[i] = expr;
+}
+
+static AZOExpression *
+new_operand (AZOIRValue *val, const AZOExpression *expr)
+{
+	AZOExpression *op;
+	unsigned int start = (expr) ? expr->term.start : 0;
+	unsigned int end = (expr) ? expr->term.end : 0;
+	val = azo_ir_value_get (val);
+	if (val->op == AZO_IR_CONST) {
+		op = azo_expression_new (EXPRESSION_CONSTANT, val->type, start, end);
+		if (val->value.impl) az_packed_value_copy (&op->value, &val->value);
+	} else if (val->op == AZO_IR_UNDEF) {
+		op = azo_expression_new (EXPRESSION_CONSTANT, AZ_TYPE_NONE, start, end);
+	} else {
+		op = azo_expression_new (EXPRESSION_VARIABLE, VARIABLE_LOCAL, start, end);
+		op->var_pos = (val->op == AZO_IR_PARAM) ? val->pos : val->slot;
+	}
+	return op;
+}
+
+static void
+append_child (AZOExpression *expr, AZOExpression *child)
+{
+	AZOExpression *last = expr->children;
+	child->parent = expr;
+	if (!last) {
+		expr->children = child;
+		return;
+	}
+	while (last->next) last = last->next;
+	last->next = child;
+}
+
+static unsigned int
+push_operand (IRLowering *low, AZOIRValue *val, const AZOExpression *expr)
+{
+	unsigned int start = low->comp->current->code.bc_len;
+	AZOExpression *op = new_operand (val, expr);
+	unsigned int result = azo_compiler_compile_expression (low->comp, op, low->src);
+	azo_expression_free_tree (op);
+	set_debug_expression (low, start, expr);
+	return result;
+}
+
+static unsigned int
+get_typed_ic (unsigned int subtype)
+{
+	switch (subtype) {
+	case ARITHMETIC_PLUS:
+		return AZO_TC_ADD_TYPED;
+	case ARITHMETIC_MINUS:
+		return AZO_TC_SUBTRACT_TYPED;
+	case ARITHMETIC_STAR:
+		return AZO_TC_MULTIPLY_TYPED;
+	case ARITHMETIC_SLASH:
+		return AZO_TC_DIVIDE_TYPED;
+	case ARITHMETIC_PERCENT:
+		return AZO_TC_MODULO_TYPED;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static unsigned int
+type_is_typed_arithmetic (unsigned int type)
+{
+	return (type >= AZ_TYPE_INT32) && (type <= AZ_TYPE_COMPLEX_DOUBLE);
+}
+
+static unsigned int
+write_typed_step (IRLowering *low, AZOIRValue *val, AZOIRValue *arg)
+{
+	AZValue one;
+	if (arg->type == AZ_TYPE_INT32) {
+		one.int32_v = 1;
+	} else if (arg->type == AZ_TYPE_INT64) {
+		one.int64_v = 1;
+	} else {
+		return 0;
+	}
+	if (!push_operand (low, arg, val->expr)) return 0;
+	azo_compiler_write_PUSH_IMMEDIATE (low->comp, arg->type, &one, val->expr);
+	azo_compiler_write_ARITHMETIC_TYPED (low->comp, (val->op == AZO_IR_INCREMENT) ? AZO_TC_ADD_TYPED : AZO_TC_SUBTRACT_TYPED, arg->type);
+	return 1;
+}
+
+/* Push the value of operation to stack */
+
+static unsigned int
+write_value (IRLowering *low, AZOIRValue *val)
+{
+	AZOExpression *expr = NULL;
+	unsigned int result = 1, start = low->comp->current->code.bc_len;
+	AZOIRValue *lhs = (val->n_args > 0) ? azo_ir_value_get (val->args[0]) : NULL;
+	AZOIRValue *rhs = (val->n_args > 1) ? azo_ir_value_get (val->args[1]) : NULL;
+	switch (val->op) {
+	case AZO_IR_ENV:
+		expr = azo_expression_new (EXPRESSION_VARIABLE, VARIABLE_PARENT, val->expr->term.start, val->expr->term.end);
+		expr->var_pos = val->pos;
+		break;
+	case AZO_IR_BINARY:
+		if (get_typed_ic (val->subtype) && (lhs->type == rhs->type) && type_is_typed_arithmetic (lhs->type)) {
+			if (!push_operand (low, lhs, val->expr)) return 0;
+			if (!push_operand (low, rhs, val->expr)) return 0;
+			azo_compiler_write_ARITHMETIC_TYPED (low->comp, get_typed_ic (val->subtype), lhs->type);
+			set_debug_expression (low, start, val->expr);
+			return 1;
+		}
+		expr = azo_expression_new (EXPRESSION_BINARY, val->subtype, val->expr->term.start, val->expr->term.end);
+		break;
+	case AZO_IR_COMPARISON:
+		expr = azo_expression_new (EXPRESSION_COMPARISON, val->subtype, val->expr->term.start, val->expr->term.end);
+		break;
+	case AZO_IR_PREFIX:
+		expr = azo_expression_new (EXPRESSION_PREFIX, val->subtype, val->expr->term.start, val->expr->term.end);
+		break;
+	case AZO_IR_INCREMENT:
+	case AZO_IR_DECREMENT:
+		if (write_typed_step (low, val, lhs)) {
+			set_debug_expression (low, start, val->expr);
+			return 1;
+		}
+		expr = new_operand (lhs, val->expr);
+		if (val->op == AZO_IR_INCREMENT) {
+			result = azo_compiler_compile_increment (low->comp, expr, val->expr, low->src);
+		} else {
+			result = azo_compiler_compile_decrement (low->comp, expr, val->expr, low->src);
+		}
+		azo_expression_free_tree (expr);
+		set_debug_expression (low, start, val->expr);
+		return result;
+	case AZO_IR_MEMBER:
+		expr = azo_expression_new (EXPRESSION_REFERENCE, REFERENCE_MEMBER, val->expr->term.start, val->expr->term.end);
+		append_child (expr, new_operand (lhs, val->expr));
+		AZOExpression *prop = azo_expression_new (EXPRESSION_REFERENCE, REFERENCE_PROPERTY, val->expr->term.start, val->expr->term.end);
+		az_packed_value_copy (&prop->value, &val->value);
+		append_child (expr, prop);
+		break;
+	default:
+		fprintf (stderr, "azo_ir_lower: Invalid operation %u\n", val->op);
+		return 0;
+	}
+	if ((val->op != AZO_IR_ENV) && (val->op != AZO_IR_MEMBER)) {
+		for (unsigned int i = 0; i < val->n_args; i++) append_child (expr, new_operand (val->args[i], val->expr));
+	}
+	result = azo_compiler_compile_expression (low->comp, expr, low->src);
+	azo_expression_free_tree (expr);
+	set_debug_expression (low, start, val->expr);
+	return result;
+}
+
+static void
+store_slot (IRLowering *low, unsigned int slot, const AZOExpression *expr)
+{
+	azo_compiler_write_EXCHANGE_FRAME (low->comp, slot, expr);
+	azo_compiler_write_POP (low->comp, 1, expr);
+}
+
+static unsigned int
+edge_needs_copies (AZOIRBlock *block)
+{
+	for (unsigned int i = 0; i < block->n_values; i++) {
+		if ((block->values[i]->op == AZO_IR_PHI) && !block->values[i]->removed) return 1;
+	}
+	return 0;
+}
+
+/* Copy incoming values of edge from -> to into phi slots */
+
+static unsigned int
+write_phi_copies (IRLowering *low, AZOIRBlock *from, AZOIRBlock *to)
+{
+	unsigned int idx;
+	for (idx = 0; idx < to->n_preds; idx++) {
+		if (to->preds[idx] == from) break;
+	}
+	for (unsigned int i = 0; i < to->n_values; i++) {
+		AZOIRValue *phi = to->values[i];
+		if ((phi->op != AZO_IR_PHI) || phi->removed) continue;
+		if (!push_operand (low, phi->args[idx], NULL)) return 0;
+	}
+	for (unsigned int i = to->n_values; i > 0; i--) {
+		AZOIRValue *phi = to->values[i - 1];
+		if ((phi->op != AZO_IR_PHI) || phi->removed) continue;
+		store_slot (low, phi->slot, NULL);
+	}
+	return 1;
+}
+
+static unsigned int
+write_block (IRLowering *low, AZOIRBlock *block, AZOIRBlock *next)
+{
+	AZOIRBlock *target;
+	block->ip = azo_frame_get_current_ip (low->comp->current);
+	for (unsigned int i = 0; i < block->n_values; i++) {
+		AZOIRValue *val = block->values[i];
+		if (val->removed || (val->op == AZO_IR_CONST) || (val->op == AZO_IR_UNDEF) || (val->op == AZO_IR_PARAM) || (val->op == AZO_IR_PHI)) continue;
+		if (!write_value (low, val)) return 0;
+		store_slot (low, val->slot, val->expr);
+	}
+	switch (block->term) {
+	case AZO_IR_END:
+		if (next) write_jump (low, JMP_32, NULL, NULL);
+		break;
+	case AZO_IR_RETURN:
+		azo_compiler_write_ic (low->comp, AZO_TC_RETURN, NULL);
+		break;
+	case AZO_IR_RETURN_VALUE:
+		if (!push_operand (low, block->cond, azo_ir_value_get (block->cond)->expr)) return 0;
+		azo_compiler_write_ic (low->comp, AZO_TC_RETURN_VALUE, NULL);
+		break;
+	case AZO_IR_JUMP:
+		if (!write_phi_copies (low, block, block->targets[0])) return 0;
+		if (block->targets[0] != next) write_jump (low, JMP_32, block->targets[0], NULL);
+		break;
+	case AZO_IR_BRANCH:
+		if (!push_operand (low, block->cond, azo_ir_value_get (block->cond)->expr)) return 0;
+		if (azo_ir_value_get (block->cond)->type != AZ_TYPE_BOOLEAN) {
+			azo_code_write_ic_u32_u32 (&low->comp->current->code, AZO_TC_EXCEPTION_IF_TYPE_IS_NOT, 0, AZ_TYPE_BOOLEAN, azo_ir_value_get (block->cond)->expr);
+		}
+		target = block->targets[1];
+		if (!edge_needs_copies (target)) {
+			write_jump (low, JMP_32_IF_NOT, target, NULL);
+			if (!write_phi_copies (low, block, block->targets[0])) return 0;
+			if (block->targets[0] != next) write_jump (low, JMP_32, block->targets[0], NULL);
+		} else {
+			unsigned int not_true = azo_compiler_write_JMP_32 (low->comp, JMP_32_IF_NOT, 0, NULL);
+			if (!write_phi_copies (low, block, block->targets[0])) return 0;
+			write_jump (low, JMP_32, block->targets[0], NULL);
+			azo_compiler_update_JMP_32 (low->comp, not_true);
+			if (!write_phi_copies (low, block, target)) return 0;
+			if (target != next) write_jump (low, JMP_32, target, NULL);
+		}
+		break;
+	default:
+		break;
+	}
+	return 1;
+}
+
+unsigned int
+azo_ir_lower (AZOCompiler *comp, AZOIRFunction *func, AZOSource *src)
+{
+	IRLowering low;
+	unsigned int n_blocks, n_slots = 0, result = 1;
+	AZOIRBlock **rpo = azo_ir_compute_order (func, &n_blocks);
+	memset (&low, 0, sizeof (IRLowering));
+	low.comp = comp;
+	low.func = func;
+	low.src = src;
+	/* Assign slots after entry values */
+	for (unsigned int i = 0; i < n_blocks; i++) {
+		AZOIRBlock *block = rpo[i];
+		for (unsigned int j = 0; j < block->n_values; j++) {
+			AZOIRValue *val = block->values[j];
+			if (val->removed || (val->op == AZO_IR_CONST) || (val->op == AZO_IR_UNDEF) || (val->op == AZO_IR_PARAM)) continue;
+			val->slot = func->n_params + n_slots++;
+		}
+	}
+	for (unsigned int i = 0; i < n_slots; i++) azo_compiler_write_PUSH_EMPTY (comp, AZ_TYPE_NONE, NULL);
+	for (unsigned int i = 0; i < n_blocks; i++) {
+		if (!write_block (&low, rpo[i], (i < (n_blocks - 1)) ? rpo[i + 1] : NULL)) {
+			result = 0;
+			break;
+		}
+	}
+	if (result) {
+		AZOCode *code = &comp->current->code;
+		for (unsigned int i = 0; i < low.n_fixups; i++) {
+			unsigned int to = (low.fixups[i].target) ? low.fixups[i].target->ip : code->bc_len;
+			int32_t raddr = (int) to - (int) (low.fixups[i].pos + 5);
+			memcpy (code->bc + low.fixups[i].pos + 1, &raddr, 4);
+		}
+	}
+	if (low.fixups) free (low.fixups);
+	free (rpo);
+	return result;
+}
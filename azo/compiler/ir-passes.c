@@ -0,0 +1,590 @@
+#define __AZO_COMPILER_IR_PASSES_C__
+
+/*
+ * A languge implementation based on AZ
+ *
+ * Copyright (C) Lauris Kaplinski 2021
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <az/string.h>
+
+#include <azo/compiler/ir.h>
+
+/* Type is not inferred yet */
+#define TYPE_UNKNOWN 0xffffffff
+/* Number of phi range changes before widening to full type range */
+#define MAX_PHI_UPDATES 3
+#define MAX_RANGE_ROUNDS 64
+#define MAX_TYPE_ROUNDS 16
+#define MAX_OPTIMIZE_ROUNDS 8
+
+static void
+replace_value (AZOIRValue *val, AZOIRValue *replacement)
+{
+	val->replacement = replacement;
+	val->removed = 1;
+}
+
+/* Create constant in entry block (constants are not emitted so position does not matter) */
+
+static AZOIRValue *
+new_constant (AZOIRFunction *func, unsigned int type, const AZValue *v, const AZOExpression *expr)
+{
+	AZOIRValue *val = azo_ir_value_new (func, func->blocks[0], AZO_IR_CONST, 0, expr);
+	val->type = type;
+	az_packed_value_set_from_type_value (&val->value, type, v);
+	return val;
+}
+
+/* Copy propagation */
+
+unsigned int
+azo_ir_propagate_copies (AZOIRFunction *func)
+{
+	unsigned int n_removed = 0, changed = 1;
+	while (changed) {
+		changed = 0;
+		for (unsigned int i = 0; i < func->n_values; i++) {
+			AZOIRValue *val = func->values[i];
+			AZOIRValue *same = NULL;
+			unsigned int trivial = 1;
+			if (val->removed || (val->op != AZO_IR_PHI)) continue;
+			for (unsigned int j = 0; j < val->n_args; j++) {
+				AZOIRValue *arg = azo_ir_value_get (val->args[j]);
+				if ((arg == val) || (arg == same)) continue;
+				if (same) {
+					trivial = 0;
+					break;
+				}
+				same = arg;
+			}
+			if (!trivial) continue;
+			if (!same) {
+				/* Only references itself, the variable is never initialized */
+				val->op = AZO_IR_UNDEF;
+				val->n_args = 0;
+				val->type = AZ_TYPE_NONE;
+			} else {
+				replace_value (val, same);
+			}
+			n_removed += 1;
+			changed = 1;
+		}
+	}
+	for (unsigned int i = 0; i < func->n_values; i++) {
+		AZOIRValue *val = func->values[i];
+		if (val->removed) continue;
+		for (unsigned int j = 0; j < val->n_args; j++) val->args[j] = azo_ir_value_get (val->args[j]);
+	}
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		AZOIRBlock *block = func->blocks[i];
+		if (block->cond) block->cond = azo_ir_value_get (block->cond);
+	}
+	return n_removed;
+}
+
+/* Type inference, mirrors the runtime promotion of arithmetic operands */
+
+static unsigned int
+type_is_arithmetic (unsigned int type)
+{
+	return (type >= AZ_TYPE_INT8) && (type <= AZ_TYPE_COMPLEX_DOUBLE);
+}
+
+static unsigned int
+type_is_signed_wide (unsigned int type)
+{
+	return (type == AZ_TYPE_INT32) || (type == AZ_TYPE_INT64) || (type == AZ_TYPE_FLOAT) || (type == AZ_TYPE_DOUBLE);
+}
+
+static unsigned int
+promote_types (unsigned int lhs, unsigned int rhs)
+{
+	if (!type_is_arithmetic (lhs) || !type_is_arithmetic (rhs)) return AZ_TYPE_ANY;
+	unsigned int max = (lhs > rhs) ? lhs : rhs;
+	return (max <= AZ_TYPE_UINT16) ? AZ_TYPE_INT32 : max;
+}
+
+static unsigned int
+compute_type (AZOIRValue *val)
+{
+	unsigned int type;
+	switch (val->op) {
+	case AZO_IR_UNDEF:
+		return AZ_TYPE_NONE;
+	case AZO_IR_CONST:
+		return val->type;
+	case AZO_IR_PARAM:
+	case AZO_IR_ENV:
+	case AZO_IR_MEMBER:
+		return AZ_TYPE_ANY;
+	case AZO_IR_PHI:
+		type = TYPE_UNKNOWN;
+		for (unsigned int i = 0; i < val->n_args; i++) {
+			AZOIRValue *arg = azo_ir_value_get (val->args[i]);
+			if ((arg == val) || (arg->type == TYPE_UNKNOWN)) continue;
+			if (type == TYPE_UNKNOWN) {
+				type = arg->type;
+			} else if (type != arg->type) {
+				type = AZ_TYPE_ANY;
+			}
+		}
+		return type;
+	default:
+		break;
+	}
+	for (unsigned int i = 0; i < val->n_args; i++) {
+		if (azo_ir_value_get (val->args[i])->type == TYPE_UNKNOWN) return TYPE_UNKNOWN;
+	}
+	unsigned int lhs = azo_ir_value_get (val->args[0])->type;
+	switch (val->op) {
+	case AZO_IR_BINARY:
+		return promote_types (lhs, azo_ir_value_get (val->args[1])->type);
+	case AZO_IR_COMPARISON:
+		return AZ_TYPE_BOOLEAN;
+	case AZO_IR_PREFIX:
+		if (val->subtype == PREFIX_NOT) return AZ_TYPE_BOOLEAN;
+		if ((val->subtype == PREFIX_PLUS) || (val->subtype == PREFIX_MINUS)) {
+			return (type_is_signed_wide (lhs)) ? lhs : AZ_TYPE_ANY;
+		}
+		return AZ_TYPE_ANY;
+	case AZO_IR_INCREMENT:
+	case AZO_IR_DECREMENT:
+		return (type_is_signed_wide (lhs)) ? lhs : AZ_TYPE_ANY;
+	default:
+		break;
+	}
+	return AZ_TYPE_ANY;
+}
+
+void
+azo_ir_infer_types (AZOIRFunction *func)
+{
+	unsigned int changed = 1;
+	for (unsigned int i = 0; i < func->n_values; i++) {
+		AZOIRValue *val = func->values[i];
+		if ((val->op != AZO_IR_CONST) && (val->op != AZO_IR_UNDEF)) val->type = TYPE_UNKNOWN;
+	}
+	for (unsigned int round = 0; changed && (round < MAX_TYPE_ROUNDS); round++) {
+		changed = 0;
+		for (unsigned int i = 0; i < func->n_values; i++) {
+			AZOIRValue *val = func->values[i];
+			if (val->removed) continue;
+			unsigned int type = compute_type (val);
+			if (type != val->type) {
+				val->type = type;
+				changed = 1;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < func->n_values; i++) {
+		AZOIRValue *val = func->values[i];
+		if ((val->op == AZO_IR_CONST) || (val->op == AZO_IR_UNDEF)) continue;
+		/* Not converged or never determined */
+		if (changed || (val->type == TYPE_UNKNOWN)) val->type = AZ_TYPE_ANY;
+	}
+}
+
+/* Range analysis */
+
+static unsigned int
+type_has_range (unsigned int type)
+{
+	return (type == AZ_TYPE_INT32) || (type == AZ_TYPE_INT64);
+}
+
+static int64_t
+type_min (unsigned int type)
+{
+	return (type == AZ_TYPE_INT32) ? INT32_MIN : INT64_MIN;
+}
+
+static int64_t
+type_max (unsigned int type)
+{
+	return (type == AZ_TYPE_INT32) ? INT32_MAX : INT64_MAX;
+}
+
+/* Whether both bounds fit into 32 bits so that sums and products of two such numbers do not overflow int64 */
+
+static unsigned int
+range_is_small (AZOIRValue *val)
+{
+	return (val->min >= INT32_MIN) && (val->max <= INT32_MAX);
+}
+
+static unsigned int
+set_range (AZOIRValue *val, unsigned int range, int64_t min, int64_t max)
+{
+	if ((range == AZO_IR_RANGE_SET) && ((min < type_min (val->type)) || (max > type_max (val->type)))) {
+		/* Result may wrap around */
+		range = AZO_IR_RANGE_FULL;
+	}
+	if (range == AZO_IR_RANGE_FULL) {
+		min = type_min (val->type);
+		max = type_max (val->type);
+	}
+	if ((range == val->range) && (min == val->min) && (max == val->max)) return 0;
+	val->range = range;
+	val->min = min;
+	val->max = max;
+	return 1;
+}
+
+static unsigned int
+compute_range (AZOIRValue *val)
+{
+	AZOIRValue *lhs, *rhs;
+	int64_t min, max;
+	unsigned int range;
+	if (val->op == AZO_IR_CONST) {
+		min = max = (val->type == AZ_TYPE_INT32) ? val->value.v.int32_v : val->value.v.int64_v;
+		return set_range (val, AZO_IR_RANGE_SET, min, max);
+	} else if (val->op == AZO_IR_PHI) {
+		range = AZO_IR_RANGE_NONE;
+		min = max = 0;
+		for (unsigned int i = 0; i < val->n_args; i++) {
+			AZOIRValue *arg = azo_ir_value_get (val->args[i]);
+			if ((arg == val) || (arg->range == AZO_IR_RANGE_NONE)) continue;
+			if (!type_has_range (arg->type) || (arg->range == AZO_IR_RANGE_FULL)) return set_range (val, AZO_IR_RANGE_FULL, 0, 0);
+			if (range == AZO_IR_RANGE_NONE) {
+				range = AZO_IR_RANGE_SET;
+				min = arg->min;
+				max = arg->max;
+			} else {
+				if (arg->min < min) min = arg->min;
+				if (arg->max > max) max = arg->max;
+			}
+		}
+		if (range == AZO_IR_RANGE_NONE) return 0;
+		return set_range (val, range, min, max);
+	}
+	if ((val->op != AZO_IR_BINARY) && (val->op != AZO_IR_PREFIX) && (val->op != AZO_IR_INCREMENT) && (val->op != AZO_IR_DECREMENT)) {
+		return set_range (val, AZO_IR_RANGE_FULL, 0, 0);
+	}
+	for (unsigned int i = 0; i < val->n_args; i++) {
+		AZOIRValue *arg = azo_ir_value_get (val->args[i]);
+		/* Wait until operands are known */
+		if (type_has_range (arg->type) && (arg->range == AZO_IR_RANGE_NONE)) return 0;
+		if (!type_has_range (arg->type) || (arg->range == AZO_IR_RANGE_FULL) || !range_is_small (arg)) {
+			return set_range (val, AZO_IR_RANGE_FULL, 0, 0);
+		}
+	}
+	lhs = azo_ir_value_get (val->args[0]);
+	switch (val->op) {
+	case AZO_IR_INCREMENT:
+		return set_range (val, AZO_IR_RANGE_SET, lhs->min + 1, lhs->max + 1);
+	case AZO_IR_DECREMENT:
+		return set_range (val, AZO_IR_RANGE_SET, lhs->min - 1, lhs->max - 1);
+	case AZO_IR_PREFIX:
+		if (val->subtype == PREFIX_PLUS) return set_range (val, AZO_IR_RANGE_SET, lhs->min, lhs->max);
+		if (val->subtype == PREFIX_MINUS) return set_range (val, AZO_IR_RANGE_SET, -lhs->max, -lhs->min);
+		break;
+	case AZO_IR_BINARY:
+		rhs = azo_ir_value_get (val->args[1]);
+		if (val->subtype == ARITHMETIC_PLUS) {
+			return set_range (val, AZO_IR_RANGE_SET, lhs->min + rhs->min, lhs->max + rhs->max);
+		} else if (val->subtype == ARITHMETIC_MINUS) {
+			return set_range (val, AZO_IR_RANGE_SET, lhs->min - rhs->max, lhs->max - rhs->min);
+		} else if (val->subtype == ARITHMETIC_STAR) {
+			int64_t p[4] = { lhs->min * rhs->min, lhs->min * rhs->max, lhs->max * rhs->min, lhs->max * rhs->max };
+			min = max = p[0];
+			for (unsigned int i = 1; i < 4; i++) {
+				if (p[i] < min) min = p[i];
+				if (p[i] > max) max = p[i];
+			}
+			return set_range (val, AZO_IR_RANGE_SET, min, max);
+		}
+		break;
+	default:
+		break;
+	}
+	return set_range (val, AZO_IR_RANGE_FULL, 0, 0);
+}
+
+/* Returns 1 if comparison is always true, 0 if always false, -1 if not known */
+
+static int
+compare_ranges (unsigned int op, AZOIRValue *lhs, AZOIRValue *rhs)
+{
+	switch (op) {
+	case COMPARISON_E:
+	case COMPARISON_NE:
+		if ((lhs->min == lhs->max) && (rhs->min == rhs->max) && (lhs->min == rhs->min)) return op == COMPARISON_E;
+		if ((lhs->max < rhs->min) || (lhs->min > rhs->max)) return op == COMPARISON_NE;
+		break;
+	case COMPARISON_LT:
+		if (lhs->max < rhs->min) return 1;
+		if (lhs->min >= rhs->max) return 0;
+		break;
+	case COMPARISON_LE:
+		if (lhs->max <= rhs->min) return 1;
+		if (lhs->min > rhs->max) return 0;
+		break;
+	case COMPARISON_GT:
+		if (lhs->min > rhs->max) return 1;
+		if (lhs->max <= rhs->min) return 0;
+		break;
+	case COMPARISON_GE:
+		if (lhs->min >= rhs->max) return 1;
+		if (lhs->max < rhs->min) return 0;
+		break;
+	default:
+		break;
+	}
+	return -1;
+}
+
+unsigned int
+azo_ir_analyze_ranges (AZOIRFunction *func)
+{
+	unsigned int n_values = func->n_values;
+	unsigned int changed = 1, n_folded = 0;
+	unsigned int *n_updates = (unsigned int *) malloc (n_values * sizeof (unsigned int));
+	memset (n_updates, 0, n_values * sizeof (unsigned int));
+	for (unsigned int i = 0; i < n_values; i++) func->values[i]->range = AZO_IR_RANGE_NONE;
+	for (unsigned int round = 0; changed && (round < MAX_RANGE_ROUNDS); round++) {
+		changed = 0;
+		for (unsigned int i = 0; i < n_values; i++) {
+			AZOIRValue *val = func->values[i];
+			if (val->removed || !type_has_range (val->type)) continue;
+			/* Widened phis stay at full range */
+			if (n_updates[i] > MAX_PHI_UPDATES) continue;
+			if (compute_range (val)) {
+				changed = 1;
+				/* Widen loop-carried values that keep growing */
+				if ((val->op == AZO_IR_PHI) && (++n_updates[i] > MAX_PHI_UPDATES)) {
+					set_range (val, AZO_IR_RANGE_FULL, 0, 0);
+				}
+			}
+		}
+	}
+	free (n_updates);
+	if (changed) {
+		/* Did not converge, results are not safe to use */
+		for (unsigned int i = 0; i < n_values; i++) func->values[i]->range = AZO_IR_RANGE_NONE;
+		return 0;
+	}
+	for (unsigned int i = 0; i < n_values; i++) {
+		AZOIRValue *val = func->values[i];
+		AZValue v;
+		if (val->removed) continue;
+		if (val->op == AZO_IR_COMPARISON) {
+			AZOIRValue *lhs = azo_ir_value_get (val->args[0]);
+			AZOIRValue *rhs = azo_ir_value_get (val->args[1]);
+			if ((lhs->range != AZO_IR_RANGE_SET) || (rhs->range != AZO_IR_RANGE_SET)) continue;
+			int result = compare_ranges (val->subtype, lhs, rhs);
+			if (result < 0) continue;
+			v.boolean_v = result;
+			replace_value (val, new_constant (func, AZ_TYPE_BOOLEAN, &v, val->expr));
+			n_folded += 1;
+		} else if ((val->op != AZO_IR_CONST) && (val->op != AZO_IR_PARAM) && (val->range == AZO_IR_RANGE_SET) && (val->min == val->max)) {
+			/* Propagate integer constants */
+			if (val->type == AZ_TYPE_INT32) {
+				v.int32_v = (int32_t) val->min;
+			} else {
+				v.int64_v = val->min;
+			}
+			AZOIRValue *c = new_constant (func, val->type, &v, val->expr);
+			c->range = AZO_IR_RANGE_SET;
+			c->min = c->max = val->min;
+			replace_value (val, c);
+			n_folded += 1;
+		}
+	}
+	return n_folded;
+}
+
+/* Common subexpression elimination */
+
+static void
+compute_dominators (AZOIRBlock **rpo, unsigned int n_blocks)
+{
+	unsigned int changed = 1;
+	for (unsigned int i = 0; i < n_blocks; i++) rpo[i]->idom = NULL;
+	rpo[0]->idom = rpo[0];
+	while (changed) {
+		changed = 0;
+		for (unsigned int i = 1; i < n_blocks; i++) {
+			AZOIRBlock *block = rpo[i];
+			AZOIRBlock *idom = NULL;
+			for (unsigned int j = 0; j < block->n_preds; j++) {
+				AZOIRBlock *pred = block->preds[j];
+				if (!pred->reachable || !pred->idom) continue;
+				if (!idom) {
+					idom = pred;
+					continue;
+				}
+				/* Intersect */
+				AZOIRBlock *a = pred, *b = idom;
+				while (a != b) {
+					while (a->order > b->order) a = a->idom;
+					while (b->order > a->order) b = b->idom;
+				}
+				idom = a;
+			}
+			if (idom != block->idom) {
+				block->idom = idom;
+				changed = 1;
+			}
+		}
+	}
+	rpo[0]->idom = NULL;
+}
+
+static unsigned int
+block_dominates (AZOIRBlock *dom, AZOIRBlock *block)
+{
+	for (; block; block = block->idom) {
+		if (block == dom) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+value_can_be_shared (AZOIRFunction *func, AZOIRValue *val)
+{
+	switch (val->op) {
+	case AZO_IR_ENV:
+	case AZO_IR_BINARY:
+	case AZO_IR_COMPARISON:
+	case AZO_IR_PREFIX:
+		return 1;
+	case AZO_IR_MEMBER:
+		/* Neither calls nor property assignments are present in IR so only getters can change values */
+		return func->pure_properties;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static unsigned int
+values_are_equal (AZOIRValue *lhs, AZOIRValue *rhs)
+{
+	if ((lhs->op != rhs->op) || (lhs->subtype != rhs->subtype) || (lhs->n_args != rhs->n_args)) return 0;
+	for (unsigned int i = 0; i < lhs->n_args; i++) {
+		if (azo_ir_value_get (lhs->args[i]) != azo_ir_value_get (rhs->args[i])) return 0;
+	}
+	if (lhs->op == AZO_IR_ENV) return lhs->pos == rhs->pos;
+	if (lhs->op == AZO_IR_MEMBER) return lhs->value.v.string == rhs->value.v.string;
+	return 1;
+}
+
+unsigned int
+azo_ir_eliminate_common (AZOIRFunction *func)
+{
+	unsigned int n_blocks, n_avail = 0, n_replaced = 0;
+	AZOIRBlock **rpo = azo_ir_compute_order (func, &n_blocks);
+	AZOIRValue **avail = (AZOIRValue **) malloc (func->n_values * sizeof (AZOIRValue *));
+	compute_dominators (rpo, n_blocks);
+	/* Dominators are visited first in reverse postorder */
+	for (unsigned int i = 0; i < n_blocks; i++) {
+		AZOIRBlock *block = rpo[i];
+		for (unsigned int j = 0; j < block->n_values; j++) {
+			AZOIRValue *val = block->values[j];
+			unsigned int k;
+			if (val->removed || !value_can_be_shared (func, val)) continue;
+			for (k = 0; k < n_avail; k++) {
+				if (values_are_equal (avail[k], val) && block_dominates (avail[k]->block, block)) break;
+			}
+			if (k < n_avail) {
+				replace_value (val, avail[k]);
+				n_replaced += 1;
+			} else {
+				avail[n_avail++] = val;
+			}
+		}
+	}
+	free (avail);
+	free (rpo);
+	return n_replaced;
+}
+
+/* Dead code elimination */
+
+static void
+count_uses (AZOIRFunction *func)
+{
+	for (unsigned int i = 0; i < func->n_values; i++) func->values[i]->n_uses = 0;
+	for (unsigned int i = 0; i < func->n_values; i++) {
+		AZOIRValue *val = func->values[i];
+		if (val->removed) continue;
+		for (unsigned int j = 0; j < val->n_args; j++) azo_ir_value_get (val->args[j])->n_uses += 1;
+	}
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		AZOIRBlock *block = func->blocks[i];
+		if (block->reachable && block->cond) azo_ir_value_get (block->cond)->n_uses += 1;
+	}
+}
+
+unsigned int
+azo_ir_eliminate_dead (AZOIRFunction *func)
+{
+	unsigned int n_blocks, n_removed = 0, changed = 1;
+	/* Constant branches */
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		AZOIRBlock *block = func->blocks[i];
+		if (!block->reachable || (block->term != AZO_IR_BRANCH)) continue;
+		AZOIRValue *cond = azo_ir_value_get (block->cond);
+		if ((cond->op != AZO_IR_CONST) || (cond->type != AZ_TYPE_BOOLEAN)) continue;
+		AZOIRBlock *taken = (cond->value.v.boolean_v) ? block->targets[0] : block->targets[1];
+		AZOIRBlock *other = (cond->value.v.boolean_v) ? block->targets[1] : block->targets[0];
+		azo_ir_block_remove_pred (other, block);
+		block->term = AZO_IR_JUMP;
+		block->cond = NULL;
+		block->targets[0] = taken;
+		block->targets[1] = NULL;
+		n_removed += 1;
+	}
+	/* Unreachable blocks */
+	free (azo_ir_compute_order (func, &n_blocks));
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		AZOIRBlock *block = func->blocks[i];
+		if (block->reachable) continue;
+		for (unsigned int j = 0; j < 2; j++) {
+			if (block->targets[j]) azo_ir_block_remove_pred (block->targets[j], block);
+			block->targets[j] = NULL;
+		}
+		block->term = AZO_IR_END;
+		block->cond = NULL;
+		for (unsigned int j = 0; j < block->n_values; j++) {
+			if (!block->values[j]->removed) {
+				block->values[j]->removed = 1;
+				n_removed += 1;
+			}
+		}
+	}
+	/* Unused values */
+	while (changed) {
+		changed = 0;
+		count_uses (func);
+		for (unsigned int i = 0; i < func->n_values; i++) {
+			AZOIRValue *val = func->values[i];
+			if (val->removed || val->n_uses || azo_ir_value_has_effects (func, val)) continue;
+			val->removed = 1;
+			n_removed += 1;
+			changed = 1;
+		}
+	}
+	return n_removed;
+}
+
+void
+azo_ir_optimize (AZOIRFunction *func)
+{
+	for (unsigned int round = 0; round < MAX_OPTIMIZE_ROUNDS; round++) {
+		unsigned int changed = azo_ir_propagate_copies (func);
+		azo_ir_infer_types (func);
+		changed += azo_ir_analyze_ranges (func);
+		changed += azo_ir_eliminate_common (func);
+		changed += azo_ir_eliminate_dead (func);
+		if (!changed) break;
+	}
+	/* Rewrite operands of the last replacements */
+	azo_ir_propagate_copies (func);
+	count_uses (func);
+}
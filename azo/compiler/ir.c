@@ -0,0 +1,807 @@
+#define __AZO_COMPILER_IR_C__
+
+/*
+ * A languge implementation based on AZ
+ *
+ * Copyright (C) Lauris Kaplinski 2021
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <az/class.h>
+#include <az/string.h>
+
+#include <azo/keyword.h>
+#include <azo/compiler/ir.h>
+
+AZOIRValue *
+azo_ir_value_new (AZOIRFunction *func, AZOIRBlock *block, unsigned int op, unsigned int subtype, const AZOExpression *expr)
+{
+	AZOIRValue *val = (AZOIRValue *) malloc (sizeof (AZOIRValue));
+	memset (val, 0, sizeof (AZOIRValue));
+	val->id = func->n_values;
+	val->op = op;
+	val->subtype = subtype;
+	val->type = AZ_TYPE_ANY;
+	val->block = block;
+	val->expr = expr;
+	if (func->n_values >= func->size_values) {
+		func->size_values = (func->size_values) ? func->size_values << 1 : 64;
+		func->values = (AZOIRValue **) realloc (func->values, func->size_values * sizeof (AZOIRValue *));
+	}
+	func->values[func->n_values++] = val;
+	if (block) {
+		if (block->n_values >= block->size_values) {
+			block->size_values = (block->size_values) ? block->size_values << 1 : 16;
+			block->values = (AZOIRValue **) realloc (block->values, block->size_values * sizeof (AZOIRValue *));
+		}
+		if (op == AZO_IR_PHI) {
+			/* Keep phis at the beginning of block */
+			unsigned int pos = 0;
+			while ((pos < block->n_values) && (block->values[pos]->op == AZO_IR_PHI)) pos += 1;
+			memmove (&block->values[pos + 1], &block->values[pos], (block->n_values - pos) * sizeof (AZOIRValue *));
+			block->values[pos] = val;
+		} else {
+			block->values[block->n_values] = val;
+		}
+		block->n_values += 1;
+	}
+	return val;
+}
+
+static void
+azo_ir_value_delete (AZOIRValue *val)
+{
+	az_packed_value_clear (&val->value);
+	if (val->args) free (val->args);
+	free (val);
+}
+
+void
+azo_ir_value_append_arg (AZOIRValue *val, AZOIRValue *arg)
+{
+	if (val->n_args >= val->size_args) {
+		val->size_args = (val->size_args) ? val->size_args << 1 : 2;
+		val->args = (AZOIRValue **) realloc (val->args, val->size_args * sizeof (AZOIRValue *));
+	}
+	val->args[val->n_args++] = arg;
+}
+
+AZOIRValue *
+azo_ir_value_get (AZOIRValue *val)
+{
+	while (val->replacement) val = val->replacement;
+	return val;
+}
+
+static unsigned int
+type_is_safe_arithmetic (unsigned int type)
+{
+	return (type >= AZ_TYPE_INT8) && (type <= AZ_TYPE_COMPLEX_DOUBLE);
+}
+
+unsigned int
+azo_ir_value_has_effects (AZOIRFunction *func, AZOIRValue *val)
+{
+	unsigned int lhs = (val->n_args > 0) ? azo_ir_value_get (val->args[0])->type : AZ_TYPE_NONE;
+	unsigned int rhs = (val->n_args > 1) ? azo_ir_value_get (val->args[1])->type : AZ_TYPE_NONE;
+	switch (val->op) {
+	case AZO_IR_UNDEF:
+	case AZO_IR_CONST:
+	case AZO_IR_PARAM:
+	case AZO_IR_ENV:
+	case AZO_IR_PHI:
+		return 0;
+	case AZO_IR_BINARY:
+		if ((val->subtype == ARITHMETIC_PLUS) || (val->subtype == ARITHMETIC_MINUS) || (val->subtype == ARITHMETIC_STAR)) {
+			return !type_is_safe_arithmetic (lhs) || !type_is_safe_arithmetic (rhs);
+		}
+		/* Division may fail on integer zero */
+		return 1;
+	case AZO_IR_COMPARISON:
+		if ((val->subtype == COMPARISON_E) || (val->subtype == COMPARISON_NE)) {
+			return !type_is_safe_arithmetic (lhs) || !type_is_safe_arithmetic (rhs);
+		}
+		return !type_is_safe_arithmetic (lhs) || (lhs > AZ_TYPE_DOUBLE) || !type_is_safe_arithmetic (rhs) || (rhs > AZ_TYPE_DOUBLE);
+	case AZO_IR_PREFIX:
+		if (val->subtype == PREFIX_NOT) return lhs != AZ_TYPE_BOOLEAN;
+		if (val->subtype == PREFIX_PLUS) return 0;
+		return 1;
+	case AZO_IR_INCREMENT:
+	case AZO_IR_DECREMENT:
+		return !type_is_safe_arithmetic (lhs);
+	case AZO_IR_MEMBER:
+		/* Property getters may have side effects and null instance throws */
+		return 1;
+	default:
+		break;
+	}
+	return 1;
+}
+
+AZOIRBlock *
+azo_ir_block_new (AZOIRFunction *func)
+{
+	AZOIRBlock *block = (AZOIRBlock *) malloc (sizeof (AZOIRBlock));
+	memset (block, 0, sizeof (AZOIRBlock));
+	block->id = func->n_blocks;
+	if (func->n_vars) {
+		block->defs = (AZOIRValue **) malloc (func->n_vars * sizeof (AZOIRValue *));
+		memset (block->defs, 0, func->n_vars * sizeof (AZOIRValue *));
+	}
+	if (func->n_blocks >= func->size_blocks) {
+		func->size_blocks = (func->size_blocks) ? func->size_blocks << 1 : 16;
+		func->blocks = (AZOIRBlock **) realloc (func->blocks, func->size_blocks * sizeof (AZOIRBlock *));
+	}
+	func->blocks[func->n_blocks++] = block;
+	return block;
+}
+
+static void
+azo_ir_block_delete (AZOIRBlock *block)
+{
+	if (block->preds) free (block->preds);
+	if (block->values) free (block->values);
+	if (block->defs) free (block->defs);
+	free (block);
+}
+
+void
+azo_ir_block_add_pred (AZOIRBlock *block, AZOIRBlock *pred)
+{
+	if (block->n_preds >= block->size_preds) {
+		block->size_preds = (block->size_preds) ? block->size_preds << 1 : 2;
+		block->preds = (AZOIRBlock **) realloc (block->preds, block->size_preds * sizeof (AZOIRBlock *));
+	}
+	block->preds[block->n_preds++] = pred;
+}
+
+void
+azo_ir_block_remove_pred (AZOIRBlock *block, AZOIRBlock *pred)
+{
+	unsigned int idx;
+	for (idx = 0; idx < block->n_preds; idx++) {
+		if (block->preds[idx] == pred) break;
+	}
+	if (idx >= block->n_preds) return;
+	memmove (&block->preds[idx], &block->preds[idx + 1], (block->n_preds - idx - 1) * sizeof (AZOIRBlock *));
+	block->n_preds -= 1;
+	for (unsigned int i = 0; i < block->n_values; i++) {
+		AZOIRValue *val = block->values[i];
+		if ((val->op != AZO_IR_PHI) || (val->n_args <= idx)) continue;
+		memmove (&val->args[idx], &val->args[idx + 1], (val->n_args - idx - 1) * sizeof (AZOIRValue *));
+		val->n_args -= 1;
+	}
+}
+
+static unsigned int
+get_successors (AZOIRBlock *block, AZOIRBlock *succ[])
+{
+	if (block->term == AZO_IR_JUMP) {
+		succ[0] = block->targets[0];
+		return 1;
+	} else if (block->term == AZO_IR_BRANCH) {
+		succ[0] = block->targets[0];
+		succ[1] = block->targets[1];
+		return 2;
+	}
+	return 0;
+}
+
+AZOIRBlock **
+azo_ir_compute_order (AZOIRFunction *func, unsigned int *n_blocks)
+{
+	/* Iterative depth-first search, next successor index is kept in parallel stack */
+	AZOIRBlock **stack = (AZOIRBlock **) malloc (func->n_blocks * sizeof (AZOIRBlock *));
+	unsigned int *next = (unsigned int *) malloc (func->n_blocks * sizeof (unsigned int));
+	AZOIRBlock **post = (AZOIRBlock **) malloc (func->n_blocks * sizeof (AZOIRBlock *));
+	unsigned int n_stack = 0, n_post = 0;
+	for (unsigned int i = 0; i < func->n_blocks; i++) func->blocks[i]->reachable = 0;
+	func->blocks[0]->reachable = 1;
+	stack[n_stack] = func->blocks[0];
+	next[n_stack++] = 0;
+	while (n_stack) {
+		AZOIRBlock *succ[2];
+		AZOIRBlock *block = stack[n_stack - 1];
+		unsigned int n_succ = get_successors (block, succ);
+		if (next[n_stack - 1] < n_succ) {
+			AZOIRBlock *child = succ[next[n_stack - 1]++];
+			if (!child->reachable) {
+				child->reachable = 1;
+				stack[n_stack] = child;
+				next[n_stack++] = 0;
+			}
+		} else {
+			post[n_post++] = block;
+			n_stack -= 1;
+		}
+	}
+	free (stack);
+	free (next);
+	AZOIRBlock **rpo = (AZOIRBlock **) malloc (n_post * sizeof (AZOIRBlock *));
+	for (unsigned int i = 0; i < n_post; i++) {
+		rpo[i] = post[n_post - 1 - i];
+		rpo[i]->order = i;
+	}
+	free (post);
+	*n_blocks = n_post;
+	return rpo;
+}
+
+void
+azo_ir_delete (AZOIRFunction *func)
+{
+	for (unsigned int i = 0; i < func->n_values; i++) azo_ir_value_delete (func->values[i]);
+	for (unsigned int i = 0; i < func->n_blocks; i++) azo_ir_block_delete (func->blocks[i]);
+	if (func->values) free (func->values);
+	if (func->blocks) free (func->blocks);
+	free (func);
+}
+
+/*
+ * Building
+ *
+ * SSA form is constructed directly from tree (Braun et al. "Simple and Efficient Construction of SSA Form").
+ * Variables are identified by frame position, positions are assigned in the same order as resolver does.
+ */
+
+typedef struct _IRBuilder IRBuilder;
+
+struct _IRBuilder {
+	AZOCompiler *comp;
+	AZOIRFunction *func;
+	/* NULL if code is unreachable */
+	AZOIRBlock *current;
+	/* Next free variable position */
+	unsigned int next_pos;
+};
+
+static AZOIRValue *read_variable (IRBuilder *b, AZOIRBlock *block, unsigned int var);
+
+static void
+write_variable (AZOIRBlock *block, unsigned int var, AZOIRValue *val)
+{
+	block->defs[var] = val;
+}
+
+static void
+add_phi_operands (IRBuilder *b, AZOIRValue *phi)
+{
+	for (unsigned int i = 0; i < phi->block->n_preds; i++) {
+		azo_ir_value_append_arg (phi, read_variable (b, phi->block->preds[i], phi->pos));
+	}
+}
+
+static AZOIRValue *
+read_variable (IRBuilder *b, AZOIRBlock *block, unsigned int var)
+{
+	AZOIRValue *val;
+	if (block->defs[var]) return block->defs[var];
+	if (!block->sealed) {
+		val = azo_ir_value_new (b->func, block, AZO_IR_PHI, 0, NULL);
+		val->pos = var;
+		val->incomplete = 1;
+	} else if (!block->n_preds) {
+		if ((block == b->func->blocks[0]) && (var < b->func->n_params)) {
+			val = azo_ir_value_new (b->func, block, AZO_IR_PARAM, 0, NULL);
+			val->pos = var;
+		} else {
+			val = azo_ir_value_new (b->func, block, AZO_IR_UNDEF, 0, NULL);
+			val->type = AZ_TYPE_NONE;
+		}
+	} else if (block->n_preds == 1) {
+		val = read_variable (b, block->preds[0], var);
+	} else {
+		val = azo_ir_value_new (b->func, block, AZO_IR_PHI, 0, NULL);
+		val->pos = var;
+		/* Break cycles */
+		write_variable (block, var, val);
+		add_phi_operands (b, val);
+	}
+	write_variable (block, var, val);
+	return val;
+}
+
+static void
+seal_block (IRBuilder *b, AZOIRBlock *block)
+{
+	for (unsigned int i = 0; i < block->n_values; i++) {
+		AZOIRValue *val = block->values[i];
+		if (val->op != AZO_IR_PHI) break;
+		if (val->incomplete) {
+			add_phi_operands (b, val);
+			val->incomplete = 0;
+		}
+	}
+	block->sealed = 1;
+}
+
+static void
+terminate (IRBuilder *b, unsigned int term, AZOIRValue *cond, AZOIRBlock *target0, AZOIRBlock *target1)
+{
+	AZOIRBlock *block = b->current;
+	block->term = term;
+	block->cond = cond;
+	block->targets[0] = target0;
+	block->targets[1] = target1;
+	if (target0) azo_ir_block_add_pred (target0, block);
+	if (target1) azo_ir_block_add_pred (target1, block);
+	b->current = NULL;
+}
+
+static AZOIRValue *build_expression (IRBuilder *b, const AZOExpression *expr);
+
+static AZOIRValue *
+build_binary (IRBuilder *b, unsigned int op, const AZOExpression *expr)
+{
+	AZOIRValue *lhs, *rhs, *val;
+	lhs = build_expression (b, expr->children);
+	if (!lhs) return NULL;
+	rhs = build_expression (b, expr->children->next);
+	if (!rhs) return NULL;
+	val = azo_ir_value_new (b->func, b->current, op, expr->term.subtype, expr);
+	azo_ir_value_append_arg (val, lhs);
+	azo_ir_value_append_arg (val, rhs);
+	return val;
+}
+
+static AZOIRValue *
+build_boolean (IRBuilder *b, unsigned int value, const AZOExpression *expr)
+{
+	AZValue v;
+	v.boolean_v = value;
+	/* Constants are not emitted so block does not matter */
+	AZOIRValue *val = azo_ir_value_new (b->func, b->func->blocks[0], AZO_IR_CONST, 0, expr);
+	val->type = AZ_TYPE_BOOLEAN;
+	az_packed_value_set_from_type_value (&val->value, AZ_TYPE_BOOLEAN, &v);
+	return val;
+}
+
+/*
+ * Right operand of && and || is evaluated only if left one does not decide the result
+ *
+ *   lhs: BRANCH lhs -> rhs, join (|| swaps targets)
+ *   rhs: BRANCH rhs -> last, join
+ *   last: JUMP join
+ *   join: PHI
+ *
+ * Both operands are tested by branches, so non-boolean values throw as in bytecode
+ */
+
+static AZOIRValue *
+build_logical (IRBuilder *b, const AZOExpression *expr)
+{
+	unsigned int is_and = (expr->term.subtype == ARITHMETIC_ANDAND);
+	AZOIRValue *lhs, *rhs, *val;
+	lhs = build_expression (b, expr->children);
+	if (!lhs) return NULL;
+	AZOIRBlock *rblock = azo_ir_block_new (b->func);
+	AZOIRBlock *last = azo_ir_block_new (b->func);
+	AZOIRBlock *join = azo_ir_block_new (b->func);
+	if (is_and) {
+		terminate (b, AZO_IR_BRANCH, lhs, rblock, join);
+	} else {
+		terminate (b, AZO_IR_BRANCH, lhs, join, rblock);
+	}
+	seal_block (b, rblock);
+	b->current = rblock;
+	rhs = build_expression (b, expr->children->next);
+	if (!rhs) return NULL;
+	if (is_and) {
+		terminate (b, AZO_IR_BRANCH, rhs, last, join);
+	} else {
+		terminate (b, AZO_IR_BRANCH, rhs, join, last);
+	}
+	seal_block (b, last);
+	b->current = last;
+	terminate (b, AZO_IR_JUMP, NULL, join, NULL);
+	seal_block (b, join);
+	b->current = join;
+	/* Predecessors are lhs, rhs and last in this order */
+	val = azo_ir_value_new (b->func, join, AZO_IR_PHI, expr->term.subtype, expr);
+	azo_ir_value_append_arg (val, build_boolean (b, !is_and, expr));
+	azo_ir_value_append_arg (val, build_boolean (b, !is_and, expr));
+	azo_ir_value_append_arg (val, build_boolean (b, is_and, expr));
+	return val;
+}
+
+static AZOIRValue *
+build_member (IRBuilder *b, AZOIRValue *obj, AZString *name, const AZOExpression *expr)
+{
+	AZOIRValue *val = azo_ir_value_new (b->func, b->current, AZO_IR_MEMBER, 0, expr);
+	azo_ir_value_append_arg (val, obj);
+	az_packed_value_set_string (&val->value, name);
+	return val;
+}
+
+/* Increment or decrement local variable, return new value */
+
+static AZOIRValue *
+build_step (IRBuilder *b, unsigned int op, const AZOExpression *var, const AZOExpression *expr, AZOIRValue **old)
+{
+	if (!AZO_EXPRESSION_IS(var, EXPRESSION_VARIABLE, VARIABLE_LOCAL)) return NULL;
+	if (var->var_pos >= b->func->n_vars) return NULL;
+	*old = read_variable (b, b->current, var->var_pos);
+	AZOIRValue *val = azo_ir_value_new (b->func, b->current, op, 0, expr);
+	azo_ir_value_append_arg (val, *old);
+	write_variable (b->current, var->var_pos, val);
+	return val;
+}
+
+static AZOIRValue *
+build_expression (IRBuilder *b, const AZOExpression *expr)
+{
+	AZOIRValue *val, *old;
+	switch (expr->term.type) {
+	case EXPRESSION_CONSTANT:
+		if (expr->children) return NULL;
+		val = azo_ir_value_new (b->func, b->current, AZO_IR_CONST, 0, expr);
+		val->type = expr->term.subtype;
+		if (expr->value.impl) az_packed_value_copy (&val->value, &expr->value);
+		return val;
+	case EXPRESSION_VARIABLE:
+		if (expr->term.subtype == VARIABLE_LOCAL) {
+			if (expr->var_pos >= b->func->n_vars) return NULL;
+			return read_variable (b, b->current, expr->var_pos);
+		}
+		if (expr->term.subtype != VARIABLE_PARENT) return NULL;
+		val = azo_ir_value_new (b->func, b->current, AZO_IR_ENV, 0, expr);
+		val->pos = expr->var_pos;
+		return val;
+	case EXPRESSION_KEYWORD:
+		if (expr->term.subtype == AZO_KEYWORD_THIS) return read_variable (b, b->current, 0);
+		return NULL;
+	case EXPRESSION_BINARY:
+		if ((expr->term.subtype == ARITHMETIC_ANDAND) || (expr->term.subtype == ARITHMETIC_OROR)) return build_logical (b, expr);
+		if (expr->term.subtype > ARITHMETIC_PERCENT) return NULL;
+		return build_binary (b, AZO_IR_BINARY, expr);
+	case EXPRESSION_COMPARISON:
+		return build_binary (b, AZO_IR_COMPARISON, expr);
+	case EXPRESSION_PREFIX:
+		if (expr->term.subtype == PREFIX_INCREMENT) {
+			return build_step (b, AZO_IR_INCREMENT, expr->children, expr, &old);
+		} else if (expr->term.subtype == PREFIX_DECREMENT) {
+			return build_step (b, AZO_IR_DECREMENT, expr->children, expr, &old);
+		}
+		old = build_expression (b, expr->children);
+		if (!old) return NULL;
+		val = azo_ir_value_new (b->func, b->current, AZO_IR_PREFIX, expr->term.subtype, expr);
+		azo_ir_value_append_arg (val, old);
+		return val;
+	case EXPRESSION_SUFFIX:
+		val = build_step (b, (expr->term.subtype == SUFFIX_INCREMENT) ? AZO_IR_INCREMENT : AZO_IR_DECREMENT, expr->children, expr, &old);
+		return (val) ? old : NULL;
+	case EXPRESSION_REFERENCE:
+		if (expr->term.subtype == REFERENCE_VARIABLE) {
+			/* Unresolved name is property of this */
+			return build_member (b, read_variable (b, b->current, 0), expr->value.v.string, expr);
+		} else if (expr->term.subtype == REFERENCE_MEMBER) {
+			if (!AZO_EXPRESSION_IS(expr->children->next, EXPRESSION_REFERENCE, REFERENCE_PROPERTY)) return NULL;
+			old = build_expression (b, expr->children);
+			if (!old) return NULL;
+			return build_member (b, old, expr->children->next->value.v.string, expr);
+		}
+		return NULL;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+static unsigned int build_sentence (IRBuilder *b, const AZOExpression *expr);
+
+static unsigned int
+build_sentences (IRBuilder *b, const AZOExpression *expr)
+{
+	for (; expr; expr = expr->next) {
+		/* Code after return is not reachable */
+		if (!b->current) return 1;
+		if (!build_sentence (b, expr)) return 0;
+	}
+	return 1;
+}
+
+static unsigned int
+build_declaration_list (IRBuilder *b, const AZOExpression *expr)
+{
+	for (const AZOExpression *decl = expr->children->next; decl; decl = decl->next) {
+		AZOIRValue *val;
+		const AZOExpression *value = decl->children->next;
+		if (value) {
+			val = build_expression (b, value);
+			if (!val) return 0;
+		} else {
+			val = azo_ir_value_new (b->func, b->current, AZO_IR_CONST, 0, decl);
+			val->type = AZ_TYPE_NONE;
+		}
+		write_variable (b->current, b->next_pos++, val);
+	}
+	return 1;
+}
+
+static unsigned int
+build_statement (IRBuilder *b, const AZOExpression *expr)
+{
+	AZOIRValue *val, *old;
+	switch (expr->term.type) {
+	case AZO_TERM_EMPTY:
+		return 1;
+	case EXPRESSION_DECLARATION_LIST:
+		return build_declaration_list (b, expr);
+	case EXPRESSION_ASSIGN:
+		if (expr->term.subtype != ASSIGN) return 0;
+		if (!AZO_EXPRESSION_IS(expr->children, EXPRESSION_VARIABLE, VARIABLE_LOCAL)) return 0;
+		if (expr->children->var_pos >= b->func->n_vars) return 0;
+		val = build_expression (b, expr->children->next);
+		if (!val) return 0;
+		write_variable (b->current, expr->children->var_pos, val);
+		return 1;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype != PREFIX_INCREMENT) && (expr->term.subtype != PREFIX_DECREMENT)) return 0;
+		return build_step (b, (expr->term.subtype == PREFIX_INCREMENT) ? AZO_IR_INCREMENT : AZO_IR_DECREMENT, expr->children, expr, &old) != NULL;
+	case EXPRESSION_SUFFIX:
+		return build_step (b, (expr->term.subtype == SUFFIX_INCREMENT) ? AZO_IR_INCREMENT : AZO_IR_DECREMENT, expr->children, expr, &old) != NULL;
+	case EXPRESSION_KEYWORD:
+		if (expr->term.subtype == AZO_KEYWORD_RETURN) {
+			if (expr->children && (expr->children->term.type != AZO_TERM_EMPTY)) {
+				val = build_expression (b, expr->children);
+				if (!val) return 0;
+				terminate (b, AZO_IR_RETURN_VALUE, val, NULL, NULL);
+			} else {
+				terminate (b, AZO_IR_RETURN, NULL, NULL, NULL);
+			}
+			return 1;
+		}
+		return 0;
+	default:
+		break;
+	}
+	return 0;
+}
+
+/* Build loop, test and step may be NULL */
+
+static unsigned int
+build_loop (IRBuilder *b, const AZOExpression *test, const AZOExpression *step, const AZOExpression *content)
+{
+	AZOIRBlock *header = azo_ir_block_new (b->func);
+	AZOIRBlock *body = azo_ir_block_new (b->func);
+	AZOIRBlock *exit = azo_ir_block_new (b->func);
+	terminate (b, AZO_IR_JUMP, NULL, header, NULL);
+	b->current = header;
+	if (test && (test->term.type != AZO_TERM_EMPTY)) {
+		AZOIRValue *cond = build_expression (b, test);
+		if (!cond) return 0;
+		terminate (b, AZO_IR_BRANCH, cond, body, exit);
+	} else {
+		terminate (b, AZO_IR_JUMP, NULL, body, NULL);
+	}
+	seal_block (b, body);
+	b->current = body;
+	if (!build_sentence (b, content)) return 0;
+	if (b->current) {
+		if (step && !build_statement (b, step)) return 0;
+		terminate (b, AZO_IR_JUMP, NULL, header, NULL);
+	}
+	seal_block (b, header);
+	seal_block (b, exit);
+	b->current = exit;
+	return 1;
+}
+
+static unsigned int
+build_sentence (IRBuilder *b, const AZOExpression *expr)
+{
+	unsigned int result, next_pos = b->next_pos;
+	if (AZO_EXPRESSION_IS(expr, AZO_EXPRESSION_BLOCK, 0)) {
+		result = build_sentences (b, expr->children);
+		b->next_pos = next_pos;
+		return result;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_IF)) {
+		const AZOExpression *cond = expr->children;
+		const AZOExpression *iftrue = cond->next;
+		const AZOExpression *iffalse = iftrue->next;
+		AZOIRValue *val = build_expression (b, cond);
+		if (!val) return 0;
+		AZOIRBlock *tblock = azo_ir_block_new (b->func);
+		AZOIRBlock *fblock = azo_ir_block_new (b->func);
+		AZOIRBlock *join = (iffalse) ? azo_ir_block_new (b->func) : fblock;
+		terminate (b, AZO_IR_BRANCH, val, tblock, fblock);
+		seal_block (b, tblock);
+		seal_block (b, fblock);
+		b->current = tblock;
+		if (!build_sentence (b, iftrue)) return 0;
+		if (b->current) terminate (b, AZO_IR_JUMP, NULL, join, NULL);
+		if (iffalse) {
+			b->current = fblock;
+			if (!build_sentence (b, iffalse)) return 0;
+			if (b->current) terminate (b, AZO_IR_JUMP, NULL, join, NULL);
+			seal_block (b, join);
+		}
+		b->current = join;
+		return 1;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_WHILE)) {
+		return build_loop (b, expr->children, NULL, expr->children->next);
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_FOR)) {
+		const AZOExpression *init = expr->children;
+		const AZOExpression *test = init->next;
+		const AZOExpression *step = test->next;
+		if (!build_statement (b, init)) return 0;
+		result = build_loop (b, test, step, step->next);
+		b->next_pos = next_pos;
+		return result;
+	}
+	return build_statement (b, expr);
+}
+
+static unsigned int
+count_declarations (const AZOExpression *expr)
+{
+	unsigned int count = (expr->term.type == EXPRESSION_DECLARATION);
+	for (const AZOExpression *child = expr->children; child; child = child->next) {
+		count += count_declarations (child);
+	}
+	return count;
+}
+
+/* Count declarations that go into the current scope (i.e. are not inside block or for) */
+
+static unsigned int
+count_scope_declarations (const AZOExpression *expr)
+{
+	unsigned int count = 0;
+	if (expr->term.type == EXPRESSION_DECLARATION_LIST) {
+		for (const AZOExpression *decl = expr->children->next; decl; decl = decl->next) count += 1;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_IF)) {
+		for (const AZOExpression *child = expr->children->next; child; child = child->next) {
+			count += count_scope_declarations (child);
+		}
+	}
+	return count;
+}
+
+AZOIRFunction *
+azo_ir_build (AZOCompiler *comp, const AZOExpression *root)
+{
+	IRBuilder b;
+	unsigned int n_top = 0;
+	/* Top-level declarations are resolved in the root scope of frame */
+	for (const AZOExpression *child = root->children; child; child = child->next) {
+		n_top += count_scope_declarations (child);
+	}
+	AZOIRFunction *func = (AZOIRFunction *) malloc (sizeof (AZOIRFunction));
+	memset (func, 0, sizeof (AZOIRFunction));
+	func->n_params = comp->current->scope->next_var_pos - n_top;
+	func->n_vars = func->n_params + count_declarations (root);
+	func->pure_properties = comp->pure_properties;
+	b.comp = comp;
+	b.func = func;
+	b.current = azo_ir_block_new (func);
+	b.next_pos = func->n_params;
+	seal_block (&b, b.current);
+	if (!build_sentences (&b, root->children)) {
+		azo_ir_delete (func);
+		return NULL;
+	}
+	if (b.current) b.current->term = AZO_IR_END;
+	/* Definitions are not needed after building */
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		free (func->blocks[i]->defs);
+		func->blocks[i]->defs = NULL;
+	}
+	/* Mark reachable blocks */
+	unsigned int n_reachable;
+	free (azo_ir_compute_order (func, &n_reachable));
+	return func;
+}
+
+/* Dump */
+
+static const char *op_names[] = {
+	"undef", "const", "param", "env", "phi", "binary", "compare", "prefix", "increment", "decrement", "member"
+};
+
+static const char *arithmetic_names[] = {
+	"add", "subtract", "divide", "multiply", "modulo", "shl", "shr", "and", "logical_and", "or", "logical_or", "xor"
+};
+
+static const char *comparison_names[] = {
+	"eq", "ne", "lt", "le", "gt", "ge"
+};
+
+static const char *prefix_names[] = {
+	"increment", "decrement", "plus", "negate", "not", "tilde"
+};
+
+static void
+dump_type (FILE *ofs, unsigned int type)
+{
+	if (type == AZ_TYPE_ANY) {
+		fprintf (ofs, "any");
+	} else {
+		const AZClass *klass = az_type_get_class (type);
+		fprintf (ofs, "%s", (klass) ? (const char *) klass->name : "?");
+	}
+}
+
+static void
+dump_value (AZOIRFunction *func, AZOIRValue *val, FILE *ofs)
+{
+	fprintf (ofs, "  v%u = ", val->id);
+	if (val->op == AZO_IR_BINARY) {
+		fprintf (ofs, "%s", arithmetic_names[val->subtype]);
+	} else if (val->op == AZO_IR_COMPARISON) {
+		fprintf (ofs, "%s", comparison_names[val->subtype]);
+	} else if (val->op == AZO_IR_PREFIX) {
+		fprintf (ofs, "%s", prefix_names[val->subtype]);
+	} else {
+		fprintf (ofs, "%s", op_names[val->op]);
+	}
+	if ((val->op == AZO_IR_PARAM) || (val->op == AZO_IR_ENV)) {
+		fprintf (ofs, " %u", val->pos);
+	} else if (val->op == AZO_IR_CONST) {
+		if ((val->type >= AZ_TYPE_INT8) && (val->type <= AZ_TYPE_INT64) && (val->range == AZO_IR_RANGE_SET) && (val->min == val->max)) {
+			fprintf (ofs, " %lld", (long long) val->min);
+		} else if (val->type == AZ_TYPE_BOOLEAN) {
+			fprintf (ofs, " %s", (val->value.v.boolean_v) ? "true" : "false");
+		} else if (val->type == AZ_TYPE_DOUBLE) {
+			fprintf (ofs, " %g", val->value.v.double_v);
+		} else if (val->type == AZ_TYPE_STRING) {
+			fprintf (ofs, " \"%s\"", val->value.v.string->str);
+		}
+	} else if (val->op == AZO_IR_MEMBER) {
+		fprintf (ofs, " v%u.%s", azo_ir_value_get (val->args[0])->id, val->value.v.string->str);
+	}
+	if (val->op != AZO_IR_MEMBER) {
+		for (unsigned int i = 0; i < val->n_args; i++) {
+			fprintf (ofs, "%s v%u", (i) ? "," : "", azo_ir_value_get (val->args[i])->id);
+			if (val->op == AZO_IR_PHI) fprintf (ofs, " (b%u)", val->block->preds[i]->id);
+		}
+	}
+	fprintf (ofs, " : ");
+	dump_type (ofs, val->type);
+	if (val->range == AZO_IR_RANGE_SET) {
+		fprintf (ofs, " [%lld..%lld]", (long long) val->min, (long long) val->max);
+	}
+	if (val->n_uses) fprintf (ofs, " uses %u", val->n_uses);
+	fprintf (ofs, "\n");
+}
+
+void
+azo_ir_dump (AZOIRFunction *func, FILE *ofs)
+{
+	fprintf (ofs, "ir: %u params, %u blocks, %u values\n", func->n_params, func->n_blocks, func->n_values);
+	for (unsigned int i = 0; i < func->n_blocks; i++) {
+		AZOIRBlock *block = func->blocks[i];
+		if (!block->reachable) continue;
+		fprintf (ofs, "b%u:", block->id);
+		if (block->n_preds) {
+			fprintf (ofs, " preds");
+			for (unsigned int j = 0; j < block->n_preds; j++) fprintf (ofs, " b%u", block->preds[j]->id);
+		}
+		if (block->idom) fprintf (ofs, " idom b%u", block->idom->id);
+		fprintf (ofs, "\n");
+		for (unsigned int j = 0; j < block->n_values; j++) {
+			if (block->values[j]->removed) continue;
+			dump_value (func, block->values[j], ofs);
+		}
+		switch (block->term) {
+		case AZO_IR_END:
+			fprintf (ofs, "  end\n");
+			break;
+		case AZO_IR_JUMP:
+			fprintf (ofs, "  jump b%u\n", block->targets[0]->id);
+			break;
+		case AZO_IR_BRANCH:
+			fprintf (ofs, "  branch v%u ? b%u : b%u\n", azo_ir_value_get (block->cond)->id, block->targets[0]->id, block->targets[1]->id);
+			break;
+		case AZO_IR_RETURN:
+			fprintf (ofs, "  return\n");
+			break;
+		case AZO_IR_RETURN_VALUE:
+			fprintf (ofs, "  return v%u\n", azo_ir_value_get (block->cond)->id);
+			break;
+		}
+	}
+}
@@ -0,0 +1,218 @@
+#ifndef __AZO_COMPILER_IR_H__
+#define __AZO_COMPILER_IR_H__
+
+/*
+ * A languge implementation based on AZ
+ *
+ * Copyright (C) Lauris Kaplinski 2021
+ */
+
+typedef struct _AZOIRValue AZOIRValue;
+typedef struct _AZOIRBlock AZOIRBlock;
+typedef struct _AZOIRFunction AZOIRFunction;
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <az/packed-value.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/expression.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Mid-level intermediate representation
+ *
+ * Built from resolved tree of a single frame (program or function body), local variables
+ * are converted to SSA values. Only a subset of the language is supported, if the frame
+ * contains anything else, building fails and the tree is compiled directly.
+ */
+
+/* Value operations */
+enum {
+	/* Uninitialized variable (none) */
+	AZO_IR_UNDEF,
+	/* Value is constant */
+	AZO_IR_CONST,
+	/* Frame variable at entry (this or argument), pos is frame position */
+	AZO_IR_PARAM,
+	/* Captured variable of closure, pos is environment position */
+	AZO_IR_ENV,
+	/*
+	 * Join of variable values, args are in the order of block predecessors
+	 * Result of && and || has subtype ARITHMETIC_ANDAND or ARITHMETIC_OROR, the first two
+	 * predecessors branch on left and right operand
+	 */
+	AZO_IR_PHI,
+	/* Arithmetic or logic, subtype is ARITHMETIC_* */
+	AZO_IR_BINARY,
+	/* Comparison, subtype is COMPARISON_* */
+	AZO_IR_COMPARISON,
+	/* Unary operator, subtype is PREFIX_PLUS, PREFIX_MINUS, PREFIX_NOT or PREFIX_TILDE */
+	AZO_IR_PREFIX,
+	AZO_IR_INCREMENT,
+	AZO_IR_DECREMENT,
+	/* Property lookup, value is property name */
+	AZO_IR_MEMBER,
+	AZO_IR_NUM_OPS
+};
+
+/* Block terminators */
+enum {
+	/* Block is not terminated (falls off the end of code) */
+	AZO_IR_END,
+	AZO_IR_JUMP,
+	/* Jump to targets[0] if cond is true, targets[1] otherwise */
+	AZO_IR_BRANCH,
+	AZO_IR_RETURN,
+	/* Return cond */
+	AZO_IR_RETURN_VALUE
+};
+
+/* Range analysis state */
+enum {
+	/* Not determined yet */
+	AZO_IR_RANGE_NONE,
+	AZO_IR_RANGE_SET,
+	/* Any value of type */
+	AZO_IR_RANGE_FULL
+};
+
+struct _AZOIRValue {
+	unsigned int id;
+	unsigned int op;
+	unsigned int subtype;
+	/* Inferred type, AZ_TYPE_ANY if not known at compile time */
+	unsigned int type;
+	AZOIRBlock *block;
+	unsigned int n_args;
+	unsigned int size_args;
+	AZOIRValue **args;
+	/* Constant value or property name */
+	AZPackedValue value;
+	/* Frame or environment position, variable index for phi */
+	unsigned int pos;
+	/* Source term, used for debug information */
+	const AZOExpression *expr;
+	/* Value is replaced by another value (copy propagation, CSE) */
+	AZOIRValue *replacement;
+	unsigned int n_uses;
+	/* Value is removed from block */
+	unsigned int removed : 1;
+	/* Phi is waiting for its block to be sealed */
+	unsigned int incomplete : 1;
+	/* Integer range for int32 and int64 values */
+	unsigned int range : 2;
+	int64_t min;
+	int64_t max;
+	/* Frame position after lowering */
+	unsigned int slot;
+};
+
+struct _AZOIRBlock {
+	unsigned int id;
+	unsigned int n_preds;
+	unsigned int size_preds;
+	AZOIRBlock **preds;
+	/* Phis are always at the beginning */
+	unsigned int n_values;
+	unsigned int size_values;
+	AZOIRValue **values;
+	/* Terminator */
+	unsigned int term;
+	AZOIRValue *cond;
+	AZOIRBlock *targets[2];
+	/* All predecessors are known */
+	unsigned int sealed : 1;
+	unsigned int reachable : 1;
+	/* Current variable definitions during building */
+	AZOIRValue **defs;
+	/* Immediate dominator */
+	AZOIRBlock *idom;
+	/* Reverse postorder index */
+	unsigned int order;
+	/* Bytecode location after lowering */
+	unsigned int ip;
+};
+
+struct _AZOIRFunction {
+	/* Number of frame positions used by variables */
+	unsigned int n_vars;
+	/* Number of values present in frame at entry (this and arguments) */
+	unsigned int n_params;
+	/* Treat property lookups as pure (copied from compiler) */
+	unsigned int pure_properties : 1;
+	unsigned int n_blocks;
+	unsigned int size_blocks;
+	AZOIRBlock **blocks;
+	unsigned int n_values;
+	unsigned int size_values;
+	AZOIRValue **values;
+};
+
+/**
+ * @brief Build IR from resolved frame body
+ *
+ * @param comp the compiler, current frame has to be the frame of body
+ * @param root program or function body
+ * @return new IR function or NULL if the body uses unsupported constructs
+ */
+AZOIRFunction *azo_ir_build (AZOCompiler *comp, const AZOExpression *root);
+void azo_ir_delete (AZOIRFunction *func);
+
+AZOIRValue *azo_ir_value_new (AZOIRFunction *func, AZOIRBlock *block, unsigned int op, unsigned int subtype, const AZOExpression *expr);
+void azo_ir_value_append_arg (AZOIRValue *val, AZOIRValue *arg);
+/* Follow replacement chain */
+AZOIRValue *azo_ir_value_get (AZOIRValue *val);
+/* Whether evaluating the value can raise exception or have side effects */
+unsigned int azo_ir_value_has_effects (AZOIRFunction *func, AZOIRValue *val);
+
+AZOIRBlock *azo_ir_block_new (AZOIRFunction *func);
+void azo_ir_block_add_pred (AZOIRBlock *block, AZOIRBlock *pred);
+/* Remove predecessor and corresponding phi operands */
+void azo_ir_block_remove_pred (AZOIRBlock *block, AZOIRBlock *pred);
+
+/**
+ * @brief Order reachable blocks
+ *
+ * Sets reachable flags and order indices of blocks.
+ *
+ * @param func the function
+ * @param n_blocks location for the number of reachable blocks
+ * @return newly allocated array of reachable blocks in reverse postorder
+ */
+AZOIRBlock **azo_ir_compute_order (AZOIRFunction *func, unsigned int *n_blocks);
+
+/* Passes */
+
+/* Remove redundant phis, rewrite arguments to replacements */
+unsigned int azo_ir_propagate_copies (AZOIRFunction *func);
+void azo_ir_infer_types (AZOIRFunction *func);
+/* Calculate integer ranges and fold comparisons with known outcome */
+unsigned int azo_ir_analyze_ranges (AZOIRFunction *func);
+/* Replace values with identical dominating values */
+unsigned int azo_ir_eliminate_common (AZOIRFunction *func);
+/* Fold constant branches, remove unreachable blocks and unused values */
+unsigned int azo_ir_eliminate_dead (AZOIRFunction *func);
+/* Run all passes until nothing changes */
+void azo_ir_optimize (AZOIRFunction *func);
+
+void azo_ir_dump (AZOIRFunction *func, FILE *ofs);
+
+/**
+ * @brief Write bytecode for IR into current frame of compiler
+ *
+ * Every non-constant value gets its own frame position after the variables present at entry.
+ *
+ * @return 1 on success
+ */
+unsigned int azo_ir_lower (AZOCompiler *comp, AZOIRFunction *func, AZOSource *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+#define __AZO_RESOLVE_BOUNDS_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <az/packed-value.h>
+#include <az/string.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/expression.h>
+#include <azo/keyword.h>
+#include <azo/optimizer.h>
+
+#define noDEBUG_BOUNDS
+
+/*
+ * Bounds check elimination for counting loops
+ *
+ * Loop of the form
+ *
+ *   for (var i = C; i < N; i++) ... a[i] ...
+ *
+ * where
+ *   C is non-negative 32-bit integer constant
+ *   N is integer constant or local variable
+ *   i, N and a are not modified inside loop
+ *   loop body contains no calls, function definitions, new, yield or member assignments
+ *   (host code may resize a while generator is suspended)
+ *   property lookups in body are pure (pure_properties)
+ *
+ * keeps i in range [C, N) whenever body is executed. If a implements list and N does not
+ * exceed its size, reads of a[i] cannot fail. Such reads are marked ARRAY_ELEMENT_BOUNDED
+ * and linked to the loop, compiler emits the loop twice: unchecked version if TEST_ARRAY_SIZE succeeds before
+ * the first iteration and normal version otherwise.
+ *
+ * With pure_properties the bound a.length is already hoisted into local variable, so
+ * the canonical form for (i = 0; i < a.length; i++) qualifies.
+ *
+ * Works on resolved tree, called before the scope of loop is popped.
+ */
+
+static unsigned int
+local_is_modified (AZOExpression *expr, unsigned int pos)
+{
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		AZOExpression *lhs = expr->children;
+		if (AZO_EXPRESSION_IS(lhs, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (lhs->var_pos == pos)) return 1;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (local_is_modified (child, pos)) return 1;
+	}
+	return 0;
+}
+
+/* Whether evaluating tree can run code that is not visible to compiler */
+
+static unsigned int
+body_is_opaque (AZOCompiler *comp, AZOExpression *expr)
+{
+	switch (expr->term.type) {
+	case EXPRESSION_FUNCTION:
+	case EXPRESSION_FUNCTION_CALL:
+		return 1;
+	case EXPRESSION_KEYWORD:
+		if (expr->term.subtype == AZO_KEYWORD_NEW) return 1;
+		/* Suspended generator lets host code run between iterations */
+		if (expr->term.subtype == AZO_KEYWORD_YIELD) return 1;
+		break;
+	case EXPRESSION_REFERENCE:
+		if ((expr->term.subtype == REFERENCE_MEMBER) && !comp->pure_properties) return 1;
+		break;
+	case EXPRESSION_ASSIGN:
+	case EXPRESSION_SUFFIX:
+		if (AZO_EXPRESSION_IS(expr->children, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) return 1;
+		break;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)) {
+			if (AZO_EXPRESSION_IS(expr->children, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) return 1;
+		}
+		break;
+	default:
+		break;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (body_is_opaque (comp, child)) return 1;
+	}
+	return 0;
+}
+
+/* Mark rvalue reads a[i], returns the number of marked elements */
+
+static unsigned int
+mark_elements (AZOExpression *expr, AZOExpression *loop, unsigned int array_pos, unsigned int index_pos, unsigned int is_lvalue)
+{
+	unsigned int n_marked = 0;
+	if (!is_lvalue && (expr->term.type == EXPRESSION_ARRAY_ELEMENT)) {
+		AZOExpression *array = expr->children;
+		AZOExpression *index = array->next;
+		if (AZO_EXPRESSION_IS(array, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (array->var_pos == array_pos) &&
+			AZO_EXPRESSION_IS(index, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (index->var_pos == index_pos)) {
+			expr->term.subtype = ARRAY_ELEMENT_BOUNDED;
+			expr->loop = loop;
+			return 1;
+		}
+	}
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		/* Written elements stay checked */
+		for (AZOExpression *child = expr->children; child; child = child->next) {
+			n_marked += mark_elements (child, loop, array_pos, index_pos, child == expr->children);
+		}
+		return n_marked;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		n_marked += mark_elements (child, loop, array_pos, index_pos, 0);
+	}
+	return n_marked;
+}
+
+/* Find the first array that is indexed by loop counter */
+
+static AZOExpression *
+find_array (AZOExpression *expr, unsigned int index_pos)
+{
+	if (expr->term.type == EXPRESSION_ARRAY_ELEMENT) {
+		AZOExpression *array = expr->children;
+		AZOExpression *index = array->next;
+		if (AZO_EXPRESSION_IS(array, EXPRESSION_VARIABLE, VARIABLE_LOCAL) &&
+			AZO_EXPRESSION_IS(index, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (index->var_pos == index_pos)) {
+			return array;
+		}
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		AZOExpression *array = find_array (child, index_pos);
+		if (array) return array;
+	}
+	return NULL;
+}
+
+static unsigned int
+is_counter_start (AZOExpression *expr)
+{
+	if (!expr || (expr->term.type != EXPRESSION_CONSTANT)) return 0;
+	if (expr->term.subtype == AZ_TYPE_INT32) return expr->value.v.int32_v >= 0;
+	return expr->term.subtype == AZ_TYPE_UINT32;
+}
+
+/* Get the position of counter initialized to non-negative constant */
+
+static unsigned int
+get_counter_pos (AZOCompiler *comp, AZOExpression *init, unsigned int *pos)
+{
+	if (init->term.type == EXPRESSION_DECLARATION_LIST) {
+		AZOExpression *decl = init->children->next;
+		if (!decl || decl->next) return 0;
+		if (!is_counter_start (decl->children->next)) return 0;
+		/* Init moved out of loop by hoisting is declared in enclosing block */
+		AZOVariable *var = azo_scope_lookup_chained (comp->current->scope, decl->children->value.v.string);
+		if (!var) return 0;
+		*pos = var->pos;
+		return 1;
+	} else if (AZO_EXPRESSION_IS(init, EXPRESSION_ASSIGN, ASSIGN)) {
+		AZOExpression *lhs = init->children;
+		if (!AZO_EXPRESSION_IS(lhs, EXPRESSION_VARIABLE, VARIABLE_LOCAL)) return 0;
+		if (!is_counter_start (lhs->next)) return 0;
+		*pos = lhs->var_pos;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned int
+azo_compiler_bound_loop (AZOCompiler *comp, AZOExpression *expr)
+{
+	AZOExpression *init, *test, *step, *content, *counter, *bound, *array;
+	unsigned int index_pos;
+	init = expr->children;
+	test = init->next;
+	step = test->next;
+	content = step->next;
+
+	if ((init->term.type == AZO_TERM_EMPTY) && expr->parent && (expr->parent->term.type == AZO_EXPRESSION_BLOCK)) {
+		/* Hoisted lookups: BLOCK { init; DECLARATION_LIST; FOR (; test; step) } */
+		AZOExpression *lookups = expr->parent->children->next;
+		if (!lookups || (lookups->next != expr) || (lookups->term.type != EXPRESSION_DECLARATION_LIST)) return 0;
+		if (!get_counter_pos (comp, expr->parent->children, &index_pos)) return 0;
+		if (local_is_modified (lookups, index_pos)) return 0;
+	} else if (!get_counter_pos (comp, init, &index_pos)) {
+		return 0;
+	}
+	/* i < N */
+	if (!AZO_EXPRESSION_IS(test, EXPRESSION_COMPARISON, COMPARISON_LT)) return 0;
+	counter = test->children;
+	bound = counter->next;
+	if (!AZO_EXPRESSION_IS(counter, EXPRESSION_VARIABLE, VARIABLE_LOCAL) || (counter->var_pos != index_pos)) return 0;
+	if (AZO_EXPRESSION_IS(bound, EXPRESSION_VARIABLE, VARIABLE_LOCAL)) {
+		if (bound->var_pos == index_pos) return 0;
+		if (local_is_modified (step, bound->var_pos) || local_is_modified (content, bound->var_pos)) return 0;
+	} else if (bound->term.type == EXPRESSION_CONSTANT) {
+		if ((bound->term.subtype != AZ_TYPE_INT32) && (bound->term.subtype != AZ_TYPE_UINT32)) return 0;
+	} else {
+		return 0;
+	}
+	/* i++ or ++i */
+	if (!AZO_EXPRESSION_IS(step, EXPRESSION_SUFFIX, SUFFIX_INCREMENT) && !AZO_EXPRESSION_IS(step, EXPRESSION_PREFIX, PREFIX_INCREMENT)) return 0;
+	if (!AZO_EXPRESSION_IS(step->children, EXPRESSION_VARIABLE, VARIABLE_LOCAL) || (step->children->var_pos != index_pos)) return 0;
+	/* Body */
+	if (local_is_modified (content, index_pos)) return 0;
+	if (body_is_opaque (comp, content)) return 0;
+	array = find_array (content, index_pos);
+	if (!array) return 0;
+	if ((array->var_pos == index_pos) || local_is_modified (content, array->var_pos)) return 0;
+	if (AZO_EXPRESSION_IS(bound, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (bound->var_pos == array->var_pos)) return 0;
+#ifdef DEBUG_BOUNDS
+	fprintf (stderr, "azo_compiler_bound_loop: Counter %u, array %u\n", index_pos, array->var_pos);
+#endif
+	return mark_elements (content, expr, array->var_pos, index_pos, 0) > 0;
+}
@@ -0,0 +1,361 @@
+#define __AZO_RESOLVE_COMMON_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <az/packed-value.h>
+#include <az/string.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/expression.h>
+#include <azo/keyword.h>
+#include <azo/optimizer.h>
+
+#define noDEBUG_COMMON
+
+/* Maximum number of common values per sentence */
+#define MAX_COMMON 16
+/* Maximum number of candidate subexpressions examined per sentence */
+#define MAX_CANDIDATES 256
+
+/*
+ * Common subexpression elimination within a single sentence
+ *
+ * Repeated member chains (a.b.c in a.b.c.x + a.b.c.y) and repeated pure arithmetic
+ * are evaluated once into hidden variable. Sentence qualifies if:
+ *   it is assignment, function call, return or declaration list directly in block or control statement
+ *   it contains no other calls, assignments, increments or function definitions (nothing can change
+ *   values between occurrences, top-level assignment or call happens after all operands are evaluated)
+ *
+ * Member chains are only shared if compiler promises that property lookups are pure (pure_properties),
+ * as host properties may be implemented by getters with side effects.
+ *
+ * Shared value is evaluated before the sentence, so candidates are only collected from positions that
+ * always run. The right operands of && and || are skipped, as they may be guarded by the left one
+ * (x != 0 && 10 / x > 1).
+ *
+ * Works on unresolved tree. Sentence in block is split in place into:
+ *
+ * DECLARATION_LIST
+ *   + TYPE any
+ *   + DECLARATION #commonN = a.b.c
+ * SENTENCE with all occurrences of a.b.c replaced by #commonN
+ *
+ * Sentence that is the body of control statement is wrapped into block instead.
+ */
+
+static unsigned int
+sentence_has_effects (AZOExpression *expr)
+{
+	switch (expr->term.type) {
+	case EXPRESSION_FUNCTION:
+	case EXPRESSION_FUNCTION_CALL:
+	case EXPRESSION_ASSIGN:
+	case EXPRESSION_SUFFIX:
+		return 1;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)) return 1;
+		break;
+	case EXPRESSION_KEYWORD:
+		if ((expr->term.subtype == AZO_KEYWORD_NEW) || (expr->term.subtype == AZO_KEYWORD_YIELD)) return 1;
+		break;
+	default:
+		break;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (sentence_has_effects (child)) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+constants_are_equal (AZOExpression *lhs, AZOExpression *rhs)
+{
+	if (lhs->children || rhs->children) return 0;
+	switch (lhs->term.subtype) {
+	case AZ_TYPE_BOOLEAN:
+		return lhs->value.v.boolean_v == rhs->value.v.boolean_v;
+	case AZ_TYPE_INT32:
+		return lhs->value.v.int32_v == rhs->value.v.int32_v;
+	case AZ_TYPE_UINT32:
+		return lhs->value.v.uint32_v == rhs->value.v.uint32_v;
+	case AZ_TYPE_INT64:
+		return lhs->value.v.int64_v == rhs->value.v.int64_v;
+	case AZ_TYPE_DOUBLE:
+		return lhs->value.v.double_v == rhs->value.v.double_v;
+	case AZ_TYPE_STRING:
+		/* Strings are interned */
+		return lhs->value.v.string == rhs->value.v.string;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static unsigned int
+trees_are_equal (AZOExpression *lhs, AZOExpression *rhs)
+{
+	if ((lhs->term.type != rhs->term.type) || (lhs->term.subtype != rhs->term.subtype)) return 0;
+	if (lhs->term.type == EXPRESSION_CONSTANT) return constants_are_equal (lhs, rhs);
+	if ((lhs->term.type == EXPRESSION_REFERENCE) && (lhs->term.subtype != REFERENCE_MEMBER)) {
+		if (lhs->value.v.string != rhs->value.v.string) return 0;
+	}
+	AZOExpression *lchild = lhs->children, *rchild = rhs->children;
+	while (lchild && rchild) {
+		if (!trees_are_equal (lchild, rchild)) return 0;
+		lchild = lchild->next;
+		rchild = rchild->next;
+	}
+	return !lchild && !rchild;
+}
+
+static unsigned int
+is_operand (AZOCompiler *comp, AZOExpression *expr)
+{
+	if (expr->term.type == EXPRESSION_CONSTANT) return !expr->children;
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_VARIABLE)) {
+		/* Unknown name is property of this */
+		return comp->pure_properties || (azo_frame_lookup_chained (comp->current, expr->value.v.string) != NULL);
+	}
+	return AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_THIS);
+}
+
+/* Whether subexpression can be evaluated once and reused */
+
+static unsigned int
+is_candidate (AZOCompiler *comp, AZOExpression *expr)
+{
+	switch (expr->term.type) {
+	case EXPRESSION_REFERENCE:
+		if (expr->term.subtype != REFERENCE_MEMBER) return 0;
+		if (!comp->pure_properties) return 0;
+		if (!AZO_EXPRESSION_IS(expr->children->next, EXPRESSION_REFERENCE, REFERENCE_PROPERTY)) return 0;
+		return is_operand (comp, expr->children) || is_candidate (comp, expr->children);
+	case EXPRESSION_BINARY:
+		if (expr->term.subtype > ARITHMETIC_PERCENT) return 0;
+		break;
+	case EXPRESSION_COMPARISON:
+		break;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)) return 0;
+		break;
+	default:
+		return 0;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (!is_operand (comp, child) && !is_candidate (comp, child)) return 0;
+	}
+	return 1;
+}
+
+static unsigned int
+uses_names_of (AZOExpression *expr, AZOExpression *list)
+{
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_VARIABLE)) {
+		for (AZOExpression *decl = list->children->next; decl; decl = decl->next) {
+			if (decl->children->value.v.string == expr->value.v.string) return 1;
+		}
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (uses_names_of (child, list)) return 1;
+	}
+	return 0;
+}
+
+/* Collect candidates in unconditionally evaluated rvalue positions, outermost first */
+
+static void
+collect_candidates (AZOCompiler *comp, AZOExpression *expr, AZOExpression *cands[], unsigned int *n_cands, unsigned int is_lvalue)
+{
+	if (*n_cands >= MAX_CANDIDATES) return;
+	if (!is_lvalue && is_candidate (comp, expr)) cands[(*n_cands)++] = expr;
+	if (is_lvalue && AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		/* Object of assigned or called member is evaluated normally */
+		collect_candidates (comp, expr->children, cands, n_cands, 0);
+		return;
+	}
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_BINARY, ARITHMETIC_ANDAND) || AZO_EXPRESSION_IS(expr, EXPRESSION_BINARY, ARITHMETIC_OROR)) {
+		/* Right operand is conditional */
+		collect_candidates (comp, expr->children, cands, n_cands, 0);
+		return;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		collect_candidates (comp, child, cands, n_cands, 0);
+	}
+}
+
+static void
+replace_candidate (AZOExpression *expr, AZOExpression *value, AZString *name, unsigned int is_lvalue)
+{
+	if (!is_lvalue && trees_are_equal (expr, value)) {
+		azo_expression_clear_children (expr);
+		az_packed_value_clear (&expr->value);
+		expr->term.type = EXPRESSION_REFERENCE;
+		expr->term.subtype = REFERENCE_VARIABLE;
+		az_packed_value_set_string (&expr->value, name);
+		return;
+	}
+	if (is_lvalue && AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		replace_candidate (expr->children, value, name, 0);
+		return;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		replace_candidate (child, value, name, 0);
+	}
+}
+
+/* Process the operands of sentence, skipping assigned or called term */
+
+static void
+collect_sentence (AZOCompiler *comp, AZOExpression *expr, AZOExpression *cands[], unsigned int *n_cands)
+{
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_FUNCTION_CALL)) {
+		collect_candidates (comp, expr->children, cands, n_cands, 1);
+		for (AZOExpression *child = expr->children->next; child; child = child->next) {
+			collect_candidates (comp, child, cands, n_cands, 0);
+		}
+	} else if (expr->term.type == EXPRESSION_DECLARATION_LIST) {
+		for (AZOExpression *decl = expr->children->next; decl; decl = decl->next) {
+			if (decl->children->next) collect_candidates (comp, decl->children->next, cands, n_cands, 0);
+		}
+	} else {
+		for (AZOExpression *child = expr->children; child; child = child->next) {
+			collect_candidates (comp, child, cands, n_cands, 0);
+		}
+	}
+}
+
+static void
+replace_sentence (AZOExpression *expr, AZOExpression *value, AZString *name)
+{
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_FUNCTION_CALL)) {
+		replace_candidate (expr->children, value, name, 1);
+		for (AZOExpression *child = expr->children->next; child; child = child->next) {
+			replace_candidate (child, value, name, 0);
+		}
+	} else if (expr->term.type == EXPRESSION_DECLARATION_LIST) {
+		for (AZOExpression *decl = expr->children->next; decl; decl = decl->next) {
+			if (decl->children->next) replace_candidate (decl->children->next, value, name, 0);
+		}
+	} else {
+		for (AZOExpression *child = expr->children; child; child = child->next) {
+			replace_candidate (child, value, name, 0);
+		}
+	}
+}
+
+static unsigned int
+is_sentence (AZOExpression *expr)
+{
+	AZOExpression *parent = expr->parent;
+	if (!parent) return 0;
+	if ((parent->term.type == AZO_EXPRESSION_BLOCK) || (parent->term.type == AZO_EXPRESSION_PROGRAM)) return 1;
+	/* Bodies of control statements */
+	if (AZO_EXPRESSION_IS(parent, EXPRESSION_KEYWORD, AZO_KEYWORD_IF)) return expr != parent->children;
+	if (AZO_EXPRESSION_IS(parent, EXPRESSION_KEYWORD, AZO_KEYWORD_WHILE)) return expr == parent->children->next;
+	if (AZO_EXPRESSION_IS(parent, EXPRESSION_KEYWORD, AZO_KEYWORD_FOR)) return expr == parent->children->next->next->next;
+	return 0;
+}
+
+unsigned int
+azo_compiler_eliminate_common (AZOCompiler *comp, AZOExpression *expr)
+{
+	AZOExpression *cands[MAX_CANDIDATES], *values[MAX_COMMON];
+	AZString *names[MAX_COMMON];
+	unsigned int n_common = 0;
+
+	if ((expr->term.type != EXPRESSION_ASSIGN) && (expr->term.type != EXPRESSION_FUNCTION_CALL) &&
+		(expr->term.type != EXPRESSION_DECLARATION_LIST) && !AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_RETURN)) return 0;
+	if (!is_sentence (expr)) return 0;
+	/* Declarations in control statement body can not be wrapped into block */
+	if ((expr->term.type == EXPRESSION_DECLARATION_LIST) && (expr->parent->term.type != AZO_EXPRESSION_BLOCK) &&
+		(expr->parent->term.type != AZO_EXPRESSION_PROGRAM)) return 0;
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (sentence_has_effects (child)) return 0;
+	}
+
+	while (n_common < MAX_COMMON) {
+		unsigned int n_cands = 0, found = 0;
+		collect_sentence (comp, expr, cands, &n_cands);
+		for (unsigned int i = 0; (i < n_cands) && !found; i++) {
+			/* Declared names are not visible before the list */
+			if ((expr->term.type == EXPRESSION_DECLARATION_LIST) && uses_names_of (cands[i], expr)) continue;
+			for (unsigned int j = i + 1; j < n_cands; j++) {
+				if (trees_are_equal (cands[i], cands[j])) {
+					found = 1;
+					break;
+				}
+			}
+			if (!found) continue;
+			unsigned char c[32];
+			sprintf ((char *) c, "#common%u", comp->n_hidden++);
+			names[n_common] = az_string_new (c);
+			/* Candidates point into sentence, so the clone has to be made before replacing */
+			values[n_common] = azo_expression_clone_tree (cands[i]);
+			replace_sentence (expr, values[n_common], names[n_common]);
+#ifdef DEBUG_COMMON
+			fprintf (stderr, "azo_compiler_eliminate_common: Shared subexpression as %s\n", names[n_common]->str);
+#endif
+			n_common += 1;
+		}
+		if (!found) break;
+	}
+	if (!n_common) return 0;
+
+	/* Move sentence into new node */
+	AZOExpression *sentence = azo_expression_new (expr->term.type, expr->term.subtype, expr->term.start, expr->term.end);
+	sentence->children = expr->children;
+	for (AZOExpression *child = sentence->children; child; child = child->next) child->parent = sentence;
+	expr->children = NULL;
+	if (expr->value.impl) {
+		az_packed_value_copy (&sentence->value, &expr->value);
+		az_packed_value_clear (&expr->value);
+	}
+
+	AZOExpression *list = azo_expression_new (EXPRESSION_DECLARATION_LIST, EXPRESSION_GENERIC, expr->term.start, expr->term.start);
+	AZOExpression *type = azo_expression_new (EXPRESSION_TYPE, AZ_TYPE_ANY, expr->term.start, expr->term.start);
+	type->parent = list;
+	list->children = type;
+	AZOExpression *prev = type;
+	for (unsigned int i = 0; i < n_common; i++) {
+		AZOExpression *decl = azo_expression_new (EXPRESSION_DECLARATION, EXPRESSION_GENERIC, values[i]->term.start, values[i]->term.end);
+		AZOExpression *id = azo_expression_new (EXPRESSION_REFERENCE, REFERENCE_VARIABLE, values[i]->term.start, values[i]->term.end);
+		az_packed_value_set_string (&id->value, names[i]);
+		az_string_unref (names[i]);
+		id->parent = decl;
+		values[i]->parent = decl;
+		decl->children = id;
+		id->next = values[i];
+		decl->parent = list;
+		prev->next = decl;
+		prev = decl;
+	}
+
+	if ((expr->parent->term.type == AZO_EXPRESSION_BLOCK) || (expr->parent->term.type == AZO_EXPRESSION_PROGRAM)) {
+		/* Split in place, sentence is resolved as the next sibling */
+		expr->term.type = EXPRESSION_DECLARATION_LIST;
+		expr->term.subtype = EXPRESSION_GENERIC;
+		expr->children = type;
+		type->parent = expr;
+		for (AZOExpression *child = type->next; child; child = child->next) child->parent = expr;
+		list->children = NULL;
+		azo_expression_free (list);
+		sentence->parent = expr->parent;
+		sentence->next = expr->next;
+		expr->next = sentence;
+	} else {
+		expr->term.type = AZO_EXPRESSION_BLOCK;
+		expr->term.subtype = 0;
+		list->parent = expr;
+		sentence->parent = expr;
+		expr->children = list;
+		list->next = sentence;
+	}
+	return 1;
+}
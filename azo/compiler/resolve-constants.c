@@ -20,6 +20,7 @@
 #include <az/string.h>
 #include <az/primitives.h>
 #include <az/classes/value-array-ref.h>
+#include <az/collections/list.h>
 
 #include <azo/compiler/compiler.h>
 #include <azo/keyword.h>
@@ -483,28 +484,127 @@ calculate_arithmetic (AZOExpression *expr)
 	return expr;
 }
 
+/*
+ * Constant literal arrays
+ *
+ * Array with all constant elements is built once at compile time and stored in program values. As arrays are
+ * mutable, literal is normally kept as LITERAL_ARRAY/COPY with the constant as the only child and compiled into
+ * a runtime copy (PUSH_VALUE, COPY_ARRAY). Where the array is provably only read (element read, arithmetic or
+ * comparison operand, or a declared variable only used that way) the copy is replaced by the shared constant.
+ */
+
+static unsigned int
+child_is_constant (AZOExpression *child)
+{
+	if (child->term.type == EXPRESSION_CONSTANT) return 1;
+	return AZO_EXPRESSION_IS (child, EXPRESSION_LITERAL_ARRAY, ARRAY_LITERAL_COPY);
+}
+
 AZOExpression *
 azo_compiler_resolve_array_literal (AZOExpression *expr)
 {
 	AZOExpression *child;
 	unsigned int size = 0, i;
+	if (expr->term.subtype == ARRAY_LITERAL_COPY) return expr;
 	for (child = expr->children; child; child = child->next) {
-		if (child->term.type != EXPRESSION_CONSTANT) return expr;
+		if (!child_is_constant (child)) return expr;
 		size += 1;
 	}
 	AZValueArrayRef *va = az_value_array_ref_new (size);
 	i = 0;
 	for (child = expr->children; child; child = child->next) {
-		az_value_array_ref_set_element (va, i, child->value.impl, &child->value.v);
+		/* Nested array is copied together with parent */
+		AZOExpression *c = (child->term.type == EXPRESSION_CONSTANT) ? child : child->children;
+		az_value_array_ref_set_element (va, i, c->value.impl, &c->value.v);
 		i += 1;
 	}
-	expr->term.type = EXPRESSION_CONSTANT;
-	expr->term.subtype = AZ_TYPE_VALUE_ARRAY_REF;
-	az_packed_value_transfer_reference (&expr->value, AZ_TYPE_VALUE_ARRAY_REF, &va->reference);
 	while (expr->children) {
 		child = expr->children;
 		expr->children = child->next;
 		azo_expression_free_tree (child);
 	}
+	child = azo_expression_new (EXPRESSION_CONSTANT, AZ_TYPE_VALUE_ARRAY_REF, expr->term.start, expr->term.end);
+	az_packed_value_transfer_reference (&child->value, AZ_TYPE_VALUE_ARRAY_REF, &va->reference);
+	child->parent = expr;
+	expr->children = child;
+	expr->term.subtype = ARRAY_LITERAL_COPY;
 	return expr;
 }
+
+static unsigned int
+array_is_flat (AZOExpression *expr)
+{
+	AZListImplementation *list_impl;
+	void *list_inst;
+	list_impl = (AZListImplementation *) az_instance_get_interface (expr->value.impl, az_value_get_inst (expr->value.impl, &expr->value.v), AZ_TYPE_LIST, &list_inst);
+	unsigned int size = az_collection_get_size (&list_impl->collection_impl, list_inst);
+	for (unsigned int i = 0; i < size; i++) {
+		AZPackedValue64 val = { 0 };
+		val.impl = az_list_get_element (list_impl, list_inst, i, &val.v.value, 64);
+		unsigned int is_array = val.impl && (AZ_IMPL_TYPE(val.impl) == AZ_TYPE_VALUE_ARRAY_REF);
+		az_packed_value_clear ((AZPackedValue *) &val);
+		if (is_array) return 0;
+	}
+	return 1;
+}
+
+unsigned int
+azo_compiler_share_array_literal (AZOExpression *expr, unsigned int need_flat)
+{
+	if (!AZO_EXPRESSION_IS (expr, EXPRESSION_LITERAL_ARRAY, ARRAY_LITERAL_COPY)) return 0;
+	AZOExpression *child = expr->children;
+	/* Nested arrays read from shared array can escape */
+	if (need_flat && !array_is_flat (child)) return 0;
+	expr->term.type = EXPRESSION_CONSTANT;
+	expr->term.subtype = AZ_TYPE_VALUE_ARRAY_REF;
+	az_packed_value_copy (&expr->value, &child->value);
+	expr->children = NULL;
+	azo_expression_free_tree (child);
+	return 1;
+}
+
+static unsigned int
+is_name (AZOExpression *expr, AZString *name)
+{
+	return AZO_EXPRESSION_IS (expr, EXPRESSION_REFERENCE, REFERENCE_VARIABLE) && (expr->value.v.string == name);
+}
+
+static unsigned int
+is_read_only (AZOExpression *expr, AZString *name, unsigned int is_flat)
+{
+	AZOExpression *child;
+	if (is_name (expr, name)) return 0;
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		/* Element write */
+		if ((expr->children->term.type == EXPRESSION_ARRAY_ELEMENT) && is_name (expr->children->children, name)) return 0;
+	}
+	child = expr->children;
+	if ((expr->term.type == EXPRESSION_ARRAY_ELEMENT) && is_flat && is_name (child, name)) {
+		child = child->next;
+	}
+	for (; child; child = child->next) {
+		/* Arithmetic result is new array */
+		if ((expr->term.type == EXPRESSION_BINARY) && (expr->term.subtype <= ARITHMETIC_PERCENT) && is_name (child, name)) continue;
+		if ((expr->term.type == EXPRESSION_COMPARISON) && is_name (child, name)) continue;
+		if (!is_read_only (child, name, is_flat)) return 0;
+	}
+	return 1;
+}
+
+unsigned int
+azo_compiler_can_share_declaration (AZOExpression *list, AZOExpression *decl, AZString *name)
+{
+	AZOExpression *value = decl->children->next;
+	if (!AZO_EXPRESSION_IS (value, EXPRESSION_LITERAL_ARRAY, ARRAY_LITERAL_COPY)) return 0;
+	unsigned int is_flat = array_is_flat (value->children);
+	/* Following declarations in the same list */
+	for (AZOExpression *expr = decl->next; expr; expr = expr->next) {
+		if (!is_read_only (expr, name, is_flat)) return 0;
+	}
+	/* Following statements in the same scope */
+	for (AZOExpression *expr = list->next; expr; expr = expr->next) {
+		if (!is_read_only (expr, name, is_flat)) return 0;
+	}
+	return 1;
+}
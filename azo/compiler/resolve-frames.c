@@ -14,6 +14,7 @@
 #include <azo/compiler/compiler.h>
 #include <azo/expression.h>
 #include <azo/keyword.h>
+#include <azo/module.h>
 #include <azo/optimizer.h>
 
 static void
@@ -26,6 +27,122 @@ analyze_variables (AZOCompiler *comp, AZOExpression *expr)
 	}
 }
 
+/*
+ * Dead code elimination
+ *
+ * Branches with constant boolean condition are replaced by the taken branch
+ * Sentences following return in the same block are removed
+ * Declarations without side effects that are never referenced later in the same scope are removed
+ */
+
+static unsigned int
+name_is_referenced (AZOExpression *expr, AZString *name)
+{
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_VARIABLE) && (expr->value.v.string == name)) return 1;
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (name_is_referenced (child, name)) return 1;
+	}
+	return 0;
+}
+
+/* Whether variable resolves without property lookup of this (getter may have side effects) */
+
+static unsigned int
+variable_is_known (AZOCompiler *comp, AZString *name)
+{
+	unsigned int def_flags;
+	if (azo_context_lookup_slot (comp->ctx, name, &def_flags) >= 0) return 1;
+	if (azo_compiler_lookup_import (comp, name)) return 1;
+	if (azo_frame_lookup_var (comp->current, name) || azo_frame_lookup_parent_var (comp->current, name)) return 1;
+	return comp->current->parent && azo_frame_lookup_chained (comp->current->parent, name);
+}
+
+static unsigned int
+declaration_is_unused (AZOCompiler *comp, AZOExpression *list, AZOExpression *decl)
+{
+	AZString *name = decl->children->value.v.string;
+	AZOExpression *value = decl->children->next;
+	if (value) {
+		/* Evaluating value must not have side effects */
+		if (value->term.type == EXPRESSION_CONSTANT) {
+			if (value->children) return 0;
+		} else if (value->term.type == EXPRESSION_KEYWORD) {
+			if ((value->term.subtype != AZO_KEYWORD_TRUE) && (value->term.subtype != AZO_KEYWORD_FALSE) &&
+				(value->term.subtype != AZO_KEYWORD_NULL) && (value->term.subtype != AZO_KEYWORD_THIS)) return 0;
+		} else if (AZO_EXPRESSION_IS(value, EXPRESSION_REFERENCE, REFERENCE_VARIABLE)) {
+			if (!comp->pure_properties && !variable_is_known (comp, value->value.v.string)) return 0;
+		} else if (value->term.type != EXPRESSION_FUNCTION) {
+			return 0;
+		}
+	}
+	for (AZOExpression *expr = decl->next; expr; expr = expr->next) {
+		if (name_is_referenced (expr, name)) return 0;
+	}
+	for (AZOExpression *expr = list->next; expr; expr = expr->next) {
+		if (name_is_referenced (expr, name)) return 0;
+	}
+	return 1;
+}
+
+/* Free all sentences following the given one */
+
+static void
+remove_following (AZOExpression *expr)
+{
+	while (expr->next) {
+		AZOExpression *next = expr->next->next;
+		azo_expression_free_tree (expr->next);
+		expr->next = next;
+	}
+}
+
+/* Replace expression with one of its children in place */
+
+static void
+replace_with_child (AZOExpression *expr, AZOExpression *child)
+{
+	AZOExpression **ref = &expr->children;
+	while (*ref != child) ref = &(*ref)->next;
+	*ref = child->next;
+	child->next = NULL;
+	azo_expression_clear_children (expr);
+	az_packed_value_clear (&expr->value);
+	expr->term = child->term;
+	if (child->value.impl) {
+		az_packed_value_copy (&expr->value, &child->value);
+	}
+	expr->children = child->children;
+	for (AZOExpression *c = expr->children; c; c = c->next) c->parent = expr;
+	child->children = NULL;
+	azo_expression_free (child);
+}
+
+static void
+make_empty_block (AZOExpression *expr)
+{
+	azo_expression_clear_children (expr);
+	az_packed_value_clear (&expr->value);
+	expr->term.type = AZO_EXPRESSION_BLOCK;
+	expr->term.subtype = EXPRESSION_GENERIC;
+	expr->scope_size = 0;
+}
+
+static unsigned int
+get_constant_condition (AZOExpression *expr, unsigned int *value)
+{
+	if ((expr->term.type == EXPRESSION_CONSTANT) && (expr->term.subtype == AZ_TYPE_BOOLEAN)) {
+		*value = expr->value.v.boolean_v != 0;
+		return 1;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_TRUE)) {
+		*value = 1;
+		return 1;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_FALSE)) {
+		*value = 0;
+		return 1;
+	}
+	return 0;
+}
+
 static unsigned int
 resolve_function (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 {
@@ -134,7 +251,7 @@ resolve_function (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 }
 
 static unsigned int
-resolve_declaration (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+resolve_declaration (AZOCompiler *comp, AZOExpression *list, AZOExpression *expr, unsigned int flags)
 {
 	AZOExpression *id, *value;
 	AZOVariable *var;
@@ -151,8 +268,15 @@ resolve_declaration (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 	if (value) {
 		value = azo_compiler_resolve_expression (comp, value, flags, &result);
 		if (result) return result;
+		if (azo_compiler_can_share_declaration (list, expr, id->value.v.string)) {
+			azo_compiler_share_array_literal (value, 0);
+		}
 		if (!(flags & AZO_COMPILER_NO_CONST_ASSIGN) && value->term.type == EXPRESSION_CONSTANT) {
 			var->const_expr = value;
+		} else if (!(flags & AZO_COMPILER_NO_CONST_ASSIGN) && (value->term.type == EXPRESSION_FUNCTION)) {
+			if (azo_compiler_can_inline_declaration (list, expr, id->value.v.string)) {
+				var->func_expr = value;
+			}
 		}
 	}
 	return 0;
@@ -165,25 +289,35 @@ resolve_declaration_list (AZOCompiler *comp, AZOExpression *expr, unsigned int f
 	unsigned int result;
 	type = expr->children;
 	child = type->next;
-	type = azo_compiler_resolve_expression (comp, type, flags, &result);
-	if (result) {
-		return result;
-	}
-	if (type->term.type != EXPRESSION_CONSTANT) {
-		fprintf (stderr, "resolve_declaration_list: Type expression is not compile-time constant (%u/%u)\n", type->term.type, type->term.subtype);
-		return 1;
-	}
-	if (type->term.subtype != AZ_TYPE_CLASS) {
-		fprintf (stderr, "resolve_declaration_list: Type expression is not a class\n");
-		return 1;
+	/* Type is already resolved if the list was generated by optimizer */
+	if (type->term.type != EXPRESSION_TYPE) {
+		type = azo_compiler_resolve_expression (comp, type, flags, &result);
+		if (result) {
+			return result;
+		}
+		if (type->term.type != EXPRESSION_CONSTANT) {
+			fprintf (stderr, "resolve_declaration_list: Type expression is not compile-time constant (%u/%u)\n", type->term.type, type->term.subtype);
+			return 1;
+		}
+		if (type->term.subtype != AZ_TYPE_CLASS) {
+			fprintf (stderr, "resolve_declaration_list: Type expression is not a class\n");
+			return 1;
+		}
+		type->term.type = EXPRESSION_TYPE;
+		type->term.subtype = AZ_IMPL_TYPE((AZImplementation *) type->value.v.block);
+		az_packed_value_clear (&type->value);
 	}
-	type->term.type = EXPRESSION_TYPE;
-	type->term.subtype = AZ_IMPL_TYPE((AZImplementation *) type->value.v.block);
-	az_packed_value_clear (&type->value);
-	for (child = type->next; child; child = child->next) {
-		if (resolve_declaration (comp, child, flags)) {
+	AZOExpression *prev = type;
+	for (child = type->next; child; child = prev->next) {
+		if (declaration_is_unused (comp, expr, child)) {
+			prev->next = child->next;
+			azo_expression_free_tree (child);
+			continue;
+		}
+		if (resolve_declaration (comp, expr, child, flags)) {
 			return 1;
 		}
+		prev = child;
 	}
 	return 0;
 }
@@ -200,10 +334,76 @@ resolve_children (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 	return 0;
 }
 
+static unsigned int
+resolve_sentences (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZOExpression *child;
+	unsigned int result;
+	for (child = expr->children; child; child = child->next) {
+		if (AZO_EXPRESSION_IS (child, EXPRESSION_KEYWORD, AZO_KEYWORD_RETURN)) {
+			/* Unreachable code */
+			remove_following (child);
+		}
+		azo_compiler_resolve_expression (comp, child, flags, &result);
+		if (result) return result;
+	}
+	return 0;
+}
+
+static unsigned int
+resolve_if (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZOExpression *cond, *child;
+	unsigned int result, value;
+	cond = azo_compiler_resolve_expression (comp, expr->children, flags, &result);
+	if (result) return result;
+	if (get_constant_condition (cond, &value)) {
+		AZOExpression *taken = (value) ? cond->next : cond->next->next;
+		if (!taken) {
+			make_empty_block (expr);
+			return 0;
+		}
+		/* Declaration would leak into enclosing scope */
+		if (taken->term.type != EXPRESSION_DECLARATION_LIST) {
+			replace_with_child (expr, taken);
+			azo_compiler_resolve_expression (comp, expr, flags, &result);
+			return result;
+		}
+	}
+	for (child = cond->next; child; child = child->next) {
+		azo_compiler_resolve_expression (comp, child, flags, &result);
+		if (result) return result;
+	}
+	return 0;
+}
+
+static unsigned int
+resolve_while (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZOExpression *test;
+	unsigned int result, value;
+	test = azo_compiler_resolve_expression (comp, expr->children, flags, &result);
+	if (result) return result;
+	if (get_constant_condition (test, &value)) {
+		if (!value) {
+			make_empty_block (expr);
+			return 0;
+		}
+		/* Empty test is not compiled */
+		azo_expression_clear_children (test);
+		az_packed_value_clear (&test->value);
+		test->term.type = AZO_TERM_EMPTY;
+		test->term.subtype = EXPRESSION_GENERIC;
+	}
+	azo_compiler_resolve_expression (comp, test->next, flags, &result);
+	return result;
+}
+
 static unsigned int
 resolve_for (AZOCompiler *comp, AZOExpression *expr, unsigned int *result)
 {
 	AZOExpression *init, *test, *step, *content;
+	unsigned int value;
 	init = expr->children;
 	test = init->next;
 	step = test->next;
@@ -211,15 +411,111 @@ resolve_for (AZOCompiler *comp, AZOExpression *expr, unsigned int *result)
 	/* for: create new scope */
 	azo_frame_push_scope (comp->current);
 	azo_compiler_resolve_expression (comp, init, AZO_COMPILER_NO_CONST_ASSIGN, result);
-	azo_compiler_resolve_expression (comp, test, 0, result);
+	test = azo_compiler_resolve_expression (comp, test, 0, result);
+	if (get_constant_condition (test, &value) && value) {
+		/* Empty test is not compiled */
+		az_packed_value_clear (&test->value);
+		test->term.type = AZO_TERM_EMPTY;
+		test->term.subtype = EXPRESSION_GENERIC;
+	}
 	azo_compiler_resolve_expression (comp, step, 0, result);
 	azo_compiler_resolve_expression (comp, content, 0, result);
+	if (!*result) azo_compiler_bound_loop (comp, expr);
 	//analyze_variables (comp, expr);
 	expr->scope_size = azo_scope_get_size (comp->current->scope);
 	azo_frame_pop_scope (comp->current);
 	return *result;
 }
 
+/*
+ * FOREACH
+ *   + DECLARATION_LIST
+ *   + collection
+ *   + content
+ *
+ * Collection and iteration index are kept in hidden variables just before the loop variable,
+ * the position of collection is stored in declaration list
+ */
+
+static unsigned int
+resolve_foreach (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZOExpression *list, *coll;
+	unsigned int result;
+	list = expr->children;
+	/* Collection is evaluated before loop variables exist */
+	coll = azo_compiler_resolve_expression (comp, list->next, flags, &result);
+	if (result) return result;
+	azo_frame_push_scope (comp->current);
+	for (unsigned int i = 0; i < 2; i++) {
+		unsigned char c[32];
+		sprintf ((char *) c, (i) ? "#index%u" : "#collection%u", comp->n_hidden++);
+		AZString *name = az_string_new (c);
+		AZOVariable *var = azo_frame_declare_variable (comp->current, name, AZ_TYPE_ANY, &result);
+		az_string_unref (name);
+		if (!i) list->var_pos = var->pos;
+	}
+	result = resolve_declaration_list (comp, list, AZO_COMPILER_NO_CONST_ASSIGN);
+	if (!result) azo_compiler_resolve_expression (comp, coll->next, 0, &result);
+	expr->scope_size = azo_scope_get_size (comp->current->scope);
+	azo_frame_pop_scope (comp->current);
+	return result;
+}
+
+/*
+ * TRY
+ *   + body
+ *   + DECLARATION_LIST | EMPTY
+ *   + handler
+ *
+ * Handler starts with the stack size of try statement plus exception that becomes
+ * catch variable, the size is stored in catch clause
+ */
+
+static unsigned int
+resolve_try (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZOExpression *body, *list;
+	unsigned int result, depth;
+	body = expr->children;
+	depth = comp->current->scope->next_var_pos;
+	/* Values assigned in body are not known in handler, body block makes them scope-local */
+	azo_compiler_resolve_expression (comp, body, flags, &result);
+	if (result) return result;
+	list = body->next;
+	azo_frame_push_scope (comp->current);
+	if (list->term.type == EXPRESSION_DECLARATION_LIST) {
+		result = resolve_declaration_list (comp, list, AZO_COMPILER_NO_CONST_ASSIGN);
+	}
+	list->var_pos = depth;
+	if (!result) azo_compiler_resolve_expression (comp, list->next, flags, &result);
+	expr->scope_size = azo_scope_get_size (comp->current->scope);
+	azo_frame_pop_scope (comp->current);
+	return result;
+}
+
+/*
+ * Import is done at compile time, the statement itself becomes empty block
+ */
+
+static unsigned int
+resolve_import (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
+{
+	AZString *name = expr->children->value.v.string;
+	if (azo_compiler_lookup_import (comp, name)) {
+		make_empty_block (expr);
+		return 0;
+	}
+	AZONamespace *nspace = azo_module_import (comp->ctx, name);
+	if (!nspace) {
+		fprintf (stderr, "resolve_import: Cannot import module %s\n", name->str);
+		return 1;
+	}
+	azo_compiler_add_import (comp, name, nspace);
+	make_empty_block (expr);
+	return 0;
+}
+
 static unsigned int
 resolve_assign (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 {
@@ -305,12 +601,28 @@ AZOExpression *
 azo_compiler_resolve_expression (AZOCompiler *comp, AZOExpression *expr, unsigned int flags, unsigned int *result)
 {
 	*result = 0;
+	if (comp->pure_properties && (expr->term.type == EXPRESSION_KEYWORD)) {
+		/* May turn loop into block */
+		azo_compiler_hoist_invariants (comp, expr);
+	}
+	/* May turn sentence into declaration of common values followed by sentence */
+	azo_compiler_eliminate_common (comp, expr);
 	if ((expr->term.type == EXPRESSION_KEYWORD) && (expr->term.subtype == AZO_KEYWORD_FOR)) {
 		resolve_for (comp, expr, result);
+	} else if (AZO_EXPRESSION_IS (expr, EXPRESSION_KEYWORD, AZO_KEYWORD_WHILE)) {
+		*result = resolve_while (comp, expr, flags);
+	} else if (expr->term.type == AZO_EXPRESSION_FOREACH) {
+		*result = resolve_foreach (comp, expr, flags);
+	} else if (AZO_EXPRESSION_IS (expr, EXPRESSION_KEYWORD, AZO_KEYWORD_TRY)) {
+		*result = resolve_try (comp, expr, flags);
+	} else if (AZO_EXPRESSION_IS (expr, EXPRESSION_KEYWORD, AZO_KEYWORD_IMPORT)) {
+		*result = resolve_import (comp, expr, flags);
+	} else if (AZO_EXPRESSION_IS (expr, EXPRESSION_KEYWORD, AZO_KEYWORD_IF)) {
+		*result = resolve_if (comp, expr, flags);
 	} else if (expr->term.type == AZO_EXPRESSION_BLOCK) {
 		/* block: create new scope */
 		azo_frame_push_scope (comp->current);
-		resolve_children (comp, expr, flags);
+		resolve_sentences (comp, expr, flags);
 		//analyze_variables (comp, expr);
 		expr->scope_size = azo_scope_get_size (comp->current->scope);
 		azo_frame_pop_scope (comp->current);
@@ -341,7 +653,19 @@ azo_compiler_resolve_expression (AZOCompiler *comp, AZOExpression *expr, unsigne
 		*result = resolve_prefix_suffix (comp, expr, flags);
 	} else {
 		resolve_children (comp, expr, flags);
+		if ((expr->term.type == EXPRESSION_ARRAY_ELEMENT) && !(flags & AZO_COMPILER_VAR_IS_LVALUE)) {
+			/* Element of constant array is read without copy */
+			azo_compiler_share_array_literal (expr->children, 1);
+		} else if (expr->term.type == EXPRESSION_COMPARISON) {
+			azo_compiler_share_array_literal (expr->children, 0);
+			azo_compiler_share_array_literal (expr->children->next, 0);
+		}
 		if (expr->term.type == EXPRESSION_BINARY) {
+			if (expr->term.subtype <= ARITHMETIC_PERCENT) {
+				/* Arithmetic on arrays creates new array */
+				azo_compiler_share_array_literal (expr->children, 0);
+				azo_compiler_share_array_literal (expr->children->next, 0);
+			}
 			/* fixme: implement sub-expression resolve in literal resolver */
 			azo_compiler_resolve_binary (expr);
 		} else if (expr->term.type == EXPRESSION_LITERAL_ARRAY) {
@@ -361,6 +685,8 @@ azo_compiler_resolve_frame (AZOCompiler *comp, AZOExpression *expr)
 	}
 	for (child = expr->children; child; child = child->next) {
 		if (AZO_EXPRESSION_IS (child, EXPRESSION_KEYWORD, AZO_KEYWORD_RETURN)) {
+			/* Unreachable code */
+			remove_following (child);
 			result = resolve_return (comp, child, 0);
 			ret_is_last = 1;
 		} else {
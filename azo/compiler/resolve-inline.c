@@ -0,0 +1,198 @@
+#define __AZO_RESOLVE_INLINE_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <az/packed-value.h>
+#include <az/string.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/expression.h>
+#include <azo/keyword.h>
+#include <azo/optimizer.h>
+
+#define noDEBUG_INLINE
+
+/*
+ * Inlining of small local functions
+ *
+ * Function is inlined if:
+ *   it is a declared local variable that is never assigned afterwards
+ *   the body is a single return statement with value below AZO_COMPILER_INLINE_MAX_NODES
+ *   it does not use parent variables (closure)
+ *   all arguments are constants or variables (no side effects, can be evaluated many times)
+ *
+ * Callee this is the same as caller this because plain calls pass frame position 0
+ */
+
+unsigned int
+azo_compiler_is_variable_modified (AZOExpression *expr, AZString *name)
+{
+	if ((expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		AZOExpression *lhs = expr->children;
+		if (AZO_EXPRESSION_IS(lhs, EXPRESSION_REFERENCE, REFERENCE_VARIABLE) && (lhs->value.v.string == name)) return 1;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (azo_compiler_is_variable_modified (child, name)) return 1;
+	}
+	return 0;
+}
+
+unsigned int
+azo_compiler_can_inline_declaration (AZOExpression *list, AZOExpression *decl, AZString *name)
+{
+	/* Following declarations in the same list */
+	for (AZOExpression *expr = decl->next; expr; expr = expr->next) {
+		if (azo_compiler_is_variable_modified (expr, name)) return 0;
+	}
+	/* Following statements in the same scope */
+	for (AZOExpression *expr = list->next; expr; expr = expr->next) {
+		if (azo_compiler_is_variable_modified (expr, name)) return 0;
+	}
+	return 1;
+}
+
+static unsigned int
+test_inlinable (AZOExpression *expr, unsigned int n_args)
+{
+	switch (expr->term.type) {
+	case EXPRESSION_VARIABLE:
+		if (expr->term.subtype != VARIABLE_LOCAL) return 0;
+		/* Only arguments can be accessed, 0 is this */
+		if ((expr->var_pos < 1) || (expr->var_pos > n_args)) return 0;
+		break;
+	case EXPRESSION_FUNCTION:
+	case EXPRESSION_ASSIGN:
+	case EXPRESSION_SUFFIX:
+	case EXPRESSION_DECLARATION_LIST:
+	case AZO_EXPRESSION_BLOCK:
+		return 0;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)) return 0;
+		break;
+	default:
+		break;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (!test_inlinable (child, n_args)) return 0;
+	}
+	return 1;
+}
+
+static unsigned int
+test_simple_argument (AZOExpression *expr)
+{
+	if (expr->term.type == EXPRESSION_CONSTANT) return !expr->children;
+	/* Global can be changed by host between evaluations */
+	if (expr->term.type == EXPRESSION_VARIABLE) return expr->term.subtype != VARIABLE_GLOBAL;
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_THIS)) return 1;
+	return 0;
+}
+
+/* Clone resolved tree, replacing argument variables with argument expressions */
+
+static AZOExpression *
+clone_resolved (AZOExpression *expr, AZOExpression *args[], unsigned int n_args)
+{
+	if (args && (expr->term.type == EXPRESSION_VARIABLE) && (expr->term.subtype == VARIABLE_LOCAL)) {
+		return clone_resolved (args[expr->var_pos - 1], NULL, 0);
+	}
+	AZOExpression *clone = azo_expression_new (expr->term.type, expr->term.subtype, expr->term.start, expr->term.end);
+	if (expr->value.impl) {
+		az_packed_value_copy (&clone->value, &expr->value);
+	}
+	clone->var_pos = expr->var_pos;
+	AZOExpression *prev = NULL;
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		AZOExpression *cloned_child = clone_resolved (child, args, n_args);
+		cloned_child->parent = clone;
+		if (!prev) {
+			clone->children = cloned_child;
+		} else {
+			prev->next = cloned_child;
+		}
+		prev = cloned_child;
+	}
+	return clone;
+}
+
+/* Fold constants in substituted tree */
+
+static void
+fold_constants (AZOExpression *expr)
+{
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		fold_constants (child);
+	}
+	if (expr->term.type == EXPRESSION_BINARY) {
+		azo_compiler_resolve_binary (expr);
+	} else if (expr->term.type == EXPRESSION_PREFIX) {
+		azo_compiler_resolve_prefix (expr);
+	} else if (expr->term.type == EXPRESSION_LITERAL_ARRAY) {
+		azo_compiler_resolve_array_literal (expr);
+	}
+}
+
+static AZOExpression *
+get_return_value (AZOExpression *func)
+{
+	AZOExpression *args, *body;
+	if (func->term.subtype != FUNCTION_STATIC) return NULL;
+	args = func->children->next;
+	body = args->next;
+	if (func->frame->n_parent_vars) return NULL;
+	if (body->term.type == AZO_EXPRESSION_BLOCK) {
+		if (!body->children || body->children->next) return NULL;
+		body = body->children;
+	}
+	if (!AZO_EXPRESSION_IS(body, EXPRESSION_KEYWORD, AZO_KEYWORD_RETURN)) return NULL;
+	if (!body->children || (body->children->term.type == AZO_TERM_EMPTY)) return NULL;
+	return body->children;
+}
+
+unsigned int
+azo_compiler_inline_call (AZOCompiler *comp, AZOExpression *expr, AZOExpression *func)
+{
+	AZOExpression *list = expr->children->next;
+	AZOExpression *args[64];
+	unsigned int n_args = 0, n_params = 0;
+
+	AZOExpression *val = get_return_value (func);
+	if (!val) return 0;
+	if (azo_expression_count_nodes (val) > AZO_COMPILER_INLINE_MAX_NODES) return 0;
+	for (AZOExpression *child = func->children->next->children; child; child = child->next) n_params += 1;
+	for (AZOExpression *child = list->children; child; child = child->next) {
+		if (n_args >= 64) return 0;
+		if (!test_simple_argument (child)) return 0;
+		args[n_args++] = child;
+	}
+	if (n_args != n_params) return 0;
+	if (!test_inlinable (val, n_args)) return 0;
+
+	AZOExpression *body = clone_resolved (val, args, n_args);
+	/* Replace call with body in place, keeping source position of call */
+	azo_expression_clear_children (expr);
+	az_packed_value_clear (&expr->value);
+	expr->term.type = body->term.type;
+	expr->term.subtype = body->term.subtype;
+	expr->var_pos = body->var_pos;
+	if (body->value.impl) {
+		az_packed_value_copy (&expr->value, &body->value);
+	}
+	expr->children = body->children;
+	for (AZOExpression *child = expr->children; child; child = child->next) child->parent = expr;
+	body->children = NULL;
+	azo_expression_free (body);
+	fold_constants (expr);
+#ifdef DEBUG_INLINE
+	fprintf (stderr, "azo_compiler_inline_call: Inlined call (%u nodes)\n", azo_expression_count_nodes (expr));
+#endif
+	return 1;
+}
@@ -0,0 +1,290 @@
+#define __AZO_RESOLVE_INVARIANTS_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <az/packed-value.h>
+#include <az/string.h>
+
+#include <azo/compiler/compiler.h>
+#include <azo/expression.h>
+#include <azo/keyword.h>
+#include <azo/optimizer.h>
+
+#define noDEBUG_HOIST
+
+/* Maximum number of hoisted lookups per loop */
+#define MAX_INVARIANTS 16
+
+/*
+ * Loop-invariant code motion for member lookups
+ *
+ * Member chain (a.b.c) is moved out of loop if:
+ *   compiler promises that property lookups are pure (pure_properties)
+ *   it appears in loop condition outside of the right operands of && and || (it is evaluated at least
+ *   once, so no new exceptions are introduced)
+ *   the root is this or a variable that is not declared or modified inside loop
+ *   loop test, step and body make no calls, constructors or property writes (any of these can run
+ *   host code that changes the looked up objects)
+ *   loop does not yield (host may modify objects while it is suspended)
+ *
+ * Final properties of constant objects are already folded to constants during resolve,
+ * so this only matters for ordinary properties of host objects.
+ *
+ * Works on unresolved tree, the loop node is rewritten in place as:
+ *
+ * BLOCK
+ *   + init of FOR (if not empty)
+ *   + DECLARATION_LIST
+ *     + TYPE any
+ *     + DECLARATION #invariantN = a.b.c
+ *   + FOR/WHILE with empty init and all occurrences of a.b.c replaced by #invariantN
+ *
+ * Init is moved out of loop because lookups have to see the values it assigns.
+ */
+
+static unsigned int
+name_is_declared (AZOExpression *expr, AZString *name)
+{
+	if ((expr->term.type == EXPRESSION_DECLARATION) && (expr->children->value.v.string == name)) return 1;
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (name_is_declared (child, name)) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+roots_are_equal (AZOExpression *lhs, AZOExpression *rhs)
+{
+	if ((lhs->term.type != rhs->term.type) || (lhs->term.subtype != rhs->term.subtype)) return 0;
+	if (lhs->term.type == EXPRESSION_REFERENCE) return lhs->value.v.string == rhs->value.v.string;
+	return 1;
+}
+
+/* Whether evaluating tree can run code that is not visible to compiler */
+
+static unsigned int
+is_opaque (AZOExpression *expr)
+{
+	switch (expr->term.type) {
+	case EXPRESSION_FUNCTION:
+	case EXPRESSION_FUNCTION_CALL:
+		return 1;
+	case EXPRESSION_KEYWORD:
+		if (expr->term.subtype == AZO_KEYWORD_NEW) return 1;
+		break;
+	case EXPRESSION_ASSIGN:
+	case EXPRESSION_SUFFIX:
+		if (AZO_EXPRESSION_IS(expr->children, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) return 1;
+		break;
+	case EXPRESSION_PREFIX:
+		if ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)) {
+			if (AZO_EXPRESSION_IS(expr->children, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) return 1;
+		}
+		break;
+	default:
+		break;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (is_opaque (child)) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+has_yield (AZOExpression *expr)
+{
+	if (expr->term.type == EXPRESSION_FUNCTION) return 0;
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_YIELD)) return 1;
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		if (has_yield (child)) return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+chain_is_invariant (AZOExpression *chain, AZOExpression *loop)
+{
+	if (AZO_EXPRESSION_IS(chain, EXPRESSION_KEYWORD, AZO_KEYWORD_THIS)) {
+		return 1;
+	} else if (AZO_EXPRESSION_IS(chain, EXPRESSION_REFERENCE, REFERENCE_VARIABLE)) {
+		if (azo_compiler_is_variable_modified (loop, chain->value.v.string)) return 0;
+		return !name_is_declared (loop, chain->value.v.string);
+	} else if (AZO_EXPRESSION_IS(chain, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		AZOExpression *member = chain->children->next;
+		if (!AZO_EXPRESSION_IS(member, EXPRESSION_REFERENCE, REFERENCE_PROPERTY)) return 0;
+		return chain_is_invariant (chain->children, loop);
+	}
+	return 0;
+}
+
+static unsigned int
+chains_are_equal (AZOExpression *lhs, AZOExpression *rhs)
+{
+	while (AZO_EXPRESSION_IS(lhs, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		if (!AZO_EXPRESSION_IS(rhs, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) return 0;
+		if (!AZO_EXPRESSION_IS(lhs->children->next, EXPRESSION_REFERENCE, REFERENCE_PROPERTY)) return 0;
+		if (!AZO_EXPRESSION_IS(rhs->children->next, EXPRESSION_REFERENCE, REFERENCE_PROPERTY)) return 0;
+		if (lhs->children->next->value.v.string != rhs->children->next->value.v.string) return 0;
+		lhs = lhs->children;
+		rhs = rhs->children;
+	}
+	return roots_are_equal (lhs, rhs);
+}
+
+/* Collect outermost invariant chains in unconditionally evaluated rvalue positions */
+
+static void
+collect_chains (AZOExpression *expr, AZOExpression *loop, AZOExpression *chains[], unsigned int *n_chains, unsigned int is_lvalue)
+{
+	if (expr->term.type == EXPRESSION_FUNCTION) return;
+	if (!is_lvalue && AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		if (chain_is_invariant (expr, loop)) {
+			for (unsigned int i = 0; i < *n_chains; i++) {
+				if (chains_are_equal (chains[i], expr)) return;
+			}
+			if (*n_chains < MAX_INVARIANTS) chains[(*n_chains)++] = expr;
+			return;
+		}
+	}
+	if ((expr->term.type == EXPRESSION_FUNCTION_CALL) || (expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		/* First child is called or assigned, but its parent object can be hoisted */
+		collect_chains (expr->children, loop, chains, n_chains, 1);
+		for (AZOExpression *child = expr->children->next; child; child = child->next) {
+			collect_chains (child, loop, chains, n_chains, 0);
+		}
+		return;
+	}
+	if (is_lvalue && AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		collect_chains (expr->children, loop, chains, n_chains, 0);
+		return;
+	}
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_BINARY, ARITHMETIC_ANDAND) || AZO_EXPRESSION_IS(expr, EXPRESSION_BINARY, ARITHMETIC_OROR)) {
+		/* Right operand may be guarded by the left one (p != null && i < p.length) */
+		collect_chains (expr->children, loop, chains, n_chains, 0);
+		return;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		collect_chains (child, loop, chains, n_chains, 0);
+	}
+}
+
+/* Replace all rvalue occurrences of chain with hidden variable */
+
+static void
+replace_chain (AZOExpression *expr, AZOExpression *chain, AZString *name, unsigned int is_lvalue)
+{
+	if (expr->term.type == EXPRESSION_FUNCTION) return;
+	if (!is_lvalue && chains_are_equal (expr, chain)) {
+		azo_expression_clear_children (expr);
+		az_packed_value_clear (&expr->value);
+		expr->term.type = EXPRESSION_REFERENCE;
+		expr->term.subtype = REFERENCE_VARIABLE;
+		az_packed_value_set_string (&expr->value, name);
+		return;
+	}
+	if ((expr->term.type == EXPRESSION_FUNCTION_CALL) || (expr->term.type == EXPRESSION_ASSIGN) || (expr->term.type == EXPRESSION_SUFFIX) ||
+		((expr->term.type == EXPRESSION_PREFIX) && ((expr->term.subtype == PREFIX_INCREMENT) || (expr->term.subtype == PREFIX_DECREMENT)))) {
+		replace_chain (expr->children, chain, name, 1);
+		for (AZOExpression *child = expr->children->next; child; child = child->next) {
+			replace_chain (child, chain, name, 0);
+		}
+		return;
+	}
+	if (is_lvalue && AZO_EXPRESSION_IS(expr, EXPRESSION_REFERENCE, REFERENCE_MEMBER)) {
+		replace_chain (expr->children, chain, name, 0);
+		return;
+	}
+	for (AZOExpression *child = expr->children; child; child = child->next) {
+		replace_chain (child, chain, name, 0);
+	}
+}
+
+unsigned int
+azo_compiler_hoist_invariants (AZOCompiler *comp, AZOExpression *expr)
+{
+	AZOExpression *init = NULL, *test, *chains[MAX_INVARIANTS];
+	unsigned int n_chains = 0;
+
+	if (!comp->pure_properties) return 0;
+	if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_FOR)) {
+		init = expr->children;
+		test = init->next;
+	} else if (AZO_EXPRESSION_IS(expr, EXPRESSION_KEYWORD, AZO_KEYWORD_WHILE)) {
+		test = expr->children;
+	} else {
+		return 0;
+	}
+	if (has_yield (expr)) return 0;
+	/* Init runs before lookups, so only test, step and body have to be transparent */
+	for (AZOExpression *child = test; child; child = child->next) {
+		if (is_opaque (child)) return 0;
+	}
+	collect_chains (test, expr, chains, &n_chains, 0);
+	if (!n_chains) return 0;
+
+	/* Move loop into new node */
+	AZOExpression *loop = azo_expression_new (expr->term.type, expr->term.subtype, expr->term.start, expr->term.end);
+	loop->children = expr->children;
+	for (AZOExpression *child = loop->children; child; child = child->next) child->parent = loop;
+	expr->children = NULL;
+	if (init && (init->term.type == AZO_TERM_EMPTY)) init = NULL;
+	if (init) {
+		/* Leave empty init in loop */
+		AZOExpression *empty = azo_expression_new (AZO_TERM_EMPTY, EXPRESSION_GENERIC, init->term.start, init->term.start);
+		empty->parent = loop;
+		empty->next = init->next;
+		loop->children = empty;
+		init->next = NULL;
+	}
+
+	AZOExpression *list = azo_expression_new (EXPRESSION_DECLARATION_LIST, EXPRESSION_GENERIC, expr->term.start, expr->term.start);
+	AZOExpression *type = azo_expression_new (EXPRESSION_TYPE, AZ_TYPE_ANY, expr->term.start, expr->term.start);
+	type->parent = list;
+	list->children = type;
+	AZOExpression *prev = type;
+	for (unsigned int i = 0; i < n_chains; i++) {
+		unsigned char c[32];
+		sprintf ((char *) c, "#invariant%u", comp->n_hidden++);
+		AZString *name = az_string_new (c);
+		AZOExpression *decl = azo_expression_new (EXPRESSION_DECLARATION, EXPRESSION_GENERIC, chains[i]->term.start, chains[i]->term.end);
+		AZOExpression *id = azo_expression_new (EXPRESSION_REFERENCE, REFERENCE_VARIABLE, chains[i]->term.start, chains[i]->term.end);
+		az_packed_value_set_string (&id->value, name);
+		AZOExpression *value = azo_expression_clone_tree (chains[i]);
+		id->parent = decl;
+		value->parent = decl;
+		decl->children = id;
+		id->next = value;
+		decl->parent = list;
+		prev->next = decl;
+		prev = decl;
+		/* Chains point into loop, so the clone has to be made before replacing */
+		replace_chain (loop, value, name, 0);
+#ifdef DEBUG_HOIST
+		fprintf (stderr, "azo_compiler_hoist_invariants: Hoisted lookup as %s\n", name->str);
+#endif
+		az_string_unref (name);
+	}
+
+	expr->term.type = AZO_EXPRESSION_BLOCK;
+	expr->term.subtype = 0;
+	az_packed_value_clear (&expr->value);
+	list->parent = expr;
+	loop->parent = expr;
+	list->next = loop;
+	if (init) {
+		init->parent = expr;
+		init->next = list;
+		expr->children = init;
+	} else {
+		expr->children = list;
+	}
+	return 1;
+}
@@ -154,12 +154,23 @@ resolve_variable (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 	/*
 	 * Try global context
 	 *
+	 * REFERENCE -> VARIABLE, global
 	 * REFERENCE -> CONSTANT
 	 */
 #ifdef DEBUG_RESOLVE_VARIABLE
 	AZString *str = expr->value.v.string;
 #endif
 	assert (!expr->children);
+	unsigned int def_flags;
+	int slot = azo_context_lookup_slot (comp->ctx, expr->value.v.string, &def_flags);
+	if ((slot >= 0) && (def_flags & AZO_CONTEXT_VARIABLE)) {
+		/* Value can change after compilation */
+		expr->term.type = EXPRESSION_VARIABLE;
+		expr->term.subtype = VARIABLE_GLOBAL;
+		az_packed_value_clear (&expr->value);
+		expr->var_pos = slot;
+		return 0;
+	}
 	expr->value.impl = azo_context_lookup (comp->ctx, expr->value.v.string, &expr->value.v, 16);
 	if (expr->value.impl) {
 		expr->term.type = EXPRESSION_CONSTANT;
@@ -170,6 +181,19 @@ resolve_variable (AZOCompiler *comp, AZOExpression *expr, unsigned int flags)
 #endif
 		return 0;
 	}
+	/*
+	 * Try imported modules
+	 *
+	 * REFERENCE -> CONSTANT
+	 */
+	AZONamespace *nspace = azo_compiler_lookup_import (comp, expr->value.v.string);
+	if (nspace) {
+		az_packed_value_clear (&expr->value);
+		az_packed_value_set_from_impl_instance (&expr->value, (const AZImplementation *) az_type_get_class (AZO_TYPE_NAMESPACE), nspace);
+		expr->term.type = EXPRESSION_CONSTANT;
+		expr->term.subtype = AZO_TYPE_NAMESPACE;
+		return 0;
+	}
 	/*
 	 * Try local
 	 *
@@ -292,11 +316,21 @@ azo_compiler_resolve_function_call (AZOCompiler *comp, AZOExpression *expr, unsi
 		return expr;
 	}
 
+	/* Local variable has to be looked up before resolving as reference loses name */
+	AZOVariable *var = NULL;
+	if (ref->term.subtype == REFERENCE_VARIABLE) {
+		var = azo_frame_lookup_var (comp->current, ref->value.v.string);
+	}
 	ref = azo_compiler_resolve_reference (comp, ref, flags, result);
 	if (*result) return expr;
 	args = azo_compiler_resolve_expression (comp, args, flags, result);
 	if (*result) return expr;
 
+	/* Try to inline small local functions */
+	if (var && var->func_expr && AZO_EXPRESSION_IS(ref, EXPRESSION_VARIABLE, VARIABLE_LOCAL) && (ref->var_pos == var->pos)) {
+		if (azo_compiler_inline_call (comp, expr, var->func_expr)) return expr;
+	}
+
 	/* If reference is already resolved to constant we have nothing to do */
 	if (ref->term.type != EXPRESSION_REFERENCE) return expr;
 	/* Test if arguments list is constant */
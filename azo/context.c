@@ -8,10 +8,11 @@
 
 typedef struct _AZOContextFull AZOContextFull;
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include <arikkei/arikkei-dict.h>
 #include <arikkei/arikkei-utils.h>
 
 #include <az/classes/active-object.h>
@@ -22,15 +23,61 @@ typedef struct _AZOContextFull AZOContextFull;
 #include <az/extend.h>
 
 #include "context.h"
+#include "generator.h"
 #include "interpreter.h"
+#include "namespace.h"
+#include "program.h"
+#include "symbol.h"
+#include "typed-array.h"
+
+/* Interpreter bound to thread */
+typedef struct _AZOThreadInterpreter {
+	pthread_t thread;
+	AZOInterpreter *intr;
+} AZOThreadInterpreter;
+
+/* Compiled module, toplevel program is kept because module values may refer to it */
+typedef struct _AZOModule {
+	unsigned int id;
+	AZString *name;
+	AZONamespace *nspace;
+	AZOProgram *prog;
+} AZOModule;
 
 struct _AZOContextFull {
 	AZOContext azo_ctx;
-	ArikkeiDict definitions;
+	/* Unique for the lifetime of process, identifies context in thread caches */
+	unsigned int serial;
+	/* Guards definitions and values */
+	pthread_rwlock_t lock;
+	/* Guards interpreters */
+	pthread_mutex_t intr_lock;
+	unsigned int n_intrs;
+	unsigned int size_intrs;
+	AZOThreadInterpreter *intrs;
+	/* Value index + 1 by symbol id, 0 if not defined */
+	unsigned int *definitions;
+	unsigned int definitions_size;
 	unsigned int values_size;
 	unsigned int nvalues;
 	AZPackedValue *values;
 	AZString **keys;
+	unsigned int *flags;
+	/* Snapshot is immutable and can be forked */
+	unsigned int frozen;
+	atomic_uint n_children;
+	/* Fork parent, slots below base belong to it */
+	AZOContextFull *parent;
+	unsigned int base;
+	/* Copy-on-write values of inherited variables by slot, allocated on first write */
+	AZPackedValue *overrides;
+	uint8_t *overridden;
+	/* Module loader and compiled modules, guarded by lock */
+	AZOModuleLoader loader;
+	void *loader_data;
+	unsigned int n_modules;
+	unsigned int size_modules;
+	AZOModule *modules;
 };
 
 struct _AZOContextClass {
@@ -72,15 +119,130 @@ context_class_init (AZOContextClass *klass)
 	az_class_define_method_va ((AZClass *) klass, FUNC_DEFINE, (const unsigned char *) "define", context_call_define, AZ_TYPE_NONE, 0);
 }
 
+static atomic_uint next_serial = 1;
+
+/* Last used context and interpreter of this thread */
+static _Thread_local struct {
+	AZOContext *ctx;
+	unsigned int serial;
+	AZOInterpreter *intr;
+} thread_cache;
+
+/*
+ * Interpreters are released when their thread exits
+ *
+ * Every thread keeps the list of contexts it has an interpreter in (as thread_key value) and the
+ * destructor of key looks these up among live contexts. Context removes itself from live list
+ * before deleting its interpreters, so both never delete the same interpreter.
+ */
+
+typedef struct _AZOThreadContexts {
+	unsigned int n_entries;
+	unsigned int size_entries;
+	struct {
+		AZOContextFull *fctx;
+		unsigned int serial;
+	} *entries;
+} AZOThreadContexts;
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+/* Guards live contexts */
+static pthread_mutex_t contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int n_contexts = 0;
+static unsigned int size_contexts = 0;
+static AZOContextFull **contexts = NULL;
+
+static void
+thread_exit (void *data)
+{
+	AZOThreadContexts *tctx = (AZOThreadContexts *) data;
+	pthread_t self = pthread_self ();
+	pthread_mutex_lock (&contexts_lock);
+	for (unsigned int i = 0; i < tctx->n_entries; i++) {
+		AZOContextFull *fctx = NULL;
+		for (unsigned int j = 0; j < n_contexts; j++) {
+			if ((contexts[j] == tctx->entries[i].fctx) && (contexts[j]->serial == tctx->entries[i].serial)) {
+				fctx = contexts[j];
+				break;
+			}
+		}
+		if (!fctx) continue;
+		AZOInterpreter *intr = NULL;
+		pthread_mutex_lock (&fctx->intr_lock);
+		for (unsigned int j = 0; j < fctx->n_intrs; j++) {
+			if (pthread_equal (fctx->intrs[j].thread, self)) {
+				intr = fctx->intrs[j].intr;
+				fctx->intrs[j] = fctx->intrs[--fctx->n_intrs];
+				break;
+			}
+		}
+		if (fctx->azo_ctx.intr == intr) fctx->azo_ctx.intr = NULL;
+		pthread_mutex_unlock (&fctx->intr_lock);
+		if (intr) interpreter_delete (intr);
+	}
+	pthread_mutex_unlock (&contexts_lock);
+	free (tctx->entries);
+	free (tctx);
+}
+
+static void
+thread_key_init (void)
+{
+	pthread_key_create (&thread_key, thread_exit);
+}
+
+static void
+thread_add_context (AZOContextFull *fctx)
+{
+	pthread_once (&thread_key_once, thread_key_init);
+	AZOThreadContexts *tctx = (AZOThreadContexts *) pthread_getspecific (thread_key);
+	if (!tctx) {
+		tctx = (AZOThreadContexts *) malloc (sizeof (AZOThreadContexts));
+		memset (tctx, 0, sizeof (AZOThreadContexts));
+		pthread_setspecific (thread_key, tctx);
+	}
+	/* Drop entries of deleted contexts */
+	pthread_mutex_lock (&contexts_lock);
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < tctx->n_entries; i++) {
+		for (unsigned int j = 0; j < n_contexts; j++) {
+			if ((contexts[j] == tctx->entries[i].fctx) && (contexts[j]->serial == tctx->entries[i].serial)) {
+				tctx->entries[n++] = tctx->entries[i];
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock (&contexts_lock);
+	tctx->n_entries = n;
+	if (tctx->n_entries >= tctx->size_entries) {
+		tctx->size_entries = (tctx->size_entries) ? tctx->size_entries << 1 : 8;
+		tctx->entries = realloc (tctx->entries, tctx->size_entries * sizeof (tctx->entries[0]));
+	}
+	tctx->entries[tctx->n_entries].fctx = fctx;
+	tctx->entries[tctx->n_entries++].serial = fctx->serial;
+}
+
 static void
 context_init (AZOContextClass *klass, AZOContextFull *fctx)
 {
-	arikkei_dict_setup_string (&fctx->definitions, 301);
+	fctx->serial = atomic_fetch_add (&next_serial, 1);
+	pthread_rwlock_init (&fctx->lock, NULL);
+	pthread_mutex_init (&fctx->intr_lock, NULL);
 	fctx->values_size = 16;
 	fctx->values = (AZPackedValue *) malloc (fctx->values_size * sizeof (AZPackedValue));
 	memset (fctx->values, 0, fctx->values_size * sizeof (AZPackedValue));
 	fctx->keys = (AZString **) malloc (fctx->values_size * sizeof (AZString *));
-	fctx->azo_ctx.intr = azo_interpreter_new (&fctx->azo_ctx);
+	fctx->flags = (unsigned int *) malloc (fctx->values_size * sizeof (unsigned int));
+	pthread_mutex_lock (&contexts_lock);
+	if (n_contexts >= size_contexts) {
+		size_contexts = (size_contexts) ? size_contexts << 1 : 8;
+		contexts = (AZOContextFull **) realloc (contexts, size_contexts * sizeof (AZOContextFull *));
+	}
+	contexts[n_contexts++] = fctx;
+	pthread_mutex_unlock (&contexts_lock);
+	/* Main interpreter belongs to the creating thread */
+	fctx->azo_ctx.intr = azo_context_get_interpreter (&fctx->azo_ctx);
 }
 
 static void
@@ -93,7 +255,38 @@ context_finalize (AZOContextClass *klass, AZOContextFull *fctx)
 	}
 	free (fctx->values);
 	free (fctx->keys);
-	arikkei_dict_release (&fctx->definitions);
+	free (fctx->flags);
+	free (fctx->definitions);
+	if (fctx->overrides) {
+		for (i = 0; i < fctx->base; i++) {
+			if (fctx->overridden[i]) az_packed_value_clear (&fctx->overrides[i]);
+		}
+		free (fctx->overrides);
+		free (fctx->overridden);
+	}
+	for (i = 0; i < fctx->n_modules; i++) {
+		az_string_unref (fctx->modules[i].name);
+		az_instance_delete (AZO_TYPE_NAMESPACE, fctx->modules[i].nspace);
+		azo_program_delete (fctx->modules[i].prog);
+	}
+	free (fctx->modules);
+	if (fctx->parent) atomic_fetch_sub (&fctx->parent->n_children, 1);
+	/* After this exiting threads leave our interpreters alone */
+	pthread_mutex_lock (&contexts_lock);
+	for (i = 0; i < n_contexts; i++) {
+		if (contexts[i] == fctx) {
+			contexts[i] = contexts[--n_contexts];
+			break;
+		}
+	}
+	pthread_mutex_unlock (&contexts_lock);
+	for (i = 0; i < fctx->n_intrs; i++) {
+		interpreter_delete (fctx->intrs[i].intr);
+	}
+	free (fctx->intrs);
+	if (thread_cache.ctx == &fctx->azo_ctx) thread_cache.ctx = NULL;
+	pthread_mutex_destroy (&fctx->intr_lock);
+	pthread_rwlock_destroy (&fctx->lock);
 }
 
 static unsigned int
@@ -112,32 +305,124 @@ azo_context_new (void)
 void
 azo_context_delete (AZOContext *ctx)
 {
+	arikkei_return_if_fail (ctx != NULL);
+	arikkei_return_if_fail (atomic_load (&((AZOContextFull *) ctx)->n_children) == 0);
 	az_instance_delete (AZO_TYPE_CONTEXT, ctx);
 }
 
-unsigned int
-azo_context_define (AZOContext *ctx, AZString *key, const AZPackedValue *value)
+void
+azo_context_snapshot (AZOContext *ctx)
 {
+	arikkei_return_if_fail (ctx != NULL);
 	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_wrlock (&fctx->lock);
+	fctx->frozen = 1;
+	pthread_rwlock_unlock (&fctx->lock);
+}
+
+unsigned int
+azo_context_is_snapshot (AZOContext *ctx)
+{
 	arikkei_return_val_if_fail (ctx != NULL, 0);
-	arikkei_return_val_if_fail (key != NULL, 0);
-	arikkei_return_val_if_fail (value != NULL, 0);
-	if (arikkei_dict_exists_pval (&fctx->definitions, key->str)) return 0;
+	return ((AZOContextFull *) ctx)->frozen;
+}
+
+AZOContext *
+azo_context_fork (AZOContext *snapshot)
+{
+	arikkei_return_val_if_fail (snapshot != NULL, NULL);
+	AZOContextFull *pfctx = (AZOContextFull *) snapshot;
+	arikkei_return_val_if_fail (pfctx->frozen, NULL);
+	AZOContextFull *fctx = (AZOContextFull *) azo_context_new ();
+	fctx->parent = pfctx;
+	fctx->base = pfctx->base + pfctx->nvalues;
+	atomic_fetch_add (&pfctx->n_children, 1);
+	return &fctx->azo_ctx;
+}
+
+unsigned int
+azo_context_inherits (AZOContext *ctx, AZOContext *ancestor)
+{
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	while (fctx) {
+		if (&fctx->azo_ctx == ancestor) return 1;
+		fctx = fctx->parent;
+	}
+	return 0;
+}
+
+/*
+ * Snapshots never change, so only the lock of the context itself has to be held.
+ */
+
+/* Find the slot of symbol in context or its ancestors, -1 if not defined */
+static int
+context_find (AZOContextFull *fctx, unsigned int id, unsigned int *flags)
+{
+	while (fctx) {
+		if (id && (id < fctx->definitions_size) && fctx->definitions[id]) {
+			unsigned int idx = fctx->definitions[id] - 1;
+			if (flags) *flags = fctx->flags[idx];
+			return fctx->base + idx;
+		}
+		fctx = fctx->parent;
+	}
+	return -1;
+}
+
+/* The value in slot, overridden values of inherited variables take precedence */
+static AZPackedValue *
+context_get_slot (AZOContextFull *fctx, unsigned int slot)
+{
+	while (slot < fctx->base) {
+		if (fctx->overridden && fctx->overridden[slot]) return &fctx->overrides[slot];
+		fctx = fctx->parent;
+	}
+	return &fctx->values[slot - fctx->base];
+}
+
+static unsigned int
+context_define (AZOContextFull *fctx, AZString *key, const AZPackedValue *value, unsigned int flags)
+{
+	if (fctx->frozen) return 0;
+	unsigned int id = azo_symbol_intern (key);
+	if (context_find (fctx, id, NULL) >= 0) return 0;
+	if (id >= fctx->definitions_size) {
+		unsigned int newsize = (fctx->definitions_size) ? fctx->definitions_size : 256;
+		while (newsize <= id) newsize = newsize << 1;
+		fctx->definitions = (unsigned int *) realloc (fctx->definitions, newsize * sizeof (unsigned int));
+		memset (&fctx->definitions[fctx->definitions_size], 0, (newsize - fctx->definitions_size) * sizeof (unsigned int));
+		fctx->definitions_size = newsize;
+	}
 	if (fctx->nvalues >= fctx->values_size) {
 		unsigned int newsize = fctx->values_size << 1;
 		fctx->values = (AZPackedValue *) realloc (fctx->values, newsize * sizeof (AZPackedValue));
 		memset (&fctx->values[fctx->values_size], 0, (newsize - fctx->values_size) * sizeof (AZPackedValue));
 		fctx->keys = (AZString **) realloc (fctx->keys, newsize * sizeof (AZString *));
+		fctx->flags = (unsigned int *) realloc (fctx->flags, newsize * sizeof (unsigned int));
 		fctx->values_size = newsize;
 	}
-	void *valptr = ARIKKEI_INT_TO_POINTER (fctx->nvalues);
-	arikkei_dict_insert_pval (&fctx->definitions, key->str, valptr);
+	fctx->definitions[id] = fctx->nvalues + 1;
 	az_packed_value_copy (&fctx->values[fctx->nvalues], value);
 	az_string_ref (key);
-	fctx->keys[fctx->nvalues++] = key;
+	fctx->keys[fctx->nvalues] = key;
+	fctx->flags[fctx->nvalues++] = flags;
 	return 1;
 }
 
+unsigned int
+azo_context_define (AZOContext *ctx, AZString *key, const AZPackedValue *value)
+{
+	arikkei_return_val_if_fail (ctx != NULL, 0);
+	arikkei_return_val_if_fail (key != NULL, 0);
+	arikkei_return_val_if_fail (value != NULL, 0);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_wrlock (&fctx->lock);
+	unsigned int result = context_define (fctx, key, value, 0);
+	pthread_rwlock_unlock (&fctx->lock);
+	return result;
+}
+
 unsigned int
 azo_context_define_by_str (AZOContext *ctx, const unsigned char *key, const AZPackedValue *value)
 {
@@ -155,23 +440,219 @@ azo_context_define_by_str (AZOContext *ctx, const unsigned char *key, const AZPa
 const AZImplementation *
 azo_context_lookup (AZOContext *ctx, AZString *key, AZValue *val, unsigned int size)
 {
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
 	arikkei_return_val_if_fail (ctx != NULL, 0);
 	arikkei_return_val_if_fail (key != NULL, 0);
 	arikkei_return_val_if_fail (val != NULL, 0);
-	return azo_context_lookup_by_str (ctx, key->str, val, size);
+	/* Keys that are not interned cannot be defined */
+	unsigned int id = azo_symbol_lookup (key);
+	const AZImplementation *impl = NULL;
+	pthread_rwlock_rdlock (&fctx->lock);
+	int slot = context_find (fctx, id, NULL);
+	if (slot >= 0) {
+		AZPackedValue *pval = context_get_slot (fctx, slot);
+		impl = az_value_copy_autobox(pval->impl, val, &pval->v, size);
+	}
+	pthread_rwlock_unlock (&fctx->lock);
+	return impl;
 }
 
 const AZImplementation *
 azo_context_lookup_by_str (AZOContext *ctx, const uint8_t *key, AZValue *val, unsigned int size)
 {
-	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	const AZImplementation *impl;
 	arikkei_return_val_if_fail (ctx != NULL, NULL);
 	arikkei_return_val_if_fail (key != NULL, NULL);
 	arikkei_return_val_if_fail (val != NULL, NULL);
-	void **ptr = (void **) arikkei_dict_lookup (&fctx->definitions, &key);
-	if (!ptr) return NULL;
-	unsigned int idx = ARIKKEI_POINTER_TO_INT(*ptr);
-	return az_value_copy_autobox(fctx->values[idx].impl, val, &fctx->values[idx].v, size);
+	AZString *str = az_string_new (key);
+	impl = azo_context_lookup (ctx, str, val, size);
+	az_string_unref (str);
+	return impl;
+}
+
+unsigned int
+azo_context_define_variable (AZOContext *ctx, AZString *key, const AZPackedValue *value)
+{
+	arikkei_return_val_if_fail (ctx != NULL, 0);
+	arikkei_return_val_if_fail (key != NULL, 0);
+	arikkei_return_val_if_fail (value != NULL, 0);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_wrlock (&fctx->lock);
+	unsigned int result = context_define (fctx, key, value, AZO_CONTEXT_VARIABLE);
+	pthread_rwlock_unlock (&fctx->lock);
+	return result;
+}
+
+unsigned int
+azo_context_set (AZOContext *ctx, AZString *key, const AZPackedValue *value)
+{
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	unsigned int flags;
+	arikkei_return_val_if_fail (value != NULL, 0);
+	int slot = azo_context_lookup_slot (ctx, key, &flags);
+	if ((slot < 0) || !(flags & AZO_CONTEXT_VARIABLE)) return 0;
+	pthread_rwlock_wrlock (&fctx->lock);
+	if (fctx->frozen) {
+		pthread_rwlock_unlock (&fctx->lock);
+		return 0;
+	}
+	AZPackedValue *pval;
+	if ((unsigned int) slot < fctx->base) {
+		/* Inherited variable, copy on write */
+		if (!fctx->overrides) {
+			fctx->overrides = (AZPackedValue *) malloc (fctx->base * sizeof (AZPackedValue));
+			memset (fctx->overrides, 0, fctx->base * sizeof (AZPackedValue));
+			fctx->overridden = (uint8_t *) malloc (fctx->base);
+			memset (fctx->overridden, 0, fctx->base);
+		}
+		fctx->overridden[slot] = 1;
+		pval = &fctx->overrides[slot];
+	} else {
+		pval = &fctx->values[slot - fctx->base];
+	}
+	/* Value may hold the last reference to the new value */
+	AZPackedValue prev = *pval;
+	pval->impl = NULL;
+	az_packed_value_copy (pval, value);
+	pthread_rwlock_unlock (&fctx->lock);
+	az_packed_value_clear (&prev);
+	return 1;
+}
+
+int
+azo_context_lookup_slot (AZOContext *ctx, AZString *key, unsigned int *flags)
+{
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	arikkei_return_val_if_fail (ctx != NULL, -1);
+	arikkei_return_val_if_fail (key != NULL, -1);
+	unsigned int id = azo_symbol_lookup (key);
+	int slot = -1;
+	pthread_rwlock_rdlock (&fctx->lock);
+	slot = context_find (fctx, id, flags);
+	pthread_rwlock_unlock (&fctx->lock);
+	return slot;
+}
+
+const AZImplementation *
+azo_context_get_slot_value (AZOContext *ctx, unsigned int slot, AZValue *val)
+{
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_rdlock (&fctx->lock);
+	AZPackedValue *pval = context_get_slot (fctx, slot);
+	const AZImplementation *impl = pval->impl;
+	if (impl) az_value_copy (impl, val, &pval->v);
+	pthread_rwlock_unlock (&fctx->lock);
+	return impl;
+}
+
+AZOInterpreter *
+azo_context_get_interpreter (AZOContext *ctx)
+{
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	AZOInterpreter *intr = NULL;
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	if ((thread_cache.ctx == ctx) && (thread_cache.serial == fctx->serial)) return thread_cache.intr;
+	pthread_t self = pthread_self ();
+	pthread_mutex_lock (&fctx->intr_lock);
+	for (unsigned int i = 0; i < fctx->n_intrs; i++) {
+		if (pthread_equal (fctx->intrs[i].thread, self)) {
+			intr = fctx->intrs[i].intr;
+			break;
+		}
+	}
+	unsigned int created = !intr;
+	if (!intr) {
+		if (fctx->n_intrs >= fctx->size_intrs) {
+			fctx->size_intrs = (fctx->size_intrs) ? fctx->size_intrs << 1 : 8;
+			fctx->intrs = (AZOThreadInterpreter *) realloc (fctx->intrs, fctx->size_intrs * sizeof (AZOThreadInterpreter));
+		}
+		intr = azo_interpreter_new (ctx);
+		fctx->intrs[fctx->n_intrs].thread = self;
+		fctx->intrs[fctx->n_intrs++].intr = intr;
+	}
+	pthread_mutex_unlock (&fctx->intr_lock);
+	if (created) thread_add_context (fctx);
+	thread_cache.ctx = ctx;
+	thread_cache.serial = fctx->serial;
+	thread_cache.intr = intr;
+	return intr;
+}
+
+void
+azo_context_set_module_loader (AZOContext *ctx, AZOModuleLoader loader, void *data)
+{
+	arikkei_return_if_fail (ctx != NULL);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_wrlock (&fctx->lock);
+	fctx->loader = loader;
+	fctx->loader_data = data;
+	pthread_rwlock_unlock (&fctx->lock);
+}
+
+AZOModuleLoader
+azo_context_get_module_loader (AZOContext *ctx, void **data)
+{
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_rdlock (&fctx->lock);
+	AZOContextFull *def = fctx;
+	while (def && !def->loader) def = def->parent;
+	AZOModuleLoader loader = (def) ? def->loader : NULL;
+	if (data) *data = (def) ? def->loader_data : NULL;
+	pthread_rwlock_unlock (&fctx->lock);
+	return loader;
+}
+
+/* Modules are identified by symbol id of name */
+static AZONamespace *
+context_find_module (AZOContextFull *fctx, unsigned int id)
+{
+	if (!id) return NULL;
+	while (fctx) {
+		for (unsigned int i = 0; i < fctx->n_modules; i++) {
+			if (fctx->modules[i].id == id) return fctx->modules[i].nspace;
+		}
+		fctx = fctx->parent;
+	}
+	return NULL;
+}
+
+AZONamespace *
+azo_context_lookup_module (AZOContext *ctx, AZString *name)
+{
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	arikkei_return_val_if_fail (name != NULL, NULL);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	pthread_rwlock_rdlock (&fctx->lock);
+	AZONamespace *nspace = context_find_module (fctx, azo_symbol_lookup (name));
+	pthread_rwlock_unlock (&fctx->lock);
+	return nspace;
+}
+
+unsigned int
+azo_context_add_module (AZOContext *ctx, AZString *name, AZONamespace *nspace, AZOProgram *prog)
+{
+	arikkei_return_val_if_fail (ctx != NULL, 0);
+	arikkei_return_val_if_fail (name != NULL, 0);
+	arikkei_return_val_if_fail (nspace != NULL, 0);
+	AZOContextFull *fctx = (AZOContextFull *) ctx;
+	unsigned int id = azo_symbol_intern (name);
+	unsigned int result = 0;
+	pthread_rwlock_wrlock (&fctx->lock);
+	if (!fctx->frozen && !context_find_module (fctx, id)) {
+		if (fctx->n_modules >= fctx->size_modules) {
+			fctx->size_modules = (fctx->size_modules) ? fctx->size_modules << 1 : 8;
+			fctx->modules = (AZOModule *) realloc (fctx->modules, fctx->size_modules * sizeof (AZOModule));
+		}
+		az_string_ref (name);
+		fctx->modules[fctx->n_modules].id = id;
+		fctx->modules[fctx->n_modules].name = name;
+		fctx->modules[fctx->n_modules].nspace = nspace;
+		fctx->modules[fctx->n_modules++].prog = prog;
+		result = 1;
+	}
+	pthread_rwlock_unlock (&fctx->lock);
+	return result;
 }
 
 void
@@ -209,6 +690,14 @@ azo_context_define_basic_types (AZOContext *ctx)
 	azo_context_define_class_by_str (ctx, (const unsigned char *) "array", AZ_TYPE_LIST);
 	azo_context_define_class_by_str (ctx, (const unsigned char *) "map", AZ_TYPE_MAP);
 	azo_context_define_class_by_str (ctx, (const unsigned char *) "ActiveObject", AZ_TYPE_ACTIVE_OBJECT);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "Generator", AZO_TYPE_GENERATOR);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "Exception", AZO_TYPE_EXCEPTION_OBJECT);
+	/* Numeric arrays */
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "Int32Array", AZO_TYPE_INT32_ARRAY);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "Uint32Array", AZO_TYPE_UINT32_ARRAY);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "Int64Array", AZO_TYPE_INT64_ARRAY);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "FloatArray", AZO_TYPE_FLOAT_ARRAY);
+	azo_context_define_class_by_str (ctx, (const unsigned char *) "DoubleArray", AZO_TYPE_DOUBLE_ARRAY);
 }
 
 unsigned int
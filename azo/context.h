@@ -12,9 +12,20 @@
 *
 * You should never redefine global variables as these are treated as final by optimizer
 *
+* Context can be used from several threads, each thread runs programs on its own interpreter
+* (azo_context_get_interpreter). Programs are immutable after compilation and shared. Compilation
+* and the first use of context (type registration) should happen on one thread.
+*
+* Fully initialized context can be frozen into snapshot and forked. Fork shares the definitions,
+* compiled programs and their constants of snapshot, defines new globals on top of it and keeps
+* its own copies of inherited variables that are changed with azo_context_set.
+*
 */
 
 typedef struct _AZOInterpreter AZOInterpreter;
+typedef struct _AZONamespace AZONamespace;
+typedef struct _AZOProgram AZOProgram;
+typedef struct _AZOSource AZOSource;
 
 #define AZO_TYPE_CONTEXT azo_context_get_type ()
 
@@ -23,22 +34,92 @@ typedef struct _AZOContextClass AZOContextClass;
 
 #include <az/types.h>
 
+/* Definition value can be changed with azo_context_set, compiled code reads it at run time */
+#define AZO_CONTEXT_VARIABLE 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct _AZOContext {
 	AZContext *az_ctx;
+	/* Interpreter of the thread that created context, NULL after that thread has exited */
 	AZOInterpreter *intr;
 };
 
 AZOContext *azo_context_new (void);
+/* Delete context, snapshot cannot be deleted before its forks */
 void azo_context_delete (AZOContext *ctx);
+
+/**
+ * @brief Freeze context into snapshot
+ *
+ * Snapshot cannot be changed anymore (define and set fail) so forks can read it without locking.
+ * Programs compiled in snapshot run unchanged in its forks.
+ */
+void azo_context_snapshot (AZOContext *ctx);
+unsigned int azo_context_is_snapshot (AZOContext *ctx);
+/**
+ * @brief Create a copy-on-write child of snapshot
+ *
+ * The fork starts with the definitions of snapshot without copying them, slots of inherited
+ * definitions stay the same. Cost does not depend on the size of snapshot.
+ *
+ * @param snapshot the snapshot (azo_context_snapshot)
+ * @return a new context or NULL if context is not snapshot
+ */
+AZOContext *azo_context_fork (AZOContext *snapshot);
+/* Test whether context is ancestor or the same context, code of ancestor can run in context */
+unsigned int azo_context_inherits (AZOContext *ctx, AZOContext *ancestor);
 unsigned int azo_context_define (AZOContext *ctx, AZString *key, const AZPackedValue *value);
 unsigned int azo_context_define_by_str (AZOContext *ctx, const unsigned char *key, const AZPackedValue *value);
 const AZImplementation *azo_context_lookup (AZOContext *ctx, AZString *key, AZValue *val, unsigned int size);
 const AZImplementation *azo_context_lookup_by_str (AZOContext *ctx, const uint8_t *key, AZValue *val, unsigned int size);
 
+/**
+ * @brief Define global whose value may change
+ *
+ * Final definitions are compiled into constants, variable definitions are read from their slot at run time.
+ */
+unsigned int azo_context_define_variable (AZOContext *ctx, AZString *key, const AZPackedValue *value);
+/* Replace the value of variable definition, returns 0 if key is not defined or definition is final */
+unsigned int azo_context_set (AZOContext *ctx, AZString *key, const AZPackedValue *value);
+/**
+ * @brief Get the slot of definition
+ *
+ * Slots are stable for the lifetime of context, so compiled code can refer to them directly.
+ *
+ * @return slot index or -1 if key is not defined
+ */
+int azo_context_lookup_slot (AZOContext *ctx, AZString *key, unsigned int *flags);
+/* Copy the value in slot to val, returns implementation */
+const AZImplementation *azo_context_get_slot_value (AZOContext *ctx, unsigned int slot, AZValue *val);
+
+/**
+ * @brief Get the interpreter of calling thread
+ *
+ * Interpreter is created on first use and stays alive until its thread exits or context is deleted.
+ */
+AZOInterpreter *azo_context_get_interpreter (AZOContext *ctx);
+
+/* Returns the source of module or NULL if it cannot be found */
+typedef AZOSource *(*AZOModuleLoader) (AZOContext *ctx, AZString *name, void *data);
+
+/* Set the loader used by import, NULL restores the default (azo_module_load_file) */
+void azo_context_set_module_loader (AZOContext *ctx, AZOModuleLoader loader, void *data);
+/* Get the loader of context or its snapshot, NULL if default */
+AZOModuleLoader azo_context_get_module_loader (AZOContext *ctx, void **data);
+/* Find compiled module in context or its snapshot */
+AZONamespace *azo_context_lookup_module (AZOContext *ctx, AZString *name);
+/**
+ * @brief Add compiled module to context
+ *
+ * Context takes ownership of namespace and program, they are released with context.
+ *
+ * @return 1 on success, 0 if name is already used or context is snapshot
+ */
+unsigned int azo_context_add_module (AZOContext *ctx, AZString *name, AZONamespace *nspace, AZOProgram *prog);
+
 void azo_context_define_basic_types (AZOContext *ctx);
 unsigned int azo_context_define_class_by_str (AZOContext *ctx, const unsigned char *key, unsigned int type);
 
@@ -0,0 +1,159 @@
+#define __AZO_CONTINUATION_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/packed-value.h>
+
+#include "continuation.h"
+#include "interpreter.h"
+#include "program.h"
+
+struct _AZOContinuation {
+	AZOCompiledFunction *func;
+	AZOInterpreter *intr;
+	unsigned int state;
+	/* Arguments until the function is started */
+	unsigned int n_args;
+	AZPackedValue *args;
+	const AZImplementation **arg_impls;
+	const AZValue **arg_vals;
+	AZPackedValue64 result;
+};
+
+static _Thread_local AZOContinuation *current_cont = NULL;
+
+static void
+clear_args (AZOContinuation *cont)
+{
+	for (unsigned int i = 0; i < cont->n_args; i++) az_packed_value_clear (&cont->args[i]);
+	free (cont->args);
+	cont->args = NULL;
+	cont->n_args = 0;
+}
+
+AZOContinuation *
+azo_continuation_new (AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[])
+{
+	arikkei_return_val_if_fail (func != NULL, NULL);
+	arikkei_return_val_if_fail (func->prog != NULL, NULL);
+	AZOContinuation *cont = (AZOContinuation *) malloc (sizeof (AZOContinuation));
+	memset (cont, 0, sizeof (AZOContinuation));
+	cont->func = func;
+	az_object_ref ((AZObject *) func);
+	cont->intr = azo_interpreter_new (func->ctx);
+	cont->intr->flags |= AZO_INTR_FLAG_SUSPEND;
+	cont->n_args = func->signature->n_args;
+	if (cont->n_args) {
+		/* Packed values and pointers to them in one block */
+		cont->args = (AZPackedValue *) malloc (cont->n_args * (sizeof (AZPackedValue) + sizeof (AZImplementation *) + sizeof (AZValue *)));
+		memset (cont->args, 0, cont->n_args * sizeof (AZPackedValue));
+		cont->arg_impls = (const AZImplementation **) (cont->args + cont->n_args);
+		cont->arg_vals = (const AZValue **) (cont->arg_impls + cont->n_args);
+		for (unsigned int i = 0; i < cont->n_args; i++) {
+			if (arg_impls[i]) az_packed_value_set_from_impl_value (&cont->args[i], arg_impls[i], arg_vals[i]);
+			cont->arg_impls[i] = cont->args[i].impl;
+			cont->arg_vals[i] = &cont->args[i].v;
+		}
+	}
+	return cont;
+}
+
+void
+azo_continuation_delete (AZOContinuation *cont)
+{
+	arikkei_return_if_fail (cont != NULL);
+	arikkei_return_if_fail (cont != current_cont);
+	/* Deleting interpreter aborts suspended run */
+	interpreter_delete (cont->intr);
+	clear_args (cont);
+	if (cont->result.impl) az_value_clear (cont->result.impl, &cont->result.v.value);
+	az_object_unref ((AZObject *) cont->func);
+	free (cont);
+}
+
+unsigned int
+azo_continuation_get_state (AZOContinuation *cont)
+{
+	arikkei_return_val_if_fail (cont != NULL, AZO_CONTINUATION_FINISHED);
+	return cont->state;
+}
+
+AZOInterpreter *
+azo_continuation_get_interpreter (AZOContinuation *cont)
+{
+	arikkei_return_val_if_fail (cont != NULL, NULL);
+	return cont->intr;
+}
+
+unsigned int
+azo_continuation_get_suspend_kind (AZOContinuation *cont)
+{
+	arikkei_return_val_if_fail (cont != NULL, AZO_INTR_SUSPEND_NONE);
+	return azo_interpreter_get_suspend_kind (cont->intr);
+}
+
+void
+azo_continuation_set_fuel (AZOContinuation *cont, uint64_t fuel)
+{
+	arikkei_return_if_fail (cont != NULL);
+	azo_interpreter_set_fuel (cont->intr, fuel);
+}
+
+unsigned int
+azo_continuation_resume (AZOContinuation *cont, const AZImplementation *impl, const AZValue *val)
+{
+	arikkei_return_val_if_fail (cont != NULL, 1);
+	arikkei_return_val_if_fail (cont->state != AZO_CONTINUATION_FINISHED, 1);
+	AZOContinuation *prev_cont = current_cont;
+	current_cont = cont;
+	if (cont->state == AZO_CONTINUATION_READY) {
+		cont->intr->closure = cont->func;
+		azo_program_interpret_call (cont->func->prog, cont->intr, cont->arg_impls, cont->arg_vals, cont->func->signature->n_args,
+			&cont->result.impl, &cont->result.v.value, 64);
+		cont->intr->closure = NULL;
+		/* Arguments were copied to the stack */
+		clear_args (cont);
+	} else {
+		azo_interpreter_resume (cont->intr, impl, val, &cont->result.impl, &cont->result.v.value, 64);
+	}
+	current_cont = prev_cont;
+	cont->state = (azo_interpreter_is_suspended (cont->intr)) ? AZO_CONTINUATION_SUSPENDED : AZO_CONTINUATION_FINISHED;
+	return cont->state == AZO_CONTINUATION_FINISHED;
+}
+
+AZOContinuation *
+azo_continuation_get_current (void)
+{
+	return current_cont;
+}
+
+unsigned int
+azo_continuation_request_suspend (AZOContinuation *cont)
+{
+	arikkei_return_val_if_fail (cont != NULL, 0);
+	return azo_interpreter_request_suspend (cont->intr);
+}
+
+const AZImplementation *
+azo_continuation_get_yielded (AZOContinuation *cont, AZValue *val, unsigned int size)
+{
+	arikkei_return_val_if_fail (cont != NULL, NULL);
+	return azo_interpreter_get_yielded (cont->intr, val, size);
+}
+
+const AZImplementation *
+azo_continuation_get_result (AZOContinuation *cont, AZValue *val, unsigned int size)
+{
+	arikkei_return_val_if_fail (cont != NULL, NULL);
+	if (!cont->result.impl) return NULL;
+	return az_value_copy_autobox (cont->result.impl, val, &cont->result.v.value, size);
+}
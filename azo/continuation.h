@@ -0,0 +1,99 @@
+#ifndef __AZO_CONTINUATION_H__
+#define __AZO_CONTINUATION_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+typedef struct _AZOContinuation AZOContinuation;
+
+#include <stdint.h>
+
+#include <az/value.h>
+
+#include <azo/compiled-function.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Continuation
+ *
+ * Invocation of compiled function that can be suspended and resumed later. Every continuation owns
+ * an interpreter, so the whole execution state (program, ipc, call records, frames and value stack)
+ * stays in it while suspended and no thread is occupied.
+ *
+ * Function is suspended by yield statement, by host function that calls azo_continuation_request_suspend
+ * and by exhausted fuel. Suspended continuation can be resumed from any thread, but only by one
+ * thread at a time.
+ */
+
+enum {
+	/* Not started yet */
+	AZO_CONTINUATION_READY,
+	AZO_CONTINUATION_SUSPENDED,
+	AZO_CONTINUATION_FINISHED
+};
+
+/**
+ * @brief Create a new continuation
+ *
+ * Arguments are copied, the number of arguments is taken from the function signature. The function
+ * does not start before the first azo_continuation_resume.
+ *
+ * @param func the function to invoke
+ * @param arg_impls the argument implementations
+ * @param arg_vals the argument values
+ * @return a new continuation or NULL if function is not compiled
+ */
+AZOContinuation *azo_continuation_new (AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[]);
+/* Discard the continuation, suspended execution is aborted */
+void azo_continuation_delete (AZOContinuation *cont);
+
+unsigned int azo_continuation_get_state (AZOContinuation *cont);
+/* The interpreter that runs the function, owned by continuation */
+AZOInterpreter *azo_continuation_get_interpreter (AZOContinuation *cont);
+/* The reason of suspension (AZO_INTR_SUSPEND_*) */
+unsigned int azo_continuation_get_suspend_kind (AZOContinuation *cont);
+/* Set remaining fuel, continuation that exhausts it is suspended */
+void azo_continuation_set_fuel (AZOContinuation *cont, uint64_t fuel);
+
+/**
+ * @brief Run until the next suspension or the end of function
+ *
+ * The first call starts the function. If the function was suspended by host function, the value
+ * becomes the result of that call, otherwise it is ignored.
+ *
+ * @param cont the continuation
+ * @param impl the implementation of resume value or NULL
+ * @param val the resume value
+ * @return 1 if the function finished, 0 if it was suspended
+ */
+unsigned int azo_continuation_resume (AZOContinuation *cont, const AZImplementation *impl, const AZValue *val);
+
+/* The continuation that is running in calling thread or NULL */
+AZOContinuation *azo_continuation_get_current (void);
+/**
+ * @brief Suspend running continuation after the current host function returns
+ *
+ * Called by host function that wants to finish its work asynchronously and later resume the
+ * continuation with the result.
+ *
+ * @param cont the continuation (azo_continuation_get_current)
+ * @return 1 if the continuation will be suspended, 0 if it cannot be (host function is invoked by nested run)
+ */
+unsigned int azo_continuation_request_suspend (AZOContinuation *cont);
+
+/* Take the value of the last yield statement, values that do not fit are autoboxed */
+const AZImplementation *azo_continuation_get_yielded (AZOContinuation *cont, AZValue *val, unsigned int size);
+/* Get the return value of finished function, NULL if it threw an exception or returned nothing */
+const AZImplementation *azo_continuation_get_result (AZOContinuation *cont, AZValue *val, unsigned int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,13 +6,19 @@
 * Copyright (C) Lauris Kaplinski 2018
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <arikkei/arikkei-strlib.h>
+#include <arikkei/arikkei-utils.h>
+#include <az/class.h>
+#include <az/field.h>
 #include <az/extend.h>
+#include <az/string.h>
 
 #include "exception.h"
+#include "program.h"
 
 static void exception_class_init (AZOExceptionClass *klass);
 /* AZClass implementation */
@@ -50,7 +56,9 @@ static const char *excnames[] = {
 	"NULL dereference",
 	"Out of bounds",
 	"Invalid property",
-	"Invalid value"
+	"Invalid value",
+	"Out of fuel",
+	"Cannot suspend"
 };
 
 unsigned int
@@ -73,3 +81,155 @@ azo_exception_clear (AZOException *exc)
 {
 	memset (exc, 0, sizeof (AZOException));
 }
+
+static void exception_object_class_init (AZOExceptionObjectClass *klass);
+static void exception_object_finalize (AZOExceptionObjectClass *klass, AZOExceptionObject *obj);
+static unsigned int exception_object_to_string (const AZImplementation* impl, void *inst, unsigned char *buf, unsigned int len);
+
+enum {
+	PROP_TYPE,
+	NUM_PROPERTIES
+};
+
+static unsigned int exception_object_type = 0;
+
+unsigned int
+azo_exception_object_get_type (void)
+{
+	if (!exception_object_type) {
+		az_register_type (&exception_object_type, (const unsigned char *) "AZOExceptionObject", AZ_TYPE_OBJECT, sizeof (AZOExceptionObjectClass), sizeof (AZOExceptionObject), 0, 0, NUM_PROPERTIES,
+			(void (*) (AZClass *)) exception_object_class_init,
+			NULL,
+			(void (*) (const AZImplementation *, void *)) exception_object_finalize);
+	}
+	return exception_object_type;
+}
+
+static void
+exception_object_class_init (AZOExceptionObjectClass *klass)
+{
+	((AZClass *) klass)->to_string = exception_object_to_string;
+	az_class_define_property ((AZClass *) klass, PROP_TYPE, (const unsigned char *) "type", AZ_TYPE_UINT32, 0,
+		AZ_FIELD_INSTANCE, AZ_FIELD_READ_VALUE, AZ_FIELD_WRITE_NONE, ARIKKEI_OFFSET(AZOExceptionObject,exc.type), NULL, NULL);
+}
+
+static void
+exception_object_finalize (AZOExceptionObjectClass *klass, AZOExceptionObject *obj)
+{
+	for (unsigned int i = 0; i < obj->n_frames; i++) {
+		if (obj->frames[i].func) az_object_unref ((AZObject *) obj->frames[i].func);
+		if (obj->frames[i].src) azo_source_unref (obj->frames[i].src);
+	}
+	free (obj->frames);
+}
+
+static unsigned int
+exception_object_to_string (const AZImplementation* impl, void *inst, unsigned char *buf, unsigned int len)
+{
+	AZOExceptionObject *obj = (AZOExceptionObject *) inst;
+	return arikkei_strncpy (buf, len, (const unsigned char *) excnames[obj->exc.type]);
+}
+
+AZOExceptionObject *
+azo_exception_object_new (const AZOException *exc, unsigned int n_frames)
+{
+	AZOExceptionObject *obj = (AZOExceptionObject *) az_object_new (AZO_TYPE_EXCEPTION_OBJECT);
+	obj->exc = *exc;
+	obj->n_frames = n_frames;
+	obj->frames = NULL;
+	if (n_frames) {
+		obj->frames = (AZOTraceFrame *) malloc (n_frames * sizeof (AZOTraceFrame));
+		memset (obj->frames, 0, n_frames * sizeof (AZOTraceFrame));
+	}
+	return obj;
+}
+
+void
+azo_exception_object_set_frame (AZOExceptionObject *obj, unsigned int idx, struct _AZOCompiledFunction *func, const struct _AZOProgram *prog, const uint8_t *ipc)
+{
+	arikkei_return_if_fail (obj != NULL);
+	arikkei_return_if_fail (idx < obj->n_frames);
+	AZOTraceFrame *frame = &obj->frames[idx];
+	if (func) az_object_ref ((AZObject *) func);
+	if (frame->func) az_object_unref ((AZObject *) frame->func);
+	if (frame->src) azo_source_unref (frame->src);
+	frame->func = func;
+	frame->prog = prog;
+	frame->pos = (unsigned int) (ipc - prog->tcode);
+	frame->src = NULL;
+	if (!func) {
+		/* Program may be deleted before exception */
+		const AZODebugInfo *dbg = &prog->debug;
+		if (dbg->terms && (frame->pos < dbg->n_terms) && dbg->src) {
+			frame->src = dbg->src;
+			azo_source_ref (frame->src);
+			frame->line = dbg->terms[frame->pos].line;
+			frame->start = dbg->terms[frame->pos].term.start;
+			frame->end = dbg->terms[frame->pos].term.end;
+		}
+		frame->prog = NULL;
+	}
+}
+
+unsigned int
+azo_exception_object_get_location (AZOExceptionObject *obj, unsigned int idx, AZOSource **src, unsigned int *line, unsigned int *start, unsigned int *end)
+{
+	arikkei_return_val_if_fail (obj != NULL, 0);
+	arikkei_return_val_if_fail (idx < obj->n_frames, 0);
+	const AZOTraceFrame *frame = &obj->frames[idx];
+	if (!frame->prog) {
+		if (!frame->src) return 0;
+		if (src) *src = frame->src;
+		if (line) *line = frame->line;
+		if (start) *start = frame->start;
+		if (end) *end = frame->end;
+		return 1;
+	}
+	const AZODebugInfo *dbg = &frame->prog->debug;
+	if (!dbg->terms || (frame->pos >= dbg->n_terms)) return 0;
+	if (src) *src = dbg->src;
+	if (line) *line = dbg->terms[frame->pos].line;
+	if (start) *start = dbg->terms[frame->pos].term.start;
+	if (end) *end = dbg->terms[frame->pos].term.end;
+	return 1;
+}
+
+unsigned int
+azo_exception_object_get_source_line (AZOExceptionObject *obj, unsigned int idx, unsigned char *buf, unsigned int len)
+{
+	AZOSource *src;
+	unsigned int line;
+	if (!azo_exception_object_get_location (obj, idx, &src, &line, NULL, NULL)) return 0;
+	azo_source_ensure_lines (src);
+	if (line >= src->n_lines) return 0;
+	unsigned int line_len = azo_source_get_line_len (src, line);
+	if (len) {
+		unsigned int n = (line_len < (len - 1)) ? line_len : len - 1;
+		memcpy (buf, src->cdata + src->lines[line], n);
+		buf[n] = 0;
+	}
+	return line_len;
+}
+
+/* Append formatted text, p is the full length so far */
+#define APPEND(fmt, ...) p += snprintf ((char *) buf + ((p < len) ? p : len), (p < len) ? len - p : 0, fmt, __VA_ARGS__)
+
+unsigned int
+azo_exception_object_format (AZOExceptionObject *obj, unsigned char *buf, unsigned int len)
+{
+	arikkei_return_val_if_fail (obj != NULL, 0);
+	unsigned int p = 0;
+	APPEND ("%s\n", excnames[obj->exc.type]);
+	for (unsigned int i = 0; i < obj->n_frames; i++) {
+		AZOSource *src;
+		unsigned int line;
+		if (azo_exception_object_get_location (obj, i, &src, &line, NULL, NULL)) {
+			unsigned char b[256];
+			azo_exception_object_get_source_line (obj, i, b, 256);
+			APPEND ("  at %s:%u: %s\n", (src->name) ? (const char *) src->name->str : "unnamed", line + 1, b);
+		} else {
+			APPEND ("  at %04X\n", obj->frames[i].pos);
+		}
+	}
+	return p;
+}
@@ -11,6 +11,16 @@
 
 typedef struct _AZOException AZOException;
 typedef struct _AZOExceptionClass AZOExceptionClass;
+typedef struct _AZOTraceFrame AZOTraceFrame;
+typedef struct _AZOExceptionObject AZOExceptionObject;
+typedef struct _AZOExceptionObjectClass AZOExceptionObjectClass;
+
+#define AZO_TYPE_EXCEPTION_OBJECT azo_exception_object_get_type ()
+
+#include <stdint.h>
+
+#include <az/object.h>
+#include <azo/source.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +56,10 @@ extern AZOExceptionClass *azo_exception_class;
 #define AZO_EXCEPTION_INVALID_PROPERTY 9
 /* Cannot write value */
 #define AZO_EXCEPTION_INVALID_VALUE 10
+/* Fuel of interpreter is exhausted */
+#define AZO_EXCEPTION_OUT_OF_FUEL 11
+/* Yield inside run that cannot be suspended */
+#define AZO_EXCEPTION_CANNOT_SUSPEND 12
 
 struct _AZOException {
 	unsigned int type;
@@ -63,6 +77,66 @@ unsigned int azo_exception_get_type (void);
 void azo_exception_set (AZOException *exc, unsigned int type, unsigned int mask, const uint8_t *ipc);
 void azo_exception_clear (AZOException *exc);
 
+/*
+ * Exception object
+ *
+ * Thrown exception together with the chain of inline calls at the time of throw. For functions only
+ * program and instruction position are recorded, source locations are looked up from program debug
+ * info when requested. Toplevel program is not owned by anything that exception can reference, so its
+ * location is resolved immediately. Scripts get it as the value of catch variable, hosts from
+ * azo_interpreter_take_exception.
+ */
+
+struct _AZOTraceFrame {
+	/* Running function, referenced (NULL for toplevel program) */
+	struct _AZOCompiledFunction *func;
+	/* Program of function, NULL for toplevel program */
+	const struct _AZOProgram *prog;
+	/* Instruction position in bytecode */
+	unsigned int pos;
+	/* Resolved location of toplevel program, src is referenced (NULL if there is no debug info) */
+	AZOSource *src;
+	unsigned int line;
+	unsigned int start;
+	unsigned int end;
+};
+
+struct _AZOExceptionObject {
+	AZObject object;
+	AZOException exc;
+	/* The throwing frame first */
+	unsigned int n_frames;
+	AZOTraceFrame *frames;
+};
+
+struct _AZOExceptionObjectClass {
+	AZObjectClass object_class;
+};
+
+unsigned int azo_exception_object_get_type (void);
+
+/* Create new exception object with n_frames empty frames */
+AZOExceptionObject *azo_exception_object_new (const AZOException *exc, unsigned int n_frames);
+/* Set frame, function is referenced and ipc has to point into program bytecode, toplevel location is resolved */
+void azo_exception_object_set_frame (AZOExceptionObject *obj, unsigned int idx, struct _AZOCompiledFunction *func, const struct _AZOProgram *prog, const uint8_t *ipc);
+
+/**
+ * @brief Find the source location of trace frame
+ *
+ * @param obj the exception object
+ * @param idx the frame index
+ * @param src the source or NULL
+ * @param line the line (from 0) or NULL
+ * @param start the start of expression in source or NULL
+ * @param end the end of expression in source or NULL
+ * @return 1 if location was found, 0 if program has no debug info
+ */
+unsigned int azo_exception_object_get_location (AZOExceptionObject *obj, unsigned int idx, AZOSource **src, unsigned int *line, unsigned int *start, unsigned int *end);
+/* Copy the source line of trace frame to buffer, return the length of line or 0 if not available */
+unsigned int azo_exception_object_get_source_line (AZOExceptionObject *obj, unsigned int idx, unsigned char *buf, unsigned int len);
+/* Write exception name and one line per frame to buffer, return the full length of text */
+unsigned int azo_exception_object_format (AZOExceptionObject *obj, unsigned char *buf, unsigned int len);
+
 #ifdef __cplusplus
 }
 #endif
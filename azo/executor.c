@@ -0,0 +1,461 @@
+#define __AZO_EXECUTOR_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/packed-value.h>
+
+#include "executor.h"
+#include "interpreter.h"
+#include "program.h"
+
+typedef struct _AZOWorker AZOWorker;
+
+struct _AZOJob {
+	atomic_uint refcount;
+	AZOCompiledFunction *func;
+	/* Function is referenced by submit and released through executor */
+	unsigned int pinned;
+	unsigned int n_args;
+	AZPackedValue *args;
+	const AZImplementation **arg_impls;
+	const AZValue **arg_vals;
+	AZOJobCallback callback;
+	void *data;
+	AZPackedValue64 result;
+	/* Uncaught exception of function or NULL */
+	AZOExceptionObject *exc;
+	/* Batch chunk, arg_vals point to the first row of columns */
+	unsigned int n_rows;
+	const AZImplementation **ret_impls;
+	AZValue *ret_vals;
+	/* Guards done */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int done;
+};
+
+/* Worker thread and its job queue (ring buffer, owner uses the end, thieves the start) */
+struct _AZOWorker {
+	AZOExecutor *exec;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	unsigned int size;
+	unsigned int first;
+	unsigned int length;
+	AZOJob **jobs;
+};
+
+struct _AZOExecutor {
+	AZOContext *ctx;
+	unsigned int n_workers;
+	AZOWorker *workers;
+	/* Round-robin position for outside submissions */
+	atomic_uint next;
+	/* The number of jobs in all queues */
+	atomic_uint n_queued;
+	/* Idle workers wait on cond */
+	atomic_uint n_sleeping;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int shutdown;
+	/* Fuel given to every job */
+	_Atomic uint64_t job_fuel;
+	/*
+	 * Functions of finished submitted jobs (guarded by lock)
+	 * Workers only append here, references are dropped by the next submit or batch from a thread that
+	 * is not a worker and by azo_executor_delete
+	 */
+	unsigned int n_released;
+	unsigned int size_released;
+	AZOCompiledFunction **released;
+};
+
+/* Worker running in this thread */
+static _Thread_local AZOWorker *current_worker = NULL;
+
+static void
+job_free (AZOJob *job)
+{
+	for (unsigned int i = 0; i < job->n_args; i++) az_packed_value_clear (&job->args[i]);
+	free (job->args);
+	if (job->result.impl) az_value_clear (job->result.impl, &job->result.v.value);
+	if (job->exc) az_object_unref ((AZObject *) job->exc);
+	pthread_cond_destroy (&job->cond);
+	pthread_mutex_destroy (&job->lock);
+	free (job);
+}
+
+static void
+worker_push (AZOWorker *worker, AZOJob *job)
+{
+	pthread_mutex_lock (&worker->lock);
+	if (worker->length >= worker->size) {
+		unsigned int new_size = (worker->size) ? worker->size << 1 : 64;
+		AZOJob **jobs = (AZOJob **) malloc (new_size * sizeof (AZOJob *));
+		for (unsigned int i = 0; i < worker->length; i++) {
+			jobs[i] = worker->jobs[(worker->first + i) % worker->size];
+		}
+		free (worker->jobs);
+		worker->jobs = jobs;
+		worker->size = new_size;
+		worker->first = 0;
+	}
+	worker->jobs[(worker->first + worker->length) % worker->size] = job;
+	worker->length += 1;
+	pthread_mutex_unlock (&worker->lock);
+}
+
+/* Newest job, used by owner */
+static AZOJob *
+worker_pop (AZOWorker *worker)
+{
+	AZOJob *job = NULL;
+	pthread_mutex_lock (&worker->lock);
+	if (worker->length) {
+		worker->length -= 1;
+		job = worker->jobs[(worker->first + worker->length) % worker->size];
+	}
+	pthread_mutex_unlock (&worker->lock);
+	return job;
+}
+
+/* Oldest job, used by thieves */
+static AZOJob *
+worker_steal (AZOWorker *worker)
+{
+	AZOJob *job = NULL;
+	pthread_mutex_lock (&worker->lock);
+	if (worker->length) {
+		job = worker->jobs[worker->first];
+		worker->first = (worker->first + 1) % worker->size;
+		worker->length -= 1;
+	}
+	pthread_mutex_unlock (&worker->lock);
+	return job;
+}
+
+static AZOJob *
+worker_take (AZOWorker *worker)
+{
+	AZOExecutor *exec = worker->exec;
+	AZOJob *job = worker_pop (worker);
+	if (!job) {
+		unsigned int self = (unsigned int) (worker - exec->workers);
+		for (unsigned int i = 1; i < exec->n_workers; i++) {
+			job = worker_steal (&exec->workers[(self + i) % exec->n_workers]);
+			if (job) break;
+		}
+	}
+	if (job) atomic_fetch_sub (&exec->n_queued, 1);
+	return job;
+}
+
+static void
+worker_run_job (AZOExecutor *exec, AZOInterpreter *intr, AZOJob *job)
+{
+	AZOCompiledFunction *cfunc = job->func;
+	AZOCompiledFunction *prev_closure = intr->closure;
+	/* Drop the exception left by previous job */
+	AZOExceptionObject *stale = azo_interpreter_take_exception (intr);
+	if (stale) az_object_unref ((AZObject *) stale);
+	azo_interpreter_set_fuel (intr, atomic_load (&exec->job_fuel));
+	intr->closure = cfunc;
+	if (job->n_rows) {
+		azo_program_interpret_batch (cfunc->prog, intr, job->n_rows, job->n_args, job->arg_impls, job->arg_vals, job->ret_impls, job->ret_vals);
+	} else {
+		azo_program_interpret_call (cfunc->prog, intr, job->arg_impls, job->arg_vals, job->n_args, &job->result.impl, &job->result.v.value, 64);
+	}
+	intr->closure = prev_closure;
+	job->exc = azo_interpreter_take_exception (intr);
+	if (job->callback) job->callback (job, job->data);
+	if (job->pinned) {
+		pthread_mutex_lock (&exec->lock);
+		if (exec->n_released >= exec->size_released) {
+			exec->size_released = (exec->size_released) ? exec->size_released << 1 : 8;
+			exec->released = (AZOCompiledFunction **) realloc (exec->released, exec->size_released * sizeof (AZOCompiledFunction *));
+		}
+		exec->released[exec->n_released++] = cfunc;
+		pthread_mutex_unlock (&exec->lock);
+	}
+	pthread_mutex_lock (&job->lock);
+	job->done = 1;
+	pthread_cond_broadcast (&job->cond);
+	pthread_mutex_unlock (&job->lock);
+	/* Drop the reference of executor */
+	azo_job_unref (job);
+}
+
+static void *
+worker_main (void *data)
+{
+	AZOWorker *worker = (AZOWorker *) data;
+	AZOExecutor *exec = worker->exec;
+	current_worker = worker;
+	AZOInterpreter *intr = azo_context_get_interpreter (exec->ctx);
+	for (;;) {
+		AZOJob *job = worker_take (worker);
+		if (job) {
+			worker_run_job (exec, intr, job);
+			continue;
+		}
+		unsigned int stop;
+		pthread_mutex_lock (&exec->lock);
+		atomic_fetch_add (&exec->n_sleeping, 1);
+		while (!atomic_load (&exec->n_queued) && !exec->shutdown) {
+			pthread_cond_wait (&exec->cond, &exec->lock);
+		}
+		atomic_fetch_sub (&exec->n_sleeping, 1);
+		stop = exec->shutdown && !atomic_load (&exec->n_queued);
+		pthread_mutex_unlock (&exec->lock);
+		if (stop) break;
+	}
+	current_worker = NULL;
+	return NULL;
+}
+
+AZOExecutor *
+azo_executor_new (AZOContext *ctx, unsigned int n_threads)
+{
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	if (!n_threads) {
+		long n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+		n_threads = (n_cpus > 0) ? (unsigned int) n_cpus : 1;
+	}
+	AZOExecutor *exec = (AZOExecutor *) malloc (sizeof (AZOExecutor));
+	memset (exec, 0, sizeof (AZOExecutor));
+	exec->ctx = ctx;
+	atomic_init (&exec->job_fuel, AZO_INTR_UNLIMITED_FUEL);
+	pthread_mutex_init (&exec->lock, NULL);
+	pthread_cond_init (&exec->cond, NULL);
+	exec->workers = (AZOWorker *) malloc (n_threads * sizeof (AZOWorker));
+	memset (exec->workers, 0, n_threads * sizeof (AZOWorker));
+	for (unsigned int i = 0; i < n_threads; i++) {
+		exec->workers[i].exec = exec;
+		pthread_mutex_init (&exec->workers[i].lock, NULL);
+	}
+	/* Queues have to exist before any worker can steal */
+	for (unsigned int i = 0; i < n_threads; i++) {
+		if (pthread_create (&exec->workers[i].thread, NULL, worker_main, &exec->workers[i])) break;
+		exec->n_workers += 1;
+	}
+	if (!exec->n_workers) {
+		azo_executor_delete (exec);
+		return NULL;
+	}
+	return exec;
+}
+
+void
+azo_executor_delete (AZOExecutor *exec)
+{
+	arikkei_return_if_fail (exec != NULL);
+	arikkei_return_if_fail (!current_worker || (current_worker->exec != exec));
+	pthread_mutex_lock (&exec->lock);
+	exec->shutdown = 1;
+	pthread_cond_broadcast (&exec->cond);
+	pthread_mutex_unlock (&exec->lock);
+	for (unsigned int i = 0; i < exec->n_workers; i++) {
+		pthread_join (exec->workers[i].thread, NULL);
+	}
+	/* Workers exit only when all queues are empty */
+	for (unsigned int i = 0; i < exec->n_workers; i++) {
+		pthread_mutex_destroy (&exec->workers[i].lock);
+		free (exec->workers[i].jobs);
+	}
+	free (exec->workers);
+	for (unsigned int i = 0; i < exec->n_released; i++) az_object_unref ((AZObject *) exec->released[i]);
+	free (exec->released);
+	pthread_cond_destroy (&exec->cond);
+	pthread_mutex_destroy (&exec->lock);
+	free (exec);
+}
+
+unsigned int
+azo_executor_get_n_threads (AZOExecutor *exec)
+{
+	arikkei_return_val_if_fail (exec != NULL, 0);
+	return exec->n_workers;
+}
+
+static AZOJob *
+job_new (AZOCompiledFunction *func, AZOJobCallback callback, void *data)
+{
+	unsigned int n_args = func->signature->n_args;
+	AZOJob *job = (AZOJob *) malloc (sizeof (AZOJob));
+	memset (job, 0, sizeof (AZOJob));
+	/* One for caller, one for executor */
+	atomic_init (&job->refcount, 2);
+	/* Not referenced, object refcounts are not atomic and job may be released by worker */
+	job->func = func;
+	job->n_args = n_args;
+	if (n_args) {
+		/* Packed values and pointers to them in one block */
+		job->args = (AZPackedValue *) malloc (n_args * (sizeof (AZPackedValue) + sizeof (AZImplementation *) + sizeof (AZValue *)));
+		memset (job->args, 0, n_args * sizeof (AZPackedValue));
+		job->arg_impls = (const AZImplementation **) (job->args + n_args);
+		job->arg_vals = (const AZValue **) (job->arg_impls + n_args);
+	}
+	job->callback = callback;
+	job->data = data;
+	pthread_mutex_init (&job->lock, NULL);
+	pthread_cond_init (&job->cond, NULL);
+	return job;
+}
+
+/* Drop the references to functions of finished jobs, object refcounts are not atomic so workers never do it */
+static void
+executor_release (AZOExecutor *exec)
+{
+	if (current_worker && (current_worker->exec == exec)) return;
+	pthread_mutex_lock (&exec->lock);
+	unsigned int n_released = exec->n_released;
+	AZOCompiledFunction **released = exec->released;
+	exec->n_released = 0;
+	exec->size_released = 0;
+	exec->released = NULL;
+	pthread_mutex_unlock (&exec->lock);
+	/* Unreferencing may run finalizers, so not under lock */
+	for (unsigned int i = 0; i < n_released; i++) az_object_unref ((AZObject *) released[i]);
+	free (released);
+}
+
+static void
+executor_queue (AZOExecutor *exec, AZOJob *job)
+{
+	AZOWorker *worker = current_worker;
+	if (!worker || (worker->exec != exec)) {
+		worker = &exec->workers[atomic_fetch_add (&exec->next, 1) % exec->n_workers];
+	}
+	worker_push (worker, job);
+	atomic_fetch_add (&exec->n_queued, 1);
+	if (atomic_load (&exec->n_sleeping)) {
+		pthread_mutex_lock (&exec->lock);
+		pthread_cond_signal (&exec->cond);
+		pthread_mutex_unlock (&exec->lock);
+	}
+}
+
+void
+azo_executor_set_job_fuel (AZOExecutor *exec, uint64_t fuel)
+{
+	arikkei_return_if_fail (exec != NULL);
+	atomic_store (&exec->job_fuel, fuel);
+}
+
+AZOJob *
+azo_executor_submit (AZOExecutor *exec, AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[], AZOJobCallback callback, void *data)
+{
+	arikkei_return_val_if_fail (exec != NULL, NULL);
+	arikkei_return_val_if_fail (func != NULL, NULL);
+	arikkei_return_val_if_fail (azo_context_inherits (exec->ctx, func->ctx), NULL);
+	executor_release (exec);
+	AZOJob *job = job_new (func, callback, data);
+	/* Held until the job is finished */
+	az_object_ref ((AZObject *) func);
+	job->pinned = 1;
+	for (unsigned int i = 0; i < job->n_args; i++) {
+		if (arg_impls[i]) az_packed_value_set_from_impl_value (&job->args[i], arg_impls[i], arg_vals[i]);
+		job->arg_impls[i] = job->args[i].impl;
+		job->arg_vals[i] = &job->args[i].v;
+	}
+	executor_queue (exec, job);
+	return job;
+}
+
+void
+azo_executor_run_batch (AZOExecutor *exec, AZOCompiledFunction *func, unsigned int n_rows, const AZImplementation *col_impls[], const AZValue *col_vals[], const AZImplementation *ret_impls[], AZValue ret_vals[])
+{
+	arikkei_return_if_fail (exec != NULL);
+	arikkei_return_if_fail (func != NULL);
+	arikkei_return_if_fail (azo_context_inherits (exec->ctx, func->ctx));
+	/* Waiting inside worker could leave nobody to run the chunks */
+	arikkei_return_if_fail (!current_worker || (current_worker->exec != exec));
+	if (!n_rows) return;
+	executor_release (exec);
+	/* Caller holds func until all chunks are done */
+	unsigned int n_chunks = (n_rows < exec->n_workers) ? n_rows : exec->n_workers;
+	AZOJob **jobs = (AZOJob **) malloc (n_chunks * sizeof (AZOJob *));
+	unsigned int first = 0;
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		AZOJob *job = job_new (func, NULL, NULL);
+		/* Spread remainder over the first chunks */
+		job->n_rows = n_rows / n_chunks + ((i < (n_rows % n_chunks)) ? 1 : 0);
+		for (unsigned int j = 0; j < job->n_args; j++) {
+			job->arg_impls[j] = col_impls[j];
+			job->arg_vals[j] = col_vals[j] + first;
+		}
+		job->ret_impls = (ret_impls) ? ret_impls + first : NULL;
+		job->ret_vals = (ret_vals) ? ret_vals + first : NULL;
+		first += job->n_rows;
+		jobs[i] = job;
+		executor_queue (exec, job);
+	}
+	for (unsigned int i = 0; i < n_chunks; i++) {
+		azo_job_wait (jobs[i]);
+		azo_job_unref (jobs[i]);
+	}
+	free (jobs);
+}
+
+void
+azo_job_ref (AZOJob *job)
+{
+	arikkei_return_if_fail (job != NULL);
+	atomic_fetch_add (&job->refcount, 1);
+}
+
+void
+azo_job_unref (AZOJob *job)
+{
+	arikkei_return_if_fail (job != NULL);
+	if (atomic_fetch_sub (&job->refcount, 1) == 1) job_free (job);
+}
+
+unsigned int
+azo_job_is_done (AZOJob *job)
+{
+	unsigned int done;
+	arikkei_return_val_if_fail (job != NULL, 0);
+	pthread_mutex_lock (&job->lock);
+	done = job->done;
+	pthread_mutex_unlock (&job->lock);
+	return done;
+}
+
+void
+azo_job_wait (AZOJob *job)
+{
+	arikkei_return_if_fail (job != NULL);
+	pthread_mutex_lock (&job->lock);
+	while (!job->done) pthread_cond_wait (&job->cond, &job->lock);
+	pthread_mutex_unlock (&job->lock);
+}
+
+const AZImplementation *
+azo_job_get_result (AZOJob *job, AZValue *val, unsigned int size)
+{
+	arikkei_return_val_if_fail (job != NULL, NULL);
+	azo_job_wait (job);
+	if (!job->result.impl) return NULL;
+	return az_value_copy_autobox (job->result.impl, val, &job->result.v.value, size);
+}
+
+AZOExceptionObject *
+azo_job_get_exception (AZOJob *job)
+{
+	arikkei_return_val_if_fail (job != NULL, NULL);
+	azo_job_wait (job);
+	return job->exc;
+}
@@ -0,0 +1,116 @@
+#ifndef __AZO_EXECUTOR_H__
+#define __AZO_EXECUTOR_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+typedef struct _AZOExecutor AZOExecutor;
+typedef struct _AZOJob AZOJob;
+
+#include <az/value.h>
+
+#include <azo/compiled-function.h>
+#include <azo/context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Executor
+ *
+ * Runs compiled functions of one context on a pool of worker threads. Every worker has its own
+ * interpreter (azo_context_get_interpreter) and a double-ended job queue. A worker takes its newest
+ * job first and, if its own queue is empty, steals the oldest job of another worker.
+ *
+ * Jobs submitted from outside of the pool are distributed round-robin, jobs submitted by a worker
+ * (e.g. from completion callback) are queued to that worker.
+ */
+
+/* Called by worker thread after the result is set and before waiters are woken */
+typedef void (*AZOJobCallback) (AZOJob *job, void *data);
+
+/**
+ * @brief Create new executor
+ *
+ * @param ctx the context of functions that will be run
+ * @param n_threads the number of worker threads, 0 uses the number of online processors
+ * @return a new executor
+ */
+AZOExecutor *azo_executor_new (AZOContext *ctx, unsigned int n_threads);
+/* Finish all queued jobs, stop the workers and release executor */
+void azo_executor_delete (AZOExecutor *exec);
+
+unsigned int azo_executor_get_n_threads (AZOExecutor *exec);
+/**
+ * @brief Limit the fuel of jobs
+ *
+ * Every job (or batch chunk) starts with given fuel, job that exhausts it throws AZO_EXCEPTION_OUT_OF_FUEL
+ * and gets NULL result. Default is AZO_INTR_UNLIMITED_FUEL.
+ */
+void azo_executor_set_job_fuel (AZOExecutor *exec, uint64_t fuel);
+
+/**
+ * @brief Queue compiled function for execution
+ *
+ * Arguments are copied and function is referenced by executor until the job is finished. Workers never
+ * touch the refcount of function, so it can be shared with other threads. The reference of finished job
+ * is dropped by the next submit or batch from a thread that is not a worker, or by azo_executor_delete. The number of arguments is taken
+ * from the function signature. The returned job has one reference that belongs to caller.
+ *
+ * @param exec the executor
+ * @param func the function to invoke
+ * @param arg_impls the argument implementations
+ * @param arg_vals the argument values
+ * @param callback completion callback or NULL
+ * @param data user data of callback
+ * @return a new job
+ */
+AZOJob *azo_executor_submit (AZOExecutor *exec, AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[], AZOJobCallback callback, void *data);
+
+/**
+ * @brief Invoke function once per row of argument columns, splitting rows between workers
+ *
+ * Every worker runs a contiguous range of rows with azo_program_interpret_batch. Blocks until
+ * all rows are done, so it must not be called from a worker of the same executor. Columns are not
+ * copied and must stay unchanged during the call.
+ *
+ * @param exec the executor
+ * @param func the function to invoke
+ * @param n_rows the number of rows
+ * @param col_impls the implementations of argument columns
+ * @param col_vals the argument columns (n_rows values each)
+ * @param ret_impls the result implementations (n_rows) or NULL if results are not needed
+ * @param ret_vals the result values (n_rows)
+ */
+void azo_executor_run_batch (AZOExecutor *exec, AZOCompiledFunction *func, unsigned int n_rows, const AZImplementation *col_impls[], const AZValue *col_vals[], const AZImplementation *ret_impls[], AZValue ret_vals[]);
+
+void azo_job_ref (AZOJob *job);
+void azo_job_unref (AZOJob *job);
+
+/* Test whether job is finished, never blocks */
+unsigned int azo_job_is_done (AZOJob *job);
+/* Block until job is finished */
+void azo_job_wait (AZOJob *job);
+/**
+ * @brief Get the return value of job
+ *
+ * Waits until job is finished. Function that threw an exception or returned nothing has NULL result.
+ *
+ * @param job the job
+ * @param val the destination value
+ * @param size the size of destination, values that do not fit are autoboxed
+ * @return the implementation of result
+ */
+const AZImplementation *azo_job_get_result (AZOJob *job, AZValue *val, unsigned int size);
+/* Wait until job is finished and get its uncaught exception (valid while job is referenced) or NULL */
+AZOExceptionObject *azo_job_get_exception (AZOJob *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -175,6 +175,15 @@ azo_print_expression (AZOExpression *expr, FILE *ofs, unsigned int indent, unsig
 			}
 			fprintf (ofs, "\n");
 			break;
+		case AZO_KEYWORD_TRY:
+			fprintf (ofs, "try ");
+			azo_print_expression (expr->children, ofs, indent, level);
+			fprintf (ofs, " catch (");
+			azo_print_expression (expr->children->next, ofs, indent, level);
+			fprintf (ofs, ") ");
+			azo_print_expression (expr->children->next->next, ofs, indent, level);
+			fprintf (ofs, "\n");
+			break;
 		default:
 			azo_print_keyword (expr->term.subtype, ofs);
 			/*azo_print_expression_list (expr->children, ofs, " ");
@@ -182,6 +191,15 @@ azo_print_expression (AZOExpression *expr, FILE *ofs, unsigned int indent, unsig
 			break;
 		}
 		break;
+	case AZO_EXPRESSION_FOREACH:
+		fprintf (ofs, "for (");
+		azo_print_expression (expr->children, ofs, indent, level);
+		fprintf (ofs, " : ");
+		azo_print_expression (expr->children->next, ofs, indent, level);
+		fprintf (ofs, ") ");
+		azo_print_expression (expr->children->next->next, ofs, indent, level);
+		fprintf (ofs, "\n");
+		break;
 	case EXPRESSION_DECLARATION:
 		azo_print_expression (expr->children, ofs, indent, level);
 		if (expr->children->next) {
@@ -368,8 +386,28 @@ print_sentence (AZOExpression *expr, FILE *ofs, unsigned int indent, unsigned in
 			}
 			fprintf (ofs, "\n");
 			break;
+		case AZO_KEYWORD_TRY:
+			if (indent) print_indent (ofs, level);
+			fprintf (ofs, "try ");
+			azo_print_expression (expr->children, ofs, 0, level);
+			fprintf (ofs, " catch (");
+			azo_print_expression (expr->children->next, ofs, 0, level);
+			fprintf (ofs, ") ");
+			azo_print_expression (expr->children->next->next, ofs, 0, level);
+			fprintf (ofs, "\n");
+			break;
 		}
 		break;
+	case AZO_EXPRESSION_FOREACH:
+		if (indent) print_indent (ofs, level);
+		fprintf (ofs, "for (");
+		azo_print_expression (expr->children, ofs, 0, level);
+		fprintf (ofs, " : ");
+		azo_print_expression (expr->children->next, ofs, 0, level);
+		fprintf (ofs, ") ");
+		azo_print_expression (expr->children->next->next, ofs, 0, level);
+		fprintf (ofs, "\n");
+		break;
 	default:
 		print_line (expr, ofs, 0, level);
 		break;
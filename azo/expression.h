@@ -36,6 +36,8 @@ enum {
 	AZO_EXPRESSION_BLOCK,
 	/* Keywords */
 	EXPRESSION_KEYWORD,
+	/* DECLARATION_LIST, COLLECTION, STATEMENT */
+	AZO_EXPRESSION_FOREACH,
 	/* TYPE DECLARATION[...]*/
 	EXPRESSION_DECLARATION_LIST,
 	/* NAME [= VALUE] */
@@ -92,7 +94,23 @@ enum {
 /* Variable subtypes */
 enum {
 	VARIABLE_PARENT,
-	VARIABLE_LOCAL
+	VARIABLE_LOCAL,
+	/* Variable definition in global context, var_pos is slot */
+	VARIABLE_GLOBAL
+};
+
+/* Array element subtypes */
+enum {
+	ARRAY_ELEMENT_GENERIC,
+	/* Index is counter of loop that is proven to stay below loop bound */
+	ARRAY_ELEMENT_BOUNDED
+};
+
+/* Literal array subtypes */
+enum {
+	ARRAY_LITERAL_GENERIC,
+	/* All elements are constant, the only child is constant array that is copied at runtime */
+	ARRAY_LITERAL_COPY
 };
 
 /* Function subtypes */
@@ -199,10 +217,12 @@ struct _AZOExpression {
 	union {
 		/* Function frame */
 		AZOFrame *frame;
-		/* Variable location */
+		/* Variable location (foreach declaration list: the position of collection, catch clause: stack size at handler) */
 		unsigned int var_pos;
 		/* Size of scope */
 		unsigned int scope_size;
+		/* Loop of bounded array element */
+		const AZOExpression *loop;
 	};
 
 	/* Optimizer */
@@ -0,0 +1,83 @@
+#define __AZO_GENERATOR_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/extend.h>
+
+#include "generator.h"
+#include "interpreter.h"
+
+static void generator_finalize (AZOGeneratorClass *klass, AZOGenerator *gen);
+
+static unsigned int generator_type = 0;
+
+unsigned int
+azo_generator_get_type (void)
+{
+	if (!generator_type) {
+		az_register_type (&generator_type, (const unsigned char *) "AZOGenerator", AZ_TYPE_OBJECT, sizeof (AZOGeneratorClass), sizeof (AZOGenerator), 0, 0, 0,
+			NULL, NULL,
+			(void (*) (const AZImplementation *, void *)) generator_finalize);
+	}
+	return generator_type;
+}
+
+static void
+generator_finalize (AZOGeneratorClass *klass, AZOGenerator *gen)
+{
+	if (gen->cont) azo_continuation_delete (gen->cont);
+}
+
+AZOGenerator *
+azo_generator_new (AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[])
+{
+	arikkei_return_val_if_fail (func != NULL, NULL);
+	AZOContinuation *cont = azo_continuation_new (func, arg_impls, arg_vals);
+	if (!cont) return NULL;
+	/* Host functions cannot suspend generator, only yield and exhausted fuel */
+	azo_continuation_get_interpreter (cont)->flags |= AZO_INTR_FLAG_YIELD_ONLY;
+	AZOGenerator *gen = (AZOGenerator *) az_object_new (AZO_TYPE_GENERATOR);
+	gen->cont = cont;
+	return gen;
+}
+
+unsigned int
+azo_generator_next (AZOGenerator *gen, uint64_t *fuel, const AZImplementation **impl, AZValue *val, unsigned int size)
+{
+	arikkei_return_val_if_fail (gen != NULL, AZO_GENERATOR_FINISHED);
+	arikkei_return_val_if_fail (!gen->running, AZO_GENERATOR_FINISHED);
+	*impl = NULL;
+	if (azo_continuation_get_state (gen->cont) == AZO_CONTINUATION_FINISHED) return AZO_GENERATOR_FINISHED;
+	AZOInterpreter *intr = azo_continuation_get_interpreter (gen->cont);
+	azo_interpreter_set_fuel (intr, (fuel) ? *fuel : AZO_INTR_UNLIMITED_FUEL);
+	/* Keep generator alive if the body releases the last reference */
+	az_object_ref ((AZObject *) gen);
+	gen->running = 1;
+	unsigned int finished = azo_continuation_resume (gen->cont, NULL, NULL);
+	gen->running = 0;
+	if (fuel) *fuel = intr->fuel;
+	unsigned int result = AZO_GENERATOR_FINISHED;
+	if (finished) {
+		if (intr->uncaught) result = AZO_GENERATOR_EXCEPTION;
+	} else if (azo_continuation_get_suspend_kind (gen->cont) == AZO_INTR_SUSPEND_YIELD) {
+		*impl = azo_continuation_get_yielded (gen->cont, val, size);
+		result = AZO_GENERATOR_YIELDED;
+	} else if (azo_continuation_get_suspend_kind (gen->cont) == AZO_INTR_SUSPEND_FUEL) {
+		result = AZO_GENERATOR_OUT_OF_FUEL;
+	}
+	az_object_unref ((AZObject *) gen);
+	return result;
+}
+
+AZOExceptionObject *
+azo_generator_take_exception (AZOGenerator *gen)
+{
+	arikkei_return_val_if_fail (gen != NULL, NULL);
+	return azo_interpreter_take_exception (azo_continuation_get_interpreter (gen->cont));
+}
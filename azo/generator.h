@@ -0,0 +1,80 @@
+#ifndef __AZO_GENERATOR_H__
+#define __AZO_GENERATOR_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+typedef struct _AZOGenerator AZOGenerator;
+typedef struct _AZOGeneratorClass AZOGeneratorClass;
+
+#define AZO_TYPE_GENERATOR azo_generator_get_type ()
+
+#include <az/object.h>
+
+#include <azo/compiled-function.h>
+#include <azo/continuation.h>
+#include <azo/exception.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Generator
+ *
+ * The value of invoking a function that contains yield statement. The function body runs in its own
+ * continuation, every azo_generator_next resumes it until the next yield or the end of function.
+ * Generators are iterated by foreach statement.
+ *
+ * The body runs on the fuel of iterating interpreter. If the fuel is exhausted, the body stays suspended
+ * and continues from the same place on the next azo_generator_next.
+ */
+
+/* Result of azo_generator_next */
+enum {
+	AZO_GENERATOR_FINISHED,
+	AZO_GENERATOR_YIELDED,
+	/* Body ran out of fuel and can be continued */
+	AZO_GENERATOR_OUT_OF_FUEL,
+	/* Body threw an exception (azo_generator_take_exception) and is finished */
+	AZO_GENERATOR_EXCEPTION
+};
+
+struct _AZOGenerator {
+	AZObject object;
+	AZOContinuation *cont;
+	/* Guards against generator that iterates itself */
+	unsigned int running;
+};
+
+struct _AZOGeneratorClass {
+	AZObjectClass object_class;
+};
+
+unsigned int azo_generator_get_type (void);
+
+/* Create new generator, the arguments are copied and the function body does not start before the first value is requested */
+AZOGenerator *azo_generator_new (AZOCompiledFunction *func, const AZImplementation *arg_impls[], const AZValue *arg_vals[]);
+
+/**
+ * @brief Run generator until the next yielded value
+ *
+ * @param gen the generator
+ * @param fuel the fuel of caller, the amount used by body is subtracted, NULL for unlimited
+ * @param impl the implementation of the yielded value
+ * @param val the destination of the yielded value
+ * @param size the size of destination, values that do not fit are autoboxed
+ * @return AZO_GENERATOR_YIELDED if a value was yielded, otherwise the reason why not
+ */
+unsigned int azo_generator_next (AZOGenerator *gen, uint64_t *fuel, const AZImplementation **impl, AZValue *val, unsigned int size);
+/* Take the uncaught exception of generator body (caller owns the reference) or NULL */
+AZOExceptionObject *azo_generator_take_exception (AZOGenerator *gen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
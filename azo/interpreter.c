@@ -7,6 +7,7 @@
 */
 
 #define DEBUG_COMP 1
+#define noDEBUG_EXCEPTIONS
 
 #include <assert.h>
 #include <math.h>
@@ -16,6 +17,7 @@
 #include <stdio.h>
 
 #include <arikkei/arikkei-iolib.h>
+#include <arikkei/arikkei-utils.h>
 #include <arikkei/arikkei-strlib.h>
 
 #include <az/classes/active-object.h>
@@ -32,7 +34,10 @@
 
 #include <azo/bytecode.h>
 #include <azo/compiled-function.h>
+#include <azo/generator.h>
 #include <azo/private.h>
+#include <azo/simd.h>
+#include <azo/typed-array.h>
 
 #include <azo/interpreter.h>
 
@@ -52,6 +57,7 @@ azo_interpreter_new (AZOContext *ctx)
 	az_instance_init_by_type (&intr->exc, AZO_TYPE_EXCEPTION);
 
 	intr->flags = AZO_INTR_FLAG_CHECK_ARGS;
+	intr->fuel = AZO_INTR_UNLIMITED_FUEL;
 
 	return intr;
 }
@@ -59,8 +65,12 @@ azo_interpreter_new (AZOContext *ctx)
 void
 interpreter_delete (AZOInterpreter *intr)
 {
+	if (intr->susp_prog) azo_interpreter_abort (intr);
+	if (intr->yielded.impl) az_value_clear (intr->yielded.impl, &intr->yielded.v.value);
+	if (intr->uncaught) az_object_unref ((AZObject *) intr->uncaught);
 	az_instance_finalize_by_type (&intr->stack, AZO_TYPE_STACK);
 	az_instance_finalize_by_type (&intr->exc, AZO_TYPE_EXCEPTION);
+	if (intr->calls) free (intr->calls);
 	free (intr->frames);
 	free (intr);
 }
@@ -463,7 +473,19 @@ interpret_PUSH_VALUE (AZOInterpreter *intr, AZOProgram *prog, const unsigned cha
 	uint32_t loc;
 	memcpy (&loc, ip + 1, 4);
 	TEST_OVERFLOW(1);
-	azo_stack_push_value (&intr->stack, prog->values[loc].impl, &prog->values[loc].v);
+	/* Constants are shared by all threads running the program */
+	azo_stack_push_value_borrowed (&intr->stack, prog->values[loc].impl, &prog->values[loc].v);
+	return ip + 5;
+}
+
+static const unsigned char *
+interpret_PUSH_ENV_VALUE (AZOInterpreter *intr, const unsigned char *ip)
+{
+	uint32_t pos;
+	memcpy (&pos, ip + 1, 4);
+	TEST(intr->closure && (pos < intr->closure->n_env), AZO_EXCEPTION_INVALID_VALUE);
+	TEST_OVERFLOW(1);
+	azo_stack_push_value_borrowed (&intr->stack, intr->closure->env[pos].impl, &intr->closure->env[pos].v);
 	return ip + 5;
 }
 
@@ -579,11 +601,23 @@ interpret_TYPE_OF (AZOInterpreter *intr, const unsigned char *ip)
 	return ip + 2;
 }
 
+/* Take one unit of fuel, return 0 if it is exhausted */
+static inline unsigned int
+consume_fuel (AZOInterpreter *intr)
+{
+	if (!intr->fuel) return 0;
+	if (intr->fuel != AZO_INTR_UNLIMITED_FUEL) intr->fuel -= 1;
+	return 1;
+}
+
+/* Backward jumps consume fuel, the jump is repeated after resume */
+
 static const unsigned char *
 interpret_JMP_32 (AZOInterpreter *intr, const unsigned char *ip)
 {
 	int32_t raddr;
 	memcpy (&raddr, ip + 1, 4);
+	if ((raddr < 0) && !consume_fuel (intr)) EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_FUEL);
 	return ip + 5 + raddr;
 }
 
@@ -591,33 +625,35 @@ static const unsigned char *
 interpret_JMP_32_COND (AZOInterpreter *intr, const unsigned char *ip)
 {
 	int raddr;
-	const unsigned char *dst;
+	unsigned int taken = 0;
 	memcpy (&raddr, ip + 1, 4);
-	dst = ip + 5;
 	switch (ip[0] & 0x7f) {
 	case JMP_32_IF:
 		CHECK_TYPE_EXACT(0, AZ_TYPE_BOOLEAN);
-		if (azo_stack_boolean_bw(&intr->stack, 0)) dst += raddr;
+		taken = azo_stack_boolean_bw(&intr->stack, 0) != 0;
 		break;
 	case JMP_32_IF_NOT:
 		CHECK_TYPE_EXACT(0, AZ_TYPE_BOOLEAN);
-		if (!azo_stack_boolean_bw(&intr->stack, 0)) dst += raddr;
+		taken = !azo_stack_boolean_bw(&intr->stack, 0);
 		break;
 	case JMP_32_IF_ZERO:
 		CHECK_TYPE_EXACT(0, AZ_TYPE_INT32);
-		if (azo_stack_int32_bw(&intr->stack, 0) == 0) dst += raddr;
+		taken = azo_stack_int32_bw(&intr->stack, 0) == 0;
 		break;
 	case JMP_32_IF_POSITIVE:
 		CHECK_TYPE_EXACT(0, AZ_TYPE_INT32);
-		if (azo_stack_int32_bw(&intr->stack, 0) > 0) dst += raddr;
+		taken = azo_stack_int32_bw(&intr->stack, 0) > 0;
 		break;
 	case JMP_32_IF_NEGATIVE:
 		CHECK_TYPE_EXACT(0, AZ_TYPE_INT32);
-		if (azo_stack_int32_bw(&intr->stack, 0) < 0) dst += raddr;
+		taken = azo_stack_int32_bw(&intr->stack, 0) < 0;
 		break;
 	}
+	if (!taken) raddr = 0;
+	/* Condition stays on stack if jump is repeated after resume */
+	if ((raddr < 0) && !consume_fuel (intr)) EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_FUEL);
 	azo_stack_pop (&intr->stack, 1);
-	return dst;
+	return ip + 5 + raddr;
 }
 
 static const unsigned char *
@@ -1298,11 +1334,18 @@ interpret_GET_INTERFACE_IMMEDIATE (AZOInterpreter *intr, const unsigned char *ip
  * [func : this, arg1...]
  * [func : this, arg1..., result]
  */
+static inline unsigned int
+can_suspend (AZOInterpreter *intr)
+{
+	return (intr->flags & AZO_INTR_FLAG_SUSPEND) && (intr->run_depth == 1);
+}
+
 static const unsigned char *
 interpret_INVOKE (AZOInterpreter *intr, const unsigned char *ip)
 {
 	unsigned int pos = ip[1];
 	CHECK_UNDERFLOW(1);
+	if (!consume_fuel (intr)) EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_FUEL);
 	AZFunctionInstance *func_inst;
 	const AZFunctionImplementation *func_impl = (const AZFunctionImplementation *) az_instance_get_interface (azo_stack_impl_bw (&intr->stack, pos), azo_stack_instance_bw (&intr->stack, pos), AZ_TYPE_FUNCTION, (void **) &func_inst);
 	if (!func_impl) {
@@ -1315,9 +1358,19 @@ interpret_INVOKE (AZOInterpreter *intr, const unsigned char *ip)
 		}
 	}
 	intr->vals[0].impl = NULL;
+	/* Only toplevel run handles requests, nested runs leave them to it */
+	unsigned int toplevel = can_suspend (intr);
+	if (toplevel) intr->susp_request = 0;
 	az_function_invoke (func_impl, func_inst, azo_stack_impls_bw (&intr->stack, sig->n_args - 1), (const AZValue **) azo_stack_values_bw (&intr->stack, sig->n_args - 1), &intr->vals[0].impl, &intr->vals[0].v, NULL);
 	azo_stack_push_value_transfer (&intr->stack, intr->vals[0].impl, &intr->vals[0].v);
 	intr->vals[0].impl = NULL;
+	if (toplevel && intr->susp_request) {
+		/* Host function wants to finish the call later */
+		intr->susp_request = 0;
+		intr->susp_kind = AZO_INTR_SUSPEND_HOST;
+		intr->susp_ipc = ip + 2;
+		return NULL;
+	}
 	return ip + 2;
 }
 
@@ -1335,17 +1388,99 @@ interpret_RETURN_VALUE (AZOInterpreter *intr, const unsigned char *ip)
 	return NULL;
 }
 
+/*
+ * YIELD
+ *
+ * [value]
+ * []
+ */
 static const unsigned char *
-interpret_BIND (AZOInterpreter *intr, const unsigned char *ip)
+interpret_YIELD (AZOInterpreter *intr, const unsigned char *ip)
+{
+	CHECK_UNDERFLOW(1);
+	if (!can_suspend (intr)) EXCEPTION_THROW(AZO_EXCEPTION_CANNOT_SUSPEND);
+	if (intr->yielded.impl) az_value_clear (intr->yielded.impl, &intr->yielded.v.value);
+	intr->yielded.impl = az_value_copy_autobox(azo_stack_impl_bw(&intr->stack, 0), &intr->yielded.v.value, azo_stack_value_bw(&intr->stack, 0), 64);
+	azo_stack_pop (&intr->stack, 1);
+	intr->susp_kind = AZO_INTR_SUSPEND_YIELD;
+	intr->susp_ipc = ip + 1;
+	return NULL;
+}
+
+/*
+ * ITERATE U32:POS
+ *
+ * [...collection, index...]
+ * [...collection, index + 1..., element, true] | [...collection, index..., false]
+ */
+static const unsigned char *
+interpret_ITERATE (AZOInterpreter *intr, const unsigned char *ip)
 {
 	uint32_t pos;
 	memcpy (&pos, ip + 1, 4);
-	CHECK_TYPE_EXACT(pos, AZO_TYPE_COMPILED_FUNCTION);
-	AZOCompiledFunction *cfunc = (AZOCompiledFunction *) azo_stack_instance_bw (&intr->stack, pos);
-	for (unsigned int i = 0; i < pos; i++) {
-		azo_compiled_function_bind (cfunc, i, azo_stack_impl_bw (&intr->stack, pos - 1 - i), azo_stack_instance_bw (&intr->stack, pos - 1 - i));
+	pos += intr->frames[intr->n_frames - 1];
+	CHECK((pos + 1) < intr->stack.length, AZO_EXCEPTION_STACK_UNDERFLOW);
+	const AZImplementation *impl = azo_stack_impl (&intr->stack, pos);
+	void *inst = azo_stack_instance (&intr->stack, pos);
+	unsigned int result;
+	AZPackedValue64 val = { 0 };
+	if (!impl) EXCEPTION_THROW(AZO_EXCEPTION_NULL_DEREFERENCE);
+	if (AZ_IMPL_TYPE(impl) == AZO_TYPE_GENERATOR) {
+		AZOGenerator *gen = (AZOGenerator *) inst;
+		TEST(!gen->running, AZO_EXCEPTION_INVALID_VALUE);
+		/* Body spends our fuel */
+		result = azo_generator_next (gen, (intr->fuel != AZO_INTR_UNLIMITED_FUEL) ? &intr->fuel : NULL, &val.impl, &val.v.value, 64);
+		if (result == AZO_GENERATOR_OUT_OF_FUEL) {
+			/* Generator stays suspended, so ITERATE can be repeated after resume */
+			EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_FUEL);
+		} else if (result == AZO_GENERATOR_EXCEPTION) {
+			/* Rethrow in our frame, so that it can be caught around foreach */
+			AZOExceptionObject *exc = azo_generator_take_exception (gen);
+			unsigned int type = exc->exc.type;
+			az_object_unref ((AZObject *) exc);
+			EXCEPTION_THROW(type);
+		}
+	} else {
+		AZListImplementation *list_impl;
+		void *list_inst;
+		list_impl = (AZListImplementation *) az_instance_get_interface (impl, inst, AZ_TYPE_LIST, (void **) &list_inst);
+		if (!list_impl) EXCEPTION_THROW(AZO_EXCEPTION_INVALID_TYPE);
+		CHECK(azo_stack_type (&intr->stack, pos + 1) == AZ_TYPE_UINT32, AZO_EXCEPTION_INVALID_TYPE);
+		uint32_t *idx = (uint32_t *) azo_stack_value (&intr->stack, pos + 1);
+		result = *idx < az_collection_get_size (&list_impl->collection_impl, list_inst);
+		if (result) {
+			val.impl = az_list_get_element (list_impl, list_inst, *idx, &val.v.value, 64);
+			/* Pushing may reallocate stack */
+			*idx += 1;
+		}
 	}
-	if (pos) azo_stack_pop (&intr->stack, pos);
+	if (result) azo_stack_push_value_transfer (&intr->stack, val.impl, &val.v);
+	azo_stack_push_value (&intr->stack, AZ_IMPL_FROM_TYPE(AZ_TYPE_BOOLEAN), &result);
+	return ip + 5;
+}
+
+/*
+ * MAKE_CLOSURE N_VALUES
+ *
+ * [func, val1, ..., valn]
+ * [closure]
+ */
+static const unsigned char *
+interpret_MAKE_CLOSURE (AZOInterpreter *intr, const unsigned char *ip)
+{
+	uint32_t n_values;
+	memcpy (&n_values, ip + 1, 4);
+	CHECK_UNDERFLOW(n_values + 1);
+	CHECK_TYPE_EXACT(n_values, AZO_TYPE_COMPILED_FUNCTION);
+	AZOCompiledFunction *cfunc = (AZOCompiledFunction *) azo_stack_instance_bw (&intr->stack, n_values);
+	TEST(!cfunc->proto, AZO_EXCEPTION_INVALID_VALUE);
+	AZOCompiledFunction *closure = azo_compiled_function_new_closure (cfunc, n_values);
+	for (unsigned int i = 0; i < n_values; i++) {
+		azo_compiled_function_bind (closure, i, azo_stack_impl_bw (&intr->stack, n_values - 1 - i), azo_stack_instance_bw (&intr->stack, n_values - 1 - i));
+	}
+	azo_stack_pop (&intr->stack, n_values + 1);
+	azo_stack_push_instance (&intr->stack, (const AZImplementation *) closure->object.klass, closure);
+	az_object_unref ((AZObject *) closure);
 	return ip + 5;
 }
 
@@ -1371,9 +1506,37 @@ interpret_NEW_ARRAY (AZOInterpreter *intr, const unsigned char *ip)
 	return ip + 1;
 }
 
+/* Array, index - element is read without list interface */
+
+static const unsigned char *
+load_typed_array_element (AZOInterpreter *intr, const uint8_t *ip, unsigned int check)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) azo_stack_instance_bw (&intr->stack, 1);
+	unsigned int idx;
+	AZValue val;
+	if (check) {
+		if (!convert_to_u32 (intr, &idx, azo_stack_impl_bw (&intr->stack, 0), azo_stack_value_bw (&intr->stack, 0), ip)) {
+			return NULL;
+		}
+		if (idx >= tarray->length) {
+			azo_exception_set (&intr->exc, AZO_EXCEPTION_OUT_OF_BOUNDS, 1UL << AZO_EXCEPTION_OUT_OF_BOUNDS, ip);
+			return NULL;
+		}
+	} else {
+		idx = *((unsigned int *) azo_stack_value_bw (&intr->stack, 0));
+	}
+	const AZImplementation *impl = azo_typed_array_get_element (tarray, idx, &val);
+	azo_stack_pop (&intr->stack, 1);
+	azo_stack_push_value (&intr->stack, impl, &val);
+	return ip + 1;
+}
+
 static const unsigned char *
 interpret_LOAD_ARRAY_ELEMENT (AZOInterpreter *intr, const uint8_t *ip)
 {
+	if (az_type_is_a (azo_stack_type_bw (&intr->stack, 1), AZO_TYPE_TYPED_ARRAY)) {
+		return load_typed_array_element (intr, ip, *ip & AZO_TC_CHECK_ARGS);
+	}
 	AZListImplementation *list_impl;
 	void *list_inst;
 	unsigned int idx;
@@ -1415,12 +1578,39 @@ interpret_LOAD_ARRAY_ELEMENT (AZOInterpreter *intr, const uint8_t *ip)
 	return ip + 1;
 }
 
+/* Array, index, value - element is stored unboxed */
+
+static const unsigned char *
+write_typed_array_element (AZOInterpreter *intr, const uint8_t *ip)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) azo_stack_instance_bw (&intr->stack, 2);
+	unsigned int idx;
+	if (!convert_to_u32 (intr, &idx, azo_stack_impl_bw (&intr->stack, 1), azo_stack_value_bw (&intr->stack, 1), ip)) {
+		return NULL;
+	}
+	if (idx >= tarray->length) {
+		azo_exception_set (&intr->exc, AZO_EXCEPTION_OUT_OF_BOUNDS, 1UL << AZO_EXCEPTION_OUT_OF_BOUNDS, ip);
+		return NULL;
+	}
+	if (!azo_typed_array_set_element (tarray, idx, azo_stack_impl_bw (&intr->stack, 0), (const AZValue *) azo_stack_value_bw (&intr->stack, 0))) {
+		azo_exception_set (&intr->exc, AZO_EXCEPTION_INVALID_CONVERSION, 1UL << AZO_EXCEPTION_INVALID_CONVERSION, ip);
+		return NULL;
+	}
+	azo_stack_pop (&intr->stack, 2);
+	return ip + 1;
+}
+
 static const unsigned char *
 interpret_WRITE_ARRAY_ELEMENT (AZOInterpreter *intr, const uint8_t *ip)
 {
 	AZValueArrayRef *varray;
 	unsigned int idx;
 	AZPackedValue val = { 0 };
+	if (azo_stack_type_bw (&intr->stack, 2) != AZ_TYPE_VALUE_ARRAY_REF) {
+		if (az_type_is_a (azo_stack_type_bw (&intr->stack, 2), AZO_TYPE_TYPED_ARRAY)) {
+			return write_typed_array_element (intr, ip);
+		}
+	}
 	if (*ip & AZO_TC_CHECK_ARGS) {
 		if (!az_type_is_a (azo_stack_type_bw (&intr->stack, 2), AZ_TYPE_VALUE_ARRAY_REF)) {
 			azo_exception_set (&intr->exc, AZO_EXCEPTION_INVALID_TYPE, 1UL << AZO_EXCEPTION_INVALID_TYPE, ip);
@@ -1446,6 +1636,258 @@ interpret_WRITE_ARRAY_ELEMENT (AZOInterpreter *intr, const uint8_t *ip)
 	return ip + 1;
 }
 
+static const unsigned char *
+interpret_LOAD_ARRAY_ELEMENT_U32_NOCHECK (AZOInterpreter *intr, const uint8_t *ip)
+{
+	AZListImplementation *list_impl;
+	void *list_inst;
+	unsigned int idx;
+	AZPackedValue64 val = { 0 };
+	if (az_type_is_a (azo_stack_type_bw (&intr->stack, 1), AZO_TYPE_TYPED_ARRAY)) {
+		return load_typed_array_element (intr, ip, 0);
+	}
+	/* Compiler has verified both the list interface and index before loop */
+	list_impl = (AZListImplementation *) az_instance_get_interface (azo_stack_impl_bw (&intr->stack, 1), azo_stack_instance_bw (&intr->stack, 1), AZ_TYPE_LIST, (void **) &list_inst);
+	idx = *((unsigned int *) azo_stack_value_bw (&intr->stack, 0));
+	val.impl = az_list_get_element (list_impl, list_inst, idx, &val.v.value, 64);
+	azo_stack_pop (&intr->stack, 1);
+	azo_stack_push_value_transfer (&intr->stack, val.impl, &val.v);
+	return ip + 1;
+}
+
+static const unsigned char *
+interpret_TEST_ARRAY_SIZE (AZOInterpreter *intr, const uint8_t *ip)
+{
+	AZListImplementation *list_impl = NULL;
+	void *list_inst;
+	unsigned int result = 0;
+	const AZImplementation *obj_impl = azo_stack_impl_bw (&intr->stack, 1);
+	const AZImplementation *bound_impl = azo_stack_impl_bw (&intr->stack, 0);
+	if (obj_impl) {
+		list_impl = (AZListImplementation *) az_instance_get_interface (obj_impl, azo_stack_instance_bw (&intr->stack, 1), AZ_TYPE_LIST, (void **) &list_inst);
+	}
+	if (list_impl && bound_impl) {
+		unsigned int size = az_collection_get_size (&list_impl->collection_impl, list_inst);
+		if (AZ_IMPL_TYPE(bound_impl) == AZ_TYPE_INT32) {
+			/* Negative bound means that loop is never entered */
+			int32_t bound = *((int32_t *) azo_stack_value_bw (&intr->stack, 0));
+			result = (bound < 0) || ((uint32_t) bound <= size);
+		} else if (AZ_IMPL_TYPE(bound_impl) == AZ_TYPE_UINT32) {
+			result = *((uint32_t *) azo_stack_value_bw (&intr->stack, 0)) <= size;
+		}
+	}
+	azo_stack_pop (&intr->stack, 2);
+	azo_stack_push_value (&intr->stack, AZ_IMPL_FROM_TYPE(AZ_TYPE_BOOLEAN), &result);
+	return ip + 1;
+}
+
+/* Literal arrays are shared by program, so nested arrays are copied too */
+
+static AZValueArrayRef *
+copy_value_array (AZClass *varray_class, AZValueArrayRef *src)
+{
+	AZListImplementation *list_impl;
+	void *list_inst;
+	list_impl = (AZListImplementation *) az_instance_get_interface (&varray_class->impl, src, AZ_TYPE_LIST, (void **) &list_inst);
+	unsigned int size = az_collection_get_size (&list_impl->collection_impl, list_inst);
+	AZValueArrayRef *dst = az_value_array_ref_new (size);
+	for (unsigned int i = 0; i < size; i++) {
+		AZPackedValue64 val = { 0 };
+		val.impl = az_list_get_element (list_impl, list_inst, i, &val.v.value, 64);
+		if (val.impl && (AZ_IMPL_TYPE(val.impl) == AZ_TYPE_VALUE_ARRAY_REF)) {
+			AZValueArrayRef *child = copy_value_array (varray_class, (AZValueArrayRef *) val.v.value.reference);
+			az_value_array_ref_set_element (dst, i, &varray_class->impl, (AZValue *) &child);
+			az_reference_unref ((AZReferenceClass *) varray_class, &child->reference);
+		} else {
+			az_value_array_ref_set_element (dst, i, val.impl, &val.v.value);
+		}
+		az_packed_value_clear ((AZPackedValue *) &val);
+	}
+	return dst;
+}
+
+static const unsigned char *
+interpret_COPY_ARRAY (AZOInterpreter *intr, const unsigned char *ip)
+{
+	CHECK_UNDERFLOW(1);
+	AZValueArrayRef *varray;
+	AZClass *varray_class;
+	if (azo_stack_type_bw (&intr->stack, 0) != AZ_TYPE_VALUE_ARRAY_REF) {
+		azo_exception_set (&intr->exc, AZO_EXCEPTION_INVALID_TYPE, 1UL << AZO_EXCEPTION_INVALID_TYPE, ip);
+		return NULL;
+	}
+	varray_class = az_type_get_class (AZ_TYPE_VALUE_ARRAY_REF);
+	varray = copy_value_array (varray_class, *((AZValueArrayRef **) azo_stack_value_bw (&intr->stack, 0)));
+	azo_stack_pop (&intr->stack, 1);
+	azo_stack_push_instance (&intr->stack, &varray_class->impl, varray);
+	az_reference_unref ((AZReferenceClass *) varray_class, &varray->reference);
+	return ip + 1;
+}
+
+static const unsigned char *
+interpret_NEW_TYPED_ARRAY (AZOInterpreter *intr, const unsigned char *ip)
+{
+	CHECK_UNDERFLOW(1);
+	unsigned int element_type, size;
+	AZOTypedArray *tarray;
+	AZListImplementation *list_impl = NULL;
+	void *list_inst;
+	memcpy (&element_type, ip + 1, 4);
+	const AZImplementation *impl = azo_stack_impl_bw (&intr->stack, 0);
+	if (impl) {
+		list_impl = (AZListImplementation *) az_instance_get_interface (impl, azo_stack_instance_bw (&intr->stack, 0), AZ_TYPE_LIST, (void **) &list_inst);
+	}
+	if (list_impl) {
+		tarray = azo_typed_array_new_from_list (element_type, list_impl, list_inst);
+		if (!tarray) {
+			azo_exception_set (&intr->exc, AZO_EXCEPTION_INVALID_CONVERSION, 1UL << AZO_EXCEPTION_INVALID_CONVERSION, ip);
+			return NULL;
+		}
+	} else {
+		if (!convert_to_u32 (intr, &size, impl, azo_stack_value_bw (&intr->stack, 0), ip)) {
+			return NULL;
+		}
+		tarray = azo_typed_array_new (element_type, size);
+	}
+	azo_stack_pop (&intr->stack, 1);
+	azo_stack_push_instance (&intr->stack, (const AZImplementation *) tarray->object.klass, tarray);
+	az_object_unref ((AZObject *) tarray);
+	return ip + 5;
+}
+
+/* Element type of vector operation result for scalar or typed array element type */
+
+static unsigned int
+get_vector_type (unsigned int type)
+{
+	if (type <= AZ_TYPE_INT32) return AZ_TYPE_INT32;
+	if (type == AZ_TYPE_UINT64) return AZ_TYPE_DOUBLE;
+	return type;
+}
+
+/* Get operand as typed array of given element type, new array is created if it has to be converted */
+
+static AZOTypedArray *
+get_vector_operand (const AZImplementation *impl, void *inst, unsigned int element_type, unsigned int *is_new)
+{
+	AZListImplementation *list_impl;
+	void *list_inst;
+	if (az_type_is_a (AZ_IMPL_TYPE(impl), AZO_TYPE_TYPED_ARRAY) && (((AZOTypedArray *) inst)->element_type == element_type)) {
+		*is_new = 0;
+		return (AZOTypedArray *) inst;
+	}
+	list_impl = (AZListImplementation *) az_instance_get_interface (impl, inst, AZ_TYPE_LIST, (void **) &list_inst);
+	*is_new = 1;
+	return azo_typed_array_new_from_list (element_type, list_impl, list_inst);
+}
+
+static unsigned int
+has_zero_element (AZOTypedArray *tarray)
+{
+	for (unsigned int i = 0; i < tarray->length; i++) {
+		switch (tarray->element_type) {
+		case AZ_TYPE_INT32:
+			if (!((int32_t *) tarray->data)[i]) return 1;
+			break;
+		case AZ_TYPE_UINT32:
+			if (!((uint32_t *) tarray->data)[i]) return 1;
+			break;
+		case AZ_TYPE_INT64:
+			if (!((int64_t *) tarray->data)[i]) return 1;
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 0;
+}
+
+static const unsigned char *
+interpret_VECTOR_ARITHMETIC (AZOInterpreter *intr, const unsigned char *ip)
+{
+	CHECK_UNDERFLOW(2);
+	unsigned int op = ip[1] & AZO_VECTOR_OPERATION_MASK;
+	const AZImplementation *impls[2];
+	void *insts[2];
+	unsigned int is_list[2], is_typed[2], is_new[2] = { 0 }, is_temp[2];
+	AZOTypedArray *arrays[2] = { NULL }, *dst;
+	unsigned int element_type = 0, type, i;
+	AZValue k;
+	is_temp[0] = (ip[1] & AZO_VECTOR_LHS_TEMPORARY) != 0;
+	is_temp[1] = (ip[1] & AZO_VECTOR_RHS_TEMPORARY) != 0;
+	for (i = 0; i < 2; i++) {
+		impls[i] = azo_stack_impl_bw (&intr->stack, 1 - i);
+		insts[i] = azo_stack_instance_bw (&intr->stack, 1 - i);
+		type = azo_stack_type_bw (&intr->stack, 1 - i);
+		is_typed[i] = type && az_type_is_a (type, AZO_TYPE_TYPED_ARRAY);
+		is_list[i] = type && az_type_implements (type, AZ_TYPE_LIST);
+		if (is_typed[i]) {
+			type = ((AZOTypedArray *) insts[i])->element_type;
+		} else if (!is_list[i] && ((type < AZ_TYPE_INT8) || (type > AZ_TYPE_DOUBLE))) {
+			EXCEPTION_THROW(AZO_EXCEPTION_INVALID_TYPE);
+		}
+		/* Untyped lists do not determine element type */
+		if (!is_list[i] || is_typed[i]) {
+			type = get_vector_type (type);
+			if (type > element_type) element_type = type;
+		}
+	}
+	if (!is_list[0] && !is_list[1]) EXCEPTION_THROW(AZO_EXCEPTION_INVALID_TYPE);
+	if (!is_typed[0] && !is_typed[1]) element_type = AZ_TYPE_DOUBLE;
+	/* Convert operands */
+	for (i = 0; i < 2; i++) {
+		if (!is_list[i]) continue;
+		arrays[i] = get_vector_operand (impls[i], insts[i], element_type, &is_new[i]);
+		if (!arrays[i]) {
+			if (is_new[0] && arrays[0]) az_object_unref ((AZObject *) arrays[0]);
+			EXCEPTION_THROW(AZO_EXCEPTION_INVALID_CONVERSION);
+		}
+	}
+	if (arrays[0] && arrays[1] && (arrays[0]->length != arrays[1]->length)) {
+		for (i = 0; i < 2; i++) if (is_new[i]) az_object_unref ((AZObject *) arrays[i]);
+		EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_BOUNDS);
+	}
+	if (!arrays[0] || !arrays[1]) {
+		unsigned int pos = (arrays[0]) ? 1 : 0;
+		const AZImplementation *k_impl = impls[pos];
+		memcpy (&k, azo_stack_value_bw (&intr->stack, 1 - pos), az_class_value_size (AZ_CLASS_FROM_IMPL(k_impl)));
+		if (!az_value_convert_in_place (&k_impl, &k, element_type)) {
+			if (is_new[1 - pos]) az_object_unref ((AZObject *) arrays[1 - pos]);
+			EXCEPTION_THROW(AZO_EXCEPTION_INVALID_CONVERSION);
+		}
+	}
+	/* Integer division by zero */
+	if ((op == AZO_SIMD_DIVIDE) && (element_type <= AZ_TYPE_INT64)) {
+		unsigned int zero = (arrays[1]) ? has_zero_element (arrays[1]) : (element_type == AZ_TYPE_INT64) ? !k.int64_v : !k.int32_v;
+		if (zero) {
+			for (i = 0; i < 2; i++) if (is_new[i]) az_object_unref ((AZObject *) arrays[i]);
+			EXCEPTION_THROW(AZO_EXCEPTION_INVALID_VALUE);
+		}
+	}
+	/* Reuse converted or temporary operand as destination */
+	dst = NULL;
+	for (i = 0; i < 2; i++) {
+		if (arrays[i] && !dst && (is_new[i] || is_temp[i])) {
+			dst = arrays[i];
+			if (!is_new[i]) az_object_ref ((AZObject *) dst);
+			is_new[i] = 0;
+		}
+	}
+	if (!dst) dst = azo_typed_array_new (element_type, (arrays[0]) ? arrays[0]->length : arrays[1]->length);
+	if (arrays[0] && arrays[1]) {
+		azo_simd_binary (element_type, op, dst->data, arrays[0]->data, arrays[1]->data, dst->length);
+	} else if (arrays[0]) {
+		azo_simd_binary_scalar (element_type, op, dst->data, arrays[0]->data, &k, dst->length);
+	} else {
+		azo_simd_scalar_binary (element_type, op, dst->data, &k, arrays[1]->data, dst->length);
+	}
+	for (i = 0; i < 2; i++) if (is_new[i]) az_object_unref ((AZObject *) arrays[i]);
+	azo_stack_pop (&intr->stack, 2);
+	azo_stack_push_instance (&intr->stack, (const AZImplementation *) dst->object.klass, dst);
+	az_object_unref ((AZObject *) dst);
+	return ip + 2;
+}
+
 static const unsigned char *
 interpret_GET_GLOBAL (AZOInterpreter *intr, const unsigned char *ip)
 {
@@ -1462,6 +1904,16 @@ interpret_GET_GLOBAL (AZOInterpreter *intr, const unsigned char *ip)
 	return ip + 1;
 }
 
+static const unsigned char *
+interpret_GET_GLOBAL_SLOT (AZOInterpreter *intr, const unsigned char *ip)
+{
+	unsigned int slot;
+	memcpy (&slot, ip + 1, 4);
+	intr->vals[0].impl = azo_context_get_slot_value (intr->ctx, slot, &intr->vals[0].v.value);
+	azo_stack_push_value_transfer (&intr->stack, intr->vals[0].impl, &intr->vals[0].v.value);
+	return ip + 5;
+}
+
 /* Instance, String -> Value */
 
 static const unsigned char *
@@ -1825,6 +2277,9 @@ azo_interpreter_interpret_tc (AZOInterpreter *intr, AZOProgram *prog, const uint
 		case AZO_TC_PUSH_VALUE:
 			ipc = interpret_PUSH_VALUE (intr, prog, ipc);
 			break;
+		case AZO_TC_PUSH_ENV_VALUE:
+			ipc = interpret_PUSH_ENV_VALUE (intr, ipc);
+			break;
 		case AZO_TC_DUPLICATE:
 			ipc = interpret_DUPLICATE (intr, ipc);
 			break;
@@ -1952,8 +2407,14 @@ azo_interpreter_interpret_tc (AZOInterpreter *intr, AZOProgram *prog, const uint
 		case AZO_TC_RETURN_VALUE:
 			ipc = interpret_RETURN_VALUE (intr, ipc);
 			break;
-		case AZO_TC_BIND:
-			ipc = interpret_BIND (intr, ipc);
+		case AZO_TC_MAKE_CLOSURE:
+			ipc = interpret_MAKE_CLOSURE (intr, ipc);
+			break;
+		case AZO_TC_YIELD:
+			ipc = interpret_YIELD (intr, ipc);
+			break;
+		case AZO_TC_ITERATE:
+			ipc = interpret_ITERATE (intr, ipc);
 			break;
 
 		case NEW_ARRAY:
@@ -1965,10 +2426,28 @@ azo_interpreter_interpret_tc (AZOInterpreter *intr, AZOProgram *prog, const uint
 		case WRITE_ARRAY_ELEMENT:
 			ipc = interpret_WRITE_ARRAY_ELEMENT (intr, ipc);
 			break;
+		case LOAD_ARRAY_ELEMENT_U32_NOCHECK:
+			ipc = interpret_LOAD_ARRAY_ELEMENT_U32_NOCHECK (intr, ipc);
+			break;
+		case TEST_ARRAY_SIZE:
+			ipc = interpret_TEST_ARRAY_SIZE (intr, ipc);
+			break;
+		case NEW_TYPED_ARRAY:
+			ipc = interpret_NEW_TYPED_ARRAY (intr, ipc);
+			break;
+		case VECTOR_ARITHMETIC:
+			ipc = interpret_VECTOR_ARITHMETIC (intr, ipc);
+			break;
+		case COPY_ARRAY:
+			ipc = interpret_COPY_ARRAY (intr, ipc);
+			break;
 
 		case AZO_TC_GET_GLOBAL:
 			ipc = interpret_GET_GLOBAL (intr, ipc);
 			break;
+		case GET_GLOBAL_SLOT:
+			ipc = interpret_GET_GLOBAL_SLOT (intr, ipc);
+			break;
 		case AZO_TC_GET_PROPERTY:
 			ipc = interpret_GET_PROPERTY (intr, ipc);
 			break;
@@ -2004,28 +2483,317 @@ azo_interpreter_interpret_tc (AZOInterpreter *intr, AZOProgram *prog, const uint
 	return ipc;
 }
 
-void
-azo_interpreter_run(AZOInterpreter *intr, AZOProgram *prog)
+/*
+ * INVOKE N_ARGS for compiled functions
+ *
+ * [func : this, arg1...]
+ * [func : this, arg1... | callee frame]
+ *
+ * Saves the caller state and continues from the start of callee code, the arguments
+ * stay in place and become the callee frame.
+ * Other functions are invoked through function interface.
+ */
+static const uint8_t *
+interpret_INVOKE_inline (AZOInterpreter *intr, AZOProgram **prog, const uint8_t *ip)
+{
+	unsigned int pos = ip[1];
+	CHECK_UNDERFLOW(pos + 1);
+	if (azo_stack_type_bw (&intr->stack, pos) != AZO_TYPE_COMPILED_FUNCTION) {
+		return interpret_INVOKE (intr, ip);
+	}
+	AZOCompiledFunction *cfunc = (AZOCompiledFunction *) azo_stack_instance_bw (&intr->stack, pos);
+	if (((cfunc->ctx != intr->ctx) && !azo_context_inherits (intr->ctx, cfunc->ctx)) || !cfunc->prog || !cfunc->prog->tcode_length || cfunc->generator) {
+		return interpret_INVOKE (intr, ip);
+	}
+	if (!consume_fuel (intr)) EXCEPTION_THROW(AZO_EXCEPTION_OUT_OF_FUEL);
+	const AZFunctionSignature *sig = cfunc->signature;
+	CHECK_UNDERFLOW(sig->n_args);
+	for (unsigned int i = 0; i < sig->n_args; i++) {
+		if (!azo_stack_convert_bw (&intr->stack, sig->n_args - 1 - i, sig->arg_types[i])) {
+			EXCEPTION_THROW(AZO_EXCEPTION_INVALID_TYPE);
+		}
+	}
+	if (intr->n_calls >= intr->size_calls) {
+		intr->size_calls = (intr->size_calls) ? intr->size_calls << 1 : 16;
+		intr->calls = (AZOCallRecord *) realloc (intr->calls, intr->size_calls * sizeof (AZOCallRecord));
+	}
+	AZOCallRecord *rec = &intr->calls[intr->n_calls++];
+	/* Function stays on stack below callee frame, so it is not referenced */
+	rec->cfunc = cfunc;
+	rec->prog = *prog;
+	rec->ipc = ip + 2;
+	rec->closure = intr->closure;
+	rec->n_args = sig->n_args;
+	rec->frame = azo_interpreter_push_frame (intr, sig->n_args);
+	intr->vals[0].impl = NULL;
+	intr->closure = cfunc;
+	*prog = cfunc->prog;
+	return cfunc->prog->tcode;
+}
+
+/*
+ * Return from compiled function to the caller
+ *
+ * [func : this, arg1... | callee frame]
+ * [func : this, arg1..., result]
+ */
+static const uint8_t *
+return_inline (AZOInterpreter *intr, AZOProgram **prog)
 {
-	const uint8_t *ipc = prog->tcode;
-	const uint8_t *end = prog->tcode + prog->tcode_length;
+	AZOCallRecord *rec = &intr->calls[--intr->n_calls];
+	unsigned int keep = intr->frames[rec->frame] + rec->n_args;
+	if (intr->stack.length > keep) {
+		azo_stack_pop (&intr->stack, intr->stack.length - keep);
+	}
+	intr->n_frames = rec->frame;
+	azo_stack_push_value_transfer (&intr->stack, intr->vals[0].impl, &intr->vals[0].v);
+	intr->vals[0].impl = NULL;
+	intr->closure = rec->closure;
+	*prog = rec->prog;
+	return rec->ipc;
+}
 
-	while (ipc && (ipc < end)) {
-		ipc = azo_interpreter_interpret_tc(intr, prog, ipc);
+/*
+ * Record current exception with throwing position and the return addresses of inline calls above base
+ *
+ * Only pointers are copied, source locations are resolved by exception object when asked.
+ */
+static AZOExceptionObject *
+capture_exception (AZOInterpreter *intr, AZOProgram *prog, unsigned int base)
+{
+	unsigned int n_frames = 1 + intr->n_calls - base;
+	AZOExceptionObject *obj = azo_exception_object_new (&intr->exc, n_frames);
+	azo_exception_object_set_frame (obj, 0, intr->closure, prog, intr->exc.ipc);
+	for (unsigned int i = 1; i < n_frames; i++) {
+		AZOCallRecord *rec = &intr->calls[intr->n_calls - i];
+		/* Inside caller INVOKE */
+		azo_exception_object_set_frame (obj, i, rec->closure, rec->prog, rec->ipc - 1);
 	}
+	return obj;
+}
 
-	if (intr->exc.type != AZO_EXCEPTION_NONE) {
-		unsigned char b[1024];
-		/* Exception */
-		az_instance_to_string (&azo_exception_class->klass.impl, &intr->exc, b, 1024);
-		fprintf (stderr, "Fatal exception: %s\n", b);
-		fprintf(stderr, "Position: %ld %d\n", intr->exc.ipc - prog->tcode, prog->tcode[intr->exc.ipc - prog->tcode] & 0x7f);
-		azo_intepreter_print_stack (intr, stderr);
-		fprintf (stderr, "\n");
+static void
+uncaught_exception (AZOInterpreter *intr, AZOProgram *prog, unsigned int base)
+{
+	if (intr->uncaught) az_object_unref ((AZObject *) intr->uncaught);
+	intr->uncaught = capture_exception (intr, prog, base);
+#ifdef DEBUG_EXCEPTIONS
+	unsigned char b[1024];
+	azo_exception_object_format (intr->uncaught, b, 1024);
+	fprintf (stderr, "Uncaught exception: %s", b);
+	azo_intepreter_print_stack (intr, stderr);
+	fprintf (stderr, "\n");
+#endif
+	/* Clear, otherwise return will invoke exceptions */
+	intr->exc.type = AZO_EXCEPTION_NONE;
+}
+
+AZOExceptionObject *
+azo_interpreter_take_exception (AZOInterpreter *intr)
+{
+	arikkei_return_val_if_fail (intr != NULL, NULL);
+	AZOExceptionObject *obj = intr->uncaught;
+	intr->uncaught = NULL;
+	return obj;
+}
+
+static const AZOExceptionHandler *
+find_handler (AZOProgram *prog, const uint8_t *ip)
+{
+	if ((ip < prog->tcode) || (ip >= (prog->tcode + prog->tcode_length))) return NULL;
+	uint32_t pos = (uint32_t) (ip - prog->tcode);
+	for (unsigned int i = 0; i < prog->n_handlers; i++) {
+		if ((pos >= prog->handlers[i].start) && (pos < prog->handlers[i].end)) return &prog->handlers[i];
+	}
+	return NULL;
+}
+
+/*
+ * Find the innermost handler of current exception in current program or its inline callers above base
+ *
+ * If found, unwinds calls, frames and stack to the handler, pushes exception and returns handler
+ * address. Otherwise nothing is changed and NULL is returned. Exhausted fuel cannot be caught.
+ */
+static const uint8_t *
+catch_exception (AZOInterpreter *intr, AZOProgram **prog, unsigned int base, unsigned int frame)
+{
+	if (intr->exc.type == AZO_EXCEPTION_OUT_OF_FUEL) return NULL;
+	AZOProgram *p = *prog;
+	const uint8_t *ip = intr->exc.ipc;
+	unsigned int level = intr->n_calls;
+	const AZOExceptionHandler *h = find_handler (p, ip);
+	while (!h && (level > base)) {
+		level -= 1;
+		p = intr->calls[level].prog;
+		/* Inside caller INVOKE */
+		ip = intr->calls[level].ipc - 1;
+		h = find_handler (p, ip);
+	}
+	if (!h) return NULL;
+	AZOExceptionObject *obj = capture_exception (intr, *prog, base);
+	while (intr->n_calls > level) {
+		AZOCallRecord *rec = &intr->calls[--intr->n_calls];
+		intr->closure = rec->closure;
+	}
+	if (level > base) frame = intr->calls[level - 1].frame;
+	azo_interpreter_restore_frame (intr, frame + 1);
+	azo_stack_pop (&intr->stack, intr->stack.length - (intr->frames[frame] + h->depth));
+	azo_stack_push_instance (&intr->stack, (const AZImplementation *) obj->object.klass, obj);
+	az_object_unref ((AZObject *) obj);
+	intr->exc.type = AZO_EXCEPTION_NONE;
+	*prog = p;
+	return p->tcode + h->handler;
+}
+
+/* Run from ipc until calls above base have returned, return 0 if suspended */
+
+static unsigned int
+run (AZOInterpreter *intr, AZOProgram *prog, const uint8_t *ipc, unsigned int base, unsigned int frame)
+{
+	while (ipc) {
+		if (ipc >= (prog->tcode + prog->tcode_length)) {
+			/* End of code is implicit return */
+			if (intr->n_calls == base) break;
+			ipc = return_inline (intr, &prog);
+			continue;
+		}
+		if ((*ipc & 127) == AZO_TC_INVOKE) {
+			ipc = interpret_INVOKE_inline (intr, &prog, ipc);
+		} else {
+			ipc = azo_interpreter_interpret_tc(intr, prog, ipc);
+		}
+		if (!ipc && (intr->exc.type == AZO_EXCEPTION_OUT_OF_FUEL) && can_suspend (intr)) {
+			/* Suspend before the instruction that ran out of fuel */
+			intr->susp_kind = AZO_INTR_SUSPEND_FUEL;
+			intr->susp_ipc = intr->exc.ipc;
+			intr->exc.type = AZO_EXCEPTION_NONE;
+		}
+		if (!ipc && intr->susp_kind) {
+			/* Resume address was set by instruction */
+			intr->susp_prog = prog;
+			intr->susp_base = base;
+			intr->susp_closure = intr->closure;
+			if (intr->susp_closure) az_object_ref ((AZObject *) intr->susp_closure);
+			return 0;
+		}
+		if (!ipc && (intr->exc.type != AZO_EXCEPTION_NONE)) {
+			ipc = catch_exception (intr, &prog, base, frame);
+		}
+		if (!ipc && (intr->n_calls > base)) {
+			/* Return or exception inside function, the latter terminates only the function itself */
+			if (intr->exc.type != AZO_EXCEPTION_NONE) {
+				uncaught_exception (intr, prog, base);
+				intr->vals[0].impl = NULL;
+			}
+			ipc = return_inline (intr, &prog);
+		}
+	}
 
-		/* fixme: Clear for now (otherwise return will invoke exceptions) */
-		intr->exc.type = AZO_EXCEPTION_NONE;
+	if (intr->exc.type != AZO_EXCEPTION_NONE) {
+		uncaught_exception (intr, prog, base);
 	}
+	return 1;
+}
+
+static _Thread_local AZOInterpreter *current_intr = NULL;
+
+unsigned int
+azo_interpreter_run(AZOInterpreter *intr, AZOProgram *prog)
+{
+	unsigned int result;
+	AZOInterpreter *prev_intr = current_intr;
+	current_intr = intr;
+	intr->run_depth += 1;
+	/* Calls below base belong to outer (recursive) invocations */
+	result = run (intr, prog, prog->tcode, intr->n_calls, intr->n_frames - 1);
+	intr->run_depth -= 1;
+	current_intr = prev_intr;
+	return result;
+}
+
+AZOInterpreter *
+azo_interpreter_get_current (void)
+{
+	return current_intr;
+}
+
+unsigned int
+azo_interpreter_request_suspend (AZOInterpreter *intr)
+{
+	arikkei_return_val_if_fail (intr != NULL, 0);
+	if (!can_suspend (intr) || (intr->flags & AZO_INTR_FLAG_YIELD_ONLY)) return 0;
+	intr->susp_request = 1;
+	return 1;
+}
+
+const AZImplementation *
+azo_interpreter_get_yielded (AZOInterpreter *intr, AZValue *val, unsigned int size)
+{
+	arikkei_return_val_if_fail (intr != NULL, NULL);
+	const AZImplementation *impl = az_value_transfer_autobox (intr->yielded.impl, val, &intr->yielded.v.value, size);
+	intr->yielded.impl = NULL;
+	return impl;
+}
+
+void
+azo_interpreter_set_fuel (AZOInterpreter *intr, uint64_t fuel)
+{
+	arikkei_return_if_fail (intr != NULL);
+	intr->fuel = fuel;
+}
+
+unsigned int
+azo_interpreter_resume (AZOInterpreter *intr, const AZImplementation *impl, const AZValue *val, const AZImplementation **ret_impl, AZValue *ret_val, unsigned int ret_size)
+{
+	arikkei_return_val_if_fail (intr != NULL, 1);
+	arikkei_return_val_if_fail (intr->susp_prog != NULL, 1);
+	arikkei_return_val_if_fail (!intr->run_depth, 1);
+	AZOProgram *prog = intr->susp_prog;
+	const uint8_t *ipc = intr->susp_ipc;
+	struct _AZOCompiledFunction *prev_closure = intr->closure;
+	/* Reference is kept until run stops, suspending again takes a new one */
+	struct _AZOCompiledFunction *closure = intr->susp_closure;
+	if (intr->susp_kind == AZO_INTR_SUSPEND_HOST) {
+		/* Replace the result of host function */
+		azo_stack_pop (&intr->stack, 1);
+		azo_stack_push_value (&intr->stack, impl, val);
+	}
+	intr->susp_prog = NULL;
+	intr->susp_kind = AZO_INTR_SUSPEND_NONE;
+	intr->susp_ipc = NULL;
+	intr->susp_closure = NULL;
+	intr->closure = closure;
+	AZOInterpreter *prev_intr = current_intr;
+	current_intr = intr;
+	intr->run_depth += 1;
+	unsigned int result = run (intr, prog, ipc, intr->susp_base, intr->susp_frame);
+	intr->run_depth -= 1;
+	current_intr = prev_intr;
+	if (result) {
+		*ret_impl = az_value_transfer_autobox (intr->vals[0].impl, ret_val, &intr->vals[0].v.value, ret_size);
+		intr->vals[0].impl = NULL;
+		azo_interpreter_restore_frame (intr, intr->susp_frame);
+	}
+	intr->closure = prev_closure;
+	if (closure) az_object_unref ((AZObject *) closure);
+	return result;
+}
+
+void
+azo_interpreter_abort (AZOInterpreter *intr)
+{
+	arikkei_return_if_fail (intr != NULL);
+	arikkei_return_if_fail (intr->susp_prog != NULL);
+	/* Unwind inline calls made by suspended run */
+	if (intr->n_calls > intr->susp_base) intr->n_calls = intr->susp_base;
+	intr->susp_prog = NULL;
+	intr->susp_kind = AZO_INTR_SUSPEND_NONE;
+	intr->susp_ipc = NULL;
+	if (intr->susp_closure) az_object_unref ((AZObject *) intr->susp_closure);
+	intr->susp_closure = NULL;
+	if (intr->vals[0].impl) az_value_clear (intr->vals[0].impl, &intr->vals[0].v.value);
+	intr->vals[0].impl = NULL;
+	azo_interpreter_restore_frame (intr, intr->susp_frame);
 }
 
 static const uint8_t *
@@ -8,7 +8,9 @@
 */
 
 typedef struct _AZOInterpreter AZOInterpreter;
+typedef struct _AZOCallRecord AZOCallRecord;
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include <az/packed-value.h>
@@ -25,6 +27,37 @@ extern "C" {
 #define _REGISTER_THIS 0
 
 #define AZO_INTR_FLAG_CHECK_ARGS 1
+/* Exhausted fuel suspends toplevel run instead of throwing exception */
+#define AZO_INTR_FLAG_SUSPEND 2
+/* Only yield suspends the run, host function suspension requests are refused (generators) */
+#define AZO_INTR_FLAG_YIELD_ONLY 4
+
+/* Fuel value that is never exhausted */
+#define AZO_INTR_UNLIMITED_FUEL UINT64_MAX
+
+/* The reason of suspension */
+enum {
+	AZO_INTR_SUSPEND_NONE,
+	/* Fuel was exhausted, the instruction is run again on resume */
+	AZO_INTR_SUSPEND_FUEL,
+	/* Yield statement, the yielded value is kept by interpreter */
+	AZO_INTR_SUSPEND_YIELD,
+	/* Host function requested suspension, the resume value becomes its result */
+	AZO_INTR_SUSPEND_HOST
+};
+
+/* Caller state of a compiled function invoked inside the same dispatch loop */
+struct _AZOCallRecord {
+	/* Callee, not referenced because it stays on stack below callee frame */
+	struct _AZOCompiledFunction *cfunc;
+	/* Return address and closure of caller */
+	AZOProgram *prog;
+	const uint8_t *ipc;
+	struct _AZOCompiledFunction *closure;
+	/* Callee frame and the number of arguments at its start */
+	unsigned int frame;
+	unsigned int n_args;
+};
 
 struct _AZOInterpreter {
 	AZOContext *ctx;
@@ -34,8 +67,32 @@ struct _AZOInterpreter {
 	unsigned int size_frames;
 	unsigned int *frames;
 	AZOStack stack;
+	/* Active non-recursive calls */
+	unsigned int n_calls;
+	unsigned int size_calls;
+	AZOCallRecord *calls;
+	/* Currently executing closure (NULL for toplevel program) */
+	struct _AZOCompiledFunction *closure;
 	uint32_t flags;
 	AZOException exc;
+	/* Remaining backward jumps and invocations */
+	uint64_t fuel;
+	/* Nesting level of azo_interpreter_run */
+	unsigned int run_depth;
+	/* Suspended run, prog is NULL if interpreter is not suspended */
+	AZOProgram *susp_prog;
+	unsigned int susp_kind;
+	/* Set by azo_interpreter_request_suspend during host invocation */
+	unsigned int susp_request;
+	const uint8_t *susp_ipc;
+	unsigned int susp_base;
+	/* Frame of entry point, restored when suspended run finishes */
+	unsigned int susp_frame;
+	struct _AZOCompiledFunction *susp_closure;
+	/* The value of the last yield */
+	AZPackedValue64 yielded;
+	/* The last exception that was not caught by script */
+	AZOExceptionObject *uncaught;
 	/* Register */
 	AZPackedValue64 vals[4];
 };
@@ -66,7 +123,93 @@ void azo_interpreter_exception(AZOInterpreter *intr, const uint8_t *ip, unsigned
 
 const uint8_t *azo_interpreter_interpret_tc (AZOInterpreter *intr, AZOProgram *prog, const uint8_t *ipc);
 
-void azo_interpreter_run(AZOInterpreter *intr, AZOProgram *prog);
+/**
+ * @brief Runs program until return, end of code or exception
+ * 
+ * Compiled functions of the same interpreter are invoked without recursion - the
+ * caller state is pushed to the call stack and the arguments become the callee frame.
+ * 
+ * Every backward jump and invocation consumes one unit of fuel. If fuel is exhausted, toplevel run
+ * with AZO_INTR_FLAG_SUSPEND is suspended before the instruction, otherwise AZO_EXCEPTION_OUT_OF_FUEL
+ * is thrown.
+ * 
+ * Toplevel run with AZO_INTR_FLAG_SUSPEND is also suspended by yield statement and by host function
+ * that calls azo_interpreter_request_suspend. Runs nested in host functions cannot be suspended
+ * because their state includes C stack, yield throws AZO_EXCEPTION_CANNOT_SUSPEND there.
+ * 
+ * @param intr the interpreter
+ * @param prog the program
+ * @return 1 if the program finished, 0 if it was suspended
+ */
+unsigned int azo_interpreter_run(AZOInterpreter *intr, AZOProgram *prog);
+
+/* Set remaining fuel, AZO_INTR_UNLIMITED_FUEL disables metering */
+void azo_interpreter_set_fuel (AZOInterpreter *intr, uint64_t fuel);
+
+static inline unsigned int
+azo_interpreter_is_suspended (AZOInterpreter *intr)
+{
+	return intr->susp_prog != NULL;
+}
+
+static inline unsigned int
+azo_interpreter_get_suspend_kind (AZOInterpreter *intr)
+{
+	return intr->susp_kind;
+}
+
+/* The interpreter that is running in calling thread or NULL */
+AZOInterpreter *azo_interpreter_get_current (void);
+
+/**
+ * @brief Ask the run that invoked host function to suspend after it returns
+ *
+ * The result of host function is replaced by the value given to azo_interpreter_resume. If run cannot be
+ * suspended, host function has to complete the call normally (e.g. by blocking).
+ *
+ * @param intr the interpreter (azo_interpreter_get_current)
+ * @return 1 if the run will be suspended, 0 if it cannot be
+ */
+unsigned int azo_interpreter_request_suspend (AZOInterpreter *intr);
+
+/**
+ * @brief Take the value of the last yield statement
+ *
+ * @param intr the interpreter
+ * @param val the destination value
+ * @param size the size of destination, values that do not fit are autoboxed
+ * @return the implementation of value or NULL if there is none
+ */
+const AZImplementation *azo_interpreter_get_yielded (AZOInterpreter *intr, AZValue *val, unsigned int size);
+
+/**
+ * @brief Take the last exception that was not caught by script
+ *
+ * Uncaught exception terminates the function that threw it (or the whole run at toplevel), the
+ * interpreter keeps the last one until it is taken.
+ *
+ * @param intr the interpreter
+ * @return the exception object (reference is transferred to caller) or NULL
+ */
+AZOExceptionObject *azo_interpreter_take_exception (AZOInterpreter *intr);
+
+/**
+ * @brief Continue suspended run
+ *
+ * Fuel has to be added with azo_interpreter_set_fuel before resuming a run that exhausted it. When the run
+ * finishes, the result is returned and the frame of entry point (azo_program_interpret_call) is removed.
+ *
+ * @param intr the interpreter
+ * @param impl the implementation of resume value (host suspension only) or NULL
+ * @param val the resume value
+ * @param ret_impl the location of result implementation
+ * @param ret_val the location of result value
+ * @param ret_size the size of result storage
+ * @return 1 if the program finished, 0 if it was suspended again
+ */
+unsigned int azo_interpreter_resume (AZOInterpreter *intr, const AZImplementation *impl, const AZValue *val, const AZImplementation **ret_impl, AZValue *ret_val, unsigned int ret_size);
+/* Discard suspended run and release its frames */
+void azo_interpreter_abort (AZOInterpreter *intr);
 
 void azo_intepreter_print_stack (AZOInterpreter *intr, FILE *ofs);
 
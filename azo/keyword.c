@@ -30,6 +30,10 @@ const char *azo_keywords[] = {
 	"return",
 	"is",
 	"implements",
+	"yield",
+	"try",
+	"catch",
+	"import",
 	"debug"
 };
 
@@ -48,6 +48,13 @@ enum {
 	AZO_KEYWORD_IS,
 	/* REFERENCE IMPLEMENTS REFERENCE */
 	AZO_KEYWORD_IMPLEMENTS,
+	/* YIELD VALUE */
+	AZO_KEYWORD_YIELD,
+	/* TRY, BLOCK, DECLARATION_LIST | EMPTY, BLOCK */
+	AZO_KEYWORD_TRY,
+	AZO_KEYWORD_CATCH,
+	/* IMPORT NAME */
+	AZO_KEYWORD_IMPORT,
 
 	/* DEBUG */
 	AZO_KEYWORD_DEBUG,
@@ -0,0 +1,146 @@
+#define __AZO_MODULE_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/extend.h>
+
+#include <azo/exception.h>
+#include <azo/interpreter.h>
+#include <azo/module.h>
+#include <azo/parser.h>
+#include <azo/program.h>
+#include <azo/compiler/compiler.h>
+
+/* Modules that are being imported by this thread, to detect cycles */
+typedef struct _AZOImportChain AZOImportChain;
+
+struct _AZOImportChain {
+	AZOImportChain *next;
+	AZString *name;
+};
+
+static _Thread_local AZOImportChain *importing = NULL;
+
+AZOSource *
+azo_module_load_file (AZOContext *ctx, AZString *name, void *data)
+{
+	char path[1024];
+	const char *dir = (const char *) data;
+	if (dir) {
+		snprintf (path, 1024, "%s/%s.azo", dir, (const char *) name->str);
+	} else {
+		snprintf (path, 1024, "%s.azo", (const char *) name->str);
+	}
+	FILE *ifs = fopen (path, "rb");
+	if (!ifs) return NULL;
+	fseek (ifs, 0, SEEK_END);
+	long size = ftell (ifs);
+	fseek (ifs, 0, SEEK_SET);
+	if (size < 0) {
+		fclose (ifs);
+		return NULL;
+	}
+	uint8_t *cdata = (uint8_t *) malloc (size + 1);
+	if (fread (cdata, 1, size, ifs) != (size_t) size) {
+		free (cdata);
+		fclose (ifs);
+		return NULL;
+	}
+	fclose (ifs);
+	cdata[size] = 0;
+	return azo_source_new_transfer ((const uint8_t *) path, cdata, (unsigned int) size);
+}
+
+static AZOProgram *
+module_compile (AZOContext *ctx, AZONamespace *nspace, AZOSource *src)
+{
+	AZOCompiler comp;
+	azo_compiler_init (&comp, ctx);
+	comp.debug = 1;
+	azo_compiler_push_frame (&comp, (const AZImplementation *) az_type_get_class (AZO_TYPE_NAMESPACE), nspace, AZ_TYPE_NONE);
+	AZOParser parser;
+	azo_parser_setup (&parser, src);
+	AZOExpression *expr = azo_parser_parse (&parser);
+	AZOProgram *prog = (expr) ? azo_compiler_compile (&comp, expr, 1, src) : NULL;
+	azo_parser_release (&parser);
+	azo_compiler_finalize (&comp);
+	return prog;
+}
+
+/* Run toplevel program with namespace as this, returns 0 if it threw an exception */
+static unsigned int
+module_run (AZOContext *ctx, AZONamespace *nspace, AZOProgram *prog, AZString *name)
+{
+	AZOInterpreter *intr = azo_context_get_interpreter (ctx);
+	/* Keep the exception of host */
+	AZOExceptionObject *prev = azo_interpreter_take_exception (intr);
+	const AZImplementation *arg_impl = (const AZImplementation *) az_type_get_class (AZO_TYPE_NAMESPACE);
+	AZValue arg_val;
+	arg_val.block = nspace;
+	const AZValue *arg_vals[] = { &arg_val };
+	const AZImplementation *ret_impl;
+	AZValue64 ret_val;
+	azo_program_interpret (prog, intr, &arg_impl, arg_vals, 1, &ret_impl, &ret_val.value, 64);
+	if (ret_impl) az_value_clear (ret_impl, &ret_val.value);
+	AZOExceptionObject *exc = azo_interpreter_take_exception (intr);
+	intr->uncaught = prev;
+	if (exc) {
+		unsigned char b[1024];
+		azo_exception_object_format (exc, b, 1024);
+		fprintf (stderr, "azo_module_import: Module %s threw %s", name->str, b);
+		az_object_unref ((AZObject *) exc);
+		return 0;
+	}
+	return 1;
+}
+
+AZONamespace *
+azo_module_import (AZOContext *ctx, AZString *name)
+{
+	arikkei_return_val_if_fail (ctx != NULL, NULL);
+	arikkei_return_val_if_fail (name != NULL, NULL);
+	AZONamespace *nspace = azo_context_lookup_module (ctx, name);
+	if (nspace) return nspace;
+	for (AZOImportChain *link = importing; link; link = link->next) {
+		if (!strcmp ((const char *) link->name->str, (const char *) name->str)) {
+			fprintf (stderr, "azo_module_import: Circular import of %s\n", name->str);
+			return NULL;
+		}
+	}
+	void *data;
+	AZOModuleLoader loader = azo_context_get_module_loader (ctx, &data);
+	if (!loader) loader = azo_module_load_file;
+	AZOSource *src = loader (ctx, name, data);
+	if (!src) {
+		fprintf (stderr, "azo_module_import: Module %s not found\n", name->str);
+		return NULL;
+	}
+	AZOImportChain link = { importing, name };
+	importing = &link;
+	nspace = (AZONamespace *) az_instance_new (AZO_TYPE_NAMESPACE);
+	AZOProgram *prog = module_compile (ctx, nspace, src);
+	unsigned int success = prog && module_run (ctx, nspace, prog, name);
+	importing = link.next;
+	azo_source_unref (src);
+	if (success) {
+		azo_namespace_seal (nspace);
+		success = azo_context_add_module (ctx, name, nspace, prog);
+		if (!success) fprintf (stderr, "azo_module_import: Cannot add module %s to snapshot\n", name->str);
+	}
+	if (!success) {
+		az_instance_delete (AZO_TYPE_NAMESPACE, nspace);
+		if (prog) azo_program_delete (prog);
+		return NULL;
+	}
+	return nspace;
+}
@@ -0,0 +1,57 @@
+#ifndef __AZO_MODULE_H__
+#define __AZO_MODULE_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <az/string.h>
+
+#include <azo/context.h>
+#include <azo/namespace.h>
+#include <azo/source.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Modules
+ *
+ * Module is a script that is compiled and run once per context (or its snapshot). The toplevel program
+ * gets a new namespace as this and exports values by assigning them to its members:
+ *
+ *   this.square = function (x) { return x * x; };
+ *
+ * After the run the namespace is sealed. Statement "import name;" resolves name to the namespace at
+ * compile time and member lookups of it to the exported values.
+ */
+
+/**
+ * @brief The default module loader
+ *
+ * Reads file name.azo from given directory.
+ *
+ * @param ctx the context
+ * @param name the module name
+ * @param data the directory (const char *) or NULL for current directory
+ * @return a new source or NULL if file cannot be read
+ */
+AZOSource *azo_module_load_file (AZOContext *ctx, AZString *name, void *data);
+
+/**
+ * @brief Get compiled module, loading and running it on first use
+ *
+ * @param ctx the context
+ * @param name the module name
+ * @return the namespace of module (owned by context) or NULL on error
+ */
+AZONamespace *azo_module_import (AZOContext *ctx, AZString *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,7 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <arikkei/arikkei-utils.h>
 
@@ -15,9 +16,11 @@
 #include <az/extend.h>
 
 #include <azo/namespace.h>
+#include <azo/symbol.h>
 
 static void namespace_class_init (AZONamespaceClass *klass);
 static void namespace_init (AZONamespaceClass *klass, AZONamespace *nspace);
+static void namespace_finalize (AZONamespaceClass *klass, AZONamespace *nspace);
 
 static unsigned int namespace_get_size (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst);
 static unsigned int namespace_contains (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst, const AZImplementation *impl, const void *inst);
@@ -40,7 +43,7 @@ azo_namespace_get_type (void)
 		az_register_type (&azo_namespace_type, (const unsigned char *) "AZONamespace", AZ_TYPE_BLOCK, sizeof (AZONamespaceClass), sizeof (AZONamespace), AZ_FLAG_ZERO_MEMORY | AZ_FLAG_FINAL, 1, 0,
 			(void (*) (AZClass *)) namespace_class_init,
 			(void (*) (const AZImplementation *, void *)) namespace_init,
-			NULL);
+			(void (*) (const AZImplementation *, void *)) namespace_finalize);
 		azo_namespace_class = (AZONamespaceClass *) az_type_get_class (azo_namespace_type);
 	}
 	return azo_namespace_type;
@@ -65,6 +68,42 @@ namespace_init (AZONamespaceClass *klass, AZONamespace *nspace)
 {
 	nspace->size = 32;
 	nspace->entries = (AZONamespaceEntry *) malloc (nspace->size * sizeof (AZONamespaceEntry));
+	nspace->index_size = 64;
+	nspace->index = (unsigned int *) malloc (nspace->index_size * sizeof (unsigned int));
+	memset (nspace->index, 0, nspace->index_size * sizeof (unsigned int));
+}
+
+static void
+namespace_finalize (AZONamespaceClass *klass, AZONamespace *nspace)
+{
+	for (unsigned int i = 0; i < nspace->length; i++) {
+		az_string_unref (nspace->entries[i].key);
+		az_packed_value_clear (&nspace->entries[i].val.packed_val);
+	}
+	free (nspace->entries);
+	free (nspace->index);
+}
+
+/* Index slot of key, either holding key or empty */
+
+static unsigned int
+find_slot (AZONamespace *nspace, const AZString *key)
+{
+	unsigned int mask = nspace->index_size - 1;
+	unsigned int slot = azo_symbol_hash (key) & mask;
+	while (nspace->index[slot] && (nspace->entries[nspace->index[slot] - 1].key != key)) slot = (slot + 1) & mask;
+	return slot;
+}
+
+static void
+grow_index (AZONamespace *nspace)
+{
+	nspace->index_size = nspace->index_size << 1;
+	nspace->index = (unsigned int *) realloc (nspace->index, nspace->index_size * sizeof (unsigned int));
+	memset (nspace->index, 0, nspace->index_size * sizeof (unsigned int));
+	for (unsigned int i = 0; i < nspace->length; i++) {
+		nspace->index[find_slot (nspace, nspace->entries[i].key)] = i + 1;
+	}
 }
 
 static unsigned int
@@ -100,10 +139,7 @@ namespace_contains_key (const AZMapImplementation *map_impl, AZMap *map_inst, co
 {
 	arikkei_return_val_if_fail (AZ_IMPL_TYPE(key_impl) == AZ_TYPE_STRING, 0);
 	AZONamespace *nspace = (AZONamespace *) ARIKKEI_BASE_ADDRESS(AZONamespace,adict,map_inst);
-	for (unsigned int i = 0; i < nspace->length; i++) {
-		if (nspace->entries[i].key == key_inst) return 1;
-	}
-	return 0;
+	return nspace->index[find_slot (nspace, (const AZString *) key_inst)] != 0;
 }
 
 static const AZImplementation *
@@ -117,13 +153,12 @@ namespace_get_element (const AZCollectionImplementation *coll_impl, AZCollection
 const AZImplementation *
 namespace_lookup (const AZAttribDictImplementation *attrd_impl, AZAttribDict *attrd_inst, const AZString *key, AZValue *val, int size, unsigned int *flags)
 {
-	unsigned int i;
 	AZONamespace *nspace = (AZONamespace *) ARIKKEI_BASE_ADDRESS(AZONamespace,adict,attrd_inst);
-	for (i = 0; i < nspace->length; i++) {
-		if (nspace->entries[i].key == key) {
-			*flags = nspace->entries[i].flags;
-			return az_value_copy_autobox (nspace->entries[i].val.impl, val, &nspace->entries[i].val.v.value, size);
-		}
+	unsigned int idx = nspace->index[find_slot (nspace, key)];
+	if (idx) {
+		AZONamespaceEntry *entry = &nspace->entries[idx - 1];
+		*flags = entry->flags;
+		return az_value_copy_autobox (entry->val.impl, val, &entry->val.v.value, size);
 	}
 	*flags = 0;
 	return 0;
@@ -132,11 +167,9 @@ namespace_lookup (const AZAttribDictImplementation *attrd_impl, AZAttribDict *at
 unsigned int
 namespace_set (const AZAttribDictImplementation *attrd_impl, AZAttribDict *attrd_inst, AZString *key, const AZImplementation *impl, void *inst, unsigned int flags)
 {
-	unsigned int i;
 	AZONamespace *nspace = (AZONamespace *) ARIKKEI_BASE_ADDRESS(AZONamespace,adict,attrd_inst);
-	for (i = 0; i < nspace->length; i++) {
-		arikkei_return_val_if_fail (nspace->entries[i].key != key, 0);
-	}
+	unsigned int slot = find_slot (nspace, key);
+	arikkei_return_val_if_fail (!nspace->index[slot], 0);
 	if (nspace->length >= nspace->size) {
 		nspace->size = nspace->size << 1;
 		nspace->entries = (AZONamespaceEntry *) realloc (nspace->entries, nspace->size * sizeof (AZONamespaceEntry));
@@ -147,6 +180,12 @@ namespace_set (const AZAttribDictImplementation *attrd_impl, AZAttribDict *attrd
 	nspace->entries[nspace->length].val.impl = impl;
 	az_packed_value_set_from_impl_instance (&nspace->entries[nspace->length].val.packed_val, impl, inst);
 	nspace->length += 1;
+	/* Keep load below 1/2 */
+	if ((2 * nspace->length) > nspace->index_size) {
+		grow_index (nspace);
+	} else {
+		nspace->index[slot] = nspace->length;
+	}
 	return 1;
 }
 
@@ -189,3 +228,12 @@ azo_namespace_define_class_by_str (AZONamespace *nspace, const unsigned char *ke
 {
 	return azo_namespace_define_by_str_type (nspace, key, AZ_TYPE_CLASS, az_type_get_class (type));
 }
+
+void
+azo_namespace_seal (AZONamespace *nspace)
+{
+	arikkei_return_if_fail (nspace != NULL);
+	for (unsigned int i = 0; i < nspace->length; i++) {
+		nspace->entries[i].flags |= AZ_ATTRIB_ARRAY_IS_FINAL;
+	}
+}
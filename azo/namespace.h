@@ -27,11 +27,18 @@ struct _AZONamespaceEntry {
 	AZPackedValue64 val;
 };
 
+/*
+ * Entries are kept in definition order, keys are indexed by open addressing hash table of entry indices
+ */
+
 struct _AZONamespace {
 	unsigned int length;
 	unsigned int size;
 	AZAttribDict adict;
 	AZONamespaceEntry *entries;
+	/* Entry index + 1, 0 is empty slot, size is power of 2 */
+	unsigned int index_size;
+	unsigned int *index;
 };
 
 struct _AZONamespaceClass {
@@ -47,6 +54,8 @@ unsigned int azo_namespace_define_by_type (AZONamespace *nspace, AZString *key,
 unsigned int azo_namespace_define_by_str_type (AZONamespace *nspace, const unsigned char *key, unsigned int type, void *inst);
 unsigned int azo_namespace_define_class (AZONamespace *nspace, AZString *key, unsigned int type);
 unsigned int azo_namespace_define_class_by_str (AZONamespace *nspace, const unsigned char *key, unsigned int type);
+/* Make all current entries final, so compiler can replace member lookups with their values */
+void azo_namespace_seal (AZONamespace *nspace);
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,9 @@ extern "C" {
 #define AZO_COMPILER_NO_CONST_ASSIGN 1
 #define AZO_COMPILER_VAR_IS_LVALUE 2
 
+/* Maximum size of inlined function return expression */
+#define AZO_COMPILER_INLINE_MAX_NODES 16
+
 AZOExpression *azo_compiler_resolve_frame (AZOCompiler *comp, AZOExpression *root);
 
 AZOExpression *azo_compiler_resolve_expression (AZOCompiler *comp, AZOExpression *expr, unsigned int flags, unsigned int *result);
@@ -26,11 +29,28 @@ AZOExpression *azo_compiler_resolve_expression (AZOCompiler *comp, AZOExpression
 AZOExpression *azo_compiler_resolve_binary (AZOExpression *expr);
 AZOExpression *azo_compiler_resolve_prefix (AZOExpression *expr);
 AZOExpression *azo_compiler_resolve_array_literal (AZOExpression *expr);
+/* Replace copied literal array with shared constant, return 1 if replaced */
+unsigned int azo_compiler_share_array_literal (AZOExpression *expr, unsigned int need_flat);
+/* Test whether declared constant array is only read (elements and operators) later in the same scope */
+unsigned int azo_compiler_can_share_declaration (AZOExpression *list, AZOExpression *decl, AZString *name);
 
 AZOExpression *azo_compiler_resolve_reference (AZOCompiler *comp, AZOExpression *expr, unsigned int flags, unsigned int *result);
 AZOExpression *azo_compiler_resolve_function_call (AZOCompiler *comp, AZOExpression *expr, unsigned int flags, unsigned int *result);
 AZOExpression *azo_compiler_resolve_new (AZOCompiler *comp, AZOExpression *expr, unsigned int flags, unsigned int *result);
 
+/* Test whether variable is assigned, incremented or decremented anywhere in tree */
+unsigned int azo_compiler_is_variable_modified (AZOExpression *expr, AZString *name);
+/* Test whether declared variable is not modified later in the same scope */
+unsigned int azo_compiler_can_inline_declaration (AZOExpression *list, AZOExpression *decl, AZString *name);
+/* Replace function call with the body of resolved function, return 1 if inlined */
+unsigned int azo_compiler_inline_call (AZOCompiler *comp, AZOExpression *expr, AZOExpression *func);
+/* Move loop-invariant member lookups out of for/while loop, loop node is wrapped into block in place */
+unsigned int azo_compiler_hoist_invariants (AZOCompiler *comp, AZOExpression *expr);
+/* Evaluate repeated subexpressions of sentence once into hidden variables, sentence is split or wrapped in place */
+unsigned int azo_compiler_eliminate_common (AZOCompiler *comp, AZOExpression *expr);
+/* Mark array reads indexed by counter of resolved for loop that cannot be out of bounds, return 1 if any was marked */
+unsigned int azo_compiler_bound_loop (AZOCompiler *comp, AZOExpression *expr);
+
 #ifdef __cplusplus
 }
 #endif
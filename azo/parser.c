@@ -46,6 +46,8 @@ static unsigned int azo_parser_parse_block (AZOParser *parser, AZOToken *token);
 static unsigned int azo_parser_parse_line (AZOParser *parser, AZOToken *token);
 static unsigned int azo_parser_parse_statement (AZOParser *parser, AZOToken *token);
 static unsigned int azo_parser_parse_return (AZOParser *parser, AZOToken *token);
+static unsigned int azo_parser_parse_yield (AZOParser *parser, AZOToken *token);
+static unsigned int azo_parser_parse_import (AZOParser *parser, AZOToken *token);
 static unsigned int azo_parser_parse_step_statement (AZOParser *parser, AZOToken *token);
 static unsigned int azo_parser_parse_declaration_expression (AZOParser *parser, AZOToken *token, unsigned int qual_static, unsigned int qual_final);
 static unsigned int azo_parser_parse_single_declaration (AZOParser *parser, AZOToken *token);
@@ -214,8 +216,10 @@ term_is_silent_statement (AZOTerm *expr)
 static unsigned int parse_operator (AZOParser *parser, AZOToken *token);
 static unsigned int parse_type_operator (AZOParser *parser, AZOToken *token);
 static unsigned int parse_for (AZOParser *parser, AZOToken *token);
+static unsigned int parse_foreach (AZOParser *parser, AZOToken *token, unsigned int start);
 static unsigned int parse_while (AZOParser *parser, AZOToken *token);
 static unsigned int parse_if (AZOParser *parser, AZOToken *token);
+static unsigned int parse_try (AZOParser *parser, AZOToken *token);
 static unsigned int parse_function_call (AZOParser *parser, AZOToken *token);
 static unsigned int parse_new (AZOParser *parser, AZOToken *token);
 static unsigned int parse_array_literal (AZOParser *parser, AZOToken *token);
@@ -272,6 +276,7 @@ azo_parser_parse_sentences (AZOParser *parser, AZOToken *token)
  *   for
  *   while
  *   if
+ *   try
  */
 
 static unsigned int
@@ -285,6 +290,8 @@ azo_parser_parse_sentence (AZOParser *parser, AZOToken *token)
 		return parse_while (parser, token);
 	} else if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_IF)) {
 		return parse_if (parser, token);
+	} else if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_TRY)) {
+		return parse_try (parser, token);
 	}
 	/* Line */
 	return azo_parser_parse_line (parser, token);
@@ -338,6 +345,8 @@ azo_parser_parse_line (AZOParser *parser, AZOToken *token)
  *   Step_statement
  *   debug
  *   return
+ *   yield
+ *   import
  */
 
 static unsigned int
@@ -347,6 +356,10 @@ azo_parser_parse_statement (AZOParser *parser, AZOToken *token)
 	/* Return */
 	if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_RETURN)) {
 		return azo_parser_parse_return (parser, token);
+	} else if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_YIELD)) {
+		return azo_parser_parse_yield (parser, token);
+	} else if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_IMPORT)) {
+		return azo_parser_parse_import (parser, token);
 	} else if (azo_token_is_keyword (parser->src, token, AZO_KEYWORD_DEBUG)) {
 		AZOExpression *expr = azo_expression_new (EXPRESSION_KEYWORD, AZO_KEYWORD_DEBUG, token->start, token->end);
 		parser_append (parser, expr);
@@ -386,6 +399,52 @@ azo_parser_parse_return (AZOParser *parser, AZOToken *token)
 	return result;
 }
 
+/*
+* Yield:
+*   yield Expression
+*/
+
+static unsigned int
+azo_parser_parse_yield (AZOParser *parser, AZOToken *token)
+{
+	AZOExpression *expr, *val;
+	unsigned int start, result;
+	start = token->start;
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	result = azo_parser_parse_expression (parser, token, AZO_PRECEDENCE_MINIMUM);
+	if (result) return result;
+	val = parser_detach_last (parser);
+	if (!val) {
+		fprintf (stderr, "azo_parser_parse_yield: Expression resulted in no value\n");
+		return ERROR_SYNTAX;
+	}
+	expr = azo_expression_new (EXPRESSION_KEYWORD, AZO_KEYWORD_YIELD, start, val->term.end);
+	expr->children = val;
+	parser_append (parser, expr);
+	return result;
+}
+
+/*
+* Import:
+*   import Name
+*/
+
+static unsigned int
+azo_parser_parse_import (AZOParser *parser, AZOToken *token)
+{
+	AZOExpression *expr, *name;
+	unsigned int start;
+	start = token->start;
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	if (token->type != AZO_TOKEN_WORD) return ERROR_SYNTAX;
+	name = azo_expression_new_reference (REFERENCE_VARIABLE, parser->src, token);
+	expr = azo_expression_new (EXPRESSION_KEYWORD, AZO_KEYWORD_IMPORT, start, token->end);
+	expr->children = name;
+	parser_append (parser, expr);
+	azo_tokenizer_get_next_token (&parser->tokenizer, token);
+	return ERROR_NONE;
+}
+
 /*
  * Step_statement:
  *   Declaration
@@ -1464,8 +1523,47 @@ parse_while (AZOParser *parser, AZOToken *token)
 	return ERROR_NONE;
 }
 
+/*
+* for (TYPE NAME : COLLECTION) STATEMENT
+*
+* Current token is at colon, declaration is already parsed
+*/
+
+static unsigned int
+parse_foreach (AZOParser *parser, AZOToken *token, unsigned int start)
+{
+	AZOExpression *expr, *list, *coll, *block;
+	unsigned int error;
+	/* Single declaration without value */
+	list = parser_get_last (parser);
+	if (!list || (list->term.type != EXPRESSION_DECLARATION_LIST)) return ERROR_SYNTAX;
+	if (!list->children->next || list->children->next->next || list->children->next->children->next) return ERROR_SYNTAX;
+	/* Collection */
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	error = azo_parser_parse_expression (parser, token, AZO_PRECEDENCE_MINIMUM);
+	if (error) return error;
+	/* ) */
+	if (token->type == AZO_TOKEN_EOF) return ERROR_UNEXPECTED_EOF;
+	if (token->type != AZO_TOKEN_RIGHT_PARENTHESIS) return ERROR_SYNTAX;
+	/* Statement/Block */
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	error = azo_parser_parse_sentence (parser, token);
+	if (error) return error;
+	block = parser_detach_last (parser);
+	coll = parser_detach_last (parser);
+	list = parser_detach_last (parser);
+	if (!list || !coll || !block) return ERROR_SYNTAX;
+	expr = azo_expression_new (AZO_EXPRESSION_FOREACH, EXPRESSION_GENERIC, start, block->term.end);
+	expr->children = list;
+	list->next = coll;
+	coll->next = block;
+	parser_append (parser, expr);
+	return ERROR_NONE;
+}
+
 /*
 * for (INITIALIZATION; CONDITION; STEP) STATEMENT
+* for (TYPE NAME : COLLECTION) STATEMENT
 *
 * Current token is at keyword
 */
@@ -1483,6 +1581,9 @@ parse_for (AZOParser *parser, AZOToken *token)
 	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
 	error = azo_parser_parse_step_statement (parser, token);
 	if (error) return error;
+	if (AZO_TOKEN_IS_OPERATOR (token) && (AZO_TOKEN_OPERATOR_CODE (token) == AZO_OPERATOR_COLON)) {
+		return parse_foreach (parser, token, start);
+	}
 	/* ; */
 	if (token->type == AZO_TOKEN_EOF) return ERROR_UNEXPECTED_EOF;
 	if (token->type != AZO_TOKEN_SEMICOLON) return ERROR_SYNTAX;
@@ -1566,3 +1667,53 @@ parse_if (AZOParser *parser, AZOToken *token)
 	return ERROR_NONE;
 }
 
+/*
+* try BLOCK catch [(TYPE NAME)] BLOCK
+*
+* Current token is at keyword
+*/
+
+static unsigned int
+parse_try (AZOParser *parser, AZOToken *token)
+{
+	AZOExpression *expr, *body, *list, *handler;
+	unsigned int start, error;
+	start = token->start;
+	/* Block */
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	if (token->type != AZO_TOKEN_LEFT_BRACE) return ERROR_SYNTAX;
+	error = azo_parser_parse_block (parser, token);
+	if (error) return error;
+	body = parser_detach_last (parser);
+	/* catch */
+	if (token->type == AZO_TOKEN_EOF) return ERROR_UNEXPECTED_EOF;
+	if (!azo_token_is_keyword (parser->src, token, AZO_KEYWORD_CATCH)) return ERROR_SYNTAX;
+	if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	if (token->type == AZO_TOKEN_LEFT_PARENTHESIS) {
+		/* Single declaration without value */
+		if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+		error = azo_parser_parse_step_statement (parser, token);
+		if (error) return error;
+		list = parser_detach_last (parser);
+		if (!list || (list->term.type != EXPRESSION_DECLARATION_LIST)) return ERROR_SYNTAX;
+		if (!list->children->next || list->children->next->next || list->children->next->children->next) return ERROR_SYNTAX;
+		/* ) */
+		if (token->type == AZO_TOKEN_EOF) return ERROR_UNEXPECTED_EOF;
+		if (token->type != AZO_TOKEN_RIGHT_PARENTHESIS) return ERROR_CLOSING_PARENTHESIS_MISSING;
+		if (!azo_tokenizer_get_next_token (&parser->tokenizer, token)) return ERROR_UNEXPECTED_EOF;
+	} else {
+		list = azo_expression_new (AZO_TERM_EMPTY, EXPRESSION_GENERIC, token->start, token->start);
+	}
+	/* Block */
+	if (token->type != AZO_TOKEN_LEFT_BRACE) return ERROR_SYNTAX;
+	error = azo_parser_parse_block (parser, token);
+	if (error) return error;
+	handler = parser_detach_last (parser);
+	if (!body || !handler) return ERROR_SYNTAX;
+	expr = azo_expression_new (EXPRESSION_KEYWORD, AZO_KEYWORD_TRY, start, handler->term.end);
+	expr->children = body;
+	body->next = list;
+	list->next = handler;
+	parser_append (parser, expr);
+	return ERROR_NONE;
+}
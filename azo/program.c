@@ -27,6 +27,8 @@ azo_program_new(AZOContext *ctx, AZOCode *code, AZOExpression *tree, AZOSource *
 	prog->tcode_length = code->bc_len;
 	prog->values = code->data;
 	prog->nvalues = code->data_len;
+	prog->n_handlers = code->n_handlers;
+	prog->handlers = code->handlers;
 	if (code->exprs) {
 		azo_debug_info_setup(&prog->debug, code, src);
 	}
@@ -37,6 +39,9 @@ azo_program_new(AZOContext *ctx, AZOCode *code, AZOExpression *tree, AZOSource *
 	code->data = NULL;
 	code->data_size = 0;
 	code->data_len = 0;
+	code->handlers = NULL;
+	code->n_handlers = 0;
+	code->size_handlers = 0;
 
 	return prog;
 }
@@ -48,6 +53,7 @@ azo_program_delete (AZOProgram *program)
 	if (program->tcode) free (program->tcode);
 	for (i = 0; i < program->nvalues; i++) az_packed_value_clear (&program->values[i]);
 	free (program->values);
+	if (program->handlers) free (program->handlers);
 	free (program);
 }
 
@@ -89,8 +95,11 @@ azo_program_interpret(AZOProgram *prog, AZOInterpreter *intr, const AZImplementa
 		AZODebugger *debugger = azo_debugger_new(intr);
 		azo_debugger_run(debugger, prog);
 		azo_debugger_unref(debugger);
-	} else {
-		azo_interpreter_run (intr, prog);
+	} else if (!azo_interpreter_run (intr, prog)) {
+		/* Frame is kept until azo_interpreter_resume finishes */
+		intr->susp_frame = prev_frame;
+		*ret_impl = NULL;
+		return;
 	}
 	*ret_impl = az_value_transfer_autobox(intr->vals[0].impl, ret_val, &intr->vals[0].v.value, ret_size);
 	azo_interpreter_restore_frame (intr, prev_frame);
@@ -105,9 +114,39 @@ azo_program_interpret_call(AZOProgram *prog, AZOInterpreter *intr, const AZImple
 		AZODebugger *debugger = azo_debugger_new(intr);
 		azo_debugger_run(debugger, prog);
 		azo_debugger_unref(debugger);
-	} else {
-		azo_interpreter_run (intr, prog);
+	} else if (!azo_interpreter_run (intr, prog)) {
+		/* Frame is kept until azo_interpreter_resume finishes */
+		intr->susp_frame = prev_frame;
+		*ret_impl = NULL;
+		return;
 	}
 	*ret_impl = az_value_transfer_autobox(intr->vals[0].impl, ret_val, &intr->vals[0].v.value, ret_size);
 	azo_interpreter_restore_frame (intr, prev_frame);
 }
+
+void
+azo_program_interpret_batch (AZOProgram *prog, AZOInterpreter *intr, unsigned int n_rows, unsigned int n_args, const AZImplementation *col_impls[], const AZValue *col_vals[], const AZImplementation *ret_impls[], AZValue ret_vals[])
+{
+	unsigned int prev_frame = azo_interpreter_push_frame (intr, 0);
+	/* Rows cannot be suspended, exhausted fuel throws in every following row */
+	uint32_t flags = intr->flags;
+	intr->flags &= ~AZO_INTR_FLAG_SUSPEND;
+	intr->vals[0].impl = NULL;
+	for (unsigned int row = 0; row < n_rows; row++) {
+		for (unsigned int i = 0; i < n_args; i++) {
+			azo_stack_push_value (&intr->stack, col_impls[i], &col_vals[i][row]);
+		}
+		azo_interpreter_run (intr, prog);
+		if (ret_impls) {
+			ret_impls[row] = az_value_transfer_autobox (intr->vals[0].impl, &ret_vals[row], &intr->vals[0].v.value, sizeof (AZValue));
+		} else if (intr->vals[0].impl) {
+			az_value_clear (intr->vals[0].impl, &intr->vals[0].v.value);
+		}
+		intr->vals[0].impl = NULL;
+		/* Drop frames left by exception and reset stack to frame base */
+		azo_interpreter_restore_frame (intr, prev_frame + 1);
+		azo_interpreter_clear_frame (intr);
+	}
+	intr->flags = flags;
+	azo_interpreter_restore_frame (intr, prev_frame);
+}
@@ -19,6 +19,8 @@ extern "C" {
 
 typedef struct _AZOProgram AZOProgram;
 
+/* Program is not modified after compilation and can be run by several interpreters at once */
+
 struct _AZOProgram {
 	AZOContext *ctx;
 	/* Typecode */
@@ -27,6 +29,9 @@ struct _AZOProgram {
 	/* Immediate values */
 	unsigned int nvalues;
 	AZPackedValue *values;
+	/* Exception table */
+	unsigned int n_handlers;
+	AZOExceptionHandler *handlers;
 	/* Debug info */
 	AZODebugInfo debug;
 };
@@ -49,9 +54,31 @@ AZOProgram *azo_program_compile_from_text(AZOContext *ctx, const uint8_t *name,
 	const AZImplementation *this_impl, void *this_inst, unsigned int ret_type, unsigned int n_args, AZString *arg_names[], const unsigned int arg_types[],
 	const uint8_t *code, unsigned int code_len);
 
+/*
+ * If interpreter is suspended (see azo_interpreter_run), ret_impl is set to NULL and the frame is left
+ * in place, azo_interpreter_resume returns the result later.
+ */
 void azo_program_interpret(AZOProgram *prog, AZOInterpreter *intr, const AZImplementation *arg_impls[], const AZValue *arg_vals[], unsigned int n_args, const AZImplementation **ret_impl, AZValue *ret_val, unsigned int ret_size);
 void azo_program_interpret_call(AZOProgram *prog, AZOInterpreter *intr, const AZImplementation *arg_impls[], const AZValue *arg_vals[], unsigned int n_args, const AZImplementation **ret_impl, AZValue *ret_val, unsigned int ret_size);
 
+/**
+ * @brief Run program once per row of argument columns
+ *
+ * The frame is set up once, for every row the arguments are pushed to the frame base and the stack
+ * is reset after the run. Results that do not fit into AZValue are autoboxed, rows that threw an
+ * exception or did not return a value get NULL implementation.
+ *
+ * @param prog the program
+ * @param intr the interpreter (closure has to be set by caller)
+ * @param n_rows the number of rows
+ * @param n_args the number of arguments
+ * @param col_impls the implementations of argument columns
+ * @param col_vals n_args columns of n_rows values
+ * @param ret_impls the result implementations (n_rows) or NULL if results are not needed
+ * @param ret_vals the result values (n_rows)
+ */
+void azo_program_interpret_batch (AZOProgram *prog, AZOInterpreter *intr, unsigned int n_rows, unsigned int n_args, const AZImplementation *col_impls[], const AZValue *col_vals[], const AZImplementation *ret_impls[], AZValue ret_vals[]);
+
 #ifdef __cplusplus
 }
 #endif
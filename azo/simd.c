@@ -0,0 +1,566 @@
+#define __AZO_SIMD_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdint.h>
+
+#include <az/types.h>
+
+#include <azo/simd.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AZO_SIMD_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__ ((target ("sse2")))
+#define TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+
+static unsigned int simd_level = ~0U;
+
+unsigned int
+azo_simd_get_level (void)
+{
+	/* Races are harmless, every thread detects the same level */
+	if (simd_level == ~0U) {
+#ifdef AZO_SIMD_X86
+		__builtin_cpu_init ();
+		if (__builtin_cpu_supports ("avx2")) {
+			simd_level = AZO_SIMD_AVX2;
+		} else if (__builtin_cpu_supports ("sse2")) {
+			simd_level = AZO_SIMD_SSE2;
+		} else {
+			simd_level = AZO_SIMD_NONE;
+		}
+#else
+		simd_level = AZO_SIMD_NONE;
+#endif
+	}
+	return simd_level;
+}
+
+unsigned int
+azo_simd_is_element_type (unsigned int type)
+{
+	switch (type) {
+	case AZ_TYPE_INT32:
+	case AZ_TYPE_UINT32:
+	case AZ_TYPE_INT64:
+	case AZ_TYPE_FLOAT:
+	case AZ_TYPE_DOUBLE:
+		return 1;
+	default:
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Plain loops
+ *
+ * These are used for tails of vector loops, for types without vector implementation and
+ * on architectures without detection.
+ */
+
+/* Integer add, subtract and multiply are done in unsigned type U to wrap like vector code and interpreter */
+#define SCALAR_OP(op,x,y,U,div) \
+	switch (op) { \
+	case AZO_SIMD_ADD: return (U) x + (U) y; \
+	case AZO_SIMD_SUBTRACT: return (U) x - (U) y; \
+	case AZO_SIMD_MULTIPLY: return (U) x * (U) y; \
+	case AZO_SIMD_DIVIDE: return div; \
+	case AZO_SIMD_MIN: return (x < y) ? x : y; \
+	case AZO_SIMD_MAX: return (x > y) ? x : y; \
+	} \
+	return x;
+
+/* INT32_MIN / -1 traps on x86, so it is calculated as negation with wraparound */
+static inline int32_t op_i32 (unsigned int op, int32_t x, int32_t y) { SCALAR_OP(op, x, y, uint32_t, (y == -1) ? (int32_t) (0U - (uint32_t) x) : x / y) }
+static inline uint32_t op_u32 (unsigned int op, uint32_t x, uint32_t y) { SCALAR_OP(op, x, y, uint32_t, x / y) }
+static inline int64_t op_i64 (unsigned int op, int64_t x, int64_t y) { SCALAR_OP(op, x, y, uint64_t, (y == -1) ? (int64_t) (0ULL - (uint64_t) x) : x / y) }
+static inline float op_f32 (unsigned int op, float x, float y) { SCALAR_OP(op, x, y, float, x / y) }
+static inline double op_f64 (unsigned int op, double x, double y) { SCALAR_OP(op, x, y, double, x / y) }
+
+/* Sums are accumulated in UACC, the unsigned counterpart of integer ACC */
+#define SCALAR_KERNELS(N,T,ACC,UACC) \
+static void \
+binary_##N (unsigned int op, T *d, const T *a, const T *b, unsigned int n) \
+{ \
+	for (unsigned int i = 0; i < n; i++) d[i] = op_##N (op, a[i], b[i]); \
+} \
+static void \
+binary_scalar_##N (unsigned int op, T *d, const T *a, T k, unsigned int n) \
+{ \
+	for (unsigned int i = 0; i < n; i++) d[i] = op_##N (op, a[i], k); \
+} \
+static void \
+scalar_binary_##N (unsigned int op, T *d, T k, const T *a, unsigned int n) \
+{ \
+	for (unsigned int i = 0; i < n; i++) d[i] = op_##N (op, k, a[i]); \
+} \
+static ACC \
+sum_##N (const T *a, unsigned int n) \
+{ \
+	UACC s = 0; \
+	for (unsigned int i = 0; i < n; i++) s += (UACC) (ACC) a[i]; \
+	return (ACC) s; \
+} \
+static ACC \
+dot_##N (const T *a, const T *b, unsigned int n) \
+{ \
+	UACC s = 0; \
+	for (unsigned int i = 0; i < n; i++) s += (UACC) (ACC) a[i] * (UACC) (ACC) b[i]; \
+	return (ACC) s; \
+} \
+static void \
+min_max_##N (const T *a, unsigned int n, T *min, T *max) \
+{ \
+	for (unsigned int i = 0; i < n; i++) { \
+		if (a[i] < *min) *min = a[i]; \
+		if (a[i] > *max) *max = a[i]; \
+	} \
+}
+
+SCALAR_KERNELS(i32, int32_t, int64_t, uint64_t)
+SCALAR_KERNELS(u32, uint32_t, int64_t, uint64_t)
+SCALAR_KERNELS(i64, int64_t, int64_t, uint64_t)
+SCALAR_KERNELS(f32, float, double, double)
+SCALAR_KERNELS(f64, double, double, double)
+
+#ifdef AZO_SIMD_X86
+
+/*
+ * Vector loops
+ *
+ * Every function processes whole vectors and returns the number of elements done,
+ * the rest is finished by plain loop.
+ */
+
+#define VECTOR_LOOP(W,STORE,EXPR) for (; (i + W) <= n; i += W) STORE (d + i, EXPR)
+
+#define VECTOR_OPS(W,STORE,ADD,SUB,MUL,DIV,MIN,MAX,A,B) \
+	switch (op) { \
+	case AZO_SIMD_ADD: VECTOR_LOOP(W, STORE, ADD (A, B)); break; \
+	case AZO_SIMD_SUBTRACT: VECTOR_LOOP(W, STORE, SUB (A, B)); break; \
+	case AZO_SIMD_MULTIPLY: VECTOR_LOOP(W, STORE, MUL (A, B)); break; \
+	case AZO_SIMD_DIVIDE: VECTOR_LOOP(W, STORE, DIV (A, B)); break; \
+	case AZO_SIMD_MIN: VECTOR_LOOP(W, STORE, MIN (A, B)); break; \
+	case AZO_SIMD_MAX: VECTOR_LOOP(W, STORE, MAX (A, B)); break; \
+	}
+
+/* Double */
+
+static unsigned int TARGET_SSE2
+binary_f64_sse2 (unsigned int op, unsigned int mode, double *d, const double *a, const double *b, double k, unsigned int n)
+{
+	unsigned int i = 0;
+	__m128d kv = _mm_set1_pd (k);
+	if (mode == 0) {
+		VECTOR_OPS(2, _mm_storeu_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, _mm_min_pd, _mm_max_pd, _mm_loadu_pd (a + i), _mm_loadu_pd (b + i))
+	} else if (mode == 1) {
+		VECTOR_OPS(2, _mm_storeu_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, _mm_min_pd, _mm_max_pd, _mm_loadu_pd (a + i), kv)
+	} else {
+		VECTOR_OPS(2, _mm_storeu_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, _mm_min_pd, _mm_max_pd, kv, _mm_loadu_pd (a + i))
+	}
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+binary_f64_avx2 (unsigned int op, unsigned int mode, double *d, const double *a, const double *b, double k, unsigned int n)
+{
+	unsigned int i = 0;
+	__m256d kv = _mm256_set1_pd (k);
+	if (mode == 0) {
+		VECTOR_OPS(4, _mm256_storeu_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, _mm256_min_pd, _mm256_max_pd, _mm256_loadu_pd (a + i), _mm256_loadu_pd (b + i))
+	} else if (mode == 1) {
+		VECTOR_OPS(4, _mm256_storeu_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, _mm256_min_pd, _mm256_max_pd, _mm256_loadu_pd (a + i), kv)
+	} else {
+		VECTOR_OPS(4, _mm256_storeu_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, _mm256_min_pd, _mm256_max_pd, kv, _mm256_loadu_pd (a + i))
+	}
+	return i;
+}
+
+static unsigned int TARGET_SSE2
+dot_f64_sse2 (const double *a, const double *b, unsigned int n, double *s)
+{
+	unsigned int i = 0;
+	double v[2];
+	__m128d acc = _mm_setzero_pd ();
+	for (; (i + 2) <= n; i += 2) {
+		__m128d x = _mm_loadu_pd (a + i);
+		acc = _mm_add_pd (acc, (b) ? _mm_mul_pd (x, _mm_loadu_pd (b + i)) : x);
+	}
+	_mm_storeu_pd (v, acc);
+	*s = v[0] + v[1];
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+dot_f64_avx2 (const double *a, const double *b, unsigned int n, double *s)
+{
+	unsigned int i = 0;
+	double v[4];
+	__m256d acc = _mm256_setzero_pd ();
+	for (; (i + 4) <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd (a + i);
+		acc = _mm256_add_pd (acc, (b) ? _mm256_mul_pd (x, _mm256_loadu_pd (b + i)) : x);
+	}
+	_mm256_storeu_pd (v, acc);
+	*s = (v[0] + v[1]) + (v[2] + v[3]);
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+min_max_f64_avx2 (const double *a, unsigned int n, double *min, double *max)
+{
+	unsigned int i = 0;
+	double lo[4], hi[4];
+	__m256d vmin = _mm256_set1_pd (*min);
+	__m256d vmax = _mm256_set1_pd (*max);
+	for (; (i + 4) <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd (a + i);
+		vmin = _mm256_min_pd (x, vmin);
+		vmax = _mm256_max_pd (x, vmax);
+	}
+	_mm256_storeu_pd (lo, vmin);
+	_mm256_storeu_pd (hi, vmax);
+	min_max_f64 (lo, 4, min, max);
+	min_max_f64 (hi, 4, min, max);
+	return i;
+}
+
+/* Float, sums are accumulated in double */
+
+static unsigned int TARGET_SSE2
+binary_f32_sse2 (unsigned int op, unsigned int mode, float *d, const float *a, const float *b, float k, unsigned int n)
+{
+	unsigned int i = 0;
+	__m128 kv = _mm_set1_ps (k);
+	if (mode == 0) {
+		VECTOR_OPS(4, _mm_storeu_ps, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_div_ps, _mm_min_ps, _mm_max_ps, _mm_loadu_ps (a + i), _mm_loadu_ps (b + i))
+	} else if (mode == 1) {
+		VECTOR_OPS(4, _mm_storeu_ps, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_div_ps, _mm_min_ps, _mm_max_ps, _mm_loadu_ps (a + i), kv)
+	} else {
+		VECTOR_OPS(4, _mm_storeu_ps, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_div_ps, _mm_min_ps, _mm_max_ps, kv, _mm_loadu_ps (a + i))
+	}
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+binary_f32_avx2 (unsigned int op, unsigned int mode, float *d, const float *a, const float *b, float k, unsigned int n)
+{
+	unsigned int i = 0;
+	__m256 kv = _mm256_set1_ps (k);
+	if (mode == 0) {
+		VECTOR_OPS(8, _mm256_storeu_ps, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_min_ps, _mm256_max_ps, _mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i))
+	} else if (mode == 1) {
+		VECTOR_OPS(8, _mm256_storeu_ps, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_min_ps, _mm256_max_ps, _mm256_loadu_ps (a + i), kv)
+	} else {
+		VECTOR_OPS(8, _mm256_storeu_ps, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_min_ps, _mm256_max_ps, kv, _mm256_loadu_ps (a + i))
+	}
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+dot_f32_avx2 (const float *a, const float *b, unsigned int n, double *s)
+{
+	unsigned int i = 0;
+	double v[4];
+	__m256d acc = _mm256_setzero_pd ();
+	for (; (i + 4) <= n; i += 4) {
+		__m256d x = _mm256_cvtps_pd (_mm_loadu_ps (a + i));
+		acc = _mm256_add_pd (acc, (b) ? _mm256_mul_pd (x, _mm256_cvtps_pd (_mm_loadu_ps (b + i))) : x);
+	}
+	_mm256_storeu_pd (v, acc);
+	*s = (v[0] + v[1]) + (v[2] + v[3]);
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+min_max_f32_avx2 (const float *a, unsigned int n, float *min, float *max)
+{
+	unsigned int i = 0;
+	float lo[8], hi[8];
+	__m256 vmin = _mm256_set1_ps (*min);
+	__m256 vmax = _mm256_set1_ps (*max);
+	for (; (i + 8) <= n; i += 8) {
+		__m256 x = _mm256_loadu_ps (a + i);
+		vmin = _mm256_min_ps (x, vmin);
+		vmax = _mm256_max_ps (x, vmax);
+	}
+	_mm256_storeu_ps (lo, vmin);
+	_mm256_storeu_ps (hi, vmax);
+	min_max_f32 (lo, 8, min, max);
+	min_max_f32 (hi, 8, min, max);
+	return i;
+}
+
+/* Int32, there is no vector division */
+
+#define VECTOR_OPS_I32(W,STORE,ADD,SUB,MUL,MIN,MAX,A,B) \
+	switch (op) { \
+	case AZO_SIMD_ADD: VECTOR_LOOP(W, STORE, ADD (A, B)); break; \
+	case AZO_SIMD_SUBTRACT: VECTOR_LOOP(W, STORE, SUB (A, B)); break; \
+	case AZO_SIMD_MULTIPLY: VECTOR_LOOP(W, STORE, MUL (A, B)); break; \
+	case AZO_SIMD_MIN: VECTOR_LOOP(W, STORE, MIN (A, B)); break; \
+	case AZO_SIMD_MAX: VECTOR_LOOP(W, STORE, MAX (A, B)); break; \
+	}
+
+#define LOAD_I32(p) _mm256_loadu_si256 ((const __m256i *) (p))
+#define STORE_I32(p,v) _mm256_storeu_si256 ((__m256i *) (p), v)
+
+static unsigned int TARGET_AVX2
+binary_i32_avx2 (unsigned int op, unsigned int mode, int32_t *d, const int32_t *a, const int32_t *b, int32_t k, unsigned int n)
+{
+	unsigned int i = 0;
+	__m256i kv = _mm256_set1_epi32 (k);
+	if (mode == 0) {
+		VECTOR_OPS_I32(8, STORE_I32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_mullo_epi32, _mm256_min_epi32, _mm256_max_epi32, LOAD_I32 (a + i), LOAD_I32 (b + i))
+	} else if (mode == 1) {
+		VECTOR_OPS_I32(8, STORE_I32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_mullo_epi32, _mm256_min_epi32, _mm256_max_epi32, LOAD_I32 (a + i), kv)
+	} else {
+		VECTOR_OPS_I32(8, STORE_I32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_mullo_epi32, _mm256_min_epi32, _mm256_max_epi32, kv, LOAD_I32 (a + i))
+	}
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+sum_i32_avx2 (const int32_t *a, unsigned int n, int64_t *s)
+{
+	unsigned int i = 0;
+	uint64_t v[4];
+	__m256i acc = _mm256_setzero_si256 ();
+	for (; (i + 4) <= n; i += 4) {
+		acc = _mm256_add_epi64 (acc, _mm256_cvtepi32_epi64 (_mm_loadu_si128 ((const __m128i *) (a + i))));
+	}
+	_mm256_storeu_si256 ((__m256i *) v, acc);
+	*s = (int64_t) (v[0] + v[1] + v[2] + v[3]);
+	return i;
+}
+
+static unsigned int TARGET_AVX2
+min_max_i32_avx2 (const int32_t *a, unsigned int n, int32_t *min, int32_t *max)
+{
+	unsigned int i = 0;
+	int32_t lo[8], hi[8];
+	__m256i vmin = _mm256_set1_epi32 (*min);
+	__m256i vmax = _mm256_set1_epi32 (*max);
+	for (; (i + 8) <= n; i += 8) {
+		__m256i x = LOAD_I32 (a + i);
+		vmin = _mm256_min_epi32 (vmin, x);
+		vmax = _mm256_max_epi32 (vmax, x);
+	}
+	STORE_I32 (lo, vmin);
+	STORE_I32 (hi, vmax);
+	min_max_i32 (lo, 8, min, max);
+	min_max_i32 (hi, 8, min, max);
+	return i;
+}
+
+#endif
+
+/* mode 0 is a op b, 1 is a op k, 2 is k op a */
+
+static void
+binary_any (unsigned int type, unsigned int op, unsigned int mode, void *d, const void *a, const void *b, const AZValue *k, unsigned int n)
+{
+	unsigned int i = 0;
+	switch (type) {
+	case AZ_TYPE_INT32: {
+		int32_t kv = (k) ? k->int32_v : 0;
+#ifdef AZO_SIMD_X86
+		if ((op != AZO_SIMD_DIVIDE) && (azo_simd_get_level () >= AZO_SIMD_AVX2)) i = binary_i32_avx2 (op, mode, d, a, b, kv, n);
+#endif
+		if (mode == 0) {
+			binary_i32 (op, (int32_t *) d + i, (const int32_t *) a + i, (const int32_t *) b + i, n - i);
+		} else if (mode == 1) {
+			binary_scalar_i32 (op, (int32_t *) d + i, (const int32_t *) a + i, kv, n - i);
+		} else {
+			scalar_binary_i32 (op, (int32_t *) d + i, kv, (const int32_t *) a + i, n - i);
+		}
+		break;
+	}
+	case AZ_TYPE_UINT32: {
+		uint32_t kv = (k) ? k->uint32_v : 0;
+		if (mode == 0) {
+			binary_u32 (op, d, a, b, n);
+		} else if (mode == 1) {
+			binary_scalar_u32 (op, d, a, kv, n);
+		} else {
+			scalar_binary_u32 (op, d, kv, a, n);
+		}
+		break;
+	}
+	case AZ_TYPE_INT64: {
+		int64_t kv = (k) ? k->int64_v : 0;
+		if (mode == 0) {
+			binary_i64 (op, d, a, b, n);
+		} else if (mode == 1) {
+			binary_scalar_i64 (op, d, a, kv, n);
+		} else {
+			scalar_binary_i64 (op, d, kv, a, n);
+		}
+		break;
+	}
+	case AZ_TYPE_FLOAT: {
+		float kv = (k) ? k->float_v : 0;
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) {
+			i = binary_f32_avx2 (op, mode, d, a, b, kv, n);
+		} else if (azo_simd_get_level () >= AZO_SIMD_SSE2) {
+			i = binary_f32_sse2 (op, mode, d, a, b, kv, n);
+		}
+#endif
+		if (mode == 0) {
+			binary_f32 (op, (float *) d + i, (const float *) a + i, (const float *) b + i, n - i);
+		} else if (mode == 1) {
+			binary_scalar_f32 (op, (float *) d + i, (const float *) a + i, kv, n - i);
+		} else {
+			scalar_binary_f32 (op, (float *) d + i, kv, (const float *) a + i, n - i);
+		}
+		break;
+	}
+	case AZ_TYPE_DOUBLE: {
+		double kv = (k) ? k->double_v : 0;
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) {
+			i = binary_f64_avx2 (op, mode, d, a, b, kv, n);
+		} else if (azo_simd_get_level () >= AZO_SIMD_SSE2) {
+			i = binary_f64_sse2 (op, mode, d, a, b, kv, n);
+		}
+#endif
+		if (mode == 0) {
+			binary_f64 (op, (double *) d + i, (const double *) a + i, (const double *) b + i, n - i);
+		} else if (mode == 1) {
+			binary_scalar_f64 (op, (double *) d + i, (const double *) a + i, kv, n - i);
+		} else {
+			scalar_binary_f64 (op, (double *) d + i, kv, (const double *) a + i, n - i);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void
+azo_simd_binary (unsigned int type, unsigned int op, void *d, const void *a, const void *b, unsigned int n)
+{
+	binary_any (type, op, 0, d, a, b, NULL, n);
+}
+
+void
+azo_simd_binary_scalar (unsigned int type, unsigned int op, void *d, const void *a, const AZValue *k, unsigned int n)
+{
+	binary_any (type, op, 1, d, a, NULL, k, n);
+}
+
+void
+azo_simd_scalar_binary (unsigned int type, unsigned int op, void *d, const AZValue *k, const void *a, unsigned int n)
+{
+	binary_any (type, op, 2, d, a, NULL, k, n);
+}
+
+/* b is NULL for sum */
+
+static unsigned int
+reduce_any (unsigned int type, const void *a, const void *b, unsigned int n, AZValue *result)
+{
+	unsigned int i = 0;
+	switch (type) {
+	case AZ_TYPE_INT32: {
+		int64_t s = 0;
+#ifdef AZO_SIMD_X86
+		if (!b && (azo_simd_get_level () >= AZO_SIMD_AVX2)) i = sum_i32_avx2 (a, n, &s);
+#endif
+		s = (int64_t) ((uint64_t) s + (uint64_t) ((b) ? dot_i32 (a, b, n) : sum_i32 ((const int32_t *) a + i, n - i)));
+		result->int64_v = s;
+		return AZ_TYPE_INT64;
+	}
+	case AZ_TYPE_UINT32:
+		result->int64_v = (b) ? dot_u32 (a, b, n) : sum_u32 (a, n);
+		return AZ_TYPE_INT64;
+	case AZ_TYPE_INT64:
+		result->int64_v = (b) ? dot_i64 (a, b, n) : sum_i64 (a, n);
+		return AZ_TYPE_INT64;
+	case AZ_TYPE_FLOAT: {
+		double s = 0;
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) i = dot_f32_avx2 (a, b, n, &s);
+#endif
+		s += (b) ? dot_f32 ((const float *) a + i, (const float *) b + i, n - i) : sum_f32 ((const float *) a + i, n - i);
+		result->double_v = s;
+		return AZ_TYPE_DOUBLE;
+	}
+	case AZ_TYPE_DOUBLE: {
+		double s = 0;
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) {
+			i = dot_f64_avx2 (a, b, n, &s);
+		} else if (azo_simd_get_level () >= AZO_SIMD_SSE2) {
+			i = dot_f64_sse2 (a, b, n, &s);
+		}
+#endif
+		s += (b) ? dot_f64 ((const double *) a + i, (const double *) b + i, n - i) : sum_f64 ((const double *) a + i, n - i);
+		result->double_v = s;
+		return AZ_TYPE_DOUBLE;
+	}
+	default:
+		break;
+	}
+	return AZ_TYPE_NONE;
+}
+
+unsigned int
+azo_simd_sum (unsigned int type, const void *a, unsigned int n, AZValue *result)
+{
+	return reduce_any (type, a, NULL, n, result);
+}
+
+unsigned int
+azo_simd_dot (unsigned int type, const void *a, const void *b, unsigned int n, AZValue *result)
+{
+	return reduce_any (type, a, b, n, result);
+}
+
+void
+azo_simd_min_max (unsigned int type, const void *a, unsigned int n, AZValue *min, AZValue *max)
+{
+	unsigned int i = 0;
+	switch (type) {
+	case AZ_TYPE_INT32:
+		min->int32_v = max->int32_v = *((const int32_t *) a);
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) i = min_max_i32_avx2 (a, n, &min->int32_v, &max->int32_v);
+#endif
+		min_max_i32 ((const int32_t *) a + i, n - i, &min->int32_v, &max->int32_v);
+		break;
+	case AZ_TYPE_UINT32:
+		min->uint32_v = max->uint32_v = *((const uint32_t *) a);
+		min_max_u32 (a, n, &min->uint32_v, &max->uint32_v);
+		break;
+	case AZ_TYPE_INT64:
+		min->int64_v = max->int64_v = *((const int64_t *) a);
+		min_max_i64 (a, n, &min->int64_v, &max->int64_v);
+		break;
+	case AZ_TYPE_FLOAT:
+		min->float_v = max->float_v = *((const float *) a);
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) i = min_max_f32_avx2 (a, n, &min->float_v, &max->float_v);
+#endif
+		min_max_f32 ((const float *) a + i, n - i, &min->float_v, &max->float_v);
+		break;
+	case AZ_TYPE_DOUBLE:
+		min->double_v = max->double_v = *((const double *) a);
+#ifdef AZO_SIMD_X86
+		if (azo_simd_get_level () >= AZO_SIMD_AVX2) i = min_max_f64_avx2 (a, n, &min->double_v, &max->double_v);
+#endif
+		min_max_f64 ((const double *) a + i, n - i, &min->double_v, &max->double_v);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef __AZO_SIMD_H__
+#define __AZO_SIMD_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <az/value.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Element kernels for contiguous numeric arrays
+ *
+ * Element type is one of AZ_TYPE_INT32, AZ_TYPE_UINT32, AZ_TYPE_INT64, AZ_TYPE_FLOAT or AZ_TYPE_DOUBLE.
+ * Implementation is selected once by runtime CPU detection (SSE2 or AVX2 on x86), other
+ * architectures use plain loops.
+ */
+
+/* Instruction set levels */
+enum {
+	AZO_SIMD_NONE,
+	AZO_SIMD_SSE2,
+	AZO_SIMD_AVX2
+};
+
+/* Elementwise operations */
+enum {
+	AZO_SIMD_ADD,
+	AZO_SIMD_SUBTRACT,
+	AZO_SIMD_MULTIPLY,
+	AZO_SIMD_DIVIDE,
+	AZO_SIMD_MIN,
+	AZO_SIMD_MAX,
+	AZO_SIMD_NUM_OPS
+};
+
+/* Detected instruction set */
+unsigned int azo_simd_get_level (void);
+
+/* Whether the type can be element of numeric array */
+unsigned int azo_simd_is_element_type (unsigned int type);
+
+/**
+ * @brief Sum of elements
+ *
+ * Integer arrays are summed into int64 (result type is AZ_TYPE_INT64), real arrays into double.
+ *
+ * @return the type of result
+ */
+unsigned int azo_simd_sum (unsigned int type, const void *a, unsigned int n, AZValue *result);
+/* Dot product, result type follows the same rules as for sum */
+unsigned int azo_simd_dot (unsigned int type, const void *a, const void *b, unsigned int n, AZValue *result);
+/* Minimum and maximum of elements, values are of element type, n has to be at least 1 */
+void azo_simd_min_max (unsigned int type, const void *a, unsigned int n, AZValue *min, AZValue *max);
+
+/* d[i] = a[i] op b[i], d may be the same as a or b, integer division has to be tested by caller */
+void azo_simd_binary (unsigned int type, unsigned int op, void *d, const void *a, const void *b, unsigned int n);
+/* d[i] = a[i] op k, k is of element type */
+void azo_simd_binary_scalar (unsigned int type, unsigned int op, void *d, const void *a, const AZValue *k, unsigned int n);
+/* d[i] = k op a[i], k is of element type */
+void azo_simd_scalar_binary (unsigned int type, unsigned int op, void *d, const AZValue *k, const void *a, unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -71,6 +71,7 @@ stack_init (AZOStackClass *klass, AZOStack *stack)
 	stack->size = 256;
 	stack->impls = (const AZImplementation **) malloc (stack->size * sizeof (AZImplementation *));
 	stack->values = (AZStackEntry *) malloc (stack->size * sizeof (AZStackEntry));
+	stack->borrowed = (uint8_t *) malloc (stack->size);
 	stack->values[0].ptr = stack->data;
 }
 
@@ -79,10 +80,11 @@ stack_finalize (AZOStackClass *klass, AZOStack *stack)
 {
 	unsigned int i;
 	for (i = 0; i < stack->length; i++) {
-		if (azo_stack_impl (stack, i)) az_value_clear (azo_stack_impl (stack, i), azo_stack_value (stack, i));
+		if (azo_stack_impl (stack, i) && !stack->borrowed[i]) az_value_clear (azo_stack_impl (stack, i), azo_stack_value (stack, i));
 	}
 	free ((void *) stack->impls);
 	free (stack->values);
+	free (stack->borrowed);
 	free (stack->data);
 }
 
@@ -95,6 +97,7 @@ stack_ensure_size (AZOStack *stack, unsigned int n_entries, unsigned int data_si
 		if ((stack->length + n_entries + 1) >= stack->size) stack->size = stack->length + n_entries + 1;
 		stack->impls = (const AZImplementation **) realloc ((void *) stack->impls, stack->size * sizeof (AZImplementation *));
 		stack->values = (AZStackEntry *) realloc (stack->values, stack->size * sizeof (AZStackEntry));
+		stack->borrowed = (uint8_t *) realloc (stack->borrowed, stack->size);
 	}
 	if ((stack->values[stack->length].ptr + data_size) >= (stack->data + stack->data_size)) {
 		stack->data_size = stack->data_size << 1;
@@ -122,6 +125,7 @@ azo_stack_pop (AZOStack *stack, unsigned int n_data)
 	arikkei_return_if_fail (n_data <= stack->length);
 	for (i = 0; i < n_data; i++) {
 		stack->length -= 1;
+		if (stack->borrowed[stack->length]) continue;
 		az_value_clear (azo_stack_impl (stack, stack->length), azo_stack_value (stack, stack->length));
 	}
 }
@@ -132,6 +136,7 @@ azo_stack_remove (AZOStack *stack, unsigned int first, unsigned int n_data)
 	unsigned int i;
 	arikkei_return_if_fail ((first + n_data) <= stack->length);
 	for (i = 0; i < n_data; i++) {
+		if (stack->borrowed[first + i]) continue;
 		az_value_clear (azo_stack_impl (stack, first + i), azo_stack_value (stack, first + i));
 	}
 	if ((first + n_data) < stack->length) {
@@ -147,6 +152,7 @@ azo_stack_remove (AZOStack *stack, unsigned int first, unsigned int n_data)
 		memmove ((unsigned char *) start, mid, end - mid);
 		for (i = 0; i <= n_tail; i++) {
 			stack->impls[first + i] = stack->impls[first + n_data + i];
+			if (i < n_tail) stack->borrowed[first + i] = stack->borrowed[first + n_data + i];
 			stack->values[first + i].ptr = stack->values[first + n_data + i].ptr - (mid - start);
 		}
 	}
@@ -158,6 +164,7 @@ azo_stack_push_value_default (AZOStack *stack, const AZImplementation *impl)
 {
 	unsigned int size;
 	stack->impls[stack->length] = impl;
+	stack->borrowed[stack->length] = 0;
 	if (impl) {
 		size = STACK_IMPL_VALUE_SIZE(impl);
 		stack_ensure_size (stack, 1, size);
@@ -175,6 +182,7 @@ azo_stack_push_value (AZOStack *stack, const AZImplementation *impl, const void
 {
 	unsigned int size;
 	stack->impls[stack->length] = impl;
+	stack->borrowed[stack->length] = 0;
 	if (impl) {
 		size = STACK_IMPL_VALUE_SIZE(impl);
 		stack_ensure_size (stack, 1, size);
@@ -192,6 +200,7 @@ azo_stack_push_value_transfer (AZOStack *stack, const AZImplementation *impl, vo
 {
 	unsigned int size;
 	stack->impls[stack->length] = impl;
+	stack->borrowed[stack->length] = 0;
 	if (impl) {
 		size = STACK_VALUE_SIZE(AZ_CLASS_FROM_IMPL(impl));
 		stack_ensure_size (stack, 1, size);
@@ -209,6 +218,7 @@ azo_stack_push_instance (AZOStack *stack, const AZImplementation *impl, void *in
 {
 	unsigned int size;
 	stack->impls[stack->length] = impl;
+	stack->borrowed[stack->length] = 0;
 	if (impl) {
 		size = STACK_VALUE_SIZE(AZ_CLASS_FROM_IMPL(impl));
 		stack_ensure_size (stack, 1, size);
@@ -221,10 +231,32 @@ azo_stack_push_instance (AZOStack *stack, const AZImplementation *impl, void *in
 	stack->length += 1;
 }
 
+void
+azo_stack_push_value_borrowed (AZOStack *stack, const AZImplementation *impl, const void *value)
+{
+	if (!impl || !az_type_is_a (AZ_IMPL_TYPE(impl), AZ_TYPE_REFERENCE)) {
+		azo_stack_push_value (stack, impl, value);
+		return;
+	}
+	/* Value may be on stack itself (duplicate) */
+	AZReference *ref = ((const AZValue *) value)->reference;
+	unsigned int size = STACK_IMPL_VALUE_SIZE(impl);
+	stack_ensure_size (stack, 1, size);
+	stack->impls[stack->length] = impl;
+	stack->borrowed[stack->length] = 1;
+	azo_stack_value (stack, stack->length)->reference = ref;
+	stack->values[stack->length + 1].ptr = stack->values[stack->length].ptr + size;
+	stack->length += 1;
+}
+
 void
 azo_stack_duplicate (AZOStack *stack, unsigned int pos)
 {
-	azo_stack_push_value (stack, azo_stack_impl (stack, pos), azo_stack_value (stack, pos));
+	if (stack->borrowed[pos]) {
+		azo_stack_push_value_borrowed (stack, azo_stack_impl (stack, pos), azo_stack_value (stack, pos));
+	} else {
+		azo_stack_push_value (stack, azo_stack_impl (stack, pos), azo_stack_value (stack, pos));
+	}
 }
 
 void
@@ -232,7 +264,11 @@ azo_stack_exchange (AZOStack *stack, unsigned int pos)
 {
 	unsigned int size_a, size_b;
 	const AZImplementation *impl;
+	uint8_t borrowed;
 	arikkei_return_if_fail (pos < stack->length - 1);
+	borrowed = stack->borrowed[pos];
+	stack->borrowed[pos] = stack->borrowed[stack->length - 1];
+	stack->borrowed[stack->length - 1] = borrowed;
 	size_a = STACK_IMPL_VALUE_SIZE(azo_stack_impl(stack, pos));
 	size_b = STACK_IMPL_VALUE_SIZE(azo_stack_impl(stack, stack->length - 1));
 	if (size_a == size_b) {
@@ -291,6 +327,13 @@ azo_stack_convert (AZOStack *stack, unsigned int pos, unsigned int to_type)
 	AZClass *klass;
 	arikkei_return_val_if_fail (pos < stack->length, 0);
 	klass = az_type_get_class (to_type);
+	if (stack->borrowed[pos] && !az_type_is_a (azo_stack_type (stack, pos), to_type)) {
+		/* Conversion may release the original value, so entry has to own it first */
+		AZValue val;
+		az_value_copy (stack->impls[pos], &val, azo_stack_value (stack, pos));
+		azo_stack_value (stack, pos)->reference = val.reference;
+		stack->borrowed[pos] = 0;
+	}
 	stack_ensure_element_size (stack, pos, az_class_value_size(klass));
 	if (!az_value_convert_in_place (&stack->impls[pos], (AZValue *) stack->values[pos].ptr, to_type)) return 0;
 	return 1;
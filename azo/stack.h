@@ -37,6 +37,8 @@ struct _AZOStack {
 	/* Entries have (length + 1) elements, the last pointing to the first free value */
 	const AZImplementation *(*impls);
 	AZStackEntry *values;
+	/* Nonzero for entries that do not hold a reference (borrowed from constants that outlive them) */
+	uint8_t *borrowed;
 	unsigned int data_size;
 	unsigned char *data;
 };
@@ -61,6 +63,12 @@ void azo_stack_push_value_default (AZOStack *stack, const AZImplementation *impl
 void azo_stack_push_value (AZOStack *stack, const AZImplementation *impl, const void *value);
 void azo_stack_push_value_transfer (AZOStack *stack, const AZImplementation *impl, void *value);
 void azo_stack_push_instance (AZOStack *stack, const AZImplementation *impl, void *inst);
+/*
+ * Push reference without changing its refcount, other values are copied
+ * The owner of value (program constant or closure environment) has to outlive the entry. Object refcounts
+ * are not atomic, so this keeps interpreters of different threads from touching shared constants.
+ */
+void azo_stack_push_value_borrowed (AZOStack *stack, const AZImplementation *impl, const void *value);
 
 static inline void
 azo_stack_push_u32(AZOStack *stack, uint32_t val)
@@ -0,0 +1,106 @@
+#define __AZO_SYMBOL_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <azo/symbol.h>
+
+/* Symbols can be interned from any thread */
+static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+/* Keys by id, 0 is unused */
+static AZString **keys = NULL;
+static unsigned int n_keys = 1;
+static unsigned int keys_size = 0;
+/* Open addressing table of ids, 0 is empty slot, size is power of 2 */
+static unsigned int *slots = NULL;
+static unsigned int n_slots = 0;
+
+static unsigned int
+find_slot (const AZString *key)
+{
+	unsigned int mask = n_slots - 1;
+	unsigned int slot = azo_symbol_hash (key) & mask;
+	while (slots[slot] && (keys[slots[slot]] != key)) slot = (slot + 1) & mask;
+	return slot;
+}
+
+static void
+grow_slots (void)
+{
+	free (slots);
+	n_slots = (n_slots) ? n_slots << 1 : 256;
+	slots = (unsigned int *) malloc (n_slots * sizeof (unsigned int));
+	memset (slots, 0, n_slots * sizeof (unsigned int));
+	for (unsigned int id = 1; id < n_keys; id++) {
+		slots[find_slot (keys[id])] = id;
+	}
+}
+
+static unsigned int
+symbol_lookup (const AZString *key)
+{
+	if (!n_slots) return 0;
+	return slots[find_slot (key)];
+}
+
+unsigned int
+azo_symbol_intern (AZString *key)
+{
+	pthread_rwlock_wrlock (&lock);
+	unsigned int id = symbol_lookup (key);
+	if (id) {
+		pthread_rwlock_unlock (&lock);
+		return id;
+	}
+	if (n_keys >= keys_size) {
+		keys_size = (keys_size) ? keys_size << 1 : 256;
+		keys = (AZString **) realloc (keys, keys_size * sizeof (AZString *));
+		keys[0] = NULL;
+	}
+	az_string_ref (key);
+	id = n_keys++;
+	keys[id] = key;
+	/* Keep load below 1/2 */
+	if ((2 * n_keys) > n_slots) {
+		grow_slots ();
+	} else {
+		slots[find_slot (key)] = id;
+	}
+	pthread_rwlock_unlock (&lock);
+	return id;
+}
+
+unsigned int
+azo_symbol_intern_str (const unsigned char *str)
+{
+	AZString *key = az_string_new (str);
+	unsigned int id = azo_symbol_intern (key);
+	az_string_unref (key);
+	return id;
+}
+
+unsigned int
+azo_symbol_lookup (const AZString *key)
+{
+	pthread_rwlock_rdlock (&lock);
+	unsigned int id = symbol_lookup (key);
+	pthread_rwlock_unlock (&lock);
+	return id;
+}
+
+AZString *
+azo_symbol_get_key (unsigned int id)
+{
+	AZString *key = NULL;
+	pthread_rwlock_rdlock (&lock);
+	if (id && (id < n_keys)) key = keys[id];
+	pthread_rwlock_unlock (&lock);
+	return key;
+}
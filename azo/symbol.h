@@ -0,0 +1,47 @@
+#ifndef __AZO_SYMBOL_H__
+#define __AZO_SYMBOL_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdint.h>
+
+#include <az/string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Symbol table
+ *
+ * AZ strings are unique by content, so equal keys are the same object. Symbol table holds a reference to every
+ * interned key, keeping its address unique for the lifetime of the process, and assigns it a dense id (starting
+ * from 1). Tables keyed by symbols hash and compare key pointers and never touch string data.
+ */
+
+/* Hash of interned key */
+static inline unsigned int
+azo_symbol_hash (const AZString *key)
+{
+	uint64_t h = (uint64_t) (uintptr_t) key;
+	h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+	return (unsigned int) (h ^ (h >> 32));
+}
+
+/* Intern key and return its id */
+unsigned int azo_symbol_intern (AZString *key);
+unsigned int azo_symbol_intern_str (const unsigned char *str);
+/* Get id of key, 0 if it is not interned */
+unsigned int azo_symbol_lookup (const AZString *key);
+/* Get key of symbol, the reference is not transferred */
+AZString *azo_symbol_get_key (unsigned int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,401 @@
+#define __AZO_TYPED_ARRAY_C__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <arikkei/arikkei-utils.h>
+
+#include <az/class.h>
+#include <az/field.h>
+#include <az/value.h>
+#include <az/extend.h>
+
+#include <azo/simd.h>
+#include <azo/typed-array.h>
+
+static void typed_array_class_init (AZOTypedArrayClass *klass);
+static void typed_array_finalize (AZOTypedArrayClass *klass, AZOTypedArray *tarray);
+
+/* AZCollection implementation */
+static unsigned int typed_array_get_size (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst);
+static unsigned int typed_array_contains (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst, const AZImplementation *impl, const void *inst);
+static const AZImplementation *typed_array_get_coll_element (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst, const AZValue *iter, AZValue *val, unsigned int size);
+/* AZList implementation */
+static const AZImplementation *typed_array_get_list_element (const AZListImplementation *list_impl, void *list_inst, unsigned int idx, AZValue *val, int size);
+
+/* Method implementations */
+static unsigned int typed_array_call_sum (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_dot (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_min (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_max (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_fill (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_scale (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_offset (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_add (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_subtract (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+static unsigned int typed_array_call_multiply (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx);
+
+enum {
+	/* Functions */
+	FUNC_SUM,
+	FUNC_DOT,
+	FUNC_MIN,
+	FUNC_MAX,
+	FUNC_FILL,
+	FUNC_SCALE,
+	FUNC_OFFSET,
+	FUNC_ADD,
+	FUNC_SUBTRACT,
+	FUNC_MULTIPLY,
+	NUM_FUNCTIONS,
+	/* Values */
+	PROP_LENGTH = NUM_FUNCTIONS,
+	NUM_PROPERTIES
+};
+
+/* Element types in the order of array types */
+enum {
+	ARRAY_INT32,
+	ARRAY_UINT32,
+	ARRAY_INT64,
+	ARRAY_FLOAT,
+	ARRAY_DOUBLE,
+	NUM_ARRAY_TYPES
+};
+
+static const struct {
+	const char *name;
+	unsigned int element_type;
+	unsigned int element_size;
+} array_types[] = {
+	{ "Int32Array", AZ_TYPE_INT32, 4 },
+	{ "Uint32Array", AZ_TYPE_UINT32, 4 },
+	{ "Int64Array", AZ_TYPE_INT64, 8 },
+	{ "FloatArray", AZ_TYPE_FLOAT, 4 },
+	{ "DoubleArray", AZ_TYPE_DOUBLE, 8 }
+};
+
+#define ELEMENT_SIZE(t) ((((t) == AZ_TYPE_INT64) || ((t) == AZ_TYPE_DOUBLE)) ? 8 : 4)
+
+unsigned int azo_typed_array_type = 0;
+static unsigned int subtypes[NUM_ARRAY_TYPES] = { 0 };
+
+unsigned int
+azo_typed_array_get_type (void)
+{
+	if (!azo_typed_array_type) {
+		az_register_type (&azo_typed_array_type, (const unsigned char *) "AZOTypedArray", AZ_TYPE_OBJECT, sizeof (AZOTypedArrayClass), sizeof (AZOTypedArray), AZ_FLAG_ABSTRACT | AZ_FLAG_ZERO_MEMORY, 1, NUM_PROPERTIES,
+			(void (*) (AZClass *)) typed_array_class_init,
+			NULL,
+			(void (*) (const AZImplementation *, void *)) typed_array_finalize);
+		for (unsigned int i = 0; i < NUM_ARRAY_TYPES; i++) {
+			az_register_type (&subtypes[i], (const unsigned char *) array_types[i].name, azo_typed_array_type, sizeof (AZOTypedArrayClass), sizeof (AZOTypedArray), AZ_FLAG_FINAL | AZ_FLAG_ZERO_MEMORY, 0, 0,
+				NULL, NULL, NULL);
+			AZOTypedArrayClass *klass = (AZOTypedArrayClass *) az_type_get_class (subtypes[i]);
+			klass->element_type = array_types[i].element_type;
+			klass->element_size = array_types[i].element_size;
+		}
+	}
+	return azo_typed_array_type;
+}
+
+static void
+typed_array_class_init (AZOTypedArrayClass *klass)
+{
+	az_class_declare_interface ((AZClass *) klass, 0, AZ_TYPE_LIST, ARIKKEI_OFFSET (AZOTypedArrayClass, list_impl), 0);
+	az_class_define_method_va ((AZClass *) klass, FUNC_SUM, (const unsigned char *) "sum", typed_array_call_sum, AZ_TYPE_ANY, 0);
+	az_class_define_method_va ((AZClass *) klass, FUNC_DOT, (const unsigned char *) "dot", typed_array_call_dot, AZ_TYPE_ANY, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_MIN, (const unsigned char *) "min", typed_array_call_min, AZ_TYPE_ANY, 0);
+	az_class_define_method_va ((AZClass *) klass, FUNC_MAX, (const unsigned char *) "max", typed_array_call_max, AZ_TYPE_ANY, 0);
+	az_class_define_method_va ((AZClass *) klass, FUNC_FILL, (const unsigned char *) "fill", typed_array_call_fill, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_SCALE, (const unsigned char *) "scale", typed_array_call_scale, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_OFFSET, (const unsigned char *) "offset", typed_array_call_offset, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_ADD, (const unsigned char *) "add", typed_array_call_add, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_SUBTRACT, (const unsigned char *) "subtract", typed_array_call_subtract, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_method_va ((AZClass *) klass, FUNC_MULTIPLY, (const unsigned char *) "multiply", typed_array_call_multiply, AZ_TYPE_NONE, 1, AZ_TYPE_ANY);
+	az_class_define_property ((AZClass *) klass, PROP_LENGTH, (const unsigned char *) "length", AZ_TYPE_UINT32, 0,
+		AZ_FIELD_INSTANCE, AZ_FIELD_READ_VALUE, AZ_FIELD_WRITE_NONE, ARIKKEI_OFFSET(AZOTypedArray,length), NULL, NULL);
+	/* Implementation */
+	klass->list_impl.collection_impl.get_size = typed_array_get_size;
+	klass->list_impl.collection_impl.contains = typed_array_contains;
+	klass->list_impl.collection_impl.get_element = typed_array_get_coll_element;
+	klass->list_impl.get_element = typed_array_get_list_element;
+}
+
+static void
+typed_array_finalize (AZOTypedArrayClass *klass, AZOTypedArray *tarray)
+{
+	if (tarray->data) free (tarray->data);
+}
+
+static unsigned int
+typed_array_get_size (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) coll_inst;
+	return tarray->length;
+}
+
+static unsigned int
+typed_array_contains (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst, const AZImplementation *impl, const void *inst)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) coll_inst;
+	if (!impl || (AZ_IMPL_TYPE(impl) != tarray->element_type)) return 0;
+	unsigned int size = ELEMENT_SIZE(tarray->element_type);
+	for (unsigned int i = 0; i < tarray->length; i++) {
+		if (!memcmp ((const char *) tarray->data + i * size, inst, size)) return 1;
+	}
+	return 0;
+}
+
+static const AZImplementation *
+typed_array_get_coll_element (const AZCollectionImplementation *coll_impl, AZCollection *coll_inst, const AZValue *iter, AZValue *val, unsigned int size)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) coll_inst;
+	return azo_typed_array_get_element (tarray, iter->uint32_v, val);
+}
+
+static const AZImplementation *
+typed_array_get_list_element (const AZListImplementation *list_impl, void *list_inst, unsigned int idx, AZValue *val, int size)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) list_inst;
+	return azo_typed_array_get_element (tarray, idx, val);
+}
+
+/* Convert numeric argument to element type */
+
+static unsigned int
+get_scalar (AZOTypedArray *tarray, const AZImplementation *impl, const AZValue *val, AZValue *k)
+{
+	if (!impl || (AZ_IMPL_TYPE(impl) < AZ_TYPE_INT8) || (AZ_IMPL_TYPE(impl) > AZ_TYPE_DOUBLE)) return 0;
+	memcpy (k, val, az_class_value_size (AZ_CLASS_FROM_IMPL(impl)));
+	return az_value_convert_in_place (&impl, k, tarray->element_type);
+}
+
+/* Get the other array of binary operation, it has to be of the same type and length */
+
+static AZOTypedArray *
+get_operand (AZOTypedArray *tarray, const AZImplementation *impl, const AZValue *val)
+{
+	if (!impl || !az_type_is_a (AZ_IMPL_TYPE(impl), AZO_TYPE_TYPED_ARRAY)) return NULL;
+	AZOTypedArray *other = (AZOTypedArray *) val->reference;
+	if ((other->element_type != tarray->element_type) || (other->length != tarray->length)) return NULL;
+	return other;
+}
+
+static unsigned int
+typed_array_call_sum (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	unsigned int type = azo_simd_sum (tarray->element_type, tarray->data, tarray->length, &ret_val->value);
+	*ret_impl = AZ_IMPL_FROM_TYPE(type);
+	return 1;
+}
+
+static unsigned int
+typed_array_call_dot (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZOTypedArray *other = get_operand (tarray, arg_impls[1], arg_vals[1]);
+	if (!other) return 0;
+	unsigned int type = azo_simd_dot (tarray->element_type, tarray->data, other->data, tarray->length, &ret_val->value);
+	*ret_impl = AZ_IMPL_FROM_TYPE(type);
+	return 1;
+}
+
+static unsigned int
+typed_array_call_min (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZValue max;
+	if (!tarray->length) {
+		*ret_impl = NULL;
+		return 1;
+	}
+	azo_simd_min_max (tarray->element_type, tarray->data, tarray->length, &ret_val->value, &max);
+	*ret_impl = AZ_IMPL_FROM_TYPE(tarray->element_type);
+	return 1;
+}
+
+static unsigned int
+typed_array_call_max (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZValue min;
+	if (!tarray->length) {
+		*ret_impl = NULL;
+		return 1;
+	}
+	azo_simd_min_max (tarray->element_type, tarray->data, tarray->length, &min, &ret_val->value);
+	*ret_impl = AZ_IMPL_FROM_TYPE(tarray->element_type);
+	return 1;
+}
+
+static unsigned int
+typed_array_call_fill (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZValue k;
+	if (!get_scalar (tarray, arg_impls[1], arg_vals[1], &k)) return 0;
+	unsigned int size = ELEMENT_SIZE(tarray->element_type);
+	for (unsigned int i = 0; i < tarray->length; i++) {
+		memcpy ((char *) tarray->data + i * size, &k, size);
+	}
+	*ret_impl = NULL;
+	return 1;
+}
+
+/* In-place elementwise operation with scalar */
+
+static unsigned int
+call_scalar_op (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, unsigned int op)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZValue k;
+	if (!get_scalar (tarray, arg_impls[1], arg_vals[1], &k)) return 0;
+	azo_simd_binary_scalar (tarray->element_type, op, tarray->data, tarray->data, &k, tarray->length);
+	*ret_impl = NULL;
+	return 1;
+}
+
+/* In-place elementwise operation with array */
+
+static unsigned int
+call_array_op (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, unsigned int op)
+{
+	AZOTypedArray *tarray = (AZOTypedArray *) arg_vals[0]->reference;
+	AZOTypedArray *other = get_operand (tarray, arg_impls[1], arg_vals[1]);
+	if (!other) return 0;
+	azo_simd_binary (tarray->element_type, op, tarray->data, tarray->data, other->data, tarray->length);
+	*ret_impl = NULL;
+	return 1;
+}
+
+static unsigned int
+typed_array_call_scale (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	return call_scalar_op (arg_impls, arg_vals, ret_impl, AZO_SIMD_MULTIPLY);
+}
+
+static unsigned int
+typed_array_call_offset (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	return call_scalar_op (arg_impls, arg_vals, ret_impl, AZO_SIMD_ADD);
+}
+
+static unsigned int
+typed_array_call_add (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	return call_array_op (arg_impls, arg_vals, ret_impl, AZO_SIMD_ADD);
+}
+
+static unsigned int
+typed_array_call_subtract (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	return call_array_op (arg_impls, arg_vals, ret_impl, AZO_SIMD_SUBTRACT);
+}
+
+static unsigned int
+typed_array_call_multiply (const AZImplementation **arg_impls, const AZValue **arg_vals, const AZImplementation **ret_impl, AZValue64 *ret_val, AZContext *ctx)
+{
+	return call_array_op (arg_impls, arg_vals, ret_impl, AZO_SIMD_MULTIPLY);
+}
+
+unsigned int
+azo_typed_array_get_type_for_element (unsigned int element_type)
+{
+	if (!azo_typed_array_type) azo_typed_array_get_type ();
+	for (unsigned int i = 0; i < NUM_ARRAY_TYPES; i++) {
+		if (array_types[i].element_type == element_type) return subtypes[i];
+	}
+	return 0;
+}
+
+AZOTypedArray *
+azo_typed_array_new (unsigned int element_type, unsigned int length)
+{
+	unsigned int type = azo_typed_array_get_type_for_element (element_type);
+	arikkei_return_val_if_fail (type != 0, NULL);
+	AZOTypedArrayClass *klass = (AZOTypedArrayClass *) az_type_get_class (type);
+	AZOTypedArray *tarray = (AZOTypedArray *) az_object_new (type);
+	tarray->element_type = element_type;
+	tarray->length = length;
+	if (length) tarray->data = calloc (length, klass->element_size);
+	return tarray;
+}
+
+AZOTypedArray *
+azo_typed_array_new_from_list (unsigned int element_type, const AZListImplementation *list_impl, void *list_inst)
+{
+	unsigned int length = az_collection_get_size (&list_impl->collection_impl, list_inst);
+	AZOTypedArray *tarray = azo_typed_array_new (element_type, length);
+	if (!tarray) return NULL;
+	for (unsigned int i = 0; i < length; i++) {
+		AZPackedValue64 val = { 0 };
+		val.impl = az_list_get_element (list_impl, list_inst, i, &val.v.value, 64);
+		unsigned int result = azo_typed_array_set_element (tarray, i, val.impl, &val.v.value);
+		az_packed_value_clear ((AZPackedValue *) &val);
+		if (!result) {
+			az_object_unref ((AZObject *) tarray);
+			return NULL;
+		}
+	}
+	return tarray;
+}
+
+const AZImplementation *
+azo_typed_array_get_element (AZOTypedArray *tarray, unsigned int idx, AZValue *val)
+{
+	switch (tarray->element_type) {
+	case AZ_TYPE_INT32:
+		val->int32_v = ((int32_t *) tarray->data)[idx];
+		break;
+	case AZ_TYPE_UINT32:
+		val->uint32_v = ((uint32_t *) tarray->data)[idx];
+		break;
+	case AZ_TYPE_INT64:
+		val->int64_v = ((int64_t *) tarray->data)[idx];
+		break;
+	case AZ_TYPE_FLOAT:
+		val->float_v = ((float *) tarray->data)[idx];
+		break;
+	case AZ_TYPE_DOUBLE:
+		val->double_v = ((double *) tarray->data)[idx];
+		break;
+	default:
+		return NULL;
+	}
+	return AZ_IMPL_FROM_TYPE(tarray->element_type);
+}
+
+unsigned int
+azo_typed_array_set_element (AZOTypedArray *tarray, unsigned int idx, const AZImplementation *impl, const AZValue *val)
+{
+	AZValue k;
+	if (!get_scalar (tarray, impl, val, &k)) return 0;
+	switch (tarray->element_type) {
+	case AZ_TYPE_INT32:
+		((int32_t *) tarray->data)[idx] = k.int32_v;
+		break;
+	case AZ_TYPE_UINT32:
+		((uint32_t *) tarray->data)[idx] = k.uint32_v;
+		break;
+	case AZ_TYPE_INT64:
+		((int64_t *) tarray->data)[idx] = k.int64_v;
+		break;
+	case AZ_TYPE_FLOAT:
+		((float *) tarray->data)[idx] = k.float_v;
+		break;
+	case AZ_TYPE_DOUBLE:
+		((double *) tarray->data)[idx] = k.double_v;
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
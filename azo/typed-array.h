@@ -0,0 +1,83 @@
+#ifndef __AZO_TYPED_ARRAY_H__
+#define __AZO_TYPED_ARRAY_H__
+
+/*
+* A languge implementation based on AZ
+*
+* Copyright (C) Lauris Kaplinski 2021
+*/
+
+#define AZO_TYPE_TYPED_ARRAY ((azo_typed_array_type) ? azo_typed_array_type : azo_typed_array_get_type ())
+#define AZO_TYPE_INT32_ARRAY azo_typed_array_get_type_for_element (AZ_TYPE_INT32)
+#define AZO_TYPE_UINT32_ARRAY azo_typed_array_get_type_for_element (AZ_TYPE_UINT32)
+#define AZO_TYPE_INT64_ARRAY azo_typed_array_get_type_for_element (AZ_TYPE_INT64)
+#define AZO_TYPE_FLOAT_ARRAY azo_typed_array_get_type_for_element (AZ_TYPE_FLOAT)
+#define AZO_TYPE_DOUBLE_ARRAY azo_typed_array_get_type_for_element (AZ_TYPE_DOUBLE)
+
+typedef struct _AZOTypedArray AZOTypedArray;
+typedef struct _AZOTypedArrayClass AZOTypedArrayClass;
+
+#include <az/collections/list.h>
+#include <az/object.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __AZO_TYPED_ARRAY_C__
+extern unsigned int azo_typed_array_type;
+#endif
+
+/*
+ * Fixed-size array of unboxed numbers
+ *
+ * Elements are stored contiguously, the element type is one of int32, uint32, int64, float or double
+ * and is determined by final subclass. Array implements list, elements are returned as values of element type.
+ */
+
+struct _AZOTypedArray {
+	AZObject object;
+	unsigned int element_type;
+	unsigned int length;
+	void *data;
+};
+
+struct _AZOTypedArrayClass {
+	AZObjectClass object_class;
+	AZListImplementation list_impl;
+	/* Set for final subclasses */
+	unsigned int element_type;
+	unsigned int element_size;
+};
+
+unsigned int azo_typed_array_get_type (void);
+/* Get the array type for element type, 0 if type is not supported */
+unsigned int azo_typed_array_get_type_for_element (unsigned int element_type);
+
+/* Create new array of given length, elements are set to zero */
+AZOTypedArray *azo_typed_array_new (unsigned int element_type, unsigned int length);
+/**
+ * @brief Create new array from the elements of list
+ *
+ * Elements are converted to element type.
+ *
+ * @return new array or NULL if some element cannot be converted
+ */
+AZOTypedArray *azo_typed_array_new_from_list (unsigned int element_type, const AZListImplementation *list_impl, void *list_inst);
+
+/* Get element, idx has to be less than length */
+const AZImplementation *azo_typed_array_get_element (AZOTypedArray *tarray, unsigned int idx, AZValue *val);
+/**
+ * @brief Set element
+ *
+ * The value is converted to element type, idx has to be less than length.
+ *
+ * @return 1 on success, 0 if value cannot be converted
+ */
+unsigned int azo_typed_array_set_element (AZOTypedArray *tarray, unsigned int idx, const AZImplementation *impl, const AZValue *val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif